@@ -0,0 +1,286 @@
+/*
+ * @file access_trace.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the writing and decoding of the raw access trace.
+ */
+
+#include <stdio.h>
+
+#include "access_trace.h"
+
+/** The maximum number of accesses in one ACCESS_TRACE_RECORD_ACCESSES record which the decoder accepts */
+static const uint64_t max_accesses_per_record = 1024 * 1024;
+
+access_trace_writer::access_trace_writer (trace_sink &sink)
+    : sink (sink), num_instructions (0)
+{
+    sink.write (access_trace_magic, access_trace_magic_length);
+}
+
+void access_trace_writer::start_record (access_trace_record_type record_type)
+{
+    record.clear();
+    record.push_back ((char) record_type);
+}
+
+/**
+ * @brief Append an unsigned LEB128 varint to the record
+ * @param[in] value The value to append
+ */
+void access_trace_writer::put_varint (uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        record.push_back ((char) ((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    record.push_back ((char) value);
+}
+
+/**
+ * @brief Append a string to the record, as the length followed by the characters
+ * @param[in] str The string to append
+ */
+void access_trace_writer::put_string (const std::string &str)
+{
+    put_varint (str.size());
+    record.insert (record.end(), str.begin(), str.end());
+}
+
+void access_trace_writer::write_record (void)
+{
+    sink.write (&record[0], record.size());
+}
+
+/**
+ * @brief Define one memory operand of a static instruction, which must be done before the first access by the operand
+ * @param[in] instruction The memory operand to define
+ * @return The index which the accesses by the operand refer to
+ */
+uint32_t access_trace_writer::instruction (const access_trace_instruction &instruction)
+{
+    start_record (ACCESS_TRACE_RECORD_INSTRUCTION);
+    put_varint (instruction.ip);
+    put_varint (instruction.mem_op);
+    put_varint (instruction.access_kind);
+    put_string (instruction.routine);
+    write_record ();
+
+    return num_instructions++;
+}
+
+void access_trace_writer::function_enter (const std::string &func_name)
+{
+    start_record (ACCESS_TRACE_RECORD_FUNCTION_ENTER);
+    put_string (func_name);
+    write_record ();
+}
+
+void access_trace_writer::function_exit (const std::string &func_name)
+{
+    start_record (ACCESS_TRACE_RECORD_FUNCTION_EXIT);
+    put_string (func_name);
+    write_record ();
+}
+
+/**
+ * @brief Write a block of accesses made by one thread
+ * @param[in] thread_id The thread which made the accesses
+ * @param[in] accesses The accesses, in the order they were made
+ * @param[in] num_accesses The number of accesses
+ */
+void access_trace_writer::accesses (const uint32_t thread_id, const access_trace_access accesses[],
+                                    const uint32_t num_accesses)
+{
+    uint64_t previous_addr = 0;
+
+    if (num_accesses == 0)
+    {
+        return;
+    }
+
+    start_record (ACCESS_TRACE_RECORD_ACCESSES);
+    put_varint (thread_id);
+    put_varint (num_accesses);
+    for (uint32_t access_index = 0; access_index < num_accesses; access_index++)
+    {
+        const access_trace_access &access = accesses[access_index];
+        const int64_t addr_delta = (int64_t) (access.addr - previous_addr);
+
+        put_varint (access.instruction_index);
+        put_varint (access.bytes_accessed);
+        put_varint (((uint64_t) addr_delta << 1) ^ (uint64_t) (addr_delta >> 63));
+        previous_addr = access.addr;
+    }
+    write_record ();
+}
+
+/** Reads the fields of records from an access trace */
+class access_trace_reader
+{
+public:
+    access_trace_reader (std::istream &input) : input (input), truncated (false) {}
+
+    /**
+     * @brief Read an unsigned LEB128 varint
+     * @return The value read, or zero if the input is truncated
+     */
+    uint64_t get_varint (void)
+    {
+        uint64_t value = 0;
+        uint32_t shift = 0;
+        int byte;
+
+        do
+        {
+            byte = input.get();
+            if (byte == EOF)
+            {
+                truncated = true;
+                return 0;
+            }
+            if (shift < 64)
+            {
+                value |= (uint64_t) (byte & 0x7f) << shift;
+            }
+            shift += 7;
+        } while ((byte & 0x80) != 0);
+
+        return value;
+    }
+
+    int64_t get_signed_varint (void)
+    {
+        const uint64_t value = get_varint ();
+
+        return (int64_t) ((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    /**
+     * @brief Read a string of the length given by a preceding varint
+     * @param[out] str The string read
+     */
+    void get_string (std::string &str)
+    {
+        const uint64_t length = get_varint ();
+
+        str.resize (truncated ? 0 : length);
+        if (!str.empty())
+        {
+            input.read (&str[0], str.size());
+            truncated = truncated || (input.gcount() != (std::streamsize) str.size());
+        }
+    }
+
+    std::istream &input;
+
+    /** Set when the input ends part way through a record */
+    bool truncated;
+};
+
+/**
+ * @brief Decode an access trace, passing each record to a handler
+ * @details The records before an error are passed to the handler.
+ * @param[in,out] input The access trace to decode
+ * @param[in,out] handler The handler to pass the decoded records to
+ * @param[out] error When returning false, describes why the access trace couldn't be decoded
+ * @return Returns true if the access trace was decoded, or false if it is invalid
+ */
+bool decode_access_trace (std::istream &input, access_trace_handler &handler, std::string &error)
+{
+    access_trace_reader reader (input);
+    char magic[access_trace_magic_length];
+    uint32_t num_instructions = 0;
+    std::vector<access_trace_access> accesses;
+    access_trace_instruction instruction;
+    std::string func_name;
+    int record_type;
+
+    input.read (magic, access_trace_magic_length);
+    if ((input.gcount() != (std::streamsize) access_trace_magic_length) ||
+        (std::string (magic, access_trace_magic_length) != access_trace_magic))
+    {
+        error = "not an access trace";
+        return false;
+    }
+
+    while ((record_type = input.get()) != EOF)
+    {
+        switch (record_type)
+        {
+        case ACCESS_TRACE_RECORD_INSTRUCTION:
+            instruction.ip = reader.get_varint ();
+            instruction.mem_op = reader.get_varint ();
+            instruction.access_kind = reader.get_varint ();
+            reader.get_string (instruction.routine);
+            if (!reader.truncated)
+            {
+                handler.instruction (num_instructions, instruction);
+                num_instructions++;
+            }
+            break;
+
+        case ACCESS_TRACE_RECORD_FUNCTION_ENTER:
+        case ACCESS_TRACE_RECORD_FUNCTION_EXIT:
+            reader.get_string (func_name);
+            if (!reader.truncated)
+            {
+                if (record_type == ACCESS_TRACE_RECORD_FUNCTION_ENTER)
+                {
+                    handler.function_enter (func_name);
+                }
+                else
+                {
+                    handler.function_exit (func_name);
+                }
+            }
+            break;
+
+        case ACCESS_TRACE_RECORD_ACCESSES:
+            {
+                const uint32_t thread_id = reader.get_varint ();
+                const uint64_t num_accesses = reader.get_varint ();
+                uint64_t previous_addr = 0;
+
+                if (num_accesses > max_accesses_per_record)
+                {
+                    error = "invalid number of accesses in accesses record";
+                    return false;
+                }
+                accesses.resize (num_accesses);
+                for (uint32_t access_index = 0; !reader.truncated && (access_index < num_accesses); access_index++)
+                {
+                    access_trace_access &access = accesses[access_index];
+
+                    access.instruction_index = reader.get_varint ();
+                    access.bytes_accessed = reader.get_varint ();
+                    access.addr = previous_addr + reader.get_signed_varint ();
+                    previous_addr = access.addr;
+                    if (!reader.truncated && (access.instruction_index >= num_instructions))
+                    {
+                        error = "access by an undefined instruction";
+                        return false;
+                    }
+                }
+                if (!reader.truncated && (num_accesses > 0))
+                {
+                    handler.accesses (thread_id, &accesses[0], num_accesses);
+                }
+            }
+            break;
+
+        default:
+            error = "unknown record type";
+            return false;
+        }
+
+        if (reader.truncated)
+        {
+            error = "truncated record at end of trace";
+            return false;
+        }
+    }
+
+    return true;
+}
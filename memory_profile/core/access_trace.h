@@ -0,0 +1,112 @@
+/*
+ * @file access_trace.h
+ * @date 16 Oct 2026
+ * @details
+ *  Defines the raw access trace, which records the memory accesses made while top-level functions are active.
+ *  The memory_profile_replay program replays the accesses through the analyses at native speed, so that the analyses
+ *  can be repeated with different parameters, such as the cache line size or cache configuration, without re-running
+ *  the instrumented program.
+ *
+ *  The trace starts with a header of access_trace_magic, followed by records which each start with a one byte
+ *  access_trace_record_type. Record fields are unsigned LEB128 varints:
+ *  - ACCESS_TRACE_RECORD_INSTRUCTION defines one memory operand of a static instruction by an index, before the first
+ *    access by the operand.
+ *  - ACCESS_TRACE_RECORD_FUNCTION_ENTER and ACCESS_TRACE_RECORD_FUNCTION_EXIT mark the activations of top-level
+ *    functions by name.
+ *  - ACCESS_TRACE_RECORD_ACCESSES is a block of accesses made by one thread, in the order they were made. Each access
+ *    is the instruction index, the size and the address zig-zag delta encoded against the previous access in the block.
+ *
+ *  Accesses are buffered per thread, so the accesses of different threads are ordered relative to the function markers
+ *  but not to each other.
+ *
+ *  This is independent of Pin, so that the same code is used by the memory_profile Pin tool to write the trace and by
+ *  memory_profile_replay to read it.
+ */
+
+#ifndef ACCESS_TRACE_H_
+#define ACCESS_TRACE_H_
+
+#include <stdint.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace_format.h"
+
+/** One memory operand of a static instruction which made accesses */
+struct access_trace_instruction
+{
+    /** The address of the instruction */
+    uint64_t ip;
+    /** The memory operand of the instruction */
+    uint32_t mem_op;
+    /** The memory_access_kind of the accesses by the operand, which is MEMORY_ACCESS_READ_WRITE for an operand which is
+     *  read and written */
+    uint32_t access_kind;
+    /** The name of the routine containing the instruction */
+    std::string routine;
+};
+
+/** One memory access in the trace */
+struct access_trace_access
+{
+    /** The address accessed */
+    uint64_t addr;
+    /** The index of the access_trace_instruction which made the access */
+    uint32_t instruction_index;
+    /** The number of bytes accessed */
+    uint32_t bytes_accessed;
+};
+
+/** The types of record in the access trace */
+enum access_trace_record_type
+{
+    ACCESS_TRACE_RECORD_INSTRUCTION,
+    ACCESS_TRACE_RECORD_FUNCTION_ENTER,
+    ACCESS_TRACE_RECORD_FUNCTION_EXIT,
+    ACCESS_TRACE_RECORD_ACCESSES
+};
+
+/** The header at the start of an access trace. The first character isn't a valid access_trace_record_type. */
+const char access_trace_magic[] = "MPACCES1";
+const size_t access_trace_magic_length = sizeof (access_trace_magic) - 1;
+
+/** Writes the records of an access trace */
+class access_trace_writer
+{
+public:
+    access_trace_writer (trace_sink &sink);
+    uint32_t instruction (const access_trace_instruction &instruction);
+    void function_enter (const std::string &func_name);
+    void function_exit (const std::string &func_name);
+    void accesses (uint32_t thread_id, const access_trace_access accesses[], uint32_t num_accesses);
+private:
+    void start_record (access_trace_record_type record_type);
+    void put_varint (uint64_t value);
+    void put_string (const std::string &str);
+    void write_record (void);
+
+    trace_sink &sink;
+
+    /** The number of instructions defined, which is the index of the next instruction */
+    uint32_t num_instructions;
+
+    /** Used to encode one record at a time */
+    std::vector<char> record;
+};
+
+/** Interface to receive the records decoded from an access trace */
+class access_trace_handler
+{
+public:
+    virtual ~access_trace_handler (void) {}
+    virtual void instruction (uint32_t instruction_index, const access_trace_instruction &instruction) = 0;
+    virtual void function_enter (const std::string &func_name) = 0;
+    virtual void function_exit (const std::string &func_name) = 0;
+    virtual void accesses (uint32_t thread_id, const access_trace_access accesses[], uint32_t num_accesses) = 0;
+};
+
+bool decode_access_trace (std::istream &input, access_trace_handler &handler, std::string &error);
+
+#endif /* ACCESS_TRACE_H_ */
@@ -0,0 +1,134 @@
+/*
+ * @file cache_line_sharing.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the detection of cache lines shared between threads.
+ */
+
+#include <sstream>
+
+#include "cache_line_sharing.h"
+
+/**
+ * @brief Set the configuration of the detector, which initially has no lines written
+ * @param[in] line_size The cache line size in bytes, which must be a power of two of at most 64 bytes so that the
+ *                      bytes written in a line fit in a 64-bit mask
+ * @param[in] table_lines The number of entries in the shadow table, which must be a power of two
+ * @param[out] error When returning false, describes why the configuration is invalid
+ * @return Returns true if the configuration is valid
+ */
+bool cache_line_sharing_detector::configure (const uint32_t line_size, const uint64_t table_lines, std::string &error)
+{
+    if ((line_size == 0) || ((line_size & (line_size - 1)) != 0) || (line_size > 64))
+    {
+        std::ostringstream message;
+
+        message << "cache line size " << line_size << " must be a power of two of at most 64 bytes";
+        error = message.str();
+        return false;
+    }
+    if ((table_lines == 0) || ((table_lines & (table_lines - 1)) != 0))
+    {
+        std::ostringstream message;
+
+        message << "shadow table size " << table_lines << " must be a power of two";
+        error = message.str();
+        return false;
+    }
+
+    shadow_line unused_line;
+
+    unused_line.lock = 0;
+    unused_line.last_writer = 0;
+    unused_line.line_addr = 0;
+    unused_line.writer_mask = 0;
+    line_shift = __builtin_ctz (line_size);
+    table_bits = __builtin_ctzll (table_lines);
+    table.assign (table_lines, unused_line);
+
+    return true;
+}
+
+/**
+ * @brief Record a write by a thread to one cache line
+ * @details The entry of the line is taken over if it was used by another line which hashes to the same entry.
+ * @param[in] thread_id The thread which wrote the line
+ * @param[in] line_addr The address of the line shifted right by line_shift
+ * @param[in] byte_mask The bytes of the line which were written
+ * @return How the write was shared with the previous writer of the line
+ */
+cache_line_sharing_kind cache_line_sharing_detector::record_line_write (const uint32_t thread_id,
+                                                                        const uint64_t line_addr,
+                                                                        const uint64_t byte_mask)
+{
+    const uint64_t hash = line_addr * 0x9e3779b97f4a7c15ULL;
+    shadow_line &line = table[(table_bits > 0) ? (hash >> (64 - table_bits)) : 0];
+    const uint32_t writer = thread_id + 1;
+    cache_line_sharing_kind kind = CACHE_LINE_NOT_SHARED;
+
+    while (__sync_lock_test_and_set (&line.lock, 1) != 0)
+    {
+        while (line.lock != 0)
+        {
+        }
+    }
+
+    if ((line.last_writer == 0) || (line.line_addr != line_addr))
+    {
+        line.line_addr = line_addr;
+        line.last_writer = writer;
+        line.writer_mask = byte_mask;
+    }
+    else if (line.last_writer == writer)
+    {
+        line.writer_mask |= byte_mask;
+    }
+    else
+    {
+        kind = ((line.writer_mask & byte_mask) != 0) ? CACHE_LINE_TRUE_SHARING : CACHE_LINE_FALSE_SHARING;
+        line.last_writer = writer;
+        line.writer_mask = byte_mask;
+    }
+
+    __sync_lock_release (&line.lock);
+
+    return kind;
+}
+
+/**
+ * @brief Record a write by a thread, which may span multiple cache lines
+ * @param[in] thread_id The thread which made the write
+ * @param[in] addr The address written
+ * @param[in] bytes_accessed The number of bytes written
+ * @param[out] shared_line_addr When the write was shared, the address of the first line with the returned sharing
+ * @return How the write was shared with the previous writers of its lines, where true sharing of any line takes
+ *         precedence over false sharing
+ */
+cache_line_sharing_kind cache_line_sharing_detector::record_write (const uint32_t thread_id, const uint64_t addr,
+                                                                   const uint32_t bytes_accessed,
+                                                                   uint64_t &shared_line_addr)
+{
+    const uint64_t last_addr = addr + bytes_accessed - 1;
+    const uint64_t last_line_addr = last_addr >> line_shift;
+    const uint32_t line_offset_mask = (1U << line_shift) - 1;
+    cache_line_sharing_kind kind = CACHE_LINE_NOT_SHARED;
+
+    for (uint64_t line_addr = addr >> line_shift; line_addr <= last_line_addr; line_addr++)
+    {
+        const uint32_t first_byte = (line_addr == (addr >> line_shift)) ? ((uint32_t) addr & line_offset_mask) : 0;
+        const uint32_t last_byte = (line_addr == last_line_addr) ? ((uint32_t) last_addr & line_offset_mask) :
+                                                                   line_offset_mask;
+        const uint32_t num_bytes = last_byte - first_byte + 1;
+        const uint64_t byte_mask =
+                ((num_bytes == 64) ? ~(uint64_t) 0 : (((uint64_t) 1 << num_bytes) - 1)) << first_byte;
+        const cache_line_sharing_kind line_kind = record_line_write (thread_id, line_addr, byte_mask);
+
+        if (line_kind > kind)
+        {
+            kind = line_kind;
+            shared_line_addr = line_addr << line_shift;
+        }
+    }
+
+    return kind;
+}
@@ -0,0 +1,73 @@
+/*
+ * @file cache_line_sharing.h
+ * @date 16 Oct 2026
+ * @details
+ *  Detects cache lines which are written by more than one thread, which causes the lines to move between the caches
+ *  of the cores running the threads. A shadow table at cache line granularity holds, for each line, the last thread
+ *  which wrote the line and a mask of the bytes of the line it has written. When a thread writes a line last written
+ *  by another thread the write is classified as:
+ *  - False sharing, when the bytes written don't overlap the bytes written by the other thread. The threads are
+ *    accessing different data which happens to be in the same line, which can be avoided by changing the layout.
+ *  - True sharing, when the bytes written overlap the bytes written by the other thread. The threads are communicating
+ *    through the data.
+ *
+ *  The shadow table is a fixed size hash table, direct mapped by line address, so a line which collides with a more
+ *  recently written line loses its history. Each entry has its own spin lock, so threads only serialise when writing
+ *  lines which hash to the same entry, which is the contention being measured.
+ *
+ *  This is independent of Pin, so that the detection can be used by programs other than the memory_profile Pin tool.
+ */
+
+#ifndef CACHE_LINE_SHARING_H_
+#define CACHE_LINE_SHARING_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/** How a write to a cache line was shared with the previous writer of the line */
+enum cache_line_sharing_kind
+{
+    /** The line was last written by the same thread, or hasn't been written */
+    CACHE_LINE_NOT_SHARED,
+    /** The line was last written by another thread, which wrote different bytes */
+    CACHE_LINE_FALSE_SHARING,
+    /** The line was last written by another thread, which wrote some of the same bytes */
+    CACHE_LINE_TRUE_SHARING
+};
+
+/** Detects the sharing of cache lines written by different threads, using a shadow table of the lines written */
+class cache_line_sharing_detector
+{
+public:
+    cache_line_sharing_detector (void) : line_shift (0), table_bits (0) {}
+    bool configure (uint32_t line_size, uint64_t table_lines, std::string &error);
+    cache_line_sharing_kind record_write (uint32_t thread_id, uint64_t addr, uint32_t bytes_accessed,
+                                          uint64_t &shared_line_addr);
+private:
+    /** The shadow of one cache line */
+    struct shadow_line
+    {
+        /** Spin lock which serialises updates of the entry */
+        volatile uint32_t lock;
+        /** The thread which last wrote the line plus one, or zero when the entry is unused */
+        uint32_t last_writer;
+        /** The address of the line shifted right by line_shift */
+        uint64_t line_addr;
+        /** The bytes of the line written by last_writer since it took over the line */
+        uint64_t writer_mask;
+    };
+
+    cache_line_sharing_kind record_line_write (uint32_t thread_id, uint64_t line_addr, uint64_t byte_mask);
+
+    uint32_t line_shift;
+
+    /** The shadow table, indexed by the hash of the line address */
+    std::vector<shadow_line> table;
+
+    /** The number of bits of the hash used to index table[] */
+    uint32_t table_bits;
+};
+
+#endif /* CACHE_LINE_SHARING_H_ */
@@ -0,0 +1,443 @@
+/*
+ * @file cache_simulator.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the simulation of a set-associative cache hierarchy.
+ */
+
+#include <stdlib.h>
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "cache_simulator.h"
+
+/** Marks a way which doesn't hold a line, which can't match a line address */
+static const uint64_t invalid_line_addr = ~(uint64_t) 0;
+
+cache_level::cache_level (void)
+    : num_ways (0), set_mask (0), replacement_policy (CACHE_REPLACEMENT_LRU), plru_tree_depth (0)
+{
+}
+
+/**
+ * @brief Set the geometry of the cache level, which is initially empty
+ * @param[in] size The size of the cache level in bytes
+ * @param[in] ways The associativity
+ * @param[in] line_shift log2 of the cache line size
+ * @param[in] policy How the line to evict from a set is selected
+ * @param[out] error When returning false, describes why the geometry isn't supported
+ * @return Returns true if the cache level was configured
+ */
+bool cache_level::configure (const uint64_t size, const uint32_t ways, const uint32_t line_shift,
+                             const cache_replacement_policy policy, std::string &error)
+{
+    const uint64_t set_size = (uint64_t) ways << line_shift;
+    uint64_t num_sets;
+
+    if ((ways == 0) || (ways > cache_max_ways))
+    {
+        error = "associativity must be between 1 and 32";
+        return false;
+    }
+    if ((policy == CACHE_REPLACEMENT_PLRU) && ((ways & (ways - 1)) != 0))
+    {
+        error = "pseudo-LRU replacement requires a power-of-two associativity";
+        return false;
+    }
+    num_sets = size / set_size;
+    if ((num_sets == 0) || ((num_sets * set_size) != size) || ((num_sets & (num_sets - 1)) != 0))
+    {
+        error = "size must be a power-of-two number of sets of associativity * line size";
+        return false;
+    }
+
+    num_ways = ways;
+    set_mask = num_sets - 1;
+    replacement_policy = policy;
+    plru_tree_depth = __builtin_ctz (ways);
+    line_addrs.assign (num_sets * ways, invalid_line_addr);
+    lru_ranks.resize (num_sets * ways);
+    for (uint64_t set_index = 0; set_index < num_sets; set_index++)
+    {
+        for (uint32_t way = 0; way < ways; way++)
+        {
+            lru_ranks[(set_index * ways) + way] = (uint8_t) way;
+        }
+    }
+    plru_trees.assign (num_sets, 0);
+    dirty_ways.assign (num_sets, 0);
+
+    return true;
+}
+
+/**
+ * @brief Find which way of a set holds a line
+ * @details The line addresses of the set are compared two at a time with SSE2, which has no 64-bit compare, so the
+ *          32-bit halves are compared and then combined.
+ * @param[in] set_index The set to search
+ * @param[in] line_addr The line address to find, or invalid_line_addr to find an empty way
+ * @return The way which holds the line, or -1 if not found
+ */
+int32_t cache_level::find_way (const uint32_t set_index, const uint64_t line_addr) const
+{
+    const uint64_t *const set_line_addrs = &line_addrs[(uint64_t) set_index * num_ways];
+    uint32_t way = 0;
+
+#if defined (__SSE2__)
+    const __m128i key = _mm_set1_epi64x ((long long) line_addr);
+
+    for (; (way + 2) <= num_ways; way += 2)
+    {
+        const __m128i equal_halves =
+                _mm_cmpeq_epi32 (_mm_loadu_si128 ((const __m128i *) &set_line_addrs[way]), key);
+        const __m128i equal = _mm_and_si128 (equal_halves, _mm_shuffle_epi32 (equal_halves, _MM_SHUFFLE (2, 3, 0, 1)));
+        const int match_mask = _mm_movemask_pd (_mm_castsi128_pd (equal));
+
+        if (match_mask != 0)
+        {
+            return (int32_t) (way + __builtin_ctz (match_mask));
+        }
+    }
+#endif
+
+    for (; way < num_ways; way++)
+    {
+        if (set_line_addrs[way] == line_addr)
+        {
+            return (int32_t) way;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Select the way of a full set to evict, according to the replacement policy
+ * @param[in] set_index The set to select the way from
+ * @return The way to evict
+ */
+uint32_t cache_level::victim_way (const uint32_t set_index) const
+{
+    uint32_t way = 0;
+
+    if (replacement_policy == CACHE_REPLACEMENT_PLRU)
+    {
+        const uint32_t tree = plru_trees[set_index];
+        uint32_t node = 1;
+
+        /* Follow the tree bits, which point away from the most recently used half at each node */
+        for (uint32_t level = 0; level < plru_tree_depth; level++)
+        {
+            const uint32_t bit = (tree >> node) & 1;
+
+            way = (way << 1) | bit;
+            node = (node << 1) | bit;
+        }
+    }
+    else
+    {
+        const uint8_t *const set_ranks = &lru_ranks[(uint64_t) set_index * num_ways];
+
+        while (set_ranks[way] != (num_ways - 1))
+        {
+            way++;
+        }
+    }
+
+    return way;
+}
+
+/**
+ * @brief Update the replacement state of a set when a way is used
+ * @param[in] set_index The set containing the way
+ * @param[in] way The way which was used
+ */
+void cache_level::touch (const uint32_t set_index, const uint32_t way)
+{
+    if (replacement_policy == CACHE_REPLACEMENT_PLRU)
+    {
+        uint32_t &tree = plru_trees[set_index];
+        uint32_t node = 1;
+
+        for (uint32_t level = 0; level < plru_tree_depth; level++)
+        {
+            const uint32_t bit = (way >> (plru_tree_depth - 1 - level)) & 1;
+
+            if (bit != 0)
+            {
+                tree &= ~(1U << node);
+            }
+            else
+            {
+                tree |= 1U << node;
+            }
+            node = (node << 1) | bit;
+        }
+    }
+    else
+    {
+        uint8_t *const set_ranks = &lru_ranks[(uint64_t) set_index * num_ways];
+        const uint8_t rank = set_ranks[way];
+
+        for (uint32_t other_way = 0; other_way < num_ways; other_way++)
+        {
+            set_ranks[other_way] += (set_ranks[other_way] < rank) ? 1 : 0;
+        }
+        set_ranks[way] = 0;
+    }
+}
+
+/**
+ * @brief Place a line in a set, using an empty way if there is one, otherwise evicting a line
+ * @param[in] set_index The set for the line
+ * @param[in] line_addr The line to place
+ * @param[in] dirty Whether the line is dirty
+ * @param[out] victim_line_addr When returning true, the evicted line
+ * @return Returns true if a dirty line was evicted, which needs to be written back
+ */
+bool cache_level::install (const uint32_t set_index, const uint64_t line_addr, const bool dirty,
+                           uint64_t &victim_line_addr)
+{
+    const int32_t empty_way = find_way (set_index, invalid_line_addr);
+    const uint32_t way = (empty_way >= 0) ? (uint32_t) empty_way : victim_way (set_index);
+    const uint32_t way_mask = 1U << way;
+    uint64_t &way_line_addr = line_addrs[((uint64_t) set_index * num_ways) + way];
+    const bool evicted_dirty = (dirty_ways[set_index] & way_mask) != 0;
+
+    victim_line_addr = way_line_addr;
+    way_line_addr = line_addr;
+    if (dirty)
+    {
+        dirty_ways[set_index] |= way_mask;
+    }
+    else
+    {
+        dirty_ways[set_index] &= ~way_mask;
+    }
+    touch (set_index, way);
+
+    return evicted_dirty;
+}
+
+/**
+ * @brief Look up a line for an access, updating the replacement state on a hit
+ * @param[in] line_addr The line accessed
+ * @param[in] write When true the line is marked as dirty on a hit
+ * @return Returns true on a hit
+ */
+bool cache_level::lookup (const uint64_t line_addr, const bool write)
+{
+    const uint32_t set_index = (uint32_t) (line_addr & set_mask);
+    const int32_t way = find_way (set_index, line_addr);
+
+    if (way < 0)
+    {
+        return false;
+    }
+    touch (set_index, (uint32_t) way);
+    if (write)
+    {
+        dirty_ways[set_index] |= 1U << way;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Fill a line after a miss
+ * @param[in] line_addr The line to fill, which isn't in the cache level
+ * @param[in] dirty Whether the line is dirty
+ * @param[out] victim_line_addr When returning true, the evicted line
+ * @return Returns true if a dirty line was evicted, which needs to be written back
+ */
+bool cache_level::fill (const uint64_t line_addr, const bool dirty, uint64_t &victim_line_addr)
+{
+    return install ((uint32_t) (line_addr & set_mask), line_addr, dirty, victim_line_addr);
+}
+
+/**
+ * @brief Accept a dirty line written back from the level above, allocating the line if not present
+ * @param[in] line_addr The line written back
+ * @param[out] victim_line_addr When returning true, the evicted line
+ * @return Returns true if a dirty line was evicted, which needs to be written back
+ */
+bool cache_level::write_back (const uint64_t line_addr, uint64_t &victim_line_addr)
+{
+    if (lookup (line_addr, true))
+    {
+        return false;
+    }
+
+    return install ((uint32_t) (line_addr & set_mask), line_addr, true, victim_line_addr);
+}
+
+/**
+ * @brief Set the configuration of the cache hierarchy, which is initially empty
+ * @param[in] config The configuration
+ * @param[out] error When returning false, describes why the configuration isn't supported
+ * @return Returns true if the cache hierarchy was configured
+ */
+bool cache_hierarchy::configure (const cache_config &config, std::string &error)
+{
+    if ((config.line_size == 0) || ((config.line_size & (config.line_size - 1)) != 0))
+    {
+        error = "cache line size must be a power of two";
+        return false;
+    }
+
+    line_shift = __builtin_ctz (config.line_size);
+    next_line_prefetch = config.next_line_prefetch;
+    for (uint32_t level = 0; level < cache_num_levels; level++)
+    {
+        if (!levels[level].configure (config.level_sizes[level], config.level_ways[level], line_shift,
+                                      config.replacement_policy, error))
+        {
+            error = std::string (trace_cache_level_field_names[level]) + ": " + error;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Write back a dirty line evicted from one level to the next level, or to memory from the last level
+ * @param[in] level The level the line was evicted from
+ * @param[in] line_addr The evicted line
+ * @param[in,out] outcome Updated with the writebacks
+ */
+void cache_hierarchy::write_back (const uint32_t level, const uint64_t line_addr, cache_access_outcome &outcome)
+{
+    uint64_t victim_line_addr;
+
+    outcome.writebacks[level]++;
+    if (((level + 1) < cache_num_levels) && levels[level + 1].write_back (line_addr, victim_line_addr))
+    {
+        write_back (level + 1, victim_line_addr, outcome);
+    }
+}
+
+/**
+ * @brief Simulate an access to one cache line, filling the line into each level which missed
+ * @param[in] line_addr The line accessed
+ * @param[in] write When true the line is dirty in the L1D after the access
+ * @param[in,out] outcome Updated with the writebacks caused by the fills
+ * @return The number of levels which missed
+ */
+uint32_t cache_hierarchy::access_line (const uint64_t line_addr, const bool write, cache_access_outcome &outcome)
+{
+    uint32_t levels_missed = 0;
+    uint64_t victim_line_addr;
+
+    while ((levels_missed < cache_num_levels) && !levels[levels_missed].lookup (line_addr, write && (levels_missed == 0)))
+    {
+        levels_missed++;
+    }
+
+    /* Fill from the outermost level which missed, so the evictions from each level are written back in order */
+    for (uint32_t level = levels_missed; level > 0; level--)
+    {
+        if (levels[level - 1].fill (line_addr, write && (level == 1), victim_line_addr))
+        {
+            write_back (level - 1, victim_line_addr, outcome);
+        }
+    }
+
+    return levels_missed;
+}
+
+/**
+ * @brief Simulate one memory access, which may span more than one cache line
+ * @details The outcome of an access which spans cache lines is the deepest level reached by any of the lines.
+ *          When next line prefetch is enabled, an L1D miss also fetches the following line. A prefetch which hits
+ *          in the L1D still updates the replacement state.
+ * @param[in] addr The address accessed
+ * @param[in] bytes_accessed The number of bytes accessed, where zero is treated as one byte
+ * @param[in] write True for a write access
+ * @param[out] outcome The outcome of the access
+ */
+void cache_hierarchy::access (const uint64_t addr, const uint32_t bytes_accessed, const bool write,
+                              cache_access_outcome &outcome)
+{
+    const uint64_t first_line_addr = addr >> line_shift;
+    const uint64_t last_line_addr = (addr + ((bytes_accessed > 0) ? (bytes_accessed - 1) : 0)) >> line_shift;
+
+    outcome.levels_missed = 0;
+    for (uint32_t level = 0; level < cache_num_levels; level++)
+    {
+        outcome.writebacks[level] = 0;
+    }
+
+    for (uint64_t line_addr = first_line_addr; line_addr <= last_line_addr; line_addr++)
+    {
+        const uint32_t levels_missed = access_line (line_addr, write, outcome);
+
+        if (levels_missed > outcome.levels_missed)
+        {
+            outcome.levels_missed = levels_missed;
+        }
+        if (next_line_prefetch && (levels_missed > 0))
+        {
+            access_line (line_addr + 1, false, outcome);
+        }
+    }
+}
+
+/**
+ * @brief Parse the configuration of one cache level, in the form size:ways
+ * @details The size may have a K, M or G suffix for a multiple of 1024, 1024^2 or 1024^3 bytes.
+ * @param[in] text The text to parse, e.g. 32K:8
+ * @param[out] size The size in bytes
+ * @param[out] ways The associativity
+ * @return Returns true if the text was parsed
+ */
+bool parse_cache_level_config (const std::string &text, uint64_t &size, uint32_t &ways)
+{
+    const char *const start = text.c_str();
+    char *end;
+
+    size = strtoull (start, &end, 10);
+    if (end == start)
+    {
+        return false;
+    }
+    switch (*end)
+    {
+    case 'K':
+    case 'k':
+        size <<= 10;
+        end++;
+        break;
+
+    case 'M':
+    case 'm':
+        size <<= 20;
+        end++;
+        break;
+
+    case 'G':
+    case 'g':
+        size <<= 30;
+        end++;
+        break;
+
+    default:
+        break;
+    }
+    if (*end != ':')
+    {
+        return false;
+    }
+
+    const char *const ways_start = end + 1;
+    const unsigned long parsed_ways = strtoul (ways_start, &end, 10);
+    if ((end == ways_start) || (*end != '\0'))
+    {
+        return false;
+    }
+    ways = (uint32_t) parsed_ways;
+
+    return true;
+}
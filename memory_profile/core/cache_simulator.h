@@ -0,0 +1,115 @@
+/*
+ * @file cache_simulator.h
+ * @date 16 Oct 2026
+ * @details
+ *  Simulates a hierarchy of set-associative data caches, of L1D, L2 and LLC, to estimate the hits, misses and
+ *  writebacks caused by a sequence of memory accesses. The caches are write-back and write-allocate, and are
+ *  non-inclusive: a line is filled into every level which missed, and a dirty line evicted from one level is written
+ *  back to the next level. Only the tags are simulated, not the data.
+ *
+ *  This is independent of Pin, so that the simulation can be used by programs other than the memory_profile Pin tool.
+ */
+
+#ifndef CACHE_SIMULATOR_H_
+#define CACHE_SIMULATOR_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "trace_format.h"
+
+/** The number of levels in the simulated cache hierarchy */
+const uint32_t cache_num_levels = trace_num_cache_levels;
+
+/** The maximum associativity of one cache level, limited by the bitmasks used for each set */
+const uint32_t cache_max_ways = 32;
+
+/** How the line to evict from a set is selected */
+enum cache_replacement_policy
+{
+    /** Least recently used */
+    CACHE_REPLACEMENT_LRU,
+    /** Tree pseudo-LRU, as used by many hardware caches. Requires a power-of-two associativity. */
+    CACHE_REPLACEMENT_PLRU
+};
+
+/** The configuration of the simulated cache hierarchy */
+struct cache_config
+{
+    /** The size in bytes of each level, indexed from L1D */
+    uint64_t level_sizes[cache_num_levels];
+    /** The associativity of each level, indexed from L1D */
+    uint32_t level_ways[cache_num_levels];
+    /** The size of a cache line in bytes, which is the same for all levels */
+    uint32_t line_size;
+    cache_replacement_policy replacement_policy;
+    /** When true, a demand miss in the L1D also fetches the next cache line */
+    bool next_line_prefetch;
+};
+
+/** The outcome of simulating one memory access */
+struct cache_access_outcome
+{
+    /** The number of levels which missed, starting from the L1D. cache_num_levels means the access went to memory. */
+    uint32_t levels_missed;
+    /** The number of dirty lines written back from each level as a result of the access */
+    uint32_t writebacks[cache_num_levels];
+};
+
+/** One level of set-associative cache */
+class cache_level
+{
+public:
+    cache_level (void);
+    bool configure (uint64_t size, uint32_t ways, uint32_t line_shift, cache_replacement_policy policy,
+                    std::string &error);
+    bool lookup (uint64_t line_addr, bool write);
+    bool fill (uint64_t line_addr, bool dirty, uint64_t &victim_line_addr);
+    bool write_back (uint64_t line_addr, uint64_t &victim_line_addr);
+private:
+    int32_t find_way (uint32_t set_index, uint64_t line_addr) const;
+    uint32_t victim_way (uint32_t set_index) const;
+    void touch (uint32_t set_index, uint32_t way);
+    bool install (uint32_t set_index, uint64_t line_addr, bool dirty, uint64_t &victim_line_addr);
+
+    uint32_t num_ways;
+    uint64_t set_mask;
+    cache_replacement_policy replacement_policy;
+
+    /** The number of levels in the pseudo-LRU tree of each set, which is log2 of the associativity */
+    uint32_t plru_tree_depth;
+
+    /** The line address held by each way, stored contiguously for each set so the ways of a set are compared
+     *  in one pass. The full line address is used as the tag. */
+    std::vector<uint64_t> line_addrs;
+
+    /** For LRU replacement, the recency rank of each way within its set, where zero is the most recently used */
+    std::vector<uint8_t> lru_ranks;
+
+    /** For pseudo-LRU replacement, the tree bits of each set. Bit n is node n of the tree, with the root at bit 1. */
+    std::vector<uint32_t> plru_trees;
+
+    /** A bitmask for each set of the ways which hold a dirty line */
+    std::vector<uint32_t> dirty_ways;
+};
+
+/** A simulated hierarchy of caches, for the accesses made by one thread */
+class cache_hierarchy
+{
+public:
+    bool configure (const cache_config &config, std::string &error);
+    void access (uint64_t addr, uint32_t bytes_accessed, bool write, cache_access_outcome &outcome);
+private:
+    uint32_t access_line (uint64_t line_addr, bool write, cache_access_outcome &outcome);
+    void write_back (uint32_t level, uint64_t line_addr, cache_access_outcome &outcome);
+
+    cache_level levels[cache_num_levels];
+    uint32_t line_shift;
+    bool next_line_prefetch;
+};
+
+bool parse_cache_level_config (const std::string &text, uint64_t &size, uint32_t &ways);
+
+#endif /* CACHE_SIMULATOR_H_ */
@@ -0,0 +1,133 @@
+/*
+ * @file call_stacks.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the symbolisation and interning of call stacks.
+ */
+
+#include <algorithm>
+
+#include "call_stacks.h"
+
+/**
+ * @brief Used to binary search symbol_cache.symbols[] by start address
+ */
+struct symbol_start_compare
+{
+    template <class symbol_type>
+    bool operator() (const uint64_t addr, const symbol_type &symbol) const
+    {
+        return addr < symbol.start_addr;
+    }
+
+    template <class symbol_type>
+    bool operator() (const symbol_type &symbol, const uint64_t addr) const
+    {
+        return symbol.start_addr < addr;
+    }
+};
+
+/**
+ * @brief Add a routine to the cache
+ * @details Routines are normally added in increasing address order within each image, so are appended. A routine
+ *          at the same start address as an existing routine, i.e. an alias, is ignored.
+ * @param[in] start_addr The first address of the routine
+ * @param[in] size The size of the routine in bytes, where zero is treated as one byte
+ * @param[in] name The name of the routine
+ */
+void symbol_cache::add_symbol (const uint64_t start_addr, const uint64_t size, const std::string &name)
+{
+    symbol new_symbol;
+    std::vector<symbol>::iterator insert_it = symbols.end();
+
+    if (!symbols.empty() && (start_addr <= symbols.back().start_addr))
+    {
+        insert_it = std::upper_bound (symbols.begin(), symbols.end(), start_addr, symbol_start_compare());
+        if ((insert_it != symbols.begin()) && ((insert_it - 1)->start_addr == start_addr))
+        {
+            return;
+        }
+    }
+
+    new_symbol.start_addr = start_addr;
+    new_symbol.end_addr = start_addr + ((size > 0) ? (size - 1) : 0);
+    new_symbol.name = name;
+    symbols.insert (insert_it, new_symbol);
+}
+
+/**
+ * @brief Remove the routines in an address range from the cache, such as when an image is unloaded
+ * @param[in] low_addr The first address of the range
+ * @param[in] high_addr The last address of the range
+ */
+void symbol_cache::remove_symbols (const uint64_t low_addr, const uint64_t high_addr)
+{
+    const std::vector<symbol>::iterator first_it =
+            std::lower_bound (symbols.begin(), symbols.end(), low_addr, symbol_start_compare());
+    const std::vector<symbol>::iterator end_it =
+            std::upper_bound (first_it, symbols.end(), high_addr, symbol_start_compare());
+
+    symbols.erase (first_it, end_it);
+}
+
+/**
+ * @brief Find the name of the routine containing an address
+ * @param[in] addr The instruction address to find
+ * @return The name of the routine, or an empty string if the address isn't in any routine.
+ *         Only valid until the cache is next modified.
+ */
+const std::string &symbol_cache::find (const uint64_t addr) const
+{
+    const std::vector<symbol>::const_iterator it =
+            std::upper_bound (symbols.begin(), symbols.end(), addr, symbol_start_compare());
+
+    if ((it != symbols.begin()) && (addr <= (it - 1)->end_addr))
+    {
+        return (it - 1)->name;
+    }
+
+    return unknown_name;
+}
+
+call_stack_trie::call_stack_trie (void)
+{
+    call_stack_node root;
+
+    root.parent_id = empty_call_stack_id;
+    root.ip = 0;
+    nodes.push_back (root);
+}
+
+/**
+ * @brief Intern a call stack
+ * @param[in] ips The instruction addresses of the frames of the call stack, innermost first as from a backtrace
+ * @param[in] num_ips The number of frames in the call stack
+ * @return The stack ID of the call stack, which is empty_call_stack_id for an empty call stack
+ */
+uint32_t call_stack_trie::intern (const uint64_t ips[], const uint32_t num_ips)
+{
+    uint32_t stack_id = empty_call_stack_id;
+
+    for (uint32_t frame = num_ips; frame > 0; frame--)
+    {
+        const std::pair<uint32_t,uint64_t> child_key (stack_id, ips[frame - 1]);
+        const std::map<std::pair<uint32_t,uint64_t>,uint32_t>::const_iterator it = children.find (child_key);
+
+        if (it != children.end())
+        {
+            stack_id = it->second;
+        }
+        else
+        {
+            call_stack_node child;
+
+            child.parent_id = stack_id;
+            child.ip = ips[frame - 1];
+            stack_id = nodes.size();
+            nodes.push_back (child);
+            children.insert (std::pair<std::pair<uint32_t,uint64_t>,uint32_t> (child_key, stack_id));
+        }
+    }
+
+    return stack_id;
+}
@@ -0,0 +1,98 @@
+/*
+ * @file call_stacks.h
+ * @date 16 Oct 2026
+ * @details
+ *  Symbolises the call sites of memory allocations, and interns the call stacks of allocations.
+ *
+ *  The symbol_cache maps an instruction address to the name of the routine containing it, by a binary search of the
+ *  routines which were added when each image was loaded. This avoids a slow symbol lookup, and a copy of the name,
+ *  for each allocation event.
+ *
+ *  The call_stack_trie interns call stacks as paths from the root of a trie, starting with the outermost caller. Each
+ *  node is a call stack identified by a compact stack ID, so that an allocation event only needs to carry the ID.
+ *  Call stacks which share callers share nodes, so the table of nodes which is output once is small.
+ *
+ *  This is independent of Pin, so that the symbolisation can be used by programs other than the memory_profile Pin tool.
+ */
+
+#ifndef CALL_STACKS_H_
+#define CALL_STACKS_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+/** Maps instruction addresses to the name of the containing routine */
+class symbol_cache
+{
+public:
+    void add_symbol (uint64_t start_addr, uint64_t size, const std::string &name);
+    void remove_symbols (uint64_t low_addr, uint64_t high_addr);
+    const std::string &find (uint64_t addr) const;
+private:
+    /** One routine in symbols[] */
+    struct symbol
+    {
+        /** The first address of the routine */
+        uint64_t start_addr;
+        /** The last address of the routine */
+        uint64_t end_addr;
+        /** The name of the routine */
+        std::string name;
+    };
+
+    /** The routines which have been added, sorted by start address */
+    std::vector<symbol> symbols;
+
+    /** Returned by find() for an address which isn't in any routine */
+    std::string unknown_name;
+};
+
+/** The stack ID of the empty call stack, which is the root of a call_stack_trie */
+const uint32_t empty_call_stack_id = 0;
+
+/** Interns call stacks as nodes in a trie */
+class call_stack_trie
+{
+public:
+    call_stack_trie (void);
+    uint32_t intern (const uint64_t ips[], uint32_t num_ips);
+
+    /** @return The number of call stacks interned, including the empty call stack */
+    uint32_t num_stacks (void) const
+    {
+        return nodes.size();
+    }
+
+    /** @return The stack ID of the call stack of the callers of the innermost frame of a call stack */
+    uint32_t parent (const uint32_t stack_id) const
+    {
+        return nodes[stack_id].parent_id;
+    }
+
+    /** @return The instruction address of the innermost frame of a call stack */
+    uint64_t ip (const uint32_t stack_id) const
+    {
+        return nodes[stack_id].ip;
+    }
+private:
+    /** One node of the trie, for the innermost frame of a call stack */
+    struct call_stack_node
+    {
+        /** The stack ID of the callers of the frame */
+        uint32_t parent_id;
+        /** The instruction address of the frame */
+        uint64_t ip;
+    };
+
+    /** The nodes of the trie, indexed by stack ID */
+    std::vector<call_stack_node> nodes;
+
+    /** The stack ID of the child of each node, indexed by the stack ID of the node and the instruction address of
+     *  the child */
+    std::map<std::pair<uint32_t,uint64_t>,uint32_t> children;
+};
+
+#endif /* CALL_STACKS_H_ */
@@ -0,0 +1,146 @@
+/*
+ * @file fp_operations.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the classification of instructions by the floating point operations they perform.
+ */
+
+#include "fp_operations.h"
+
+/** The x87 arithmetic instructions, which each perform one scalar operation */
+static const char *const x87_arithmetic_mnemonics[] =
+{
+    "FADD", "FADDP", "FIADD", "FSUB", "FSUBP", "FSUBR", "FSUBRP", "FISUB", "FISUBR",
+    "FMUL", "FMULP", "FIMUL", "FDIV", "FDIVP", "FDIVR", "FDIVRP", "FIDIV", "FIDIVR"
+};
+
+/** The prefixes of the mnemonics of the fused multiply-add instructions, which perform two operations per lane.
+ *  The longer prefixes are first, so the operand order digits or element type follow the matching prefix. */
+static const char *const fma_prefixes[] =
+{
+    "VFMADDSUB", "VFMSUBADD", "VFNMADD", "VFNMSUB", "VFMADD", "VFMSUB"
+};
+
+/** The operations of the SSE and AVX arithmetic instructions which perform one operation per lane, as the mnemonic
+ *  without the leading V of the AVX forms and the element type suffix */
+static const char *const vector_arithmetic_operations[] =
+{
+    "ADD", "SUB", "MUL", "DIV", "ADDSUB", "HADD", "HSUB"
+};
+
+/**
+ * @brief Get the number of lanes of an SSE or AVX instruction from the element type suffix of the mnemonic
+ * @param[in] suffix The last two characters of the mnemonic, where PS / PD are packed single / double and
+ *                   SS / SD are scalar single / double
+ * @param[in] vector_length_bits The vector length of the instruction
+ * @param[out] vector_width The vector width of the instruction
+ * @param[out] lanes The number of elements operated upon
+ * @return Returns false if the suffix isn't a floating point element type, or the vector length isn't supported
+ */
+static bool get_vector_lanes (const std::string &suffix, const uint32_t vector_length_bits,
+                              fp_vector_width &vector_width, uint32_t &lanes)
+{
+    if ((suffix == "SS") || (suffix == "SD"))
+    {
+        vector_width = FP_VECTOR_SCALAR;
+        lanes = 1;
+        return true;
+    }
+    if ((suffix != "PS") && (suffix != "PD"))
+    {
+        return false;
+    }
+
+    const uint32_t element_bits = (suffix == "PS") ? 32 : 64;
+    switch (vector_length_bits)
+    {
+    case 0:
+    case 128:
+        /* Legacy SSE instructions don't have a VEX or EVEX vector length */
+        vector_width = FP_VECTOR_128;
+        lanes = 128 / element_bits;
+        return true;
+
+    case 256:
+        vector_width = FP_VECTOR_256;
+        lanes = 256 / element_bits;
+        return true;
+
+    case 512:
+        vector_width = FP_VECTOR_512;
+        lanes = 512 / element_bits;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Classify an instruction by the floating point operations it performs
+ * @param[in] mnemonic The upper case mnemonic of the instruction
+ * @param[in] vector_length_bits The vector length of the instruction in bits for VEX and EVEX encoded instructions,
+ *                               or zero for other instructions
+ * @param[out] vector_width When returning true, the vector width of the instruction
+ * @param[out] flops When returning true, the number of floating point operations performed by one execution
+ * @return Returns true if the instruction performs floating point arithmetic operations which are counted
+ */
+bool classify_fp_operation (const std::string &mnemonic, const uint32_t vector_length_bits,
+                            fp_vector_width &vector_width, uint32_t &flops)
+{
+    const size_t num_x87_mnemonics = sizeof (x87_arithmetic_mnemonics) / sizeof (x87_arithmetic_mnemonics[0]);
+    const size_t num_fma_prefixes = sizeof (fma_prefixes) / sizeof (fma_prefixes[0]);
+    const size_t num_vector_operations =
+            sizeof (vector_arithmetic_operations) / sizeof (vector_arithmetic_operations[0]);
+    uint32_t lanes;
+
+    for (size_t index = 0; index < num_x87_mnemonics; index++)
+    {
+        if (mnemonic == x87_arithmetic_mnemonics[index])
+        {
+            vector_width = FP_VECTOR_SCALAR;
+            flops = 1;
+            return true;
+        }
+    }
+
+    if (mnemonic.size() < 3)
+    {
+        return false;
+    }
+    const std::string suffix = mnemonic.substr (mnemonic.size() - 2);
+    if (!get_vector_lanes (suffix, vector_length_bits, vector_width, lanes))
+    {
+        return false;
+    }
+
+    /* A fused multiply-add has digits giving the operand order between the prefix and the suffix, except FMA4 */
+    for (size_t index = 0; index < num_fma_prefixes; index++)
+    {
+        const std::string prefix = fma_prefixes[index];
+
+        if ((mnemonic.size() >= (prefix.size() + suffix.size())) && (mnemonic.compare (0, prefix.size(), prefix) == 0))
+        {
+            const std::string order = mnemonic.substr (prefix.size(), mnemonic.size() - prefix.size() - suffix.size());
+
+            if (order.find_first_not_of ("0123456789") == std::string::npos)
+            {
+                flops = 2 * lanes;
+                return true;
+            }
+        }
+    }
+
+    const size_t operation_start = (mnemonic[0] == 'V') ? 1 : 0;
+    const std::string operation = mnemonic.substr (operation_start, mnemonic.size() - operation_start - suffix.size());
+    for (size_t index = 0; index < num_vector_operations; index++)
+    {
+        if (operation == vector_arithmetic_operations[index])
+        {
+            flops = lanes;
+            return true;
+        }
+    }
+
+    return false;
+}
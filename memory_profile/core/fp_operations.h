@@ -0,0 +1,43 @@
+/*
+ * @file fp_operations.h
+ * @date 16 Oct 2026
+ * @details
+ *  Classifies x86 instructions by the floating point operations they perform, to count the floating point operations
+ *  of a top-level function at instrumentation time. Combined with the bytes read and written by the function this
+ *  gives the operational intensity, which places the function on a roofline model as bandwidth or compute bound.
+ *
+ *  The floating point add, subtract, multiply, divide and fused multiply-add instructions are counted, as scalar SSE,
+ *  x87 or packed SSE / AVX / AVX-512 instructions. Each lane of a packed instruction is one operation, apart from
+ *  a fused multiply-add which is two operations per lane. Other floating point instructions, such as moves,
+ *  comparisons, conversions, minimum / maximum and square root, aren't counted as operations.
+ *
+ *  The instruction is identified from its mnemonic, as the operation and element type are encoded in the mnemonic.
+ *  The number of lanes of an AVX-512 instruction with a write mask is counted as the full vector length, since the
+ *  mask is only known when the instruction executes.
+ *
+ *  This is independent of Pin, so that the classification can be used by programs other than the memory_profile Pin
+ *  tool.
+ */
+
+#ifndef FP_OPERATIONS_H_
+#define FP_OPERATIONS_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "trace_format.h"
+
+/** The vector widths which floating point operations are counted by, indexing trace_roofline.flops[] */
+enum fp_vector_width
+{
+    FP_VECTOR_SCALAR,
+    FP_VECTOR_128,
+    FP_VECTOR_256,
+    FP_VECTOR_512
+};
+
+bool classify_fp_operation (const std::string &mnemonic, uint32_t vector_length_bits, fp_vector_width &vector_width,
+                            uint32_t &flops);
+
+#endif /* FP_OPERATIONS_H_ */
@@ -0,0 +1,169 @@
+/*
+ * @file instruction_traffic.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the counting of the memory traffic of instructions, and the roll up to source lines.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "instruction_traffic.h"
+#include "memory_regions.h"
+
+instruction_traffic::instruction_traffic (const uint32_t line_size)
+    : lines (line_size)
+{
+    std::fill (accesses, accesses + trace_num_access_kinds, 0);
+    std::fill (bytes, bytes + trace_num_access_kinds, 0);
+}
+
+/**
+ * @brief Count one memory access by the operand
+ * @param[in] access_kind The memory_access_kind of the access, where a read-modify-write access is counted as both
+ *                        a read and a write
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ */
+void instruction_traffic::record_access (const uint32_t access_kind, const uint64_t memory_addr,
+                                         const uint32_t bytes_accessed)
+{
+    if (access_kind == MEMORY_ACCESS_READ_WRITE)
+    {
+        accesses[MEMORY_ACCESS_READ]++;
+        bytes[MEMORY_ACCESS_READ] += bytes_accessed;
+        accesses[MEMORY_ACCESS_WRITE]++;
+        bytes[MEMORY_ACCESS_WRITE] += bytes_accessed;
+    }
+    else
+    {
+        accesses[access_kind]++;
+        bytes[access_kind] += bytes_accessed;
+    }
+    lines.add_range (memory_addr, memory_addr + bytes_accessed - 1);
+}
+
+/**
+ * @brief Add the traffic of another operand, or of the same operand counted by another thread
+ * @param[in] other The traffic to add, which must have the same line size
+ */
+void instruction_traffic::merge_from (const instruction_traffic &other)
+{
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        accesses[kind] += other.accesses[kind];
+        bytes[kind] += other.bytes[kind];
+    }
+    lines.merge_from (other.lines);
+}
+
+/**
+ * @return Returns true if no accesses have been counted
+ */
+bool instruction_traffic::empty (void) const
+{
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        if (accesses[kind] > 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool instruction_source_location::operator< (const instruction_source_location &other) const
+{
+    if (routine != other.routine)
+    {
+        return routine < other.routine;
+    }
+    if (file != other.file)
+    {
+        return file < other.file;
+    }
+
+    return line < other.line;
+}
+
+/**
+ * @brief Add the traffic of a memory operand of an instruction to the source line of the instruction
+ * @details May be called more than once for the same operand, such as once for the traffic counted by each thread.
+ * @param[in] ip The address of the instruction
+ * @param[in] location The location of the instruction in the source
+ * @param[in] traffic The traffic of the memory operand, which is ignored if empty
+ */
+void source_line_traffic::add_operand (const uint64_t ip, const instruction_source_location &location,
+                                       const instruction_traffic &traffic)
+{
+    if (traffic.empty())
+    {
+        return;
+    }
+
+    std::map<instruction_source_location,source_line>::iterator it = source_lines.find (location);
+    if (it == source_lines.end())
+    {
+        it = source_lines.insert
+                (std::pair<instruction_source_location,source_line> (location, source_line (line_size))).first;
+    }
+    it->second.ips.insert (ip);
+    it->second.traffic.merge_from (traffic);
+}
+
+/**
+ * @brief Used to sort the source lines by decreasing total bytes accessed
+ */
+static bool more_traffic (const trace_source_line_traffic &left, const trace_source_line_traffic &right)
+{
+    uint64_t left_bytes = 0;
+    uint64_t right_bytes = 0;
+
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        left_bytes += left.bytes[kind];
+        right_bytes += right.bytes[kind];
+    }
+
+    return (left_bytes != right_bytes) ? (left_bytes > right_bytes) : (left.first_ip < right.first_ip);
+}
+
+/**
+ * @brief Output the traffic of each source line, in order of decreasing total bytes accessed
+ * @param[in,out] output Where to output the traffic
+ * @param[in] prefix The prefix of each source line record
+ */
+void source_line_traffic::display (trace_encoder &output, const std::string &prefix) const
+{
+    std::vector<trace_source_line_traffic> sorted_lines;
+    std::map<instruction_source_location,source_line>::const_iterator it;
+
+    for (it = source_lines.begin(); it != source_lines.end(); ++it)
+    {
+        trace_source_line_traffic traffic;
+        trace_page_footprint footprint;
+
+        traffic.routine = it->first.routine;
+        traffic.file = it->first.file;
+        traffic.line = it->first.line;
+        traffic.first_ip = *it->second.ips.begin();
+        traffic.instructions = it->second.ips.size();
+        for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+        {
+            traffic.accesses[kind] = it->second.traffic.accesses[kind];
+            traffic.bytes[kind] = it->second.traffic.bytes[kind];
+        }
+        it->second.traffic.lines.get_statistics (footprint);
+        traffic.line_size = footprint.line_size;
+        traffic.lines = footprint.lines;
+        sorted_lines.push_back (traffic);
+    }
+    std::sort (sorted_lines.begin(), sorted_lines.end(), more_traffic);
+
+    for (std::vector<trace_source_line_traffic>::const_iterator line_it = sorted_lines.begin();
+         line_it != sorted_lines.end(); ++line_it)
+    {
+        output.source_line_traffic (prefix, *line_it);
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * @file instruction_traffic.h
+ * @date 16 Oct 2026
+ * @details
+ *  Counts the memory traffic of each memory operand of each static instruction, as the bytes accessed of each kind and
+ *  the distinct cache lines touched, and rolls the traffic up to the source lines of the instructions. This shows
+ *  which code is responsible for the accesses to a region, rather than only which regions were accessed.
+ *
+ *  The touched cache lines are held in a page_footprint, so the distinct lines of the instructions at a source line,
+ *  and of different threads, are counted by merging the footprints.
+ *
+ *  This is independent of Pin, so that the counting can be used by programs other than the memory_profile Pin tool.
+ */
+
+#ifndef INSTRUCTION_TRAFFIC_H_
+#define INSTRUCTION_TRAFFIC_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <map>
+#include <set>
+
+#include "trace_format.h"
+#include "page_footprint.h"
+
+/** The memory traffic of one memory operand of a static instruction */
+class instruction_traffic
+{
+public:
+    instruction_traffic (uint32_t line_size);
+    void record_access (uint32_t access_kind, uint64_t memory_addr, uint32_t bytes_accessed);
+    void merge_from (const instruction_traffic &other);
+    bool empty (void) const;
+private:
+    friend class source_line_traffic;
+
+    /** The number of accesses, indexed by memory_access_kind */
+    uint64_t accesses[trace_num_access_kinds];
+    /** The total bytes accessed, indexed by memory_access_kind */
+    uint64_t bytes[trace_num_access_kinds];
+    /** The cache lines touched by accesses of any kind */
+    page_footprint lines;
+};
+
+/** The location in the source of a static instruction, which its traffic is rolled up to */
+struct instruction_source_location
+{
+    /** The name of the routine containing the instruction */
+    std::string routine;
+    /** The source file, or ??? when the instruction has no line information */
+    std::string file;
+    /** The line number in the source file, or zero when the instruction has no line information */
+    uint32_t line;
+
+    bool operator< (const instruction_source_location &other) const;
+};
+
+/** Rolls up the traffic of the memory operands of instructions to the source lines of the instructions */
+class source_line_traffic
+{
+public:
+    source_line_traffic (uint32_t line_size) : line_size (line_size) {}
+    void add_operand (uint64_t ip, const instruction_source_location &location, const instruction_traffic &traffic);
+    void display (trace_encoder &output, const std::string &prefix) const;
+private:
+    /** The traffic of the instructions at one source line */
+    struct source_line
+    {
+        source_line (uint32_t line_size) : traffic (line_size) {}
+
+        /** The addresses of the instructions, which may each have multiple memory operands */
+        std::set<uint64_t> ips;
+        /** The combined traffic of the memory operands of the instructions */
+        instruction_traffic traffic;
+    };
+
+    uint32_t line_size;
+    std::map<instruction_source_location,source_line> source_lines;
+};
+
+#endif /* INSTRUCTION_TRAFFIC_H_ */
@@ -0,0 +1,1228 @@
+/*
+ * @file memory_regions.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the recording of the memory profile of a set of memory accesses.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "memory_regions.h"
+#include "page_footprint.h"
+
+const char *const memory_access_kind_names[NUM_MEMORY_OPERAND_KINDS] =
+{
+    "memory read",
+    "memory write",
+    "memory prefetch",
+    "memory read-modify-write"
+};
+
+memory_regions_config memory_regions_usage::config = {false, false, false, 64};
+
+/**
+ * @brief Select the optional statistics maintained for all memory profiles
+ * @details Must be called before any access is recorded, as the statistics are maintained per region.
+ * @param[in] new_config The optional statistics to maintain
+ */
+void memory_regions_usage::configure (const memory_regions_config &new_config)
+{
+    config = new_config;
+}
+
+memory_regions_usage::memory_regions_usage()
+    : total_regions (0), num_cached_regions (0), region_cache_hits (0), region_cache_misses (0)
+{
+    odd_size_counts.resize (1);
+}
+
+/**
+ * @brief Clear the memory profile
+ * @details The pools of regions and histograms are reset rather than freed, so their storage is re-used
+ *          by the next top-level function.
+ */
+void memory_regions_usage::clear(void)
+{
+    region_chunks.clear();
+    chunk_order.clear();
+    free_chunks.clear();
+    total_regions = 0;
+    size_histograms.clear();
+    reuse_distance_histograms.clear();
+    free_histogram_indices.clear();
+    odd_size_counts.resize (1);
+    num_cached_regions = 0;
+}
+
+/**
+ * @brief Count accesses with a size which isn't a power of two, in the sparse list for the histogram
+ * @param[in,out] histogram The access size histogram to update
+ * @param[in] bytes_accessed How many bytes were accessed by the instruction
+ * @param[in] num_accesses The number of accesses to count
+ */
+void memory_regions_usage::update_odd_size_count (access_size_histogram &histogram, const uint32_t bytes_accessed,
+                                                  const uint32_t num_accesses)
+{
+    uint32_t odd_size_index;
+
+    for (odd_size_index = histogram.first_odd_size_index; odd_size_index != 0;
+         odd_size_index = odd_size_counts[odd_size_index].next_index)
+    {
+        if (odd_size_counts[odd_size_index].mem_access_size == bytes_accessed)
+        {
+            odd_size_counts[odd_size_index].count += num_accesses;
+            return;
+        }
+    }
+
+    odd_size_count new_count;
+    new_count.count = num_accesses;
+    new_count.mem_access_size = bytes_accessed;
+    new_count.next_index = histogram.first_odd_size_index;
+    histogram.first_odd_size_index = odd_size_counts.size();
+    odd_size_counts.push_back (new_count);
+}
+
+/**
+ * @brief Insert an empty chunk into the region index
+ * @details Chunks emptied by erasing their regions are re-used before allocating a new chunk.
+ * @param[in] chunk_index Where to insert the chunk in chunk_order[]
+ */
+void memory_regions_usage::insert_chunk (const uint32_t chunk_index)
+{
+    uint32_t pool_index;
+
+    if (free_chunks.empty())
+    {
+        pool_index = region_chunks.size();
+        region_chunks.resize (pool_index + 1);
+    }
+    else
+    {
+        pool_index = free_chunks.back();
+        free_chunks.pop_back();
+    }
+    region_chunks[pool_index].num_regions = 0;
+    chunk_order.insert (chunk_order.begin() + chunk_index, pool_index);
+
+    for (uint32_t cache_index = 0; cache_index < num_cached_regions; cache_index++)
+    {
+        if (cached_regions[cache_index].chunk_index >= chunk_index)
+        {
+            cached_regions[cache_index].chunk_index++;
+        }
+    }
+}
+
+/**
+ * @brief Split a full chunk, by moving the upper half of its regions to a new chunk which follows it
+ * @param[in] chunk_index The index in chunk_order[] of the chunk to split
+ */
+void memory_regions_usage::split_chunk (const uint32_t chunk_index)
+{
+    const uint32_t first_moved_region = max_chunk_regions / 2;
+
+    insert_chunk (chunk_index + 1);
+
+    region_chunk &chunk = region_chunks[chunk_order[chunk_index]];
+    region_chunk &new_chunk = region_chunks[chunk_order[chunk_index + 1]];
+
+    new_chunk.num_regions = chunk.num_regions - first_moved_region;
+    memcpy (new_chunk.regions, &chunk.regions[first_moved_region], new_chunk.num_regions * sizeof (region_info));
+    chunk.num_regions = first_moved_region;
+
+    for (uint32_t cache_index = 0; cache_index < num_cached_regions; cache_index++)
+    {
+        region_position &position = cached_regions[cache_index];
+
+        if ((position.chunk_index == chunk_index) && (position.region_index >= first_moved_region))
+        {
+            position.chunk_index++;
+            position.region_index -= first_moved_region;
+        }
+    }
+}
+
+/**
+ * @brief Remove an empty chunk from the region index, so it can be re-used
+ * @param[in] chunk_index The index in chunk_order[] of the chunk to remove, which isn't cached
+ */
+void memory_regions_usage::remove_chunk (const uint32_t chunk_index)
+{
+    free_chunks.push_back (chunk_order[chunk_index]);
+    chunk_order.erase (chunk_order.begin() + chunk_index);
+
+    for (uint32_t cache_index = 0; cache_index < num_cached_regions; cache_index++)
+    {
+        if (cached_regions[cache_index].chunk_index > chunk_index)
+        {
+            cached_regions[cache_index].chunk_index--;
+        }
+    }
+}
+
+/**
+ * @brief Insert a new region, with zero access counts
+ * @details A region inserted between two chunks is appended to the preceding chunk when it has space, so that regions
+ *          inserted in order of increasing address fill each chunk. A full chunk is split in half, unless the region
+ *          is appended after the last region in which case the region starts a new chunk.
+ * @param[in,out] position On entry where to insert the region, which is the position of the first region with a
+ *                         greater start address. On exit the position of the inserted region.
+ * @param[in] start_addr The start address of the new region
+ * @param[in] end_addr The end address of the new region
+ */
+void memory_regions_usage::insert_region (region_position &position, const uint64_t start_addr,
+                                          const uint64_t end_addr)
+{
+    region_info new_region;
+    access_size_histogram new_histogram;
+
+    memset (&new_histogram, 0, sizeof (new_histogram));
+    new_region.region_start_addr = start_addr;
+    new_region.region_end_addr = end_addr;
+    new_region.total_bytes = 0;
+    new_region.cache_line_increments = 0;
+    new_region.cache_line_decrements = 0;
+    if (free_histogram_indices.empty())
+    {
+        new_region.size_histogram_index = size_histograms.size();
+        size_histograms.push_back (new_histogram);
+    }
+    else
+    {
+        new_region.size_histogram_index = free_histogram_indices.back();
+        free_histogram_indices.pop_back();
+        size_histograms[new_region.size_histogram_index] = new_histogram;
+    }
+    if (config.reuse_distance)
+    {
+        trace_reuse_distance_histogram new_reuse_distances;
+
+        memset (&new_reuse_distances, 0, sizeof (new_reuse_distances));
+        if (new_region.size_histogram_index == reuse_distance_histograms.size())
+        {
+            reuse_distance_histograms.push_back (new_reuse_distances);
+        }
+        else
+        {
+            reuse_distance_histograms[new_region.size_histogram_index] = new_reuse_distances;
+        }
+    }
+
+    if (chunk_order.empty())
+    {
+        insert_chunk (0);
+    }
+    else if ((position.region_index == 0) && (position.chunk_index > 0) &&
+             (is_end_position (position) ||
+              (region_chunks[chunk_order[position.chunk_index - 1]].num_regions < max_chunk_regions)))
+    {
+        position.chunk_index--;
+        position.region_index = region_chunks[chunk_order[position.chunk_index]].num_regions;
+    }
+    if (region_chunks[chunk_order[position.chunk_index]].num_regions == max_chunk_regions)
+    {
+        if (position.region_index == max_chunk_regions)
+        {
+            insert_chunk (position.chunk_index + 1);
+            position.chunk_index++;
+            position.region_index = 0;
+        }
+        else
+        {
+            split_chunk (position.chunk_index);
+            if (position.region_index >= region_chunks[chunk_order[position.chunk_index]].num_regions)
+            {
+                position.region_index -= region_chunks[chunk_order[position.chunk_index]].num_regions;
+                position.chunk_index++;
+            }
+        }
+    }
+
+    region_chunk &chunk = region_chunks[chunk_order[position.chunk_index]];
+
+    memmove (&chunk.regions[position.region_index + 1], &chunk.regions[position.region_index],
+             (chunk.num_regions - position.region_index) * sizeof (region_info));
+    chunk.regions[position.region_index] = new_region;
+    chunk.num_regions++;
+    total_regions++;
+
+    for (uint32_t cache_index = 0; cache_index < num_cached_regions; cache_index++)
+    {
+        region_position &cached_position = cached_regions[cache_index];
+
+        if ((cached_position.chunk_index == position.chunk_index) &&
+            (cached_position.region_index >= position.region_index))
+        {
+            cached_position.region_index++;
+        }
+    }
+}
+
+/**
+ * @brief Erase consecutive regions, which have been merged into the preceding region
+ * @details The access size histograms of the erased regions are made available for re-use. Cached erased regions
+ *          are replaced by the preceding region they were merged into, which may then be cached more than once
+ *          so duplicate cache entries are removed.
+ * @param[in] first_position The position of the first region to erase
+ * @param[in] num_regions The number of regions to erase
+ */
+void memory_regions_usage::erase_regions (const region_position &first_position, const uint32_t num_regions)
+{
+    region_position merged_position = first_position;
+    region_position position = first_position;
+    uint32_t remaining_regions = num_regions;
+    uint32_t num_unique_regions;
+
+    previous_position (merged_position);
+    while (remaining_regions > 0)
+    {
+        region_chunk &chunk = region_chunks[chunk_order[position.chunk_index]];
+        const uint32_t num_erased = std::min (remaining_regions, chunk.num_regions - position.region_index);
+        const uint32_t end_region_index = position.region_index + num_erased;
+
+        for (uint32_t region_index = position.region_index; region_index < end_region_index; region_index++)
+        {
+            free_histogram_indices.push_back (chunk.regions[region_index].size_histogram_index);
+        }
+        memmove (&chunk.regions[position.region_index], &chunk.regions[end_region_index],
+                 (chunk.num_regions - end_region_index) * sizeof (region_info));
+        chunk.num_regions -= num_erased;
+        total_regions -= num_erased;
+        remaining_regions -= num_erased;
+
+        for (uint32_t cache_index = 0; cache_index < num_cached_regions; cache_index++)
+        {
+            region_position &cached_position = cached_regions[cache_index];
+
+            if (cached_position.chunk_index == position.chunk_index)
+            {
+                if (cached_position.region_index >= end_region_index)
+                {
+                    cached_position.region_index -= num_erased;
+                }
+                else if (cached_position.region_index >= position.region_index)
+                {
+                    cached_position = merged_position;
+                }
+            }
+        }
+
+        if (chunk.num_regions == 0)
+        {
+            /* The regions which followed the erased regions start the next chunk, which takes the removed chunk's
+             * place in chunk_order[] */
+            remove_chunk (position.chunk_index);
+        }
+        else
+        {
+            position.chunk_index++;
+            position.region_index = 0;
+        }
+    }
+
+    num_unique_regions = 0;
+    for (uint32_t cache_index = 0; cache_index < num_cached_regions; cache_index++)
+    {
+        bool duplicate = false;
+
+        for (uint32_t unique_index = 0; !duplicate && (unique_index < num_unique_regions); unique_index++)
+        {
+            duplicate = same_position (cached_regions[unique_index], cached_regions[cache_index]);
+        }
+        if (!duplicate)
+        {
+            cached_regions[num_unique_regions] = cached_regions[cache_index];
+            num_unique_regions++;
+        }
+    }
+    num_cached_regions = num_unique_regions;
+}
+
+/**
+ * @brief Merge the counts for a region into the adjacent preceding region
+ * @param[in,out] region The region to merge into
+ * @param[in] next_region The region to be merged, which will then be erased by the caller
+ */
+void memory_regions_usage::merge_region (region_info &region, const region_info &next_region)
+{
+    access_size_histogram &histogram = size_histograms[region.size_histogram_index];
+    const access_size_histogram &next_histogram = size_histograms[next_region.size_histogram_index];
+
+    if (next_region.region_end_addr > region.region_end_addr)
+    {
+        region.region_end_addr = next_region.region_end_addr;
+    }
+    region.total_bytes += next_region.total_bytes;
+    region.cache_line_increments += next_region.cache_line_increments;
+    region.cache_line_decrements += next_region.cache_line_decrements;
+    for (uint32_t size_index = 0; size_index < num_power_of_two_sizes; size_index++)
+    {
+        histogram.power_of_two_counts[size_index] += next_histogram.power_of_two_counts[size_index];
+    }
+    histogram.unknown_size_count += next_histogram.unknown_size_count;
+    for (uint32_t level = 0; level < trace_num_cache_levels; level++)
+    {
+        histogram.cache.misses[level] += next_histogram.cache.misses[level];
+        histogram.cache.writebacks[level] += next_histogram.cache.writebacks[level];
+    }
+    for (uint32_t pattern = 0; pattern < trace_num_access_patterns; pattern++)
+    {
+        histogram.access_pattern_counts[pattern] += next_histogram.access_pattern_counts[pattern];
+    }
+    for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+    {
+        histogram.tlb_misses[page_size] += next_histogram.tlb_misses[page_size];
+    }
+    if (config.reuse_distance)
+    {
+        trace_reuse_distance_histogram &reuse_distances = reuse_distance_histograms[region.size_histogram_index];
+        const trace_reuse_distance_histogram &next_reuse_distances =
+                reuse_distance_histograms[next_region.size_histogram_index];
+
+        reuse_distances.cold += next_reuse_distances.cold;
+        for (uint32_t bucket = 0; bucket < trace_num_reuse_distance_buckets; bucket++)
+        {
+            reuse_distances.counts[bucket] += next_reuse_distances.counts[bucket];
+        }
+    }
+
+    /* Append the list of odd sized counts. Any sizes in both lists are combined when displayed. */
+    if (next_histogram.first_odd_size_index != 0)
+    {
+        if (histogram.first_odd_size_index == 0)
+        {
+            histogram.first_odd_size_index = next_histogram.first_odd_size_index;
+        }
+        else
+        {
+            uint32_t odd_size_index = histogram.first_odd_size_index;
+
+            while (odd_size_counts[odd_size_index].next_index != 0)
+            {
+                odd_size_index = odd_size_counts[odd_size_index].next_index;
+            }
+            odd_size_counts[odd_size_index].next_index = next_histogram.first_odd_size_index;
+        }
+    }
+}
+
+/**
+ * @brief Merge any following regions which overlap or are adjacent to a region into the region
+ * @param[in] position The position of the region to merge into
+ */
+void memory_regions_usage::merge_next_regions (const region_position &position)
+{
+    region_info &region = region_at (position);
+    region_position next_region_position = position;
+    uint32_t num_merged_regions = 0;
+
+    while (next_position (next_region_position) &&
+           ((region.region_end_addr + 1) >= region_at (next_region_position).region_start_addr))
+    {
+        /* Regions are adjacent - so combine */
+        merge_region (region, region_at (next_region_position));
+        num_merged_regions++;
+    }
+    if (num_merged_regions > 0)
+    {
+        region_position first_merged_position = position;
+
+        next_position (first_merged_position);
+        erase_regions (first_merged_position, num_merged_regions);
+    }
+}
+
+/**
+ * @brief Make a region the most recently used entry in the cached regions
+ * @param[in] cache_index The index in cached_regions[] which it currently occupies,
+ *                        or num_cached_regions if the region isn't currently cached
+ * @param[in] position The position of the region to make the most recently used
+ */
+void memory_regions_usage::make_most_recently_used (const uint32_t cache_index, const region_position &position)
+{
+    uint32_t index = cache_index;
+
+    if (index == num_cached_regions)
+    {
+        if (num_cached_regions < max_cached_regions)
+        {
+            num_cached_regions++;
+        }
+        else
+        {
+            /* Evict the least recently used region */
+            index--;
+        }
+    }
+
+    for (; index > 0; index--)
+    {
+        cached_regions[index] = cached_regions[index - 1];
+    }
+    cached_regions[0] = position;
+}
+
+/**
+ * @details
+ *  Attempt to record a memory access using the cached regions, which handles the common cases of:
+ *  a) The access being entirely within a cached region.
+ *  b) The access extending the end of a cached region, without reaching the following region.
+ *  c) The access extending the start of a cached region, without reaching the preceding region.
+ *  Only the neighbouring regions of the cached region are examined, rather than searching the region index.
+ *  The updates made to the region are the same as those made by record_access() for the same access.
+ * @param[in] access_start_addr Start address read or written
+ * @param[in] access_end_addr End address read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ * @return Returns true if the access was recorded, or false if record_access() needs to search for the regions
+ *         affected by the access.
+ */
+bool memory_regions_usage::record_cached_access (const uint64_t access_start_addr, const uint64_t access_end_addr,
+                                                 const uint32_t bytes_accessed)
+{
+    for (uint32_t cache_index = 0; cache_index < num_cached_regions; cache_index++)
+    {
+        const region_position position = cached_regions[cache_index];
+        region_info &region = region_at (position);
+
+        if ((access_start_addr >= region.region_start_addr) && (access_end_addr <= region.region_end_addr))
+        {
+            /* The memory access is entirely within the cached region */
+            update_access_counts (region, bytes_accessed);
+            make_most_recently_used (cache_index, position);
+            return true;
+        }
+        else if ((access_start_addr >= region.region_start_addr) && (access_start_addr <= (region.region_end_addr + 1)) &&
+                 (access_end_addr > region.region_end_addr))
+        {
+            /* The memory access overlaps, or is adjacent to, the end of the cached region.
+             * Can only extend in place if the access doesn't reach the following region, otherwise need to merge. */
+            region_position next_region_position = position;
+
+            if (!next_position (next_region_position) ||
+                (region_at (next_region_position).region_start_addr > (access_end_addr + 1)))
+            {
+                update_addr_inc_cache_line_counts (region, access_end_addr);
+                region.region_end_addr = access_end_addr;
+                update_access_counts (region, bytes_accessed);
+                make_most_recently_used (cache_index, position);
+                return true;
+            }
+            return false;
+        }
+        else if ((access_start_addr < region.region_start_addr) && ((access_end_addr + 1) >= region.region_start_addr) &&
+                 (access_end_addr <= region.region_end_addr))
+        {
+            /* The memory access overlaps, or is adjacent to, the start of the cached region.
+             * Can only extend in place if the access doesn't reach the preceding region, otherwise need to merge. */
+            region_position previous_region_position = position;
+
+            if (!previous_position (previous_region_position) ||
+                ((region_at (previous_region_position).region_end_addr + 1) < access_start_addr))
+            {
+                update_addr_dec_cache_line_counts (region, access_start_addr);
+                region.region_start_addr = access_start_addr;
+                update_access_counts (region, bytes_accessed);
+                make_most_recently_used (cache_index, position);
+                return true;
+            }
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Called when an instruction reads or write memory to update the memory profile
+ * @details An access which is only adjacent to existing regions extends one of the regions in place, rather than
+ *          inserting a new region which is then merged, so that only accesses which start a new region insert one.
+ * @param[in] access_start_address Start address read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ */
+void memory_regions_usage::record_access (const uint64_t access_start_addr, const uint32_t bytes_accessed)
+{
+    const uint64_t access_end_addr = access_start_addr + bytes_accessed - 1;
+    region_position position, adjacent_position;
+    bool region_processed = false;
+    bool region_addrs_changed = false;
+    bool adjacent_to_end = false;
+    bool adjacent_to_start = false;
+    bool region_merge_complete;
+    uint64_t modified_start_addr = access_start_addr;
+    uint64_t modified_end_addr = access_end_addr;
+
+    if (record_cached_access (access_start_addr, access_end_addr, bytes_accessed))
+    {
+        region_cache_hits++;
+        return;
+    }
+    region_cache_misses++;
+
+    /* Determine if the memory access overlaps, or is adjacent to, any existing region */
+    position = lower_bound_region (access_start_addr);
+    previous_position (position);
+    while (!region_processed && !is_end_position (position) &&
+           (region_at (position).region_start_addr <= (access_end_addr + 1)))
+    {
+        region_info &region = region_at (position);
+
+        if ((access_start_addr < region.region_start_addr) && (access_end_addr >= region.region_start_addr))
+        {
+            /* The memory access overlaps the beginning of an existing region.
+             * The preceding region ends before the access, so the order of the regions is unchanged. */
+            update_addr_dec_cache_line_counts (region, access_start_addr);
+            update_access_counts (region, bytes_accessed);
+            if (access_end_addr > region.region_end_addr)
+            {
+                region.region_end_addr = access_end_addr;
+            }
+            region.region_start_addr = access_start_addr;
+            region_processed = true;
+            region_addrs_changed = true;
+            modified_end_addr = region.region_end_addr;
+        }
+        else if ((access_start_addr >= region.region_start_addr) && (access_end_addr <= region.region_end_addr))
+        {
+            /* The memory access is entirely within an existing region */
+            update_access_counts (region, bytes_accessed);
+            region_processed = true;
+        }
+        else if ((access_start_addr <= region.region_end_addr) && (access_end_addr > region.region_end_addr))
+        {
+            /* The memory access overlaps the end of an existing region */
+            update_addr_inc_cache_line_counts (region, access_end_addr);
+            region.region_end_addr = access_end_addr;
+            update_access_counts (region, bytes_accessed);
+            region_processed = true;
+            region_addrs_changed = true;
+            modified_start_addr = region.region_start_addr;
+        }
+        else
+        {
+            /* Update cache line counts for a memory access which will be combined with an adjacent region */
+            if (access_start_addr == (region.region_end_addr + 1))
+            {
+                update_addr_inc_cache_line_counts (region, access_end_addr);
+                adjacent_to_end = true;
+                adjacent_position = position;
+            }
+            if ((access_end_addr + 1) == region.region_start_addr)
+            {
+                update_addr_dec_cache_line_counts (region, access_start_addr);
+                if (!adjacent_to_end)
+                {
+                    adjacent_to_start = true;
+                    adjacent_position = position;
+                }
+            }
+        }
+        if (!region_processed)
+        {
+            next_position (position);
+        }
+    }
+
+    if (!region_processed)
+    {
+        if (adjacent_to_end)
+        {
+            /* Extend the preceding region in place. Any following adjacent region is merged into it below. */
+            region_info &region = region_at (adjacent_position);
+
+            region.region_end_addr = access_end_addr;
+            update_access_counts (region, bytes_accessed);
+            modified_start_addr = region.region_start_addr;
+        }
+        else if (adjacent_to_start)
+        {
+            /* Extend the following region in place. The preceding region isn't adjacent to the access. */
+            region_info &region = region_at (adjacent_position);
+
+            region.region_start_addr = access_start_addr;
+            update_access_counts (region, bytes_accessed);
+            modified_end_addr = region.region_end_addr;
+        }
+        else
+        {
+            /* Insert as a new region.
+             * No existing region starts at the access, otherwise it would have been processed */
+            adjacent_position = upper_bound_region (access_start_addr);
+            insert_region (adjacent_position, access_start_addr, access_end_addr);
+            update_access_counts (region_at (adjacent_position), bytes_accessed);
+        }
+        region_addrs_changed = true;
+    }
+
+    if (region_addrs_changed)
+    {
+        /* Combine adjacent regions */
+        position = lower_bound_region (modified_start_addr);
+        previous_position (position);
+
+        region_merge_complete = false;
+        while (!region_merge_complete)
+        {
+            merge_next_regions (position);
+            region_merge_complete = !next_position (position) ||
+                    (region_at (position).region_start_addr > modified_end_addr);
+        }
+
+        /* Find the region which now contains the access */
+        position = upper_bound_region (access_start_addr);
+        previous_position (position);
+    }
+
+    /* Cache the region which contains the access, as the next access is likely to be within or next to it */
+    for (uint32_t cache_index = 0; cache_index < num_cached_regions; cache_index++)
+    {
+        if (same_position (cached_regions[cache_index], position))
+        {
+            make_most_recently_used (cache_index, position);
+            return;
+        }
+    }
+    make_most_recently_used (num_cached_regions, position);
+}
+
+/**
+ * @details
+ *  Called to record a run of consecutive accesses of the same size to contiguous addresses, which has the same effect
+ *  on the memory profile as calling record_access() for each access in the run.
+ *  The first access is recorded by record_access(), which leaves the region containing the access as the most
+ *  recently used cached region. If the remainder of the run only extends that region, without reaching a neighbouring
+ *  region, the region is updated for the remaining accesses in one step. Otherwise, the remaining accesses are recorded
+ *  individually so that neighbouring regions are merged in the same way.
+ * @param[in] first_memory_addr The address of the first access in the run
+ * @param[in] bytes_accessed The number of bytes read or written by each access in the run
+ * @param[in] num_accesses The number of accesses in the run
+ * @param[in] ascending When true each access in the run is at bytes_accessed above the previous access,
+ *                      otherwise each access is at bytes_accessed below the previous access.
+ */
+void memory_regions_usage::record_access_run (const uint64_t first_memory_addr, const uint32_t bytes_accessed,
+                                              const uint32_t num_accesses, const bool ascending)
+{
+    const uint64_t run_bytes = (uint64_t) bytes_accessed * (num_accesses - 1);
+    uint32_t access_index;
+
+    record_access (first_memory_addr, bytes_accessed);
+    if (num_accesses == 1)
+    {
+        return;
+    }
+
+    /* A single access of no more than one cache line can only extend a region into one new cache line,
+     * so the change in cache lines for the run gives the cache line counts. */
+    if ((bytes_accessed > 0) && (bytes_accessed <= cache_line_size))
+    {
+        const region_position position = cached_regions[0];
+        region_info &region = region_at (position);
+        region_position neighbour_position = position;
+
+        if (ascending)
+        {
+            const uint64_t run_end_addr = first_memory_addr + run_bytes + bytes_accessed - 1;
+
+            if (!next_position (neighbour_position) ||
+                (region_at (neighbour_position).region_start_addr > (run_end_addr + 1)))
+            {
+                if (run_end_addr > region.region_end_addr)
+                {
+                    region.cache_line_increments +=
+                            (run_end_addr / cache_line_size) - (region.region_end_addr / cache_line_size);
+                    region.region_end_addr = run_end_addr;
+                }
+                update_access_counts (region, bytes_accessed, num_accesses - 1);
+                region_cache_hits += num_accesses - 1;
+                return;
+            }
+        }
+        else
+        {
+            const uint64_t run_start_addr = first_memory_addr - run_bytes;
+
+            if (!previous_position (neighbour_position) ||
+                ((region_at (neighbour_position).region_end_addr + 1) < run_start_addr))
+            {
+                if (run_start_addr < region.region_start_addr)
+                {
+                    region.cache_line_decrements +=
+                            (region.region_start_addr / cache_line_size) - (run_start_addr / cache_line_size);
+                    region.region_start_addr = run_start_addr;
+                }
+                update_access_counts (region, bytes_accessed, num_accesses - 1);
+                region_cache_hits += num_accesses - 1;
+                return;
+            }
+        }
+    }
+
+    for (access_index = 1; access_index < num_accesses; access_index++)
+    {
+        record_access (ascending ? (first_memory_addr + ((uint64_t) bytes_accessed * access_index)) :
+                                   (first_memory_addr - ((uint64_t) bytes_accessed * access_index)),
+                       bytes_accessed);
+    }
+}
+
+/**
+ * @brief Insert one region of another memory profile into this memory profile, and merge it with any overlapping or
+ *        adjacent regions
+ * @param[in] other The memory profile containing the region
+ * @param[in] other_region The region to insert
+ * @param[in] repeated_access When true the accesses of the region are the writes of read-modify-write accesses, which
+ *                            repeat the accesses recorded for the reads. The repeat of an access hits in the simulated
+ *                            caches and TLBs, and each cache line is reused after only the other lines of the access.
+ */
+void memory_regions_usage::merge_region_from (const memory_regions_usage &other, const region_info &other_region,
+                                              const bool repeated_access)
+{
+    const access_size_histogram &other_histogram = other.size_histograms[other_region.size_histogram_index];
+    region_position position = upper_bound_region (other_region.region_start_addr);
+    region_position merge_position;
+
+    insert_region (position, other_region.region_start_addr, other_region.region_end_addr);
+    region_info &region = region_at (position);
+    access_size_histogram &histogram = size_histograms[region.size_histogram_index];
+
+    region.total_bytes = other_region.total_bytes;
+    region.cache_line_increments = other_region.cache_line_increments;
+    region.cache_line_decrements = other_region.cache_line_decrements;
+    memcpy (histogram.power_of_two_counts, other_histogram.power_of_two_counts, sizeof (histogram.power_of_two_counts));
+    histogram.unknown_size_count = other_histogram.unknown_size_count;
+    memcpy (histogram.access_pattern_counts, other_histogram.access_pattern_counts,
+            sizeof (histogram.access_pattern_counts));
+    if (!repeated_access)
+    {
+        histogram.cache = other_histogram.cache;
+        memcpy (histogram.tlb_misses, other_histogram.tlb_misses, sizeof (histogram.tlb_misses));
+    }
+    uint64_t num_accesses = other_histogram.unknown_size_count;
+    for (uint32_t size_index = 0; size_index < num_power_of_two_sizes; size_index++)
+    {
+        num_accesses += other_histogram.power_of_two_counts[size_index];
+    }
+    for (uint32_t odd_size_index = other_histogram.first_odd_size_index; odd_size_index != 0;
+         odd_size_index = other.odd_size_counts[odd_size_index].next_index)
+    {
+        odd_size_count new_count = other.odd_size_counts[odd_size_index];
+
+        num_accesses += new_count.count;
+        new_count.next_index = histogram.first_odd_size_index;
+        histogram.first_odd_size_index = odd_size_counts.size();
+        odd_size_counts.push_back (new_count);
+    }
+    if (config.reuse_distance)
+    {
+        const trace_reuse_distance_histogram &other_reuse_distances =
+                other.reuse_distance_histograms[other_region.size_histogram_index];
+        trace_reuse_distance_histogram &reuse_distances = reuse_distance_histograms[region.size_histogram_index];
+
+        if (repeated_access)
+        {
+            /* Read-modify-write operands are at most 16 bytes, so assuming they are no larger than a cache line each
+             * access is to one or two lines. The lines in excess of one per access are the accesses which span two. */
+            uint64_t num_lines = other_reuse_distances.cold;
+
+            for (uint32_t bucket = 0; bucket < trace_num_reuse_distance_buckets; bucket++)
+            {
+                num_lines += other_reuse_distances.counts[bucket];
+            }
+            const uint64_t spanning_accesses = (num_lines > num_accesses) ? (num_lines - num_accesses) : 0;
+
+            reuse_distances.counts[trace_reuse_distance_bucket (0)] = num_accesses - spanning_accesses;
+            reuse_distances.counts[trace_reuse_distance_bucket (1)] = 2 * spanning_accesses;
+        }
+        else
+        {
+            reuse_distances = other_reuse_distances;
+        }
+    }
+
+    /* Combine with overlapping or adjacent regions */
+    merge_position = position;
+    if (!previous_position (merge_position) ||
+        ((region_at (merge_position).region_end_addr + 1) < region.region_start_addr))
+    {
+        merge_position = position;
+    }
+    merge_next_regions (merge_position);
+}
+
+/**
+ * @brief Merge the regions of another memory profile into this memory profile
+ * @details Used to combine the memory profiles of different threads. Each region of the other memory profile is
+ *          inserted and then merged with any overlapping or adjacent regions, in the same way as regions are
+ *          merged when accessed. The access counts of overlapping regions are summed.
+ * @param[in] other The memory profile to merge from
+ */
+void memory_regions_usage::merge_from (const memory_regions_usage &other)
+{
+    for (region_position position = first_position (); !other.is_end_position (position);
+         other.next_position (position))
+    {
+        merge_region_from (other, other.region_at (position), false);
+    }
+}
+
+/**
+ * @brief Merge the regions of a MEMORY_ACCESS_READ_WRITE memory profile into a read or write memory profile
+ * @details A read-modify-write access is recorded once, with the outcome of the access in the simulated caches and TLBs
+ *          and the reuse distances as for the read. The write then hits, so the write memory profile gets the same
+ *          regions, access sizes and access patterns as the read, with no misses and the reuse distances of repeating
+ *          the access. This gives the same statistics as if the read and write had been recorded separately, apart from
+ *          the cache line increments and decrements of regions which are also accessed by other operands.
+ * @param[in] other The read-modify-write memory profile to merge from
+ * @param[in] access_kind Either MEMORY_ACCESS_READ or MEMORY_ACCESS_WRITE for the kind of this memory profile
+ */
+void memory_regions_usage::merge_read_modify_write_from (const memory_regions_usage &other,
+                                                         const memory_access_kind access_kind)
+{
+    for (region_position position = first_position (); !other.is_end_position (position);
+         other.next_position (position))
+    {
+        merge_region_from (other, other.region_at (position), access_kind == MEMORY_ACCESS_WRITE);
+    }
+}
+
+/**
+ * @brief Add the region cache statistics of another memory profile to this memory profile
+ * @param[in] other The memory profile to add the statistics from
+ */
+void memory_regions_usage::add_region_cache_statistics (const memory_regions_usage &other)
+{
+    region_cache_hits += other.region_cache_hits;
+    region_cache_misses += other.region_cache_misses;
+}
+
+/**
+ * @brief Count the bytes in an address range which have been accessed
+ * @param[in] start_addr The first address of the range
+ * @param[in] end_addr The last address of the range
+ * @return The number of bytes in the range which are in one of the memory regions
+ */
+uint64_t memory_regions_usage::bytes_within (const uint64_t start_addr, const uint64_t end_addr) const
+{
+    region_position position = upper_bound_region (start_addr);
+    uint64_t num_bytes = 0;
+
+    /* The region before the first region starting after start_addr may overlap the start of the range */
+    previous_position (position);
+    while (!is_end_position (position) && (region_at (position).region_start_addr <= end_addr))
+    {
+        const region_info &region = region_at (position);
+        const uint64_t overlap_start = (region.region_start_addr > start_addr) ? region.region_start_addr : start_addr;
+        const uint64_t overlap_end = (region.region_end_addr < end_addr) ? region.region_end_addr : end_addr;
+
+        if (overlap_start <= overlap_end)
+        {
+            num_bytes += (overlap_end - overlap_start) + 1;
+        }
+        next_position (position);
+    }
+
+    return num_bytes;
+}
+
+/**
+ * @return The number of unique memory regions which have been accessed
+ */
+uint32_t memory_regions_usage::num_regions (void) const
+{
+    return total_regions;
+}
+
+/**
+ * @return The total number of bytes accessed in all the memory regions, counting each access
+ */
+uint64_t memory_regions_usage::total_bytes_accessed (void) const
+{
+    uint64_t num_bytes = 0;
+
+    for (region_position position = first_position (); !is_end_position (position); next_position (position))
+    {
+        num_bytes += region_at (position).total_bytes;
+    }
+
+    return num_bytes;
+}
+
+/**
+ * @brief Get the storage allocated for the memory profile
+ * @details The pools are only reset by clear(), so this is also the peak storage used since the memory profile was
+ *          created.
+ * @return The number of bytes allocated for the chunks of regions and the pools of histograms
+ */
+uint64_t memory_regions_usage::allocated_bytes (void) const
+{
+    return (region_chunks.capacity() * sizeof (region_chunk)) +
+            ((chunk_order.capacity() + free_chunks.capacity()) * sizeof (uint32_t)) +
+            (size_histograms.capacity() * sizeof (access_size_histogram)) +
+            (reuse_distance_histograms.capacity() * sizeof (trace_reuse_distance_histogram)) +
+            (free_histogram_indices.capacity() * sizeof (uint32_t)) +
+            (odd_size_counts.capacity() * sizeof (odd_size_count));
+}
+
+/**
+ * @brief Find the region containing a memory access which has already been recorded
+ * @details The region is usually the most recently used cached region.
+ * @param[in] memory_addr The memory address read or written
+ * @param[out] position When returning true, the position of the region containing the address
+ * @return Returns true if a region was found
+ */
+bool memory_regions_usage::find_recorded_region (const uint64_t memory_addr, region_position &position) const
+{
+    if ((num_cached_regions > 0) && (memory_addr >= region_at (cached_regions[0]).region_start_addr) &&
+        (memory_addr <= region_at (cached_regions[0]).region_end_addr))
+    {
+        position = cached_regions[0];
+        return true;
+    }
+
+    position = upper_bound_region (memory_addr);
+
+    return previous_position (position);
+}
+
+/**
+ * @brief Add the outcome of simulating a memory access in the cache hierarchy to the region containing the access
+ * @details Called after the access has been recorded, so that a region contains the access.
+ * @param[in] memory_addr The memory address read or written
+ * @param[in] outcome The outcome of the access in the simulated cache hierarchy
+ */
+void memory_regions_usage::record_cache_outcome (const uint64_t memory_addr, const cache_access_outcome &outcome)
+{
+    region_position position;
+
+    if (!find_recorded_region (memory_addr, position))
+    {
+        return;
+    }
+
+    trace_cache_statistics &cache = size_histograms[region_at (position).size_histogram_index].cache;
+    for (uint32_t level = 0; level < trace_num_cache_levels; level++)
+    {
+        cache.misses[level] += (outcome.levels_missed > level) ? 1 : 0;
+        cache.writebacks[level] += outcome.writebacks[level];
+    }
+}
+
+/**
+ * @brief Measure the reuse distances of a memory access, and add them to the histogram of the region containing
+ *        the access
+ * @details Called after the access has been recorded, so that a region contains the access.
+ * @param[in] memory_addr The memory address read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ * @param[in,out] analyser Measures the reuse distances of the cache lines accessed
+ */
+void memory_regions_usage::record_reuse_distances (const uint64_t memory_addr, const uint32_t bytes_accessed,
+                                                   reuse_distance_analyser &analyser)
+{
+    region_position position;
+
+    if (find_recorded_region (memory_addr, position))
+    {
+        analyser.access (memory_addr, bytes_accessed,
+                         reuse_distance_histograms[region_at (position).size_histogram_index]);
+    }
+}
+
+/**
+ * @brief Count an access in the region containing the access, by the access pattern of the accessing instruction
+ * @details Called after the access has been recorded, so that a region contains the access.
+ * @param[in] memory_addr The memory address read or written
+ * @param[in] access_pattern The access pattern learnt for the instruction
+ */
+void memory_regions_usage::record_access_pattern (const uint64_t memory_addr, const trace_access_pattern access_pattern)
+{
+    region_position position;
+
+    if (find_recorded_region (memory_addr, position))
+    {
+        size_histograms[region_at (position).size_histogram_index].access_pattern_counts[access_pattern]++;
+    }
+}
+
+/**
+ * @brief Add the estimated data TLB misses of a memory access to the region containing the access
+ * @details Called after the access has been recorded, so that a region contains the access.
+ * @param[in] memory_addr The memory address read or written
+ * @param[in] misses The TLB misses of the access for each page size
+ */
+void memory_regions_usage::record_tlb_misses (const uint64_t memory_addr, const uint64_t misses[])
+{
+    region_position position;
+
+    if (find_recorded_region (memory_addr, position))
+    {
+        uint64_t *const tlb_misses = size_histograms[region_at (position).size_histogram_index].tlb_misses;
+
+        for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+        {
+            tlb_misses[page_size] += misses[page_size];
+        }
+    }
+}
+
+/**
+ * @brief Get the trace record for a region
+ * @param[in] info The region
+ * @param[out] region The trace record, where all bytes are set so that the record can be fingerprinted
+ */
+void memory_regions_usage::get_trace_region (const region_info &info, trace_region &region) const
+{
+    /* Expand the histogram of the region to be indexed by the size of each access, with index zero used for sizes
+     * outside of the expected range. */
+    const access_size_histogram &histogram = size_histograms[info.size_histogram_index];
+    uint64_t *const mem_access_size_counts = region.access_size_counts;
+
+    memset (&region, 0, sizeof (region));
+    mem_access_size_counts[0] = histogram.unknown_size_count;
+    for (uint32_t size_index = 0; size_index < num_power_of_two_sizes; size_index++)
+    {
+        mem_access_size_counts[1U << size_index] = histogram.power_of_two_counts[size_index];
+    }
+    for (uint32_t odd_size_index = histogram.first_odd_size_index; odd_size_index != 0;
+         odd_size_index = odd_size_counts[odd_size_index].next_index)
+    {
+        mem_access_size_counts[odd_size_counts[odd_size_index].mem_access_size] += odd_size_counts[odd_size_index].count;
+    }
+
+    region.start_addr = info.region_start_addr;
+    region.end_addr = info.region_end_addr;
+    region.total_bytes = info.total_bytes;
+    region.cache_line_increments = info.cache_line_increments;
+    region.cache_line_decrements = info.cache_line_decrements;
+    region.cache = histogram.cache;
+    memcpy (region.access_pattern_counts, histogram.access_pattern_counts, sizeof (region.access_pattern_counts));
+    memcpy (region.tlb_misses, histogram.tlb_misses, sizeof (region.tlb_misses));
+    if (config.reuse_distance)
+    {
+        region.reuse_distances = reuse_distance_histograms[info.size_histogram_index];
+    }
+}
+
+/**
+ * @brief Get the fingerprint of each region of the memory profile, as output by display()
+ * @param[in] prefix The prefix the memory profile is output with, which is included in the fingerprints so that the
+ *                   same region in different memory profiles has a different fingerprint
+ * @param[in,out] fingerprints The fingerprints are appended in the order of the regions
+ */
+void memory_regions_usage::get_region_fingerprints (const std::string &prefix,
+                                                    std::vector<uint64_t> &fingerprints) const
+{
+    const uint64_t prefix_fingerprint = trace_fingerprint (prefix.data(), prefix.size());
+    trace_region region;
+
+    for (region_position position = first_position (); !is_end_position (position); next_position (position))
+    {
+        get_trace_region (region_at (position), region);
+        fingerprints.push_back (trace_fingerprint (&region, sizeof (region), prefix_fingerprint));
+    }
+}
+
+/**
+ * @brief Output the the trace file the read or write memory profile
+ * @details When cache simulation is enabled, the regions are followed by the total outcome of the accesses in the
+ *          simulated cache hierarchy. When reuse distances are enabled, the regions are followed by the total
+ *          histogram of reuse distances. When the page footprint is enabled, the regions are followed by the pages
+ *          touched, counted from a bitmap of the cache lines in the regions.
+ *          The totals are always for all regions, including any regions which aren't output.
+ * @param[in,out] output The trace encoder to output to
+ * @param[in] prefix Output at the start of each line of trace output to identify the top-level function and if read or write
+ * @param[in] unchanged_fingerprints When not NULL, the sorted fingerprints from get_region_fingerprints() of a
+ *                                   reference memory profile. Regions which match are not output.
+ */
+void memory_regions_usage::display (trace_encoder &output, const std::string &prefix,
+                                    const std::vector<uint64_t> *const unchanged_fingerprints) const
+{
+    const uint64_t prefix_fingerprint = trace_fingerprint (prefix.data(), prefix.size());
+    uint64_t previous_end_addr = 0;
+    bool first_region = true;
+    trace_region region;
+    const uint64_t *const mem_access_size_counts = region.access_size_counts;
+    uint64_t total_accesses = 0;
+    trace_cache_statistics total_cache;
+    trace_reuse_distance_histogram total_reuse_distances;
+    trace_page_footprint footprint;
+    page_footprint touched_lines (config.line_size);
+
+    memset (&total_cache, 0, sizeof (total_cache));
+    memset (&footprint, 0, sizeof (footprint));
+    memset (&total_reuse_distances, 0, sizeof (total_reuse_distances));
+
+    for (region_position position = first_position (); !is_end_position (position); next_position (position))
+    {
+        const region_info &info = region_at (position);
+        const access_size_histogram &histogram = size_histograms[info.size_histogram_index];
+
+        get_trace_region (info, region);
+        if ((unchanged_fingerprints == NULL) ||
+            !std::binary_search (unchanged_fingerprints->begin(), unchanged_fingerprints->end(),
+                                 trace_fingerprint (&region, sizeof (region), prefix_fingerprint)))
+        {
+            output.region (prefix, region);
+        }
+        if (first_region)
+        {
+            first_region = false;
+        }
+        else
+        {
+            if ((previous_end_addr + 1) == info.region_start_addr)
+            {
+                output.region_merge_error (prefix);
+            }
+        }
+        previous_end_addr = info.region_end_addr;
+
+        for (uint32_t mem_access_size = 0; mem_access_size <= max_mem_access_size; mem_access_size++)
+        {
+            total_accesses += mem_access_size_counts[mem_access_size];
+        }
+        for (uint32_t level = 0; level < trace_num_cache_levels; level++)
+        {
+            total_cache.misses[level] += histogram.cache.misses[level];
+            total_cache.writebacks[level] += histogram.cache.writebacks[level];
+        }
+        if (config.page_footprint)
+        {
+            touched_lines.add_range (info.region_start_addr, info.region_end_addr);
+            for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+            {
+                footprint.tlb_misses[page_size] += histogram.tlb_misses[page_size];
+            }
+        }
+        total_reuse_distances.cold += region.reuse_distances.cold;
+        for (uint32_t bucket = 0; bucket < trace_num_reuse_distance_buckets; bucket++)
+        {
+            total_reuse_distances.counts[bucket] += region.reuse_distances.counts[bucket];
+        }
+    }
+
+    if (config.cache_simulation && (total_regions > 0))
+    {
+        output.cache_statistics (prefix, total_accesses, total_cache);
+    }
+    if (config.reuse_distance && (total_regions > 0))
+    {
+        output.reuse_distances (prefix, total_reuse_distances);
+    }
+    if (config.page_footprint && (total_regions > 0))
+    {
+        touched_lines.get_statistics (footprint);
+        output.page_footprint (prefix, footprint);
+    }
+}
+
+/**
+ * @brief Output to the trace file the statistics for how effective the cached regions were at avoiding searches
+ * @param[in,out] output The trace encoder to output to
+ * @param[in] prefix Output at the start of the line of trace output to identify if read or write
+ */
+void memory_regions_usage::display_region_cache_statistics (trace_encoder &output, const std::string &prefix)
+{
+    output.region_cache_statistics (prefix, region_cache_hits, region_cache_misses);
+}
@@ -0,0 +1,447 @@
+/*
+ * @file memory_regions.h
+ * @date 16 Oct 2026
+ * @details
+ *  Records the memory profile of a set of memory accesses, as the unique regions of memory which were accessed.
+ *  For each region the total bytes accessed, a histogram of the access sizes and the counts of the cache lines by which
+ *  the region was extended are maintained. The outcomes of the optional cache simulation, reuse distance measurement,
+ *  stride analysis and TLB simulation of the accesses are also maintained for each region.
+ *
+ *  The memory profiles of different threads, or of nested top-level functions, can be merged into one memory profile.
+ *
+ *  A memory operand which is both read and written, such as the destination of add [mem],reg, is recorded once in a
+ *  memory profile of MEMORY_ACCESS_READ_WRITE accesses rather than once each for the read and the write. The memory
+ *  profiles which are output for reads and writes are then made by merging in the read-modify-write memory profile
+ *  with merge_read_modify_write_from(), which halves the recording cost of read-modify-write operands.
+ *
+ *  This is independent of Pin, so that the memory profile can be recorded by programs other than the memory_profile
+ *  Pin tool, such as memory_profile_replay which replays a recorded access trace.
+ */
+
+#ifndef MEMORY_REGIONS_H_
+#define MEMORY_REGIONS_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "trace_format.h"
+#include "cache_simulator.h"
+#include "reuse_distance.h"
+
+/** The different types of memory access which are profiled. The accesses of a memory operand are recorded as one kind,
+ *  where MEMORY_ACCESS_READ_WRITE is an operand which is read and then written by the same instruction. */
+enum memory_access_kind
+{
+    MEMORY_ACCESS_READ,
+    MEMORY_ACCESS_WRITE,
+    MEMORY_ACCESS_PREFETCH,
+    NUM_MEMORY_ACCESS_KINDS,
+    MEMORY_ACCESS_READ_WRITE = NUM_MEMORY_ACCESS_KINDS,
+    NUM_MEMORY_OPERAND_KINDS
+};
+
+/** The names used in the trace file for each memory_access_kind */
+extern const char *const memory_access_kind_names[NUM_MEMORY_OPERAND_KINDS];
+
+/** Selects the optional statistics which are maintained for each region, and output with the memory profile */
+struct memory_regions_config
+{
+    /** Set when the outcome of the accesses in a simulated cache hierarchy is recorded */
+    bool cache_simulation;
+    /** Set when the reuse distances of the accesses are recorded */
+    bool reuse_distance;
+    /** Set when the estimated TLB misses are recorded, and the page footprint output */
+    bool page_footprint;
+    /** The cache line size in bytes for the page footprint */
+    uint32_t line_size;
+};
+
+/** Used to record the memory profile for either read or writes */
+class memory_regions_usage
+{
+public:
+    static void configure (const memory_regions_config &new_config);
+    void clear (void);
+    void display (trace_encoder &output, const std::string &prefix,
+                  const std::vector<uint64_t> *unchanged_fingerprints = NULL) const;
+    void get_region_fingerprints (const std::string &prefix, std::vector<uint64_t> &fingerprints) const;
+    void display_region_cache_statistics (trace_encoder &output, const std::string &prefix);
+    void record_access (uint64_t memory_addr, uint32_t bytes_accessed);
+    void record_access_run (uint64_t first_memory_addr, uint32_t bytes_accessed, uint32_t num_accesses, bool ascending);
+    void merge_from (const memory_regions_usage &other);
+    void merge_read_modify_write_from (const memory_regions_usage &other, memory_access_kind access_kind);
+    void add_region_cache_statistics (const memory_regions_usage &other);
+    uint64_t bytes_within (uint64_t start_addr, uint64_t end_addr) const;
+    uint32_t num_regions (void) const;
+    uint64_t total_bytes_accessed (void) const;
+    uint64_t allocated_bytes (void) const;
+    void record_cache_outcome (uint64_t memory_addr, const cache_access_outcome &outcome);
+    void record_reuse_distances (uint64_t memory_addr, uint32_t bytes_accessed, reuse_distance_analyser &analyser);
+    void record_access_pattern (uint64_t memory_addr, trace_access_pattern access_pattern);
+    void record_tlb_misses (uint64_t memory_addr, const uint64_t misses[]);
+
+    memory_regions_usage();
+private:
+    static const uint32_t max_mem_access_size = trace_max_mem_access_size;
+
+    /** The optional statistics maintained for all memory profiles */
+    static memory_regions_config config;
+
+    /** The number of power-of-two access sizes up to max_mem_access_size, i.e. 1, 2, 4, 8, 16, 32 and 64 bytes */
+    static const uint32_t num_power_of_two_sizes = 7;
+
+    /** The information maintained for each non-consecutive memory region which is used when searching for
+     *  and updating the region for each memory access. Kept small so that many regions fit in a cache line. */
+    struct region_info
+    {
+        /** The start address of the region */
+        uint64_t region_start_addr;
+        /** The end address of the region */
+        uint64_t region_end_addr;
+        /** The total number of bytes which have been accessed in the region */
+        uint64_t total_bytes;
+        /** Count of the number of times the region has been extended to cover a incrementing cache line */
+        uint32_t cache_line_increments;
+        /** Count of the number of times the region has been extended to cover a decrementing cache line */
+        uint32_t cache_line_decrements;
+        /** Index into size_histograms[] for the access size histogram of the region */
+        uint32_t size_histogram_index;
+    };
+
+    /** Count of total instruction memory accesses to a region by the number of bytes in each access.
+     *  Power-of-two sizes, which are used by almost all instructions, are counted in a fixed array.
+     *  Other sizes up to max_mem_access_size are counted in a sparse list of odd_size_counts[] entries. */
+    struct access_size_histogram
+    {
+        /** Counts of accesses indexed by the log2 of the access size */
+        uint64_t power_of_two_counts[num_power_of_two_sizes];
+        /** Count of accesses with sizes outside of the expected range */
+        uint64_t unknown_size_count;
+        /** Index into odd_size_counts[] of the first non power-of-two size, or zero if none */
+        uint32_t first_odd_size_index;
+        /** The outcome of the accesses in the simulated cache hierarchy, when cache simulation is enabled */
+        trace_cache_statistics cache;
+        /** Counts of accesses indexed by the access pattern of the accessing instruction,
+         *  when stride analysis is enabled */
+        uint64_t access_pattern_counts[trace_num_access_patterns];
+        /** The estimated data TLB misses for each page size, when the page footprint is enabled */
+        uint64_t tlb_misses[trace_num_page_sizes];
+    };
+
+    /** Count of accesses for one non power-of-two access size, as an entry in a singly linked list */
+    struct odd_size_count
+    {
+        /** The number of accesses */
+        uint64_t count;
+        /** The size of the accesses in bytes */
+        uint32_t mem_access_size;
+        /** Index into odd_size_counts[] of the next entry in the list, or zero for the end of the list */
+        uint32_t next_index;
+    };
+
+    /** The maximum number of regions in one chunk of the region index */
+    static const uint32_t max_chunk_regions = 32;
+
+    /** A chunk of the region index, holding consecutive regions sorted by increasing start address */
+    struct region_chunk
+    {
+        /** The number of entries of regions[] which are in use, which is only zero while the chunk is unused */
+        uint32_t num_regions;
+        /** The regions in the chunk */
+        region_info regions[max_chunk_regions];
+    };
+
+    /** Identifies a region by the chunk which holds it and the index of the region within the chunk.
+     *  The position after the last region has chunk_index equal to chunk_order.size() and region_index zero. */
+    struct region_position
+    {
+        /** The index in chunk_order[] of the chunk */
+        uint32_t chunk_index;
+        /** The index in region_chunk.regions[] of the region */
+        uint32_t region_index;
+    };
+
+    /** Which memory regions have been accessed, as a two level index of chunks of regions. The chunks are
+     *  contiguous arrays, so searching within a chunk doesn't chase pointers, while inserting or erasing a region
+     *  only moves the regions in one chunk rather than all the following regions. Unused chunks are re-used,
+     *  so that clear() only needs to reset the pool. */
+    std::vector<region_chunk> region_chunks;
+
+    /** The indices in region_chunks[] of the chunks which are in use, sorted by the start address of their regions */
+    std::vector<uint32_t> chunk_order;
+
+    /** The indices in region_chunks[] of the chunks which have been emptied by erasing their regions */
+    std::vector<uint32_t> free_chunks;
+
+    /** The total number of regions in all chunks */
+    uint32_t total_regions;
+
+    /** Pool of access size histograms, indexed by region_info.size_histogram_index.
+     *  The entries of regions which are erased when merged are re-used for new regions,
+     *  so that the pool only grows with the number of regions and clear() only needs to reset the pool. */
+    std::vector<access_size_histogram> size_histograms;
+
+    /** Pool of reuse distance histograms, indexed by region_info.size_histogram_index in the same way as
+     *  size_histograms[]. Only used when reuse distances are enabled. */
+    std::vector<trace_reuse_distance_histogram> reuse_distance_histograms;
+
+    /** The indices in size_histograms[] of the entries which were used by erased regions, and can be re-used */
+    std::vector<uint32_t> free_histogram_indices;
+
+    /** Pool of the counts for non power-of-two access sizes. Entry zero is unused, so zero can mark the end of a list */
+    std::vector<odd_size_count> odd_size_counts;
+
+    /** The maximum number of recently accessed regions which are cached, to allow accesses within or extending
+     *  a recently accessed region to be handled without searching memory_regions.
+     *  Entry zero is the most recently used region, and the remaining entries are a small victim set
+     *  which allows accesses which alternate between a few buffers to also be handled from the cache. */
+    static const uint32_t max_cached_regions = 4;
+
+    /** The positions of the recently accessed regions, in most recently used order.
+     *  Only the first num_cached_regions entries are valid. The positions are adjusted when regions are inserted or
+     *  erased, where an erased region is replaced by the region it was merged into. */
+    region_position cached_regions[max_cached_regions];
+    uint32_t num_cached_regions;
+
+    /** Statistics for how many accesses were handled from the cached regions, and how many required a search */
+    uint64_t region_cache_hits;
+    uint64_t region_cache_misses;
+
+    bool record_cached_access (const uint64_t access_start_addr, const uint64_t access_end_addr, const uint32_t bytes_accessed);
+    void make_most_recently_used (const uint32_t cache_index, const region_position &position);
+    void insert_chunk (const uint32_t chunk_index);
+    void split_chunk (const uint32_t chunk_index);
+    void remove_chunk (const uint32_t chunk_index);
+    void insert_region (region_position &position, const uint64_t start_addr, const uint64_t end_addr);
+    void erase_regions (const region_position &first_position, const uint32_t num_regions);
+    void merge_region (region_info &region, const region_info &next_region);
+    void merge_next_regions (const region_position &position);
+    void update_odd_size_count (access_size_histogram &histogram, const uint32_t bytes_accessed, const uint32_t num_accesses);
+    void merge_region_from (const memory_regions_usage &other, const region_info &other_region, bool repeated_access);
+    bool find_recorded_region (const uint64_t memory_addr, region_position &position) const;
+    void get_trace_region (const region_info &info, trace_region &region) const;
+
+    /* @todo Hard coded as sysconf (_SC_LEVEL1_DCACHE_LINESIZE) is not supported by the PinCRT */
+    static const uint64_t cache_line_size = 64;
+
+    /**
+     * @param[in] position The position of a region
+     * @return The region at the position
+     */
+    inline region_info &region_at (const region_position &position)
+    {
+        return region_chunks[chunk_order[position.chunk_index]].regions[position.region_index];
+    }
+
+    inline const region_info &region_at (const region_position &position) const
+    {
+        return region_chunks[chunk_order[position.chunk_index]].regions[position.region_index];
+    }
+
+    /**
+     * @return The position of the first region, which is the end position if there are no regions
+     */
+    inline static region_position first_position (void)
+    {
+        const region_position position = {0, 0};
+
+        return position;
+    }
+
+    /**
+     * @param[in] position The position to check
+     * @return Returns true if the position is after the last region
+     */
+    inline bool is_end_position (const region_position &position) const
+    {
+        return position.chunk_index == chunk_order.size();
+    }
+
+    /**
+     * @param[in] position, other_position The positions to compare
+     * @return Returns true if the positions are of the same region
+     */
+    inline static bool same_position (const region_position &position, const region_position &other_position)
+    {
+        return (position.chunk_index == other_position.chunk_index) &&
+                (position.region_index == other_position.region_index);
+    }
+
+    /**
+     * @brief Advance to the position of the following region
+     * @param[in,out] position The position of a region, which is advanced to the following region or the end position
+     * @return Returns true if there is a following region
+     */
+    inline bool next_position (region_position &position) const
+    {
+        position.region_index++;
+        if (position.region_index == region_chunks[chunk_order[position.chunk_index]].num_regions)
+        {
+            position.chunk_index++;
+            position.region_index = 0;
+        }
+
+        return !is_end_position (position);
+    }
+
+    /**
+     * @brief Move back to the position of the preceding region
+     * @param[in,out] position The position of a region or the end position, which is moved back to the preceding
+     *                         region. Left unchanged if there is no preceding region.
+     * @return Returns true if there is a preceding region
+     */
+    inline bool previous_position (region_position &position) const
+    {
+        if (position.region_index > 0)
+        {
+            position.region_index--;
+        }
+        else if (position.chunk_index > 0)
+        {
+            position.chunk_index--;
+            position.region_index = region_chunks[chunk_order[position.chunk_index]].num_regions - 1;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Find the first region with a start address greater than an address
+     * @details The chunks are searched by the start address of their first region, and then the regions of the
+     *          chunk which precedes the first chunk starting after the address.
+     * @param[in] addr The address to search for
+     * @return The position of the region, or the end position if no region starts after addr
+     */
+    inline region_position upper_bound_region (const uint64_t addr) const
+    {
+        region_position position = first_position ();
+        uint32_t low = 0;
+        uint32_t high = chunk_order.size();
+
+        while (low < high)
+        {
+            const uint32_t mid = low + ((high - low) / 2);
+
+            if (region_chunks[chunk_order[mid]].regions[0].region_start_addr > addr)
+            {
+                high = mid;
+            }
+            else
+            {
+                low = mid + 1;
+            }
+        }
+        if (low == 0)
+        {
+            return position;
+        }
+
+        const region_chunk &chunk = region_chunks[chunk_order[low - 1]];
+        uint32_t region_low = 1;
+        uint32_t region_high = chunk.num_regions;
+
+        while (region_low < region_high)
+        {
+            const uint32_t mid = region_low + ((region_high - region_low) / 2);
+
+            if (chunk.regions[mid].region_start_addr > addr)
+            {
+                region_high = mid;
+            }
+            else
+            {
+                region_low = mid + 1;
+            }
+        }
+        if (region_low == chunk.num_regions)
+        {
+            position.chunk_index = low;
+        }
+        else
+        {
+            position.chunk_index = low - 1;
+            position.region_index = region_low;
+        }
+
+        return position;
+    }
+
+    /**
+     * @brief Find the first region with a start address greater than or equal to an address
+     * @param[in] addr The address to search for
+     * @return The position of the region, or the end position if no region starts at or after addr
+     */
+    inline region_position lower_bound_region (const uint64_t addr) const
+    {
+        return (addr > 0) ? upper_bound_region (addr - 1) : first_position ();
+    }
+
+    /**
+     * @details
+     *  Called when an instruction memory access extends the upper address of an existing region,
+     *  to check when the region extends to a new cache line at a higher address.
+     * @param[in,out] region The region being extended
+     * @param[in] access_end_addr The end address of the memory access
+     */
+    inline void update_addr_inc_cache_line_counts (region_info &region, const uint64_t access_end_addr)
+    {
+        const uint64_t previous_end_cache_line = region.region_end_addr / cache_line_size;
+        const uint64_t access_end_cache_line = access_end_addr / cache_line_size;
+
+        if (access_end_cache_line > previous_end_cache_line)
+        {
+            region.cache_line_increments++;
+        }
+    }
+
+    /**
+     * @details
+     *  Called when an instruction memory access extends the lower address of an existing region,
+     *  to check when the region extends to a new cache line at a lower address.
+     * @param[in,out] region The region being extended
+     * @param[in] access_start_addr The start address of the memory access
+     */
+    inline void update_addr_dec_cache_line_counts (region_info &region, const uint64_t access_start_addr)
+    {
+        const uint64_t previous_start_cache_line = region.region_start_addr / cache_line_size;
+        const uint64_t access_start_cache_line = access_start_addr / cache_line_size;
+
+        if (access_start_cache_line < previous_start_cache_line)
+        {
+            region.cache_line_decrements++;
+        }
+    }
+
+    /**
+     * @brief Called after each instruction memory access to update the count of memory accesses
+     * @param[in,out] region The region to update the counter for
+     * @param[in] bytes_accessed How many bytes were accessed by the instruction
+     * @param[in] num_accesses The number of accesses of bytes_accessed to count
+     */
+    inline void update_access_counts (region_info &region, const uint32_t bytes_accessed, const uint32_t num_accesses = 1)
+    {
+        access_size_histogram &histogram = size_histograms[region.size_histogram_index];
+
+        region.total_bytes += (uint64_t) bytes_accessed * num_accesses;
+        if ((bytes_accessed == 0) || (bytes_accessed > max_mem_access_size))
+        {
+            histogram.unknown_size_count += num_accesses;
+        }
+        else if ((bytes_accessed & (bytes_accessed - 1)) == 0)
+        {
+            histogram.power_of_two_counts[__builtin_ctz (bytes_accessed)] += num_accesses;
+        }
+        else
+        {
+            update_odd_size_count (histogram, bytes_accessed, num_accesses);
+        }
+    }
+};
+
+#endif /* MEMORY_REGIONS_H_ */
@@ -0,0 +1,209 @@
+/*
+ * @file page_footprint.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the measurement of the page footprint of memory accesses, and the simulation of data TLBs.
+ */
+
+#include <algorithm>
+
+#include "page_footprint.h"
+
+page_footprint::page_footprint (const uint32_t line_size)
+    : line_shift (__builtin_ctz (line_size))
+{
+    const uint32_t lines_per_page = (1U << trace_page_shifts[0]) >> line_shift;
+
+    lines_per_page_words = (lines_per_page + 63) / 64;
+}
+
+/**
+ * @brief Remove all touched lines
+ */
+void page_footprint::clear (void)
+{
+    huge_pages.clear();
+    line_masks.clear();
+}
+
+/**
+ * @brief Find the bitmaps for a 2M page, creating empty bitmaps if the 2M page hasn't been touched
+ * @param[in] huge_page_addr The address of the 2M page shifted right by its page shift
+ * @return The bitmaps for the 2M page
+ */
+page_footprint::huge_page_bitmap &page_footprint::find_huge_page (const uint64_t huge_page_addr)
+{
+    std::vector<huge_page_bitmap>::iterator it = huge_pages.end();
+
+    if (!huge_pages.empty() && (huge_pages.back().huge_page_addr >= huge_page_addr))
+    {
+        /* Not appended in address order, so search for the position */
+        uint32_t low = 0;
+        uint32_t high = huge_pages.size();
+
+        while (low < high)
+        {
+            const uint32_t middle = (low + high) / 2;
+
+            if (huge_pages[middle].huge_page_addr < huge_page_addr)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        it = huge_pages.begin() + low;
+        if (it->huge_page_addr == huge_page_addr)
+        {
+            return *it;
+        }
+    }
+
+    huge_page_bitmap new_huge_page;
+
+    new_huge_page.huge_page_addr = huge_page_addr;
+    std::fill (new_huge_page.page_mask, new_huge_page.page_mask + (pages_per_huge_page / 64), 0);
+    new_huge_page.line_masks_index = line_masks.size();
+    line_masks.resize (line_masks.size() + (pages_per_huge_page * lines_per_page_words), 0);
+
+    return *huge_pages.insert (it, new_huge_page);
+}
+
+/**
+ * @brief Mark the cache lines of an address range as touched
+ * @param[in] start_addr The first address of the range
+ * @param[in] end_addr The last address of the range
+ */
+void page_footprint::add_range (const uint64_t start_addr, const uint64_t end_addr)
+{
+    const uint32_t page_line_shift = trace_page_shifts[0] - line_shift;
+    const uint64_t last_line_addr = end_addr >> line_shift;
+    uint64_t line_addr = start_addr >> line_shift;
+
+    while (line_addr <= last_line_addr)
+    {
+        const uint64_t huge_page_addr = line_addr >> (trace_page_shifts[1] - line_shift);
+        huge_page_bitmap &huge_page = find_huge_page (huge_page_addr);
+        const uint64_t huge_page_last_line_addr = ((huge_page_addr + 1) << (trace_page_shifts[1] - line_shift)) - 1;
+        const uint64_t range_last_line_addr = std::min (last_line_addr, huge_page_last_line_addr);
+
+        for (; line_addr <= range_last_line_addr; line_addr++)
+        {
+            const uint32_t page_index = (uint32_t) (line_addr >> page_line_shift) & (pages_per_huge_page - 1);
+            const uint32_t page_line_index = (uint32_t) line_addr & ((1U << page_line_shift) - 1);
+
+            huge_page.page_mask[page_index / 64] |= (uint64_t) 1 << (page_index % 64);
+            line_masks[huge_page.line_masks_index + (page_index * lines_per_page_words) + (page_line_index / 64)] |=
+                    (uint64_t) 1 << (page_line_index % 64);
+        }
+    }
+}
+
+/**
+ * @brief Mark the lines touched in another footprint as touched
+ * @param[in] other The footprint to merge, which must have the same line size
+ */
+void page_footprint::merge_from (const page_footprint &other)
+{
+    std::vector<huge_page_bitmap>::const_iterator it;
+
+    for (it = other.huge_pages.begin(); it != other.huge_pages.end(); ++it)
+    {
+        huge_page_bitmap &huge_page = find_huge_page (it->huge_page_addr);
+        const uint64_t *const other_masks = &other.line_masks[it->line_masks_index];
+        uint64_t *const masks = &line_masks[huge_page.line_masks_index];
+
+        for (uint32_t word = 0; word < (pages_per_huge_page / 64); word++)
+        {
+            huge_page.page_mask[word] |= it->page_mask[word];
+        }
+        for (uint32_t word = 0; word < (pages_per_huge_page * lines_per_page_words); word++)
+        {
+            masks[word] |= other_masks[word];
+        }
+    }
+}
+
+/**
+ * @brief Count the lines and pages touched
+ * @details The TLB misses are not set, as they depend upon the order of the accesses.
+ * @param[out] footprint The counts of the lines and pages touched
+ */
+void page_footprint::get_statistics (trace_page_footprint &footprint) const
+{
+    std::vector<huge_page_bitmap>::const_iterator it;
+
+    footprint.line_size = 1U << line_shift;
+    footprint.lines = 0;
+    footprint.pages[0] = 0;
+    footprint.pages[1] = huge_pages.size();
+    std::fill (footprint.huge_page_occupancy, footprint.huge_page_occupancy + trace_num_huge_page_occupancy_buckets, 0);
+    for (it = huge_pages.begin(); it != huge_pages.end(); ++it)
+    {
+        uint32_t pages_touched = 0;
+
+        for (uint32_t word = 0; word < (pages_per_huge_page / 64); word++)
+        {
+            pages_touched += __builtin_popcountll (it->page_mask[word]);
+        }
+        footprint.pages[0] += pages_touched;
+        footprint.huge_page_occupancy[31 - __builtin_clz (pages_touched)]++;
+
+        const uint64_t *const masks = &line_masks[it->line_masks_index];
+        for (uint32_t word = 0; word < (pages_per_huge_page * lines_per_page_words); word++)
+        {
+            footprint.lines += __builtin_popcountll (masks[word]);
+        }
+    }
+}
+
+/**
+ * @brief Set the configuration of the TLBs, which are initially empty
+ * @param[in] entries The number of entries of the TLB for each page size
+ * @param[in] ways The associativity of the TLB for each page size
+ * @param[out] error When returning false, describes why the configuration isn't supported
+ * @return Returns true if the TLBs were configured
+ */
+bool tlb_simulator::configure (const uint64_t entries[], const uint32_t ways[], std::string &error)
+{
+    for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+    {
+        if (!tlbs[page_size].configure (entries[page_size] << trace_page_shifts[page_size], ways[page_size],
+                                        trace_page_shifts[page_size], CACHE_REPLACEMENT_LRU, error))
+        {
+            error = std::string (trace_page_size_field_names[page_size]) + " TLB " + error;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Simulate the TLB lookups of a memory access, as if the memory was backed by each page size
+ * @param[in] addr The address accessed
+ * @param[in] bytes_accessed The number of bytes accessed, where zero is treated as one byte
+ * @param[out] misses The number of TLB misses for each page size
+ */
+void tlb_simulator::access (const uint64_t addr, const uint32_t bytes_accessed, uint64_t misses[])
+{
+    const uint64_t end_addr = addr + ((bytes_accessed > 0) ? (bytes_accessed - 1) : 0);
+
+    for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+    {
+        const uint64_t last_page_addr = end_addr >> trace_page_shifts[page_size];
+        uint64_t victim_page_addr;
+
+        misses[page_size] = 0;
+        for (uint64_t page_addr = addr >> trace_page_shifts[page_size]; page_addr <= last_page_addr; page_addr++)
+        {
+            if (!tlbs[page_size].lookup (page_addr, false))
+            {
+                tlbs[page_size].fill (page_addr, false, victim_page_addr);
+                misses[page_size]++;
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * @file page_footprint.h
+ * @date 16 Oct 2026
+ * @details
+ *  Measures the footprint of memory accesses in 4K and 2M pages, to show the TLB pressure of the accesses and if the
+ *  memory would be suitable for backing by huge pages.
+ *
+ *  The footprint is a sparse bitmap of the cache lines touched, paged by 2M page. Each 2M page touched has a bitmap of
+ *  the touched 4K pages, and a bitmap of the touched cache lines of each of its 4K pages. The storage is proportional
+ *  to the number of 2M pages touched, so a multi-GB address space only costs about 0.2% of the footprint.
+ *  The numbers of touched pages and lines are counted with popcount.
+ *
+ *  The TLB misses are estimated by simulating a set-associative data TLB for each page size, using the same set
+ *  model as the cache simulator.
+ *
+ *  This is independent of Pin, so that the measurement can be used by programs other than the memory_profile Pin tool.
+ */
+
+#ifndef PAGE_FOOTPRINT_H_
+#define PAGE_FOOTPRINT_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "trace_format.h"
+#include "cache_simulator.h"
+
+/** A sparse bitmap of the cache lines touched, from which the page footprint is counted */
+class page_footprint
+{
+public:
+    page_footprint (uint32_t line_size);
+    void clear (void);
+    void add_range (uint64_t start_addr, uint64_t end_addr);
+    void merge_from (const page_footprint &other);
+    void get_statistics (trace_page_footprint &footprint) const;
+private:
+    /** The number of 4K pages in a 2M page */
+    static const uint32_t pages_per_huge_page = 512;
+
+    /** The bitmaps for one 2M page which has been touched */
+    struct huge_page_bitmap
+    {
+        /** The address of the 2M page shifted right by its page shift */
+        uint64_t huge_page_addr;
+        /** Bitmap of the 4K pages touched */
+        uint64_t page_mask[pages_per_huge_page / 64];
+        /** Index into line_masks[] of the bitmaps of the cache lines touched in each 4K page */
+        uint32_t line_masks_index;
+    };
+
+    huge_page_bitmap &find_huge_page (uint64_t huge_page_addr);
+
+    uint32_t line_shift;
+
+    /** The 2M pages touched, sorted by address. Ranges are normally added in address order, so a new 2M page is
+     *  normally appended. */
+    std::vector<huge_page_bitmap> huge_pages;
+
+    /** The bitmaps of the cache lines touched in each 4K page, with pages_per_huge_page * lines_per_page_words words
+     *  for each 2M page */
+    std::vector<uint64_t> line_masks;
+
+    /** The number of 64-bit words in the bitmap of the cache lines of one 4K page */
+    uint32_t lines_per_page_words;
+};
+
+/** Simulates a data TLB for each page size, to estimate the TLB misses of a sequence of memory accesses */
+class tlb_simulator
+{
+public:
+    bool configure (const uint64_t entries[], const uint32_t ways[], std::string &error);
+    void access (uint64_t addr, uint32_t bytes_accessed, uint64_t misses[]);
+private:
+    /** The TLB for each page size, as a cache with a line for each page */
+    cache_level tlbs[trace_num_page_sizes];
+};
+
+#endif /* PAGE_FOOTPRINT_H_ */
@@ -0,0 +1,203 @@
+/*
+ * @file reuse_distance.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the measurement of cache line reuse distances.
+ */
+
+#include <algorithm>
+
+#include "reuse_distance.h"
+
+/** Marks an unused entry in the hash table, which can't match a line address */
+static const uint64_t empty_line_addr = ~(uint64_t) 0;
+
+/** The initial sizes of the hash table and Fenwick tree */
+static const uint32_t initial_line_timestamps_size = 1024;
+static const uint32_t initial_timestamp_marks_size = 1024;
+
+reuse_distance_analyser::reuse_distance_analyser (const uint32_t line_size)
+    : line_shift (__builtin_ctz (line_size)), num_lines (0), next_timestamp (0)
+{
+    line_timestamp empty_entry;
+
+    empty_entry.line_addr = empty_line_addr;
+    empty_entry.timestamp = 0;
+    line_timestamps.assign (initial_line_timestamps_size, empty_entry);
+    timestamp_marks.assign (initial_timestamp_marks_size + 1, 0);
+}
+
+/**
+ * @brief Find the entry in the hash table for a line
+ * @param[in] line_addr The line to find
+ * @return The entry for the line, or the empty entry where the line should be inserted
+ */
+reuse_distance_analyser::line_timestamp &reuse_distance_analyser::find_line (const uint64_t line_addr)
+{
+    const uint64_t index_mask = line_timestamps.size() - 1;
+    uint64_t index = ((line_addr * 0x9e3779b97f4a7c15ULL) >> 32) & index_mask;
+
+    while ((line_timestamps[index].line_addr != line_addr) && (line_timestamps[index].line_addr != empty_line_addr))
+    {
+        index = (index + 1) & index_mask;
+    }
+
+    return line_timestamps[index];
+}
+
+/**
+ * @brief Double the size of the hash table, re-inserting the existing lines
+ */
+void reuse_distance_analyser::grow_line_timestamps (void)
+{
+    std::vector<line_timestamp> old_line_timestamps;
+    std::vector<line_timestamp>::const_iterator it;
+    line_timestamp empty_entry;
+
+    empty_entry.line_addr = empty_line_addr;
+    empty_entry.timestamp = 0;
+    old_line_timestamps.swap (line_timestamps);
+    line_timestamps.assign (old_line_timestamps.size() * 2, empty_entry);
+    for (it = old_line_timestamps.begin(); it != old_line_timestamps.end(); ++it)
+    {
+        if (it->line_addr != empty_line_addr)
+        {
+            find_line (it->line_addr) = *it;
+        }
+    }
+}
+
+/**
+ * @brief Renumber the timestamps of the lines in order from zero, and resize the Fenwick tree to leave as many free
+ *        timestamps as there are lines
+ * @details The order of the timestamps is preserved, which is all that the reuse distances depend on.
+ */
+void reuse_distance_analyser::compact_timestamps (void)
+{
+    std::vector<std::pair<uint32_t,uint32_t> > timestamp_entries;
+
+    for (uint32_t index = 0; index < line_timestamps.size(); index++)
+    {
+        if (line_timestamps[index].line_addr != empty_line_addr)
+        {
+            timestamp_entries.push_back (std::pair<uint32_t,uint32_t> (line_timestamps[index].timestamp, index));
+        }
+    }
+    std::sort (timestamp_entries.begin(), timestamp_entries.end());
+    for (uint32_t timestamp = 0; timestamp < timestamp_entries.size(); timestamp++)
+    {
+        line_timestamps[timestamp_entries[timestamp].second].timestamp = timestamp;
+    }
+    next_timestamp = num_lines;
+
+    /* Build the Fenwick tree with a mark at each of the first num_lines timestamps, in linear time */
+    timestamp_marks.assign (std::max (initial_timestamp_marks_size, num_lines * 2) + 1, 0);
+    for (uint32_t tree_index = 1; tree_index < timestamp_marks.size(); tree_index++)
+    {
+        const uint32_t parent_index = tree_index + (tree_index & (~tree_index + 1));
+
+        timestamp_marks[tree_index] += (tree_index <= num_lines) ? 1 : 0;
+        if (parent_index < timestamp_marks.size())
+        {
+            timestamp_marks[parent_index] += timestamp_marks[tree_index];
+        }
+    }
+}
+
+/**
+ * @brief Add to the mark at a timestamp in the Fenwick tree
+ * @param[in] timestamp The timestamp to update
+ * @param[in] delta +1 to mark the timestamp, or -1 to remove the mark
+ */
+void reuse_distance_analyser::add_mark (const uint32_t timestamp, const int32_t delta)
+{
+    for (uint32_t tree_index = timestamp + 1; tree_index < timestamp_marks.size();
+         tree_index += tree_index & (~tree_index + 1))
+    {
+        timestamp_marks[tree_index] += delta;
+    }
+}
+
+/**
+ * @brief Count the marks in the Fenwick tree at timestamps up to and including a timestamp
+ * @param[in] timestamp The last timestamp to count
+ * @return The number of marks
+ */
+uint32_t reuse_distance_analyser::marks_up_to (const uint32_t timestamp) const
+{
+    uint32_t num_marks = 0;
+
+    for (uint32_t tree_index = timestamp + 1; tree_index > 0; tree_index &= tree_index - 1)
+    {
+        num_marks += timestamp_marks[tree_index];
+    }
+
+    return num_marks;
+}
+
+/**
+ * @brief Record an access to one cache line
+ * @param[in] line_addr The line accessed
+ * @return The reuse distance of the access, or -1 if this is the first access to the line
+ */
+int32_t reuse_distance_analyser::access_line (const uint64_t line_addr)
+{
+    int32_t reuse_distance = -1;
+
+    if (next_timestamp == (timestamp_marks.size() - 1))
+    {
+        compact_timestamps ();
+    }
+
+    line_timestamp *entry = &find_line (line_addr);
+    if (entry->line_addr == line_addr)
+    {
+        /* All marks are at or before the previous timestamp, so the marks after the previous access to the line
+         * are the marks not up to its timestamp. */
+        reuse_distance = (int32_t) (num_lines - marks_up_to (entry->timestamp));
+        add_mark (entry->timestamp, -1);
+    }
+    else
+    {
+        if (((num_lines + 1) * 2) > line_timestamps.size())
+        {
+            grow_line_timestamps ();
+            entry = &find_line (line_addr);
+        }
+        entry->line_addr = line_addr;
+        num_lines++;
+    }
+
+    entry->timestamp = next_timestamp;
+    add_mark (next_timestamp, 1);
+    next_timestamp++;
+
+    return reuse_distance;
+}
+
+/**
+ * @brief Record a memory access, adding the reuse distance of each cache line accessed to a histogram
+ * @param[in] addr The address accessed
+ * @param[in] bytes_accessed The number of bytes accessed, where zero is treated as one byte
+ * @param[in,out] histogram The histogram to add the reuse distances to
+ */
+void reuse_distance_analyser::access (const uint64_t addr, const uint32_t bytes_accessed,
+                                      trace_reuse_distance_histogram &histogram)
+{
+    const uint64_t first_line_addr = addr >> line_shift;
+    const uint64_t last_line_addr = (addr + ((bytes_accessed > 0) ? (bytes_accessed - 1) : 0)) >> line_shift;
+
+    for (uint64_t line_addr = first_line_addr; line_addr <= last_line_addr; line_addr++)
+    {
+        const int32_t reuse_distance = access_line (line_addr);
+
+        if (reuse_distance < 0)
+        {
+            histogram.cold++;
+        }
+        else
+        {
+            histogram.counts[trace_reuse_distance_bucket ((uint32_t) reuse_distance)]++;
+        }
+    }
+}
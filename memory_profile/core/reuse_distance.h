@@ -0,0 +1,63 @@
+/*
+ * @file reuse_distance.h
+ * @date 16 Oct 2026
+ * @details
+ *  Measures the reuse distance of cache line accesses, which is the number of distinct cache lines accessed since
+ *  the previous access to the same cache line. A fully associative LRU cache of C lines hits on exactly the accesses
+ *  with a reuse distance less than C, so a histogram of reuse distances predicts the hit rate of any cache size.
+ *
+ *  Each cache line which has been accessed is marked in a Fenwick tree at the timestamp of its most recent access,
+ *  and a hash table maps each line to that timestamp. The reuse distance is then the number of marks after the
+ *  previous access to the line, which is found in O(log n) time for n distinct lines.
+ *
+ *  This is independent of Pin, so that the analysis can be used by programs other than the memory_profile Pin tool.
+ */
+
+#ifndef REUSE_DISTANCE_H_
+#define REUSE_DISTANCE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "trace_format.h"
+
+/** Measures the reuse distances of the cache lines accessed by one thread */
+class reuse_distance_analyser
+{
+public:
+    reuse_distance_analyser (uint32_t line_size);
+    void access (uint64_t addr, uint32_t bytes_accessed, trace_reuse_distance_histogram &histogram);
+private:
+    /** One entry of the hash table of line_timestamps[] */
+    struct line_timestamp
+    {
+        /** The cache line address, or empty_line_addr for an unused entry */
+        uint64_t line_addr;
+        /** The timestamp of the most recent access to the line */
+        uint32_t timestamp;
+    };
+
+    int32_t access_line (uint64_t line_addr);
+    line_timestamp &find_line (uint64_t line_addr);
+    void grow_line_timestamps (void);
+    void compact_timestamps (void);
+    void add_mark (uint32_t timestamp, int32_t delta);
+    uint32_t marks_up_to (uint32_t timestamp) const;
+
+    uint32_t line_shift;
+
+    /** Open addressing hash table, with linear probing, of the timestamp of each line which has been accessed.
+     *  The size is a power of two and is doubled when half full. */
+    std::vector<line_timestamp> line_timestamps;
+    uint32_t num_lines;
+
+    /** Fenwick tree of the marks at the timestamp of the most recent access to each line, indexed from one */
+    std::vector<uint32_t> timestamp_marks;
+
+    /** The timestamp for the next access. When this reaches the size of the Fenwick tree, the timestamps of the lines
+     *  are renumbered in order so that the tree only needs to be as large as a small multiple of the number of lines. */
+    uint32_t next_timestamp;
+};
+
+#endif /* REUSE_DISTANCE_H_ */
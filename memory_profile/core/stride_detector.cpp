@@ -0,0 +1,131 @@
+/*
+ * @file stride_detector.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the learning of the stride of one memory operand of a static instruction.
+ */
+
+#include "stride_detector.h"
+
+stride_detector::stride_detector (void)
+    : last_thread_id (no_thread_id), last_addr (0), last_stride (0), stride (0), confidence (0),
+      samples (0), stride_matches (0), stride_changes (0), power_of_two_samples (0)
+{
+}
+
+/**
+ * @brief Determine if a stride is a power of two of at least a cache line, in either direction
+ * @param[in] stride_bytes The stride to check
+ * @param[in] line_size The cache line size in bytes
+ * @return Returns true if the stride is a power of two of at least a cache line
+ */
+bool stride_detector::is_power_of_two_stride (const int64_t stride_bytes, const uint32_t line_size) const
+{
+    const uint64_t magnitude = (stride_bytes < 0) ? (uint64_t) -stride_bytes : (uint64_t) stride_bytes;
+
+    return (magnitude >= line_size) && ((magnitude & (magnitude - 1)) == 0);
+}
+
+/**
+ * @brief Learn from the address of one access by the instruction
+ * @details The candidate stride is only replaced once the confidence in it has decayed to zero, so that an occasional
+ *          different stride, such as at the end of a row, doesn't lose the dominant stride.
+ * @param[in] thread_id The thread which made the access
+ * @param[in] addr The address accessed
+ * @param[in] line_size The cache line size in bytes, used to classify the access pattern
+ * @param[out] access_pattern When returns true, the access pattern of the instruction learnt so far
+ * @return Returns true if a stride was learnt from the access and enough strides have been observed to classify
+ *         the access pattern
+ */
+bool stride_detector::access (const uint32_t thread_id, const uint64_t addr, const uint32_t line_size,
+                              trace_access_pattern &access_pattern)
+{
+    if (thread_id != last_thread_id)
+    {
+        last_thread_id = thread_id;
+        last_addr = addr;
+        return false;
+    }
+
+    const int64_t delta = (int64_t) (addr - last_addr);
+
+    last_addr = addr;
+    samples++;
+    if ((samples > 1) && (delta != last_stride))
+    {
+        stride_changes++;
+    }
+    last_stride = delta;
+    if (is_power_of_two_stride (delta, line_size))
+    {
+        power_of_two_samples++;
+    }
+
+    if ((samples > 1) && (delta == stride))
+    {
+        stride_matches++;
+        if (confidence < max_confidence)
+        {
+            confidence++;
+        }
+    }
+    else if (confidence > 0)
+    {
+        confidence--;
+    }
+    else
+    {
+        stride = delta;
+        stride_matches = 1;
+    }
+
+    if (samples < min_classified_samples)
+    {
+        return false;
+    }
+    access_pattern = pattern (line_size);
+    return true;
+}
+
+/**
+ * @brief Classify the access pattern from the strides learnt so far
+ * @details The stride is regular when at least three quarters of the strides matched the dominant stride, or when at
+ *          most a quarter of the strides changed from the previous stride. The latter covers an instruction which
+ *          walks runs with different strides, such as alternate passes in opposite directions.
+ * @param[in] line_size The cache line size in bytes
+ * @return The access pattern
+ */
+trace_access_pattern stride_detector::pattern (const uint32_t line_size) const
+{
+    const bool regular = ((stride_matches * 4) >= (samples * 3)) || ((stride_changes * 4) <= samples);
+
+    if (regular)
+    {
+        const uint64_t magnitude = (stride < 0) ? (uint64_t) -stride : (uint64_t) stride;
+
+        if (magnitude < line_size)
+        {
+            return TRACE_ACCESS_PATTERN_SEQUENTIAL;
+        }
+        return is_power_of_two_stride (stride, line_size) ?
+                TRACE_ACCESS_PATTERN_POWER_OF_TWO_STRIDE : TRACE_ACCESS_PATTERN_FIXED_STRIDE;
+    }
+
+    return ((power_of_two_samples * 4) >= (samples * 3)) ?
+            TRACE_ACCESS_PATTERN_POWER_OF_TWO_STRIDE : TRACE_ACCESS_PATTERN_RANDOM;
+}
+
+/**
+ * @brief Get the strides learnt for the instruction
+ * @details Only the statistics fields are set, leaving the caller to set the instruction fields.
+ * @param[in] line_size The cache line size in bytes
+ * @param[out] statistics The strides learnt
+ */
+void stride_detector::get_statistics (const uint32_t line_size, trace_instruction_stride &statistics) const
+{
+    statistics.samples = samples;
+    statistics.stride = stride;
+    statistics.stride_matches = stride_matches;
+    statistics.stride_changes = stride_changes;
+    statistics.access_pattern = pattern (line_size);
+}
@@ -0,0 +1,64 @@
+/*
+ * @file stride_detector.h
+ * @date 16 Oct 2026
+ * @details
+ *  Learns the stride of the addresses accessed by one memory operand of a static instruction, in the same way as the
+ *  reference prediction table of a hardware stride prefetcher. A candidate stride is replaced only after the
+ *  confidence in it has decayed, so the candidate converges on the dominant stride. The fraction of accesses which
+ *  match the dominant stride, and the fraction where the stride changed from the previous access, then classify the
+ *  access pattern of the instruction.
+ *
+ *  This is independent of Pin, so that the detection can be used by programs other than the memory_profile Pin tool.
+ */
+
+#ifndef STRIDE_DETECTOR_H_
+#define STRIDE_DETECTOR_H_
+
+#include <stdint.h>
+
+#include "trace_format.h"
+
+/** Learns the stride of one memory operand of a static instruction */
+class stride_detector
+{
+public:
+    stride_detector (void);
+    bool access (uint32_t thread_id, uint64_t addr, uint32_t line_size, trace_access_pattern &pattern);
+    trace_access_pattern pattern (uint32_t line_size) const;
+    void get_statistics (uint32_t line_size, trace_instruction_stride &statistics) const;
+private:
+    bool is_power_of_two_stride (int64_t stride_bytes, uint32_t line_size) const;
+
+    /** Marks that no access has been observed, so there is no previous address to learn a stride from */
+    static const uint32_t no_thread_id = 0xffffffff;
+
+    /** The number of strides which have to be observed before the access pattern is classified */
+    static const uint64_t min_classified_samples = 2;
+
+    /** The maximum confidence in the candidate stride */
+    static const uint32_t max_confidence = 3;
+
+    /** The thread which made the previous access. A stride is only learnt between accesses by the same thread,
+     *  so that threads executing the same instruction on different data don't appear as an irregular stride. */
+    uint32_t last_thread_id;
+    /** The address of the previous access, valid when last_thread_id isn't no_thread_id */
+    uint64_t last_addr;
+    /** The stride between the previous two accesses */
+    int64_t last_stride;
+
+    /** The candidate dominant stride */
+    int64_t stride;
+    /** The saturating confidence in the candidate stride, which decays on each mismatch */
+    uint32_t confidence;
+
+    /** The number of strides observed */
+    uint64_t samples;
+    /** The number of strides which matched the candidate stride, since it became the candidate */
+    uint64_t stride_matches;
+    /** The number of strides which differed from the previous stride */
+    uint64_t stride_changes;
+    /** The number of strides which are a power of two of at least a cache line */
+    uint64_t power_of_two_samples;
+};
+
+#endif /* STRIDE_DETECTOR_H_ */
@@ -0,0 +1,1915 @@
+/*
+ * @file trace_format.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the .csv and binary encoders for the memory profile trace, and the decoder for the binary format.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "trace_format.h"
+
+/** Used as the previous region prefix index before any region has been written */
+static const uint32_t no_region_prefix_index = 0xffffffff;
+
+const char *const trace_access_kind_field_names[trace_num_access_kinds] =
+{
+    "read",
+    "write",
+    "prefetch"
+};
+
+const char *const trace_cache_level_field_names[trace_num_cache_levels] =
+{
+    "l1d",
+    "l2",
+    "llc"
+};
+
+const char *const trace_access_pattern_names[trace_num_access_patterns] =
+{
+    "sequential",
+    "fixed_stride",
+    "power_of_two_stride",
+    "random"
+};
+
+const char *const trace_page_size_field_names[trace_num_page_sizes] =
+{
+    "4k",
+    "2m"
+};
+
+const char *const trace_static_segment_field_names[trace_num_static_segments] =
+{
+    "stack",
+    "global"
+};
+
+const char *const trace_vector_width_field_names[trace_num_vector_widths] =
+{
+    "scalar",
+    "vector128",
+    "vector256",
+    "vector512"
+};
+
+/**
+ * @brief Encode which fields of cache statistics are non-zero, with bit n for misses[n] and
+ *        bit (trace_num_cache_levels + n) for writebacks[n]
+ */
+static uint32_t cache_statistics_field_mask (const trace_cache_statistics &statistics)
+{
+    uint32_t field_mask = 0;
+
+    for (uint32_t level = 0; level < trace_num_cache_levels; level++)
+    {
+        field_mask |= (statistics.misses[level] > 0) ? (1U << level) : 0;
+        field_mask |= (statistics.writebacks[level] > 0) ? (1U << (trace_num_cache_levels + level)) : 0;
+    }
+
+    return field_mask;
+}
+
+void ostream_trace_sink::write (const char *data, size_t length)
+{
+    stream.write (data, length);
+}
+
+void ostream_trace_sink::flush (void)
+{
+    stream.flush ();
+}
+
+csv_trace_encoder::csv_trace_encoder (trace_sink &sink)
+    : sink (sink)
+{
+    line << std::hex;
+    line.setf (std::ios::showbase);
+
+    /* Used for the reuse ratio of allocations, which is the only non-integer field */
+    line.setf (std::ios::fixed, std::ios::floatfield);
+    line.precision (2);
+}
+
+/**
+ * @brief Format the non-zero counts of a reuse distance histogram as fields, with each bucket identified by the
+ *        smallest reuse distance it counts
+ */
+void csv_trace_encoder::put_reuse_distance_fields (const trace_reuse_distance_histogram &histogram)
+{
+    if (histogram.cold > 0)
+    {
+        line << ",reuse_cold=" << histogram.cold;
+    }
+    for (uint32_t bucket = 0; bucket < trace_num_reuse_distance_buckets; bucket++)
+    {
+        if (histogram.counts[bucket] > 0)
+        {
+            line << ",reuse_distance_" << std::dec << trace_reuse_distance_bucket_start (bucket) << std::hex << "="
+                 << histogram.counts[bucket];
+        }
+    }
+}
+
+/**
+ * @brief Format the caller of an allocator function as fields, with the call stack only when it was captured
+ */
+void csv_trace_encoder::put_caller_fields (const std::string &caller, const uint32_t stack_id)
+{
+    line << ",caller=" << caller;
+    if (stack_id != 0)
+    {
+        line << ",stack=" << stack_id;
+    }
+}
+
+/**
+ * @brief Write the formatted line to the sink, and empty the line ready for the next record
+ */
+void csv_trace_encoder::write_line (void)
+{
+    line << '\n';
+    const std::string text = line.str();
+    sink.write (text.data(), text.size());
+    line.str ("");
+}
+
+void csv_trace_encoder::function_enter (const std::string &func_name)
+{
+    line << func_name << ",enter";
+    write_line ();
+}
+
+void csv_trace_encoder::function_exit (const std::string &func_name)
+{
+    line << func_name << ",exit";
+    write_line ();
+}
+
+void csv_trace_encoder::region (const std::string &prefix, const trace_region &region)
+{
+    line << prefix << ",start_addr=" << region.start_addr << ",end_addr=" << region.end_addr
+         << ",size=" << (region.end_addr - region.start_addr + 1)
+         << ",total_bytes_accessed=" << region.total_bytes;
+    if (region.cache_line_increments > 0)
+    {
+        line << ",cache_line_increments=" << region.cache_line_increments;
+    }
+    if (region.cache_line_decrements > 0)
+    {
+        line << ",cache_line_decrements=" << region.cache_line_decrements;
+    }
+    if (region.access_size_counts[0] > 0)
+    {
+        line << ",unknown size accesses=" << region.access_size_counts[0];
+    }
+    for (uint32_t mem_access_size = 1; mem_access_size <= trace_max_mem_access_size; mem_access_size++)
+    {
+        if (region.access_size_counts[mem_access_size] > 0)
+        {
+            line << "," << std::dec << mem_access_size << std::hex << " byte accesses="
+                 << region.access_size_counts[mem_access_size];
+        }
+    }
+    for (uint32_t level = 0; level < trace_num_cache_levels; level++)
+    {
+        if (region.cache.misses[level] > 0)
+        {
+            line << "," << trace_cache_level_field_names[level] << "_misses=" << region.cache.misses[level];
+        }
+        if (region.cache.writebacks[level] > 0)
+        {
+            line << "," << trace_cache_level_field_names[level] << "_writebacks=" << region.cache.writebacks[level];
+        }
+    }
+    put_reuse_distance_fields (region.reuse_distances);
+
+    /* The access pattern of the region is the class with the most accesses */
+    uint32_t dominant_pattern = trace_num_access_patterns;
+    for (uint32_t pattern = 0; pattern < trace_num_access_patterns; pattern++)
+    {
+        if (region.access_pattern_counts[pattern] > 0)
+        {
+            line << "," << trace_access_pattern_names[pattern] << "_accesses=" << region.access_pattern_counts[pattern];
+            if ((dominant_pattern == trace_num_access_patterns) ||
+                (region.access_pattern_counts[pattern] > region.access_pattern_counts[dominant_pattern]))
+            {
+                dominant_pattern = pattern;
+            }
+        }
+    }
+    if (dominant_pattern < trace_num_access_patterns)
+    {
+        line << ",access_pattern=" << trace_access_pattern_names[dominant_pattern];
+    }
+    for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+    {
+        if (region.tlb_misses[page_size] > 0)
+        {
+            line << ",tlb_" << trace_page_size_field_names[page_size] << "_misses=" << region.tlb_misses[page_size];
+        }
+    }
+    write_line ();
+}
+
+void csv_trace_encoder::region_merge_error (const std::string &prefix)
+{
+    line << prefix << ",**ERROR** merge of adjacent regions failed";
+    write_line ();
+}
+
+void csv_trace_encoder::allocation_event (const std::string &func_name, const std::string &allocator, uint64_t size,
+                                          uint64_t data_ptr, const std::string &caller, uint32_t stack_id)
+{
+    line << func_name << "," << allocator << ",size=" << size << ",data_ptr=" << data_ptr;
+    put_caller_fields (caller, stack_id);
+    write_line ();
+}
+
+void csv_trace_encoder::aligned_allocation_event (const std::string &func_name, const std::string &allocator,
+                                                  uint64_t boundary, uint64_t size, uint64_t data_ptr,
+                                                  const std::string &caller, uint32_t stack_id)
+{
+    line << func_name << "," << allocator << ",boundary=" << boundary << ",size=" << size
+         << ",data_ptr=" << data_ptr;
+    put_caller_fields (caller, stack_id);
+    write_line ();
+}
+
+void csv_trace_encoder::reallocation_event (const std::string &func_name, const std::string &allocator,
+                                            uint64_t old_data_ptr, bool old_size_known, uint64_t old_size,
+                                            uint64_t size, uint64_t data_ptr, const std::string &caller,
+                                            uint32_t stack_id)
+{
+    line << func_name << "," << allocator << ",old_data_ptr=" << old_data_ptr << ",old_size=";
+    if (old_size_known)
+    {
+        line << old_size;
+    }
+    else
+    {
+        line << "???";
+    }
+    line << ",size=" << size << ",data_ptr=" << data_ptr;
+    put_caller_fields (caller, stack_id);
+    write_line ();
+}
+
+void csv_trace_encoder::free_event (const std::string &func_name, const std::string &deallocator, uint64_t data_ptr,
+                                    bool size_known, uint64_t size, const std::string &caller, uint32_t stack_id)
+{
+    line << func_name << "," << deallocator << ",data_ptr=" << data_ptr << ",size=";
+    if (size_known)
+    {
+        line << size;
+    }
+    else
+    {
+        line << "???";
+    }
+    put_caller_fields (caller, stack_id);
+    write_line ();
+}
+
+void csv_trace_encoder::outstanding_allocations (const std::vector<trace_outstanding_allocation> &allocations)
+{
+    std::vector<trace_outstanding_allocation>::const_iterator it;
+
+    line << "N/A,outstanding_allocations";
+    for (it = allocations.begin(); it != allocations.end(); ++it)
+    {
+        line << "," << it->first << "(" << it->second << ")";
+    }
+    write_line ();
+}
+
+void csv_trace_encoder::region_cache_statistics (const std::string &prefix, uint64_t hits, uint64_t misses)
+{
+    line << prefix << ",region_cache_hits=" << hits << ",region_cache_misses=" << misses;
+    write_line ();
+}
+
+/**
+ * @details The fields are only output for the kinds of memory access which were made to the allocation.
+ *          The reuse is the average number of times each byte in the footprint was accessed.
+ */
+void csv_trace_encoder::allocation_accesses (const std::string &func_name, const trace_allocation_accesses &allocation)
+{
+    line << func_name << ",allocation,data_ptr=" << allocation.data_ptr << ",size=" << allocation.size
+         << ",allocated_in=" << allocation.allocated_in;
+    put_caller_fields (allocation.caller, allocation.stack_id);
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        if (allocation.accesses[kind] > 0)
+        {
+            const char *const kind_name = trace_access_kind_field_names[kind];
+            const double reuse = (allocation.footprint[kind] > 0) ?
+                    ((double) allocation.bytes[kind] / (double) allocation.footprint[kind]) : 0.0;
+
+            line << "," << kind_name << "_accesses=" << allocation.accesses[kind]
+                 << "," << kind_name << "_bytes=" << allocation.bytes[kind]
+                 << "," << kind_name << "_footprint=" << allocation.footprint[kind]
+                 << "," << kind_name << "_reuse=" << reuse;
+        }
+    }
+    write_line ();
+}
+
+/**
+ * @details The hits in each level are the accesses which reached the level, less the misses in the level.
+ */
+void csv_trace_encoder::cache_statistics (const std::string &prefix, uint64_t accesses,
+                                          const trace_cache_statistics &statistics)
+{
+    line << prefix << ",cache_accesses=" << accesses;
+    for (uint32_t level = 0; level < trace_num_cache_levels; level++)
+    {
+        line << "," << trace_cache_level_field_names[level] << "_misses=" << statistics.misses[level]
+             << "," << trace_cache_level_field_names[level] << "_writebacks=" << statistics.writebacks[level];
+    }
+    write_line ();
+}
+
+/**
+ * @details The cache line accesses are the total of the histogram, including the first accesses to each cache line.
+ */
+void csv_trace_encoder::reuse_distances (const std::string &prefix, const trace_reuse_distance_histogram &histogram)
+{
+    uint64_t cache_line_accesses = histogram.cold;
+
+    for (uint32_t bucket = 0; bucket < trace_num_reuse_distance_buckets; bucket++)
+    {
+        cache_line_accesses += histogram.counts[bucket];
+    }
+    line << prefix << ",cache_line_accesses=" << cache_line_accesses;
+    put_reuse_distance_fields (histogram);
+    write_line ();
+}
+
+/**
+ * @details The stride is output as signed decimal. The stride confidence is the fraction of strides which matched
+ *          the dominant stride, and the irregularity is the fraction of strides which differed from the previous stride.
+ */
+void csv_trace_encoder::instruction_stride (const std::string &prefix, const trace_instruction_stride &stride)
+{
+    const double confidence = (stride.samples > 0) ? ((double) stride.stride_matches / (double) stride.samples) : 0.0;
+    const double irregularity = (stride.samples > 0) ? ((double) stride.stride_changes / (double) stride.samples) : 0.0;
+
+    line << prefix << ",instruction,ip=" << stride.ip << ",routine=" << stride.routine
+         << ",kind=" << trace_access_kind_field_names[stride.access_kind] << ",samples=" << stride.samples
+         << ",stride=" << std::dec << stride.stride << std::hex << ",stride_confidence=" << confidence
+         << ",irregularity=" << irregularity << ",access_pattern=" << trace_access_pattern_names[stride.access_pattern];
+    write_line ();
+}
+
+/**
+ * @details The scale is the factor to multiply the profiled totals by to estimate the totals for all invocations.
+ */
+void csv_trace_encoder::sampling_statistics (const std::string &func_name, uint64_t invocations,
+                                             uint64_t sampled_invocations)
+{
+    const double scale = (sampled_invocations > 0) ? ((double) invocations / (double) sampled_invocations) : 0.0;
+
+    line << func_name << ",sampling,invocations=" << invocations << ",sampled_invocations=" << sampled_invocations
+         << ",scale=" << scale;
+    write_line ();
+}
+
+/**
+ * @details The scale is the factor to multiply the profiled totals by to estimate the totals for all instructions.
+ */
+void csv_trace_encoder::burst_sampling_statistics (uint64_t instructions, uint64_t sampled_instructions)
+{
+    const double scale = (sampled_instructions > 0) ? ((double) instructions / (double) sampled_instructions) : 0.0;
+
+    line << "N/A,burst_sampling,instructions=" << instructions << ",sampled_instructions=" << sampled_instructions
+         << ",scale=" << scale;
+    write_line ();
+}
+
+/**
+ * @details The line density is the fraction of the cache lines in the touched 4K pages which were touched, and the
+ *          page density is the fraction of the 4K pages in the touched 2M pages which were touched. Only the non-zero
+ *          buckets of the 2M page occupancy histogram are output, named by the smallest number of 4K pages counted.
+ */
+void csv_trace_encoder::page_footprint (const std::string &prefix, const trace_page_footprint &footprint)
+{
+    const uint64_t lines_per_page = (footprint.line_size > 0) ? ((1U << trace_page_shifts[0]) / footprint.line_size) : 0;
+    const uint64_t pages_per_huge_page = (uint64_t) 1 << (trace_page_shifts[1] - trace_page_shifts[0]);
+    const double line_density = ((footprint.pages[0] > 0) && (lines_per_page > 0)) ?
+            ((double) footprint.lines / (double) (footprint.pages[0] * lines_per_page)) : 0.0;
+    const double page_density = (footprint.pages[1] > 0) ?
+            ((double) footprint.pages[0] / (double) (footprint.pages[1] * pages_per_huge_page)) : 0.0;
+
+    line << prefix << ",page_footprint,lines=" << footprint.lines;
+    for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+    {
+        line << ",pages_" << trace_page_size_field_names[page_size] << "=" << footprint.pages[page_size];
+    }
+    line << ",line_density=" << line_density << ",page_density=" << page_density;
+    for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+    {
+        line << ",tlb_" << trace_page_size_field_names[page_size] << "_misses=" << footprint.tlb_misses[page_size];
+    }
+    for (uint32_t bucket = 0; bucket < trace_num_huge_page_occupancy_buckets; bucket++)
+    {
+        if (footprint.huge_page_occupancy[bucket] > 0)
+        {
+            line << ",huge_pages_with_" << std::dec << (1U << bucket) << std::hex << "_pages="
+                 << footprint.huge_page_occupancy[bucket];
+        }
+    }
+    write_line ();
+}
+
+/**
+ * @details The call stack of a stack ID is found by following the parent stack IDs to the empty call stack.
+ */
+void csv_trace_encoder::call_stack_frame (uint32_t stack_id, uint32_t parent_id, uint64_t ip, const std::string &symbol)
+{
+    line << "N/A,call_stack,stack=" << stack_id << ",parent=" << parent_id << ",ip=" << ip << ",symbol=" << symbol;
+    write_line ();
+}
+
+void csv_trace_encoder::heap_statistics (const std::string &func_name, const trace_heap_statistics &statistics)
+{
+    line << func_name << ",heap,entry_live_bytes=" << statistics.entry_live_bytes
+         << ",entry_live_blocks=" << statistics.entry_live_blocks
+         << ",peak_live_bytes=" << statistics.peak_live_bytes << ",peak_live_blocks=" << statistics.peak_live_blocks
+         << ",exit_live_bytes=" << statistics.exit_live_bytes << ",exit_live_blocks=" << statistics.exit_live_blocks;
+    write_line ();
+}
+
+void csv_trace_encoder::heap_sample (const trace_heap_sample &sample)
+{
+    line << "N/A,heap_sample,instructions=" << sample.instructions << ",live_bytes=" << sample.live_bytes
+         << ",live_blocks=" << sample.live_blocks << ",peak_live_bytes=" << sample.peak_live_bytes;
+    write_line ();
+}
+
+/**
+ * @details A full memory profile is output as only the invocation and the number of regions, and a delta as the
+ *          reference invocation and counts of the changed, unchanged and removed regions.
+ */
+void csv_trace_encoder::invocation_profile (const std::string &func_name, const trace_invocation_profile &profile)
+{
+    line << func_name << ",invocation,invocation=" << profile.invocation;
+    if (profile.reference_invocation == profile.invocation)
+    {
+        line << ",profile=full,regions=" << profile.changed_regions;
+    }
+    else
+    {
+        line << ",profile=delta,reference_invocation=" << profile.reference_invocation
+             << ",changed_regions=" << profile.changed_regions << ",unchanged_regions=" << profile.unchanged_regions
+             << ",removed_regions=" << profile.removed_regions;
+    }
+    write_line ();
+}
+
+void csv_trace_encoder::invocation_repeats (const std::string &func_name, uint64_t same_as_invocation,
+                                            uint64_t repeats)
+{
+    line << func_name << ",repeated,same_as_invocation=" << same_as_invocation << ",repeats=" << repeats;
+    write_line ();
+}
+
+/**
+ * @details The line number is output as decimal. The line reuse is the total bytes accessed divided by the bytes of
+ *          the distinct cache lines touched, i.e. the average number of times each touched line was accessed in full.
+ */
+void csv_trace_encoder::source_line_traffic (const std::string &prefix, const trace_source_line_traffic &traffic)
+{
+    uint64_t total_bytes = 0;
+
+    line << prefix << ",source_line,routine=" << traffic.routine << ",file=" << traffic.file
+         << ",line=" << std::dec << traffic.line << std::hex << ",first_ip=" << traffic.first_ip
+         << ",instructions=" << traffic.instructions;
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        if (traffic.accesses[kind] > 0)
+        {
+            const char *const kind_name = trace_access_kind_field_names[kind];
+
+            line << "," << kind_name << "_accesses=" << traffic.accesses[kind]
+                 << "," << kind_name << "_bytes=" << traffic.bytes[kind];
+            total_bytes += traffic.bytes[kind];
+        }
+    }
+
+    const double reuse = (traffic.lines > 0) ?
+            ((double) total_bytes / ((double) traffic.lines * (double) traffic.line_size)) : 0.0;
+    line << ",lines=" << traffic.lines << ",line_reuse=" << reuse;
+    write_line ();
+}
+
+/**
+ * @details The allocation is output as allocation=none when the lines aren't in an allocation.
+ */
+void csv_trace_encoder::cache_line_sharing (const std::string &func_name, const trace_cache_line_sharing &sharing)
+{
+    line << func_name << ",cache_line_sharing,ip=" << sharing.ip << ",routine=" << sharing.routine;
+    if (sharing.size > 0)
+    {
+        line << ",data_ptr=" << sharing.data_ptr << ",size=" << sharing.size;
+        put_caller_fields (sharing.caller, sharing.stack_id);
+    }
+    else
+    {
+        line << ",allocation=none";
+    }
+    line << ",false_sharing=" << sharing.false_sharing << ",true_sharing=" << sharing.true_sharing
+         << ",lines=" << sharing.lines;
+    write_line ();
+}
+
+/**
+ * @details The operational intensity is the floating point operations per byte read or written.
+ */
+void csv_trace_encoder::roofline (const std::string &prefix, const trace_roofline &roofline)
+{
+    const uint64_t total_bytes = roofline.bytes_read + roofline.bytes_written;
+    uint64_t total_flops = 0;
+
+    line << prefix << ",fp_instructions=" << roofline.fp_instructions;
+    for (uint32_t width = 0; width < trace_num_vector_widths; width++)
+    {
+        line << "," << trace_vector_width_field_names[width] << "_flops=" << roofline.flops[width];
+        total_flops += roofline.flops[width];
+    }
+
+    const double intensity = (total_bytes > 0) ? ((double) total_flops / (double) total_bytes) : 0.0;
+    line << ",flops=" << total_flops << ",bytes_read=" << roofline.bytes_read
+         << ",bytes_written=" << roofline.bytes_written << ",intensity=" << intensity;
+    write_line ();
+}
+
+/**
+ * @details Only the kinds of access which were made are output for each class of memory.
+ */
+void csv_trace_encoder::segment_traffic (const std::string &prefix, const trace_segment_traffic &traffic)
+{
+    line << prefix;
+    for (uint32_t segment = 0; segment < trace_num_static_segments; segment++)
+    {
+        for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+        {
+            if (traffic.accesses[segment][kind] > 0)
+            {
+                const char *const field_name = trace_static_segment_field_names[segment];
+                const char *const kind_name = trace_access_kind_field_names[kind];
+
+                line << "," << field_name << "_" << kind_name << "_accesses=" << traffic.accesses[segment][kind]
+                     << "," << field_name << "_" << kind_name << "_bytes=" << traffic.bytes[segment][kind];
+            }
+        }
+    }
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        if (traffic.dynamic_bytes[kind] > 0)
+        {
+            line << ",dynamic_" << trace_access_kind_field_names[kind] << "_bytes=" << traffic.dynamic_bytes[kind];
+        }
+    }
+    write_line ();
+}
+
+void csv_trace_encoder::text_line (const std::string &text)
+{
+    line << text;
+    write_line ();
+}
+
+binary_trace_encoder::binary_trace_encoder (trace_sink &sink)
+    : sink (sink), previous_region_prefix_index (no_region_prefix_index), previous_region_end_addr (0)
+{
+    previous_heap_sample.instructions = 0;
+    previous_heap_sample.live_bytes = 0;
+    previous_heap_sample.live_blocks = 0;
+    previous_heap_sample.peak_live_bytes = 0;
+    sink.write (binary_trace_magic, binary_trace_magic_length);
+}
+
+/**
+ * @brief Get the index for a string, writing a TRACE_RECORD_STRING record the first time the string is used
+ * @details Must be called before start_record() for the record which refers to the string
+ * @param[in] str The string to get the index for
+ * @return The index of the string
+ */
+uint32_t binary_trace_encoder::string_index (const std::string &str)
+{
+    std::map<std::string,uint32_t>::const_iterator it = string_indices.find (str);
+
+    if (it != string_indices.end())
+    {
+        return it->second;
+    }
+
+    const uint32_t index = string_indices.size();
+    string_indices[str] = index;
+    start_record (TRACE_RECORD_STRING);
+    put_varint (index);
+    put_varint (str.size());
+    record.insert (record.end(), str.begin(), str.end());
+    write_record ();
+
+    return index;
+}
+
+void binary_trace_encoder::start_record (trace_record_type record_type)
+{
+    record.clear();
+    record.push_back ((char) record_type);
+}
+
+/**
+ * @brief Append an unsigned LEB128 varint to the record
+ * @param[in] value The value to append
+ */
+void binary_trace_encoder::put_varint (uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        record.push_back ((char) ((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    record.push_back ((char) value);
+}
+
+/**
+ * @brief Append a signed value to the record as a zig-zag encoded varint, so that small negative deltas are small
+ * @param[in] value The value to append
+ */
+void binary_trace_encoder::put_signed_varint (int64_t value)
+{
+    put_varint (((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+/**
+ * @brief Encode a reuse distance histogram as the cold count, followed by the number of non-zero buckets and then the
+ *        delta encoded index and count of each non-zero bucket
+ */
+void binary_trace_encoder::put_reuse_distance_histogram (const trace_reuse_distance_histogram &histogram)
+{
+    uint32_t num_buckets = 0;
+    uint32_t previous_bucket = 0;
+
+    put_varint (histogram.cold);
+    for (uint32_t bucket = 0; bucket < trace_num_reuse_distance_buckets; bucket++)
+    {
+        num_buckets += (histogram.counts[bucket] > 0) ? 1 : 0;
+    }
+    put_varint (num_buckets);
+    for (uint32_t bucket = 0; bucket < trace_num_reuse_distance_buckets; bucket++)
+    {
+        if (histogram.counts[bucket] > 0)
+        {
+            put_varint (bucket - previous_bucket);
+            put_varint (histogram.counts[bucket]);
+            previous_bucket = bucket;
+        }
+    }
+}
+
+/**
+ * @brief Encode an array of up to 32 counts as the mask of non-zero counts, followed by the non-zero counts
+ * @param[in] counts The counts to encode
+ * @param[in] num_counts The number of counts in the array
+ */
+void binary_trace_encoder::put_nonzero_counts (const uint64_t counts[], const uint32_t num_counts)
+{
+    uint32_t nonzero_mask = 0;
+
+    for (uint32_t index = 0; index < num_counts; index++)
+    {
+        nonzero_mask |= (counts[index] > 0) ? (1U << index) : 0;
+    }
+    put_varint (nonzero_mask);
+    for (uint32_t index = 0; index < num_counts; index++)
+    {
+        if (counts[index] > 0)
+        {
+            put_varint (counts[index]);
+        }
+    }
+}
+
+/**
+ * @brief Encode cache statistics as the mask of non-zero fields, followed by the non-zero fields
+ */
+void binary_trace_encoder::put_cache_statistics (const trace_cache_statistics &statistics)
+{
+    const uint32_t field_mask = cache_statistics_field_mask (statistics);
+
+    put_varint (field_mask);
+    for (uint32_t level = 0; level < trace_num_cache_levels; level++)
+    {
+        if ((field_mask & (1U << level)) != 0)
+        {
+            put_varint (statistics.misses[level]);
+        }
+        if ((field_mask & (1U << (trace_num_cache_levels + level))) != 0)
+        {
+            put_varint (statistics.writebacks[level]);
+        }
+    }
+}
+
+void binary_trace_encoder::write_record (void)
+{
+    sink.write (&record[0], record.size());
+}
+
+void binary_trace_encoder::function_enter (const std::string &func_name)
+{
+    const uint32_t func_index = string_index (func_name);
+
+    start_record (TRACE_RECORD_FUNCTION_ENTER);
+    put_varint (func_index);
+    write_record ();
+}
+
+void binary_trace_encoder::function_exit (const std::string &func_name)
+{
+    const uint32_t func_index = string_index (func_name);
+
+    start_record (TRACE_RECORD_FUNCTION_EXIT);
+    put_varint (func_index);
+    write_record ();
+}
+
+/**
+ * @details The start address is encoded as a delta from the end of the previous region with the same prefix,
+ *          the end address as the size of the region, and the access size histogram, cache statistics, reuse
+ *          distance histogram, access pattern counts and TLB misses as the non-zero counts.
+ */
+void binary_trace_encoder::region (const std::string &prefix, const trace_region &region)
+{
+    const uint32_t prefix_index = string_index (prefix);
+    const uint64_t base_addr =
+            (prefix_index == previous_region_prefix_index) ? (previous_region_end_addr + 1) : 0;
+    uint32_t num_sizes = 0;
+    uint32_t previous_size = 0;
+
+    start_record (TRACE_RECORD_REGION);
+    put_varint (prefix_index);
+    put_signed_varint ((int64_t) (region.start_addr - base_addr));
+    put_varint (region.end_addr - region.start_addr);
+    put_varint (region.total_bytes);
+    put_varint (region.cache_line_increments);
+    put_varint (region.cache_line_decrements);
+    for (uint32_t mem_access_size = 0; mem_access_size <= trace_max_mem_access_size; mem_access_size++)
+    {
+        num_sizes += (region.access_size_counts[mem_access_size] > 0) ? 1 : 0;
+    }
+    put_varint (num_sizes);
+    for (uint32_t mem_access_size = 0; mem_access_size <= trace_max_mem_access_size; mem_access_size++)
+    {
+        if (region.access_size_counts[mem_access_size] > 0)
+        {
+            put_varint (mem_access_size - previous_size);
+            put_varint (region.access_size_counts[mem_access_size]);
+            previous_size = mem_access_size;
+        }
+    }
+    put_cache_statistics (region.cache);
+    put_reuse_distance_histogram (region.reuse_distances);
+    put_nonzero_counts (region.access_pattern_counts, trace_num_access_patterns);
+    put_nonzero_counts (region.tlb_misses, trace_num_page_sizes);
+    write_record ();
+
+    previous_region_prefix_index = prefix_index;
+    previous_region_end_addr = region.end_addr;
+}
+
+void binary_trace_encoder::region_merge_error (const std::string &prefix)
+{
+    const uint32_t prefix_index = string_index (prefix);
+
+    start_record (TRACE_RECORD_REGION_MERGE_ERROR);
+    put_varint (prefix_index);
+    write_record ();
+}
+
+void binary_trace_encoder::allocation_event (const std::string &func_name, const std::string &allocator,
+                                             uint64_t size, uint64_t data_ptr, const std::string &caller,
+                                             uint32_t stack_id)
+{
+    const uint32_t func_index = string_index (func_name);
+    const uint32_t allocator_index = string_index (allocator);
+    const uint32_t caller_index = string_index (caller);
+
+    start_record (TRACE_RECORD_ALLOCATION);
+    put_varint (func_index);
+    put_varint (allocator_index);
+    put_varint (size);
+    put_varint (data_ptr);
+    put_varint (caller_index);
+    put_varint (stack_id);
+    write_record ();
+}
+
+void binary_trace_encoder::aligned_allocation_event (const std::string &func_name, const std::string &allocator,
+                                                     uint64_t boundary, uint64_t size, uint64_t data_ptr,
+                                                     const std::string &caller, uint32_t stack_id)
+{
+    const uint32_t func_index = string_index (func_name);
+    const uint32_t allocator_index = string_index (allocator);
+    const uint32_t caller_index = string_index (caller);
+
+    start_record (TRACE_RECORD_ALIGNED_ALLOCATION);
+    put_varint (func_index);
+    put_varint (allocator_index);
+    put_varint (boundary);
+    put_varint (size);
+    put_varint (data_ptr);
+    put_varint (caller_index);
+    put_varint (stack_id);
+    write_record ();
+}
+
+void binary_trace_encoder::reallocation_event (const std::string &func_name, const std::string &allocator,
+                                               uint64_t old_data_ptr, bool old_size_known, uint64_t old_size,
+                                               uint64_t size, uint64_t data_ptr, const std::string &caller,
+                                               uint32_t stack_id)
+{
+    const uint32_t func_index = string_index (func_name);
+    const uint32_t allocator_index = string_index (allocator);
+    const uint32_t caller_index = string_index (caller);
+
+    start_record (TRACE_RECORD_REALLOCATION);
+    put_varint (func_index);
+    put_varint (allocator_index);
+    put_varint (old_data_ptr);
+    put_varint (old_size_known ? 1 : 0);
+    if (old_size_known)
+    {
+        put_varint (old_size);
+    }
+    put_varint (size);
+    put_varint (data_ptr);
+    put_varint (caller_index);
+    put_varint (stack_id);
+    write_record ();
+}
+
+void binary_trace_encoder::free_event (const std::string &func_name, const std::string &deallocator,
+                                       uint64_t data_ptr, bool size_known, uint64_t size, const std::string &caller,
+                                       uint32_t stack_id)
+{
+    const uint32_t func_index = string_index (func_name);
+    const uint32_t deallocator_index = string_index (deallocator);
+    const uint32_t caller_index = string_index (caller);
+
+    start_record (TRACE_RECORD_FREE);
+    put_varint (func_index);
+    put_varint (deallocator_index);
+    put_varint (data_ptr);
+    put_varint (size_known ? 1 : 0);
+    if (size_known)
+    {
+        put_varint (size);
+    }
+    put_varint (caller_index);
+    put_varint (stack_id);
+    write_record ();
+}
+
+/**
+ * @details The addresses are encoded as a delta from the previous address
+ */
+void binary_trace_encoder::outstanding_allocations (const std::vector<trace_outstanding_allocation> &allocations)
+{
+    std::vector<trace_outstanding_allocation>::const_iterator it;
+    uint64_t previous_addr = 0;
+
+    start_record (TRACE_RECORD_OUTSTANDING_ALLOCATIONS);
+    put_varint (allocations.size());
+    for (it = allocations.begin(); it != allocations.end(); ++it)
+    {
+        put_signed_varint ((int64_t) (it->first - previous_addr));
+        put_varint (it->second);
+        previous_addr = it->first;
+    }
+    write_record ();
+}
+
+void binary_trace_encoder::region_cache_statistics (const std::string &prefix, uint64_t hits, uint64_t misses)
+{
+    const uint32_t prefix_index = string_index (prefix);
+
+    start_record (TRACE_RECORD_REGION_CACHE_STATISTICS);
+    put_varint (prefix_index);
+    put_varint (hits);
+    put_varint (misses);
+    write_record ();
+}
+
+void binary_trace_encoder::allocation_accesses (const std::string &func_name,
+                                                const trace_allocation_accesses &allocation)
+{
+    const uint32_t func_index = string_index (func_name);
+    const uint32_t allocated_in_index = string_index (allocation.allocated_in);
+    const uint32_t caller_index = string_index (allocation.caller);
+
+    start_record (TRACE_RECORD_ALLOCATION_ACCESSES);
+    put_varint (func_index);
+    put_varint (allocation.data_ptr);
+    put_varint (allocation.size);
+    put_varint (allocated_in_index);
+    put_varint (caller_index);
+    put_varint (allocation.stack_id);
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        put_varint (allocation.accesses[kind]);
+        if (allocation.accesses[kind] > 0)
+        {
+            put_varint (allocation.bytes[kind]);
+            put_varint (allocation.footprint[kind]);
+        }
+    }
+    write_record ();
+}
+
+void binary_trace_encoder::cache_statistics (const std::string &prefix, uint64_t accesses,
+                                             const trace_cache_statistics &statistics)
+{
+    const uint32_t prefix_index = string_index (prefix);
+
+    start_record (TRACE_RECORD_CACHE_STATISTICS);
+    put_varint (prefix_index);
+    put_varint (accesses);
+    put_cache_statistics (statistics);
+    write_record ();
+}
+
+void binary_trace_encoder::reuse_distances (const std::string &prefix, const trace_reuse_distance_histogram &histogram)
+{
+    const uint32_t prefix_index = string_index (prefix);
+
+    start_record (TRACE_RECORD_REUSE_DISTANCES);
+    put_varint (prefix_index);
+    put_reuse_distance_histogram (histogram);
+    write_record ();
+}
+
+void binary_trace_encoder::instruction_stride (const std::string &prefix, const trace_instruction_stride &stride)
+{
+    const uint32_t prefix_index = string_index (prefix);
+    const uint32_t routine_index = string_index (stride.routine);
+
+    start_record (TRACE_RECORD_INSTRUCTION_STRIDE);
+    put_varint (prefix_index);
+    put_varint (stride.ip);
+    put_varint (routine_index);
+    put_varint (stride.access_kind);
+    put_varint (stride.samples);
+    put_signed_varint (stride.stride);
+    put_varint (stride.stride_matches);
+    put_varint (stride.stride_changes);
+    put_varint (stride.access_pattern);
+    write_record ();
+}
+
+void binary_trace_encoder::sampling_statistics (const std::string &func_name, uint64_t invocations,
+                                                uint64_t sampled_invocations)
+{
+    const uint32_t func_index = string_index (func_name);
+
+    start_record (TRACE_RECORD_SAMPLING_STATISTICS);
+    put_varint (func_index);
+    put_varint (invocations);
+    put_varint (sampled_invocations);
+    write_record ();
+}
+
+void binary_trace_encoder::burst_sampling_statistics (uint64_t instructions, uint64_t sampled_instructions)
+{
+    start_record (TRACE_RECORD_BURST_SAMPLING_STATISTICS);
+    put_varint (instructions);
+    put_varint (sampled_instructions);
+    write_record ();
+}
+
+void binary_trace_encoder::page_footprint (const std::string &prefix, const trace_page_footprint &footprint)
+{
+    const uint32_t prefix_index = string_index (prefix);
+
+    start_record (TRACE_RECORD_PAGE_FOOTPRINT);
+    put_varint (prefix_index);
+    put_varint (footprint.line_size);
+    put_varint (footprint.lines);
+    for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+    {
+        put_varint (footprint.pages[page_size]);
+    }
+    put_nonzero_counts (footprint.huge_page_occupancy, trace_num_huge_page_occupancy_buckets);
+    put_nonzero_counts (footprint.tlb_misses, trace_num_page_sizes);
+    write_record ();
+}
+
+void binary_trace_encoder::call_stack_frame (uint32_t stack_id, uint32_t parent_id, uint64_t ip,
+                                             const std::string &symbol)
+{
+    const uint32_t symbol_index = string_index (symbol);
+
+    start_record (TRACE_RECORD_CALL_STACK_FRAME);
+    put_varint (stack_id);
+    put_varint (parent_id);
+    put_varint (ip);
+    put_varint (symbol_index);
+    write_record ();
+}
+
+void binary_trace_encoder::heap_statistics (const std::string &func_name, const trace_heap_statistics &statistics)
+{
+    const uint32_t func_index = string_index (func_name);
+
+    start_record (TRACE_RECORD_HEAP_STATISTICS);
+    put_varint (func_index);
+    put_varint (statistics.entry_live_bytes);
+    put_varint (statistics.entry_live_blocks);
+    put_varint (statistics.peak_live_bytes);
+    put_varint (statistics.peak_live_blocks);
+    put_varint (statistics.exit_live_bytes);
+    put_varint (statistics.exit_live_blocks);
+    write_record ();
+}
+
+/**
+ * @details The fields are delta encoded against the previous sample, and the peak against the live bytes of the
+ *          sample, so a long time series only takes a few bytes per sample.
+ */
+void binary_trace_encoder::heap_sample (const trace_heap_sample &sample)
+{
+    start_record (TRACE_RECORD_HEAP_SAMPLE);
+    put_signed_varint ((int64_t) (sample.instructions - previous_heap_sample.instructions));
+    put_signed_varint ((int64_t) (sample.live_bytes - previous_heap_sample.live_bytes));
+    put_signed_varint ((int64_t) (sample.live_blocks - previous_heap_sample.live_blocks));
+    put_signed_varint ((int64_t) (sample.peak_live_bytes - sample.live_bytes));
+    write_record ();
+    previous_heap_sample = sample;
+}
+
+/**
+ * @details The reference invocation is delta encoded against the invocation, so is zero for a full memory profile.
+ */
+void binary_trace_encoder::invocation_profile (const std::string &func_name, const trace_invocation_profile &profile)
+{
+    const uint32_t func_index = string_index (func_name);
+
+    start_record (TRACE_RECORD_INVOCATION_PROFILE);
+    put_varint (func_index);
+    put_varint (profile.invocation);
+    put_varint (profile.invocation - profile.reference_invocation);
+    put_varint (profile.changed_regions);
+    put_varint (profile.unchanged_regions);
+    put_varint (profile.removed_regions);
+    write_record ();
+}
+
+void binary_trace_encoder::invocation_repeats (const std::string &func_name, uint64_t same_as_invocation,
+                                               uint64_t repeats)
+{
+    const uint32_t func_index = string_index (func_name);
+
+    start_record (TRACE_RECORD_INVOCATION_REPEATS);
+    put_varint (func_index);
+    put_varint (same_as_invocation);
+    put_varint (repeats);
+    write_record ();
+}
+
+void binary_trace_encoder::source_line_traffic (const std::string &prefix, const trace_source_line_traffic &traffic)
+{
+    const uint32_t prefix_index = string_index (prefix);
+    const uint32_t routine_index = string_index (traffic.routine);
+    const uint32_t file_index = string_index (traffic.file);
+
+    start_record (TRACE_RECORD_SOURCE_LINE_TRAFFIC);
+    put_varint (prefix_index);
+    put_varint (routine_index);
+    put_varint (file_index);
+    put_varint (traffic.line);
+    put_varint (traffic.first_ip);
+    put_varint (traffic.instructions);
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        put_varint (traffic.accesses[kind]);
+        if (traffic.accesses[kind] > 0)
+        {
+            put_varint (traffic.bytes[kind]);
+        }
+    }
+    put_varint (traffic.line_size);
+    put_varint (traffic.lines);
+    write_record ();
+}
+
+void binary_trace_encoder::cache_line_sharing (const std::string &func_name, const trace_cache_line_sharing &sharing)
+{
+    const uint32_t func_index = string_index (func_name);
+    const uint32_t routine_index = string_index (sharing.routine);
+    const uint32_t caller_index = string_index (sharing.caller);
+
+    start_record (TRACE_RECORD_CACHE_LINE_SHARING);
+    put_varint (func_index);
+    put_varint (sharing.ip);
+    put_varint (routine_index);
+    put_varint (sharing.data_ptr);
+    put_varint (sharing.size);
+    put_varint (caller_index);
+    put_varint (sharing.stack_id);
+    put_varint (sharing.false_sharing);
+    put_varint (sharing.true_sharing);
+    put_varint (sharing.lines);
+    write_record ();
+}
+
+void binary_trace_encoder::roofline (const std::string &prefix, const trace_roofline &roofline)
+{
+    const uint32_t prefix_index = string_index (prefix);
+
+    start_record (TRACE_RECORD_ROOFLINE);
+    put_varint (prefix_index);
+    put_varint (roofline.fp_instructions);
+    for (uint32_t width = 0; width < trace_num_vector_widths; width++)
+    {
+        put_varint (roofline.flops[width]);
+    }
+    put_varint (roofline.bytes_read);
+    put_varint (roofline.bytes_written);
+    write_record ();
+}
+
+void binary_trace_encoder::segment_traffic (const std::string &prefix, const trace_segment_traffic &traffic)
+{
+    const uint32_t prefix_index = string_index (prefix);
+
+    start_record (TRACE_RECORD_SEGMENT_TRAFFIC);
+    put_varint (prefix_index);
+    for (uint32_t segment = 0; segment < trace_num_static_segments; segment++)
+    {
+        for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+        {
+            put_varint (traffic.accesses[segment][kind]);
+            if (traffic.accesses[segment][kind] > 0)
+            {
+                put_varint (traffic.bytes[segment][kind]);
+            }
+        }
+    }
+    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+    {
+        put_varint (traffic.dynamic_bytes[kind]);
+    }
+    write_record ();
+}
+
+void binary_trace_encoder::text_line (const std::string &line)
+{
+    start_record (TRACE_RECORD_TEXT_LINE);
+    put_varint (line.size());
+    record.insert (record.end(), line.begin(), line.end());
+    write_record ();
+}
+
+/** Reads the fields of records from a binary trace */
+class binary_trace_reader
+{
+public:
+    binary_trace_reader (std::istream &input) : input (input), truncated (false), undefined_string (false) {}
+
+    /**
+     * @brief Read an unsigned LEB128 varint
+     * @return The value read, or zero if the input is truncated
+     */
+    uint64_t get_varint (void)
+    {
+        uint64_t value = 0;
+        uint32_t shift = 0;
+        int byte;
+
+        do
+        {
+            byte = input.get();
+            if (byte == EOF)
+            {
+                truncated = true;
+                return 0;
+            }
+            if (shift < 64)
+            {
+                value |= (uint64_t) (byte & 0x7f) << shift;
+            }
+            shift += 7;
+        } while ((byte & 0x80) != 0);
+
+        return value;
+    }
+
+    int64_t get_signed_varint (void)
+    {
+        const uint64_t value = get_varint ();
+
+        return (int64_t) ((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    /**
+     * @brief Read cache statistics, encoded as the mask of non-zero fields followed by the non-zero fields
+     * @param[out] statistics The statistics read
+     */
+    void get_cache_statistics (trace_cache_statistics &statistics)
+    {
+        const uint64_t field_mask = get_varint ();
+
+        for (uint32_t level = 0; level < trace_num_cache_levels; level++)
+        {
+            statistics.misses[level] = ((field_mask & (1U << level)) != 0) ? get_varint () : 0;
+            statistics.writebacks[level] =
+                    ((field_mask & (1U << (trace_num_cache_levels + level))) != 0) ? get_varint () : 0;
+        }
+    }
+
+    /**
+     * @brief Read a string of the length given by a preceding varint
+     * @param[out] str The string read
+     */
+    void get_string (std::string &str)
+    {
+        const uint64_t length = get_varint ();
+
+        str.resize (truncated ? 0 : length);
+        if (!str.empty())
+        {
+            input.read (&str[0], str.size());
+            truncated = truncated || (input.gcount() != (std::streamsize) str.size());
+        }
+    }
+
+    /**
+     * @brief Read a reference to a string previously defined by a TRACE_RECORD_STRING record
+     * @param[in] strings The strings defined so far
+     * @return The string, or an empty string if the index isn't defined
+     */
+    const std::string &get_string_ref (const std::vector<std::string> &strings)
+    {
+        static const std::string undefined;
+        const uint64_t index = get_varint ();
+
+        if (index >= strings.size())
+        {
+            undefined_string = true;
+            return undefined;
+        }
+        return strings[index];
+    }
+
+    /**
+     * @brief Read a reuse distance histogram, encoded as the cold count followed by the non-zero buckets
+     * @param[out] histogram The histogram read
+     * @return Returns false if a bucket index is invalid
+     */
+    bool get_reuse_distance_histogram (trace_reuse_distance_histogram &histogram)
+    {
+        uint64_t num_buckets;
+        uint64_t bucket = 0;
+
+        histogram.cold = get_varint ();
+        for (uint32_t bucket_index = 0; bucket_index < trace_num_reuse_distance_buckets; bucket_index++)
+        {
+            histogram.counts[bucket_index] = 0;
+        }
+        num_buckets = get_varint ();
+        for (uint64_t count_index = 0; !truncated && (count_index < num_buckets); count_index++)
+        {
+            bucket += get_varint ();
+            if (bucket >= trace_num_reuse_distance_buckets)
+            {
+                return false;
+            }
+            histogram.counts[bucket] = get_varint ();
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Read an array of counts, encoded as the mask of non-zero counts followed by the non-zero counts
+     * @param[out] counts The counts read
+     * @param[in] num_counts The number of counts in the array
+     */
+    void get_nonzero_counts (uint64_t counts[], const uint32_t num_counts)
+    {
+        const uint64_t nonzero_mask = get_varint ();
+
+        for (uint32_t index = 0; index < num_counts; index++)
+        {
+            counts[index] = ((nonzero_mask & (1U << index)) != 0) ? get_varint () : 0;
+        }
+    }
+
+    std::istream &input;
+
+    /** Set when the input ends part way through a record */
+    bool truncated;
+
+    /** Set when a record refers to a string which hasn't been defined */
+    bool undefined_string;
+};
+
+/**
+ * @brief Decode a binary trace, passing each record to another trace encoder
+ * @details Used to convert a binary trace to the .csv format. The records before an error are passed to the encoder.
+ * @param[in,out] input The binary trace to decode
+ * @param[in,out] output The encoder to pass the decoded records to
+ * @param[out] error When returning false, describes why the binary trace couldn't be decoded
+ * @return Returns true if the binary trace was decoded, or false if it is invalid
+ */
+bool decode_binary_trace (std::istream &input, trace_encoder &output, std::string &error)
+{
+    binary_trace_reader reader (input);
+    std::vector<std::string> strings;
+    uint32_t previous_region_prefix_index = no_region_prefix_index;
+    uint64_t previous_region_end_addr = 0;
+    trace_heap_sample previous_heap_sample = {0, 0, 0, 0};
+    bool header_read = false;
+    int record_type;
+
+    while ((record_type = input.get()) != EOF)
+    {
+        if (record_type == binary_trace_magic[0])
+        {
+            char magic[binary_trace_magic_length];
+
+            magic[0] = (char) record_type;
+            input.read (&magic[1], binary_trace_magic_length - 1);
+            if ((input.gcount() != (std::streamsize) (binary_trace_magic_length - 1)) ||
+                (std::string (magic, binary_trace_magic_length) != binary_trace_magic))
+            {
+                error = "invalid header";
+                return false;
+            }
+
+            /* Each header starts a new trace */
+            strings.clear();
+            previous_region_prefix_index = no_region_prefix_index;
+            previous_region_end_addr = 0;
+            previous_heap_sample.instructions = 0;
+            previous_heap_sample.live_bytes = 0;
+            previous_heap_sample.live_blocks = 0;
+            header_read = true;
+            continue;
+        }
+        if (!header_read)
+        {
+            error = "not a binary trace";
+            return false;
+        }
+
+        switch (record_type)
+        {
+        case TRACE_RECORD_STRING:
+            {
+                const uint64_t index = reader.get_varint ();
+                std::string str;
+
+                reader.get_string (str);
+                if (index != strings.size())
+                {
+                    error = "string record out of sequence";
+                    return false;
+                }
+                strings.push_back (str);
+            }
+            break;
+
+        case TRACE_RECORD_FUNCTION_ENTER:
+        case TRACE_RECORD_FUNCTION_EXIT:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+
+                if (!reader.truncated)
+                {
+                    if (record_type == TRACE_RECORD_FUNCTION_ENTER)
+                    {
+                        output.function_enter (func_name);
+                    }
+                    else
+                    {
+                        output.function_exit (func_name);
+                    }
+                }
+            }
+            break;
+
+        case TRACE_RECORD_REGION:
+            {
+                const uint64_t prefix_index = reader.get_varint ();
+                const uint64_t base_addr =
+                        (prefix_index == previous_region_prefix_index) ? (previous_region_end_addr + 1) : 0;
+                trace_region region;
+                uint64_t num_sizes;
+                uint64_t mem_access_size = 0;
+
+                region.start_addr = base_addr + (uint64_t) reader.get_signed_varint ();
+                region.end_addr = region.start_addr + reader.get_varint ();
+                region.total_bytes = reader.get_varint ();
+                region.cache_line_increments = (uint32_t) reader.get_varint ();
+                region.cache_line_decrements = (uint32_t) reader.get_varint ();
+                for (uint32_t size_index = 0; size_index <= trace_max_mem_access_size; size_index++)
+                {
+                    region.access_size_counts[size_index] = 0;
+                }
+                num_sizes = reader.get_varint ();
+                for (uint64_t count_index = 0; !reader.truncated && (count_index < num_sizes); count_index++)
+                {
+                    mem_access_size += reader.get_varint ();
+                    if (mem_access_size > trace_max_mem_access_size)
+                    {
+                        error = "invalid access size in region record";
+                        return false;
+                    }
+                    region.access_size_counts[mem_access_size] = reader.get_varint ();
+                }
+                reader.get_cache_statistics (region.cache);
+                if (!reader.get_reuse_distance_histogram (region.reuse_distances))
+                {
+                    error = "invalid reuse distance bucket in region record";
+                    return false;
+                }
+                reader.get_nonzero_counts (region.access_pattern_counts, trace_num_access_patterns);
+                reader.get_nonzero_counts (region.tlb_misses, trace_num_page_sizes);
+
+                if (prefix_index >= strings.size())
+                {
+                    reader.undefined_string = true;
+                }
+                else if (!reader.truncated)
+                {
+                    output.region (strings[prefix_index], region);
+                }
+                previous_region_prefix_index = (uint32_t) prefix_index;
+                previous_region_end_addr = region.end_addr;
+            }
+            break;
+
+        case TRACE_RECORD_REGION_MERGE_ERROR:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+
+                if (!reader.truncated)
+                {
+                    output.region_merge_error (prefix);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_ALLOCATION:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                const std::string &allocator = reader.get_string_ref (strings);
+                const uint64_t size = reader.get_varint ();
+                const uint64_t data_ptr = reader.get_varint ();
+                const std::string &caller = reader.get_string_ref (strings);
+                const uint32_t stack_id = (uint32_t) reader.get_varint ();
+
+                if (!reader.truncated)
+                {
+                    output.allocation_event (func_name, allocator, size, data_ptr, caller, stack_id);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_ALIGNED_ALLOCATION:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                const std::string &allocator = reader.get_string_ref (strings);
+                const uint64_t boundary = reader.get_varint ();
+                const uint64_t size = reader.get_varint ();
+                const uint64_t data_ptr = reader.get_varint ();
+                const std::string &caller = reader.get_string_ref (strings);
+                const uint32_t stack_id = (uint32_t) reader.get_varint ();
+
+                if (!reader.truncated)
+                {
+                    output.aligned_allocation_event (func_name, allocator, boundary, size, data_ptr, caller, stack_id);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_REALLOCATION:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                const std::string &allocator = reader.get_string_ref (strings);
+                const uint64_t old_data_ptr = reader.get_varint ();
+                const bool old_size_known = reader.get_varint () != 0;
+                const uint64_t old_size = old_size_known ? reader.get_varint () : 0;
+                const uint64_t size = reader.get_varint ();
+                const uint64_t data_ptr = reader.get_varint ();
+                const std::string &caller = reader.get_string_ref (strings);
+                const uint32_t stack_id = (uint32_t) reader.get_varint ();
+
+                if (!reader.truncated)
+                {
+                    output.reallocation_event (func_name, allocator, old_data_ptr, old_size_known, old_size, size,
+                                               data_ptr, caller, stack_id);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_FREE:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                const std::string &deallocator = reader.get_string_ref (strings);
+                const uint64_t data_ptr = reader.get_varint ();
+                const bool size_known = reader.get_varint () != 0;
+                const uint64_t size = size_known ? reader.get_varint () : 0;
+                const std::string &caller = reader.get_string_ref (strings);
+                const uint32_t stack_id = (uint32_t) reader.get_varint ();
+
+                if (!reader.truncated)
+                {
+                    output.free_event (func_name, deallocator, data_ptr, size_known, size, caller, stack_id);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_OUTSTANDING_ALLOCATIONS:
+            {
+                const uint64_t num_allocations = reader.get_varint ();
+                std::vector<trace_outstanding_allocation> allocations;
+                uint64_t addr = 0;
+
+                for (uint64_t allocation_index = 0; !reader.truncated && (allocation_index < num_allocations);
+                     allocation_index++)
+                {
+                    addr += (uint64_t) reader.get_signed_varint ();
+                    allocations.push_back (trace_outstanding_allocation (addr, reader.get_varint ()));
+                }
+                if (!reader.truncated)
+                {
+                    output.outstanding_allocations (allocations);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_REGION_CACHE_STATISTICS:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+                const uint64_t hits = reader.get_varint ();
+                const uint64_t misses = reader.get_varint ();
+
+                if (!reader.truncated)
+                {
+                    output.region_cache_statistics (prefix, hits, misses);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_TEXT_LINE:
+            {
+                std::string line;
+
+                reader.get_string (line);
+                if (!reader.truncated)
+                {
+                    output.text_line (line);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_ALLOCATION_ACCESSES:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                trace_allocation_accesses allocation;
+
+                allocation.data_ptr = reader.get_varint ();
+                allocation.size = reader.get_varint ();
+                allocation.allocated_in = reader.get_string_ref (strings);
+                allocation.caller = reader.get_string_ref (strings);
+                allocation.stack_id = (uint32_t) reader.get_varint ();
+                for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+                {
+                    allocation.accesses[kind] = reader.get_varint ();
+                    allocation.bytes[kind] = (allocation.accesses[kind] > 0) ? reader.get_varint () : 0;
+                    allocation.footprint[kind] = (allocation.accesses[kind] > 0) ? reader.get_varint () : 0;
+                }
+                if (!reader.truncated)
+                {
+                    output.allocation_accesses (func_name, allocation);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_CACHE_STATISTICS:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+                const uint64_t accesses = reader.get_varint ();
+                trace_cache_statistics statistics;
+
+                reader.get_cache_statistics (statistics);
+                if (!reader.truncated)
+                {
+                    output.cache_statistics (prefix, accesses, statistics);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_REUSE_DISTANCES:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+                trace_reuse_distance_histogram histogram;
+
+                if (!reader.get_reuse_distance_histogram (histogram))
+                {
+                    error = "invalid reuse distance bucket in reuse distances record";
+                    return false;
+                }
+                if (!reader.truncated)
+                {
+                    output.reuse_distances (prefix, histogram);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_INSTRUCTION_STRIDE:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+                trace_instruction_stride stride;
+                uint64_t access_pattern;
+
+                stride.ip = reader.get_varint ();
+                stride.routine = reader.get_string_ref (strings);
+                stride.access_kind = (uint32_t) reader.get_varint ();
+                stride.samples = reader.get_varint ();
+                stride.stride = reader.get_signed_varint ();
+                stride.stride_matches = reader.get_varint ();
+                stride.stride_changes = reader.get_varint ();
+                access_pattern = reader.get_varint ();
+                if ((stride.access_kind >= trace_num_access_kinds) || (access_pattern >= trace_num_access_patterns))
+                {
+                    error = "invalid instruction stride record";
+                    return false;
+                }
+                stride.access_pattern = (trace_access_pattern) access_pattern;
+                if (!reader.truncated)
+                {
+                    output.instruction_stride (prefix, stride);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_SAMPLING_STATISTICS:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                const uint64_t invocations = reader.get_varint ();
+                const uint64_t sampled_invocations = reader.get_varint ();
+
+                if (!reader.truncated)
+                {
+                    output.sampling_statistics (func_name, invocations, sampled_invocations);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_BURST_SAMPLING_STATISTICS:
+            {
+                const uint64_t instructions = reader.get_varint ();
+                const uint64_t sampled_instructions = reader.get_varint ();
+
+                if (!reader.truncated)
+                {
+                    output.burst_sampling_statistics (instructions, sampled_instructions);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_PAGE_FOOTPRINT:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+                trace_page_footprint footprint;
+
+                footprint.line_size = (uint32_t) reader.get_varint ();
+                footprint.lines = reader.get_varint ();
+                for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+                {
+                    footprint.pages[page_size] = reader.get_varint ();
+                }
+                reader.get_nonzero_counts (footprint.huge_page_occupancy, trace_num_huge_page_occupancy_buckets);
+                reader.get_nonzero_counts (footprint.tlb_misses, trace_num_page_sizes);
+                if (!reader.truncated)
+                {
+                    output.page_footprint (prefix, footprint);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_CALL_STACK_FRAME:
+            {
+                const uint32_t stack_id = (uint32_t) reader.get_varint ();
+                const uint32_t parent_id = (uint32_t) reader.get_varint ();
+                const uint64_t ip = reader.get_varint ();
+                const std::string &symbol = reader.get_string_ref (strings);
+
+                if (!reader.truncated)
+                {
+                    output.call_stack_frame (stack_id, parent_id, ip, symbol);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_HEAP_STATISTICS:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                trace_heap_statistics statistics;
+
+                statistics.entry_live_bytes = reader.get_varint ();
+                statistics.entry_live_blocks = reader.get_varint ();
+                statistics.peak_live_bytes = reader.get_varint ();
+                statistics.peak_live_blocks = reader.get_varint ();
+                statistics.exit_live_bytes = reader.get_varint ();
+                statistics.exit_live_blocks = reader.get_varint ();
+                if (!reader.truncated)
+                {
+                    output.heap_statistics (func_name, statistics);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_HEAP_SAMPLE:
+            {
+                trace_heap_sample sample;
+
+                sample.instructions = previous_heap_sample.instructions + (uint64_t) reader.get_signed_varint ();
+                sample.live_bytes = previous_heap_sample.live_bytes + (uint64_t) reader.get_signed_varint ();
+                sample.live_blocks = previous_heap_sample.live_blocks + (uint64_t) reader.get_signed_varint ();
+                sample.peak_live_bytes = sample.live_bytes + (uint64_t) reader.get_signed_varint ();
+                if (!reader.truncated)
+                {
+                    output.heap_sample (sample);
+                    previous_heap_sample = sample;
+                }
+            }
+            break;
+
+        case TRACE_RECORD_INVOCATION_PROFILE:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                trace_invocation_profile profile;
+
+                profile.invocation = reader.get_varint ();
+                profile.reference_invocation = profile.invocation - reader.get_varint ();
+                profile.changed_regions = reader.get_varint ();
+                profile.unchanged_regions = reader.get_varint ();
+                profile.removed_regions = reader.get_varint ();
+                if (!reader.truncated)
+                {
+                    output.invocation_profile (func_name, profile);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_INVOCATION_REPEATS:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                const uint64_t same_as_invocation = reader.get_varint ();
+                const uint64_t repeats = reader.get_varint ();
+
+                if (!reader.truncated)
+                {
+                    output.invocation_repeats (func_name, same_as_invocation, repeats);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_SOURCE_LINE_TRAFFIC:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+                trace_source_line_traffic traffic;
+
+                traffic.routine = reader.get_string_ref (strings);
+                traffic.file = reader.get_string_ref (strings);
+                traffic.line = (uint32_t) reader.get_varint ();
+                traffic.first_ip = reader.get_varint ();
+                traffic.instructions = reader.get_varint ();
+                for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+                {
+                    traffic.accesses[kind] = reader.get_varint ();
+                    traffic.bytes[kind] = (traffic.accesses[kind] > 0) ? reader.get_varint () : 0;
+                }
+                traffic.line_size = (uint32_t) reader.get_varint ();
+                traffic.lines = reader.get_varint ();
+                if (!reader.truncated)
+                {
+                    output.source_line_traffic (prefix, traffic);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_CACHE_LINE_SHARING:
+            {
+                const std::string &func_name = reader.get_string_ref (strings);
+                trace_cache_line_sharing sharing;
+
+                sharing.ip = reader.get_varint ();
+                sharing.routine = reader.get_string_ref (strings);
+                sharing.data_ptr = reader.get_varint ();
+                sharing.size = reader.get_varint ();
+                sharing.caller = reader.get_string_ref (strings);
+                sharing.stack_id = (uint32_t) reader.get_varint ();
+                sharing.false_sharing = reader.get_varint ();
+                sharing.true_sharing = reader.get_varint ();
+                sharing.lines = reader.get_varint ();
+                if (!reader.truncated)
+                {
+                    output.cache_line_sharing (func_name, sharing);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_ROOFLINE:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+                trace_roofline roofline;
+
+                roofline.fp_instructions = reader.get_varint ();
+                for (uint32_t width = 0; width < trace_num_vector_widths; width++)
+                {
+                    roofline.flops[width] = reader.get_varint ();
+                }
+                roofline.bytes_read = reader.get_varint ();
+                roofline.bytes_written = reader.get_varint ();
+                if (!reader.truncated)
+                {
+                    output.roofline (prefix, roofline);
+                }
+            }
+            break;
+
+        case TRACE_RECORD_SEGMENT_TRAFFIC:
+            {
+                const std::string &prefix = reader.get_string_ref (strings);
+                trace_segment_traffic traffic;
+
+                for (uint32_t segment = 0; segment < trace_num_static_segments; segment++)
+                {
+                    for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+                    {
+                        traffic.accesses[segment][kind] = reader.get_varint ();
+                        traffic.bytes[segment][kind] = (traffic.accesses[segment][kind] > 0) ? reader.get_varint () : 0;
+                    }
+                }
+                for (uint32_t kind = 0; kind < trace_num_access_kinds; kind++)
+                {
+                    traffic.dynamic_bytes[kind] = reader.get_varint ();
+                }
+                if (!reader.truncated)
+                {
+                    output.segment_traffic (prefix, traffic);
+                }
+            }
+            break;
+
+        default:
+            error = "unknown record type";
+            return false;
+        }
+
+        if (reader.truncated)
+        {
+            error = "truncated record at end of trace";
+            return false;
+        }
+        if (reader.undefined_string)
+        {
+            error = "record refers to an undefined string";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Add data to a fingerprint, which is used to detect repeated memory profiles
+ * @details Uses the 64-bit FNV-1a hash, which is fast for the small records hashed.
+ * @param[in] data The data to add
+ * @param[in] length The length of the data in bytes
+ * @param[in] fingerprint The fingerprint of the preceding data, or trace_fingerprint_seed to start a new fingerprint
+ * @return The fingerprint including the data
+ */
+uint64_t trace_fingerprint (const void *const data, const size_t length, uint64_t fingerprint)
+{
+    const unsigned char *const bytes = (const unsigned char *) data;
+
+    for (size_t byte_index = 0; byte_index < length; byte_index++)
+    {
+        fingerprint ^= bytes[byte_index];
+        fingerprint *= 0x100000001b3ULL;
+    }
+
+    return fingerprint;
+}
@@ -0,0 +1,565 @@
+/*
+ * @file trace_format.h
+ * @date 16 Oct 2026
+ * @details
+ *  Defines the records written to the memory profile trace, and the encoders which write the records either as
+ *  the .csv text format or as a compact binary format.
+ *
+ *  The binary format starts with a header of binary_trace_magic, followed by records which each start with a one byte
+ *  trace_record_type. Record fields are unsigned LEB128 varints, with addresses delta encoded against the previous
+ *  record. Strings, such as function names, are written once as a TRACE_RECORD_STRING record and then referred to
+ *  by an index. A header may appear again after any record, which resets the decoder state, so that a binary trace
+ *  may be appended to an existing file.
+ *
+ *  This is independent of Pin, so that the same code is used by the memory_profile Pin tool and by the
+ *  memory_profile_convert program which converts a binary trace to the .csv format.
+ */
+
+#ifndef TRACE_FORMAT_H_
+#define TRACE_FORMAT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+/** The largest memory access size, in bytes, which has its own count in the access size histogram of a region */
+const uint32_t trace_max_mem_access_size = 64;
+
+/** The number of levels of the simulated cache hierarchy, i.e. L1D, L2 and LLC */
+const uint32_t trace_num_cache_levels = 3;
+
+/** The names used for each level of the simulated cache hierarchy in the fields of a record */
+extern const char *const trace_cache_level_field_names[trace_num_cache_levels];
+
+/** The outcome of simulating a set of memory accesses in the cache hierarchy, indexed by level */
+struct trace_cache_statistics
+{
+    /** The number of accesses which missed in the level */
+    uint64_t misses[trace_num_cache_levels];
+    /** The number of dirty lines written back from the level, caused by the accesses */
+    uint64_t writebacks[trace_num_cache_levels];
+};
+
+/** The number of log2 buckets in a reuse distance histogram. Bucket zero counts a reuse distance of zero, and
+ *  bucket n counts reuse distances from 2^(n-1) to (2^n)-1, for reuse distances up to 2^32-1. */
+const uint32_t trace_num_reuse_distance_buckets = 33;
+
+/** A histogram of the reuse distances of cache line accesses, where the reuse distance is the number of distinct
+ *  cache lines accessed since the previous access to the same cache line */
+struct trace_reuse_distance_histogram
+{
+    /** The number of first accesses to a cache line, which have no reuse distance */
+    uint64_t cold;
+    /** The number of accesses in each log2 bucket of reuse distance */
+    uint64_t counts[trace_num_reuse_distance_buckets];
+};
+
+/**
+ * @brief Get the bucket of a reuse distance histogram which counts a reuse distance
+ */
+inline uint32_t trace_reuse_distance_bucket (const uint32_t reuse_distance)
+{
+    return (reuse_distance == 0) ? 0 : (32 - __builtin_clz (reuse_distance));
+}
+
+/**
+ * @brief Get the smallest reuse distance counted by a bucket of a reuse distance histogram
+ */
+inline uint64_t trace_reuse_distance_bucket_start (const uint32_t bucket)
+{
+    return (bucket == 0) ? 0 : ((uint64_t) 1 << (bucket - 1));
+}
+
+/** The number of classes of access pattern */
+const uint32_t trace_num_access_patterns = 4;
+
+/** The classes of access pattern learnt from the strides of the addresses accessed by each instruction */
+enum trace_access_pattern
+{
+    /** Strides smaller than a cache line, so successive accesses are to the same or the adjacent cache line */
+    TRACE_ACCESS_PATTERN_SEQUENTIAL,
+    /** A dominant stride of at least a cache line, which isn't a power of two */
+    TRACE_ACCESS_PATTERN_FIXED_STRIDE,
+    /** A dominant stride which is a power of two of at least a cache line, or mostly such strides without a dominant
+     *  stride as in an FFT butterfly. These map successive accesses to a small number of cache sets. */
+    TRACE_ACCESS_PATTERN_POWER_OF_TWO_STRIDE,
+    /** No dominant stride */
+    TRACE_ACCESS_PATTERN_RANDOM
+};
+
+/** The names used for each trace_access_pattern */
+extern const char *const trace_access_pattern_names[trace_num_access_patterns];
+
+/** The strides learnt for one memory operand of a static instruction */
+struct trace_instruction_stride
+{
+    /** The address of the instruction */
+    uint64_t ip;
+    /** The name of the routine containing the instruction */
+    std::string routine;
+    /** Index into trace_access_kind_field_names[] for the kind of memory access */
+    uint32_t access_kind;
+    /** The number of strides observed */
+    uint64_t samples;
+    /** The dominant stride in bytes */
+    int64_t stride;
+    /** The number of strides which matched the dominant stride */
+    uint64_t stride_matches;
+    /** The number of strides which differed from the previous stride */
+    uint64_t stride_changes;
+    trace_access_pattern access_pattern;
+};
+
+/** The number of page sizes for which page footprints and TLB misses are estimated */
+const uint32_t trace_num_page_sizes = 2;
+
+/** The names used for each page size in the fields of the trace, i.e. 4K and 2M */
+extern const char *const trace_page_size_field_names[trace_num_page_sizes];
+
+/** The log2 of each page size */
+const uint32_t trace_page_shifts[trace_num_page_sizes] = {12, 21};
+
+/** The number of buckets in the histogram of 2M page occupancy. Bucket n counts the 2M pages with between 2^n and
+ *  2^(n+1)-1 4K pages touched, with the last bucket for 2M pages with all 512 4K pages touched. */
+const uint32_t trace_num_huge_page_occupancy_buckets = 10;
+
+/** The pages touched by the accesses of a memory profile */
+struct trace_page_footprint
+{
+    /** The cache line size used to count the touched lines */
+    uint32_t line_size;
+    /** The number of distinct cache lines touched */
+    uint64_t lines;
+    /** The number of distinct pages touched, indexed by page size */
+    uint64_t pages[trace_num_page_sizes];
+    /** Histogram of the number of 4K pages touched in each 2M page touched */
+    uint64_t huge_page_occupancy[trace_num_huge_page_occupancy_buckets];
+    /** The estimated number of data TLB misses, indexed by page size, or all zeros when the TLB isn't simulated */
+    uint64_t tlb_misses[trace_num_page_sizes];
+};
+
+/** One region of a memory profile */
+struct trace_region
+{
+    /** The start address of the region */
+    uint64_t start_addr;
+    /** The end address of the region */
+    uint64_t end_addr;
+    /** The total number of bytes which have been accessed in the region */
+    uint64_t total_bytes;
+    /** Count of the number of times the region has been extended to cover a incrementing cache line */
+    uint32_t cache_line_increments;
+    /** Count of the number of times the region has been extended to cover a decrementing cache line */
+    uint32_t cache_line_decrements;
+    /** Count of accesses indexed by the access size in bytes, where index zero counts accesses of unknown size */
+    uint64_t access_size_counts[trace_max_mem_access_size + 1];
+    /** The outcome of the accesses to the region in the simulated cache hierarchy, which is all zeros
+     *  when the cache hierarchy isn't simulated */
+    trace_cache_statistics cache;
+    /** The reuse distances of the cache line accesses to the region, which is all zeros when reuse distances
+     *  aren't measured */
+    trace_reuse_distance_histogram reuse_distances;
+    /** The number of accesses to the region indexed by the trace_access_pattern of the accessing instruction,
+     *  which is all zeros when strides aren't learnt */
+    uint64_t access_pattern_counts[trace_num_access_patterns];
+    /** The estimated number of data TLB misses for accesses to the region indexed by page size,
+     *  which is all zeros when the page footprint isn't measured */
+    uint64_t tlb_misses[trace_num_page_sizes];
+};
+
+/** The number of kinds of memory access which are counted for each allocation and source line, i.e. read, write and
+ *  prefetch */
+const uint32_t trace_num_access_kinds = 3;
+
+/** The names used for each kind of memory access in the fields of allocation and source line records */
+extern const char *const trace_access_kind_field_names[trace_num_access_kinds];
+
+/** The accesses made by a top-level function to one allocation, indexed by kind of memory access */
+struct trace_allocation_accesses
+{
+    /** The start address of the allocation */
+    uint64_t data_ptr;
+    /** The size of the allocation */
+    uint64_t size;
+    /** The top-level function which was active when the allocation was made */
+    std::string allocated_in;
+    /** The function which called the memory allocation function */
+    std::string caller;
+    /** The call stack of the allocation, or zero when call stacks aren't captured */
+    uint32_t stack_id;
+    /** The number of accesses made to the allocation */
+    uint64_t accesses[trace_num_access_kinds];
+    /** The total number of bytes accessed in the allocation */
+    uint64_t bytes[trace_num_access_kinds];
+    /** The number of unique bytes of the allocation which were accessed */
+    uint64_t footprint[trace_num_access_kinds];
+};
+
+/** The memory traffic of the memory operands of the instructions at one source line, with the accesses indexed by
+ *  kind of memory access */
+struct trace_source_line_traffic
+{
+    /** The name of the routine containing the instructions */
+    std::string routine;
+    /** The source file, or ??? when the instructions have no line information */
+    std::string file;
+    /** The line number in the source file, or zero when the instructions have no line information */
+    uint32_t line;
+    /** The lowest address of the instructions */
+    uint64_t first_ip;
+    /** The number of instructions at the line which made accesses */
+    uint64_t instructions;
+    /** The number of accesses made by the instructions */
+    uint64_t accesses[trace_num_access_kinds];
+    /** The total number of bytes accessed by the instructions */
+    uint64_t bytes[trace_num_access_kinds];
+    /** The cache line size used to count the touched lines */
+    uint32_t line_size;
+    /** The number of distinct cache lines touched by the instructions */
+    uint64_t lines;
+};
+
+/** The sharing of cache lines between threads detected for the writes by one instruction to one allocation, during
+ *  the activations of a top-level function */
+struct trace_cache_line_sharing
+{
+    /** The address of the instruction which wrote the lines */
+    uint64_t ip;
+    /** The name of the routine containing the instruction */
+    std::string routine;
+    /** The start address of the allocation containing the lines */
+    uint64_t data_ptr;
+    /** The size of the allocation, or zero when the lines aren't in an allocation such as in the stack or a global */
+    uint64_t size;
+    /** The function which called the memory allocation function */
+    std::string caller;
+    /** The call stack of the allocation, or zero when call stacks aren't captured */
+    uint32_t stack_id;
+    /** The number of writes to a line last written by another thread, where the bytes written didn't overlap the bytes
+     *  written by the other thread */
+    uint64_t false_sharing;
+    /** The number of writes to a line last written by another thread, where the bytes written overlapped the bytes
+     *  written by the other thread */
+    uint64_t true_sharing;
+    /** The number of distinct cache lines which were shared */
+    uint64_t lines;
+};
+
+/** The number of vector widths which the floating point operations of a top-level function are counted by, i.e.
+ *  scalar, 128-bit, 256-bit and 512-bit vectors */
+const uint32_t trace_num_vector_widths = 4;
+
+/** The names used for each vector width in the fields of roofline records */
+extern const char *const trace_vector_width_field_names[trace_num_vector_widths];
+
+/** The floating point operations and memory traffic of an activation of a top-level function, which places the
+ *  activation on a roofline model */
+struct trace_roofline
+{
+    /** The number of floating point arithmetic instructions executed */
+    uint64_t fp_instructions;
+    /** The number of floating point operations, indexed by vector width, where a fused multiply-add is two operations
+     *  per lane */
+    uint64_t flops[trace_num_vector_widths];
+    /** The bytes read and written, where read-modify-write accesses count as both */
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+};
+
+/** The number of classes of memory whose accesses are counted without being recorded in the memory profile, i.e. the
+ *  stack and globals */
+const uint32_t trace_num_static_segments = 2;
+
+/** The names used for each class of memory in the fields of segment traffic records */
+extern const char *const trace_static_segment_field_names[trace_num_static_segments];
+
+/** The memory traffic of an activation of a top-level function broken down by class of memory, where the accesses
+ *  are indexed by kind of memory access and read-modify-write accesses count as both a read and a write */
+struct trace_segment_traffic
+{
+    /** The number of accesses to the stack and to globals, identified when the instructions were instrumented */
+    uint64_t accesses[trace_num_static_segments][trace_num_access_kinds];
+    /** The total number of bytes accessed in the stack and in globals */
+    uint64_t bytes[trace_num_static_segments][trace_num_access_kinds];
+    /** The total number of bytes accessed in other memory, such as the heap and memory mappings, which are recorded
+     *  in the memory profile */
+    uint64_t dynamic_bytes[trace_num_access_kinds];
+};
+
+/** The live heap during an activation of a top-level function, where the live heap is the allocations which are
+ *  outstanding */
+struct trace_heap_statistics
+{
+    /** The live bytes and blocks at entry to the top-level function */
+    uint64_t entry_live_bytes;
+    uint64_t entry_live_blocks;
+    /** The high-water marks of the live bytes and blocks during the activation */
+    uint64_t peak_live_bytes;
+    uint64_t peak_live_blocks;
+    /** The live bytes and blocks at exit from the top-level function */
+    uint64_t exit_live_bytes;
+    uint64_t exit_live_blocks;
+};
+
+/** One sample of the time series of the live heap */
+struct trace_heap_sample
+{
+    /** The number of instructions executed when the sample was taken */
+    uint64_t instructions;
+    /** The live bytes and blocks when the sample was taken */
+    uint64_t live_bytes;
+    uint64_t live_blocks;
+    /** The high-water mark of the live bytes since the previous sample */
+    uint64_t peak_live_bytes;
+};
+
+/** How the memory profile of an invocation of a top-level function was output, when invocations are aggregated */
+struct trace_invocation_profile
+{
+    /** The invocation of the top-level function, counting from zero */
+    uint64_t invocation;
+    /** The invocation whose memory profile the regions are relative to. When the same as invocation all regions were
+     *  output, otherwise only the changed regions were output. */
+    uint64_t reference_invocation;
+    /** The number of regions output */
+    uint64_t changed_regions;
+    /** The number of regions which are the same as in the reference invocation, so weren't output */
+    uint64_t unchanged_regions;
+    /** The number of regions of the reference invocation which aren't in this invocation */
+    uint64_t removed_regions;
+};
+
+/** An allocation which has not been freed, as an address and size */
+typedef std::pair<uint64_t,uint64_t> trace_outstanding_allocation;
+
+/** Destination for the bytes of an encoded trace */
+class trace_sink
+{
+public:
+    virtual ~trace_sink (void) {}
+    virtual void write (const char *data, size_t length) = 0;
+
+    /** Called when no more trace is expected for a while, to pass on any buffered trace */
+    virtual void flush (void) {}
+};
+
+/** A trace_sink which writes to a stream */
+class ostream_trace_sink : public trace_sink
+{
+public:
+    ostream_trace_sink (std::ostream &stream) : stream (stream) {}
+    virtual void write (const char *data, size_t length);
+    virtual void flush (void);
+private:
+    std::ostream &stream;
+};
+
+/** Interface to write the records of a memory profile trace, which is implemented for each trace format */
+class trace_encoder
+{
+public:
+    virtual ~trace_encoder (void) {}
+    virtual void function_enter (const std::string &func_name) = 0;
+    virtual void function_exit (const std::string &func_name) = 0;
+    virtual void region (const std::string &prefix, const trace_region &region) = 0;
+    virtual void region_merge_error (const std::string &prefix) = 0;
+    virtual void allocation_event (const std::string &func_name, const std::string &allocator, uint64_t size,
+                                   uint64_t data_ptr, const std::string &caller, uint32_t stack_id) = 0;
+    virtual void aligned_allocation_event (const std::string &func_name, const std::string &allocator,
+                                           uint64_t boundary, uint64_t size, uint64_t data_ptr,
+                                           const std::string &caller, uint32_t stack_id) = 0;
+    virtual void reallocation_event (const std::string &func_name, const std::string &allocator,
+                                     uint64_t old_data_ptr, bool old_size_known, uint64_t old_size,
+                                     uint64_t size, uint64_t data_ptr, const std::string &caller,
+                                     uint32_t stack_id) = 0;
+    virtual void free_event (const std::string &func_name, const std::string &deallocator, uint64_t data_ptr,
+                             bool size_known, uint64_t size, const std::string &caller, uint32_t stack_id) = 0;
+    virtual void outstanding_allocations (const std::vector<trace_outstanding_allocation> &allocations) = 0;
+    virtual void region_cache_statistics (const std::string &prefix, uint64_t hits, uint64_t misses) = 0;
+    virtual void allocation_accesses (const std::string &func_name, const trace_allocation_accesses &allocation) = 0;
+    virtual void cache_statistics (const std::string &prefix, uint64_t accesses,
+                                   const trace_cache_statistics &statistics) = 0;
+    virtual void reuse_distances (const std::string &prefix, const trace_reuse_distance_histogram &histogram) = 0;
+    virtual void instruction_stride (const std::string &prefix, const trace_instruction_stride &stride) = 0;
+    virtual void sampling_statistics (const std::string &func_name, uint64_t invocations,
+                                      uint64_t sampled_invocations) = 0;
+    virtual void burst_sampling_statistics (uint64_t instructions, uint64_t sampled_instructions) = 0;
+    virtual void page_footprint (const std::string &prefix, const trace_page_footprint &footprint) = 0;
+    virtual void call_stack_frame (uint32_t stack_id, uint32_t parent_id, uint64_t ip, const std::string &symbol) = 0;
+    virtual void heap_statistics (const std::string &func_name, const trace_heap_statistics &statistics) = 0;
+    virtual void heap_sample (const trace_heap_sample &sample) = 0;
+    virtual void invocation_profile (const std::string &func_name, const trace_invocation_profile &profile) = 0;
+    virtual void invocation_repeats (const std::string &func_name, uint64_t same_as_invocation, uint64_t repeats) = 0;
+    virtual void source_line_traffic (const std::string &prefix, const trace_source_line_traffic &traffic) = 0;
+    virtual void cache_line_sharing (const std::string &func_name, const trace_cache_line_sharing &sharing) = 0;
+    virtual void roofline (const std::string &prefix, const trace_roofline &roofline) = 0;
+    virtual void segment_traffic (const std::string &prefix, const trace_segment_traffic &traffic) = 0;
+    virtual void text_line (const std::string &line) = 0;
+};
+
+/** Writes the trace in the .csv text format */
+class csv_trace_encoder : public trace_encoder
+{
+public:
+    csv_trace_encoder (trace_sink &sink);
+    virtual void function_enter (const std::string &func_name);
+    virtual void function_exit (const std::string &func_name);
+    virtual void region (const std::string &prefix, const trace_region &region);
+    virtual void region_merge_error (const std::string &prefix);
+    virtual void allocation_event (const std::string &func_name, const std::string &allocator, uint64_t size,
+                                   uint64_t data_ptr, const std::string &caller, uint32_t stack_id);
+    virtual void aligned_allocation_event (const std::string &func_name, const std::string &allocator,
+                                           uint64_t boundary, uint64_t size, uint64_t data_ptr,
+                                           const std::string &caller, uint32_t stack_id);
+    virtual void reallocation_event (const std::string &func_name, const std::string &allocator,
+                                     uint64_t old_data_ptr, bool old_size_known, uint64_t old_size,
+                                     uint64_t size, uint64_t data_ptr, const std::string &caller, uint32_t stack_id);
+    virtual void free_event (const std::string &func_name, const std::string &deallocator, uint64_t data_ptr,
+                             bool size_known, uint64_t size, const std::string &caller, uint32_t stack_id);
+    virtual void outstanding_allocations (const std::vector<trace_outstanding_allocation> &allocations);
+    virtual void region_cache_statistics (const std::string &prefix, uint64_t hits, uint64_t misses);
+    virtual void allocation_accesses (const std::string &func_name, const trace_allocation_accesses &allocation);
+    virtual void cache_statistics (const std::string &prefix, uint64_t accesses,
+                                   const trace_cache_statistics &statistics);
+    virtual void reuse_distances (const std::string &prefix, const trace_reuse_distance_histogram &histogram);
+    virtual void instruction_stride (const std::string &prefix, const trace_instruction_stride &stride);
+    virtual void sampling_statistics (const std::string &func_name, uint64_t invocations, uint64_t sampled_invocations);
+    virtual void burst_sampling_statistics (uint64_t instructions, uint64_t sampled_instructions);
+    virtual void page_footprint (const std::string &prefix, const trace_page_footprint &footprint);
+    virtual void call_stack_frame (uint32_t stack_id, uint32_t parent_id, uint64_t ip, const std::string &symbol);
+    virtual void heap_statistics (const std::string &func_name, const trace_heap_statistics &statistics);
+    virtual void heap_sample (const trace_heap_sample &sample);
+    virtual void invocation_profile (const std::string &func_name, const trace_invocation_profile &profile);
+    virtual void invocation_repeats (const std::string &func_name, uint64_t same_as_invocation, uint64_t repeats);
+    virtual void source_line_traffic (const std::string &prefix, const trace_source_line_traffic &traffic);
+    virtual void cache_line_sharing (const std::string &func_name, const trace_cache_line_sharing &sharing);
+    virtual void roofline (const std::string &prefix, const trace_roofline &roofline);
+    virtual void segment_traffic (const std::string &prefix, const trace_segment_traffic &traffic);
+    virtual void text_line (const std::string &line);
+private:
+    void write_line (void);
+    void put_reuse_distance_fields (const trace_reuse_distance_histogram &histogram);
+    void put_caller_fields (const std::string &caller, uint32_t stack_id);
+
+    trace_sink &sink;
+
+    /** Used to format one line at a time, with the hex and showbase format used for all numbers in the trace */
+    std::ostringstream line;
+};
+
+/** The record types in the binary trace format */
+enum trace_record_type
+{
+    TRACE_RECORD_STRING = 1,
+    TRACE_RECORD_FUNCTION_ENTER,
+    TRACE_RECORD_FUNCTION_EXIT,
+    TRACE_RECORD_REGION,
+    TRACE_RECORD_REGION_MERGE_ERROR,
+    TRACE_RECORD_ALLOCATION,
+    TRACE_RECORD_ALIGNED_ALLOCATION,
+    TRACE_RECORD_FREE,
+    TRACE_RECORD_OUTSTANDING_ALLOCATIONS,
+    TRACE_RECORD_REGION_CACHE_STATISTICS,
+    TRACE_RECORD_TEXT_LINE,
+    TRACE_RECORD_ALLOCATION_ACCESSES,
+    TRACE_RECORD_REALLOCATION,
+    TRACE_RECORD_CACHE_STATISTICS,
+    TRACE_RECORD_REUSE_DISTANCES,
+    TRACE_RECORD_INSTRUCTION_STRIDE,
+    TRACE_RECORD_SAMPLING_STATISTICS,
+    TRACE_RECORD_BURST_SAMPLING_STATISTICS,
+    TRACE_RECORD_PAGE_FOOTPRINT,
+    TRACE_RECORD_CALL_STACK_FRAME,
+    TRACE_RECORD_HEAP_STATISTICS,
+    TRACE_RECORD_HEAP_SAMPLE,
+    TRACE_RECORD_INVOCATION_PROFILE,
+    TRACE_RECORD_INVOCATION_REPEATS,
+    TRACE_RECORD_SOURCE_LINE_TRAFFIC,
+    TRACE_RECORD_CACHE_LINE_SHARING,
+    TRACE_RECORD_ROOFLINE,
+    TRACE_RECORD_SEGMENT_TRAFFIC
+};
+
+/** The header at the start of a binary trace. The first character isn't a valid trace_record_type. */
+const char binary_trace_magic[] = "MPTRACE1";
+const size_t binary_trace_magic_length = sizeof (binary_trace_magic) - 1;
+
+/** Writes the trace in the binary format */
+class binary_trace_encoder : public trace_encoder
+{
+public:
+    binary_trace_encoder (trace_sink &sink);
+    virtual void function_enter (const std::string &func_name);
+    virtual void function_exit (const std::string &func_name);
+    virtual void region (const std::string &prefix, const trace_region &region);
+    virtual void region_merge_error (const std::string &prefix);
+    virtual void allocation_event (const std::string &func_name, const std::string &allocator, uint64_t size,
+                                   uint64_t data_ptr, const std::string &caller, uint32_t stack_id);
+    virtual void aligned_allocation_event (const std::string &func_name, const std::string &allocator,
+                                           uint64_t boundary, uint64_t size, uint64_t data_ptr,
+                                           const std::string &caller, uint32_t stack_id);
+    virtual void reallocation_event (const std::string &func_name, const std::string &allocator,
+                                     uint64_t old_data_ptr, bool old_size_known, uint64_t old_size,
+                                     uint64_t size, uint64_t data_ptr, const std::string &caller, uint32_t stack_id);
+    virtual void free_event (const std::string &func_name, const std::string &deallocator, uint64_t data_ptr,
+                             bool size_known, uint64_t size, const std::string &caller, uint32_t stack_id);
+    virtual void outstanding_allocations (const std::vector<trace_outstanding_allocation> &allocations);
+    virtual void region_cache_statistics (const std::string &prefix, uint64_t hits, uint64_t misses);
+    virtual void allocation_accesses (const std::string &func_name, const trace_allocation_accesses &allocation);
+    virtual void cache_statistics (const std::string &prefix, uint64_t accesses,
+                                   const trace_cache_statistics &statistics);
+    virtual void reuse_distances (const std::string &prefix, const trace_reuse_distance_histogram &histogram);
+    virtual void instruction_stride (const std::string &prefix, const trace_instruction_stride &stride);
+    virtual void sampling_statistics (const std::string &func_name, uint64_t invocations, uint64_t sampled_invocations);
+    virtual void burst_sampling_statistics (uint64_t instructions, uint64_t sampled_instructions);
+    virtual void page_footprint (const std::string &prefix, const trace_page_footprint &footprint);
+    virtual void call_stack_frame (uint32_t stack_id, uint32_t parent_id, uint64_t ip, const std::string &symbol);
+    virtual void heap_statistics (const std::string &func_name, const trace_heap_statistics &statistics);
+    virtual void heap_sample (const trace_heap_sample &sample);
+    virtual void invocation_profile (const std::string &func_name, const trace_invocation_profile &profile);
+    virtual void invocation_repeats (const std::string &func_name, uint64_t same_as_invocation, uint64_t repeats);
+    virtual void source_line_traffic (const std::string &prefix, const trace_source_line_traffic &traffic);
+    virtual void cache_line_sharing (const std::string &func_name, const trace_cache_line_sharing &sharing);
+    virtual void roofline (const std::string &prefix, const trace_roofline &roofline);
+    virtual void segment_traffic (const std::string &prefix, const trace_segment_traffic &traffic);
+    virtual void text_line (const std::string &line);
+private:
+    uint32_t string_index (const std::string &str);
+    void start_record (trace_record_type record_type);
+    void put_varint (uint64_t value);
+    void put_signed_varint (int64_t value);
+    void put_cache_statistics (const trace_cache_statistics &statistics);
+    void put_reuse_distance_histogram (const trace_reuse_distance_histogram &histogram);
+    void put_nonzero_counts (const uint64_t counts[], uint32_t num_counts);
+    void write_record (void);
+
+    trace_sink &sink;
+
+    /** The index of each string which has been written */
+    std::map<std::string,uint32_t> string_indices;
+
+    /** The prefix index and end address of the previous region, which the start address of a region
+     *  with the same prefix is delta encoded against */
+    uint32_t previous_region_prefix_index;
+    uint64_t previous_region_end_addr;
+
+    /** The previous heap sample, which the fields of a heap sample are delta encoded against */
+    trace_heap_sample previous_heap_sample;
+
+    /** Used to encode one record at a time. String records are written before the record which refers to them. */
+    std::vector<char> record;
+};
+
+bool decode_binary_trace (std::istream &input, trace_encoder &output, std::string &error);
+
+/** The initial value of a fingerprint, before any data has been added */
+const uint64_t trace_fingerprint_seed = 0xcbf29ce484222325ULL;
+
+uint64_t trace_fingerprint (const void *data, size_t length, uint64_t fingerprint = trace_fingerprint_seed);
+
+#endif /* TRACE_FORMAT_H_ */
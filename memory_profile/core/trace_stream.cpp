@@ -0,0 +1,241 @@
+/*
+ * @file trace_stream.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Implements the sending and receiving of the memory profile trace over a Unix-domain socket.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <algorithm>
+
+#include "trace_stream.h"
+
+/**
+ * @brief Fill in the address of a Unix-domain socket
+ * @param[in] socket_path The path name of the socket
+ * @param[out] address The address to fill in
+ * @param[out] error When returning false, describes why the path can't be used
+ * @return Returns true if the address was filled in, or false if the path is too long
+ */
+static bool get_socket_address (const std::string &socket_path, struct sockaddr_un &address, std::string &error)
+{
+    memset (&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || (socket_path.size() >= sizeof (address.sun_path)))
+    {
+        error = "invalid socket path " + socket_path;
+        return false;
+    }
+    strcpy (address.sun_path, socket_path.c_str());
+
+    return true;
+}
+
+unix_socket_trace_sink::~unix_socket_trace_sink (void)
+{
+    close ();
+}
+
+/**
+ * @brief Connect to the receiver of the trace, which must already be listening on the socket
+ * @param[in] socket_path The path name of the socket
+ * @param[out] error When returning false, describes why the connection failed
+ * @return Returns true if connected
+ */
+bool unix_socket_trace_sink::connect (const std::string &socket_path, std::string &error)
+{
+    struct sockaddr_un address;
+
+    if (!get_socket_address (socket_path, address, error))
+    {
+        return false;
+    }
+
+    socket_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd < 0)
+    {
+        error = std::string ("socket failed: ") + strerror (errno);
+        return false;
+    }
+
+    if (::connect (socket_fd, (const struct sockaddr *) &address, sizeof (address)) != 0)
+    {
+        error = "failed to connect to " + socket_path + ": " + strerror (errno);
+        close ();
+        return false;
+    }
+
+    return true;
+}
+
+void unix_socket_trace_sink::close (void)
+{
+    if (socket_fd >= 0)
+    {
+        ::close (socket_fd);
+        socket_fd = -1;
+    }
+}
+
+/**
+ * @brief Send encoded trace, waiting until the receiver has accepted all of it
+ * @details MSG_NOSIGNAL is used so that a receiver which has exited doesn't raise SIGPIPE in the profiled program.
+ * @param[in] data The encoded trace
+ * @param[in] length The number of bytes of encoded trace
+ */
+void unix_socket_trace_sink::write (const char *data, size_t length)
+{
+    while ((socket_fd >= 0) && (length > 0))
+    {
+        const ssize_t sent_bytes = send (socket_fd, data, length, MSG_NOSIGNAL);
+
+        if (sent_bytes > 0)
+        {
+            data += sent_bytes;
+            length -= sent_bytes;
+        }
+        else if ((sent_bytes < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        else
+        {
+            disconnected = true;
+            close ();
+        }
+    }
+}
+
+/**
+ * @brief Read more input from the file descriptor, blocking until some is available
+ * @return The next character, or EOF when the sender has disconnected
+ */
+fd_streambuf::int_type fd_streambuf::underflow (void)
+{
+    ssize_t read_bytes;
+
+    if (gptr() < egptr())
+    {
+        return traits_type::to_int_type (*gptr());
+    }
+
+    do
+    {
+        read_bytes = read (fd, &buffer[0], buffer.size());
+    } while ((read_bytes < 0) && (errno == EINTR));
+
+    if (read_bytes <= 0)
+    {
+        return traits_type::eof();
+    }
+    setg (&buffer[0], &buffer[0], &buffer[read_bytes]);
+
+    return traits_type::to_int_type (*gptr());
+}
+
+/**
+ * @brief Wait for input without consuming it, so the start of a stream can be inspected before it is decoded
+ * @details Only supported before anything has been read from the streambuf.
+ * @param[in] length The number of bytes to wait for
+ * @return The bytes available, which are fewer than length if the sender disconnected first
+ */
+std::string fd_streambuf::peek (size_t length)
+{
+    size_t available_bytes = egptr() - eback();
+    ssize_t read_bytes = 1;
+
+    while ((gptr() == eback()) && (available_bytes < length) && (available_bytes < buffer.size()) &&
+           ((read_bytes > 0) || ((read_bytes < 0) && (errno == EINTR))))
+    {
+        read_bytes = read (fd, &buffer[available_bytes], buffer.size() - available_bytes);
+        if (read_bytes > 0)
+        {
+            available_bytes += read_bytes;
+            setg (&buffer[0], &buffer[0], &buffer[available_bytes]);
+        }
+    }
+
+    return std::string (gptr(), std::min (length, (size_t) (egptr() - gptr())));
+}
+
+unix_socket_trace_source::~unix_socket_trace_source (void)
+{
+    if (connection_fd >= 0)
+    {
+        close (connection_fd);
+    }
+    if (listen_fd >= 0)
+    {
+        close (listen_fd);
+        unlink (path.c_str());
+    }
+}
+
+/**
+ * @brief Create the socket which the sender connects to, replacing any stale socket left at the path
+ * @param[in] socket_path The path name of the socket
+ * @param[out] error When returning false, describes why the socket couldn't be created
+ * @return Returns true if listening on the socket
+ */
+bool unix_socket_trace_source::listen (const std::string &socket_path, std::string &error)
+{
+    struct sockaddr_un address;
+
+    if (!get_socket_address (socket_path, address, error))
+    {
+        return false;
+    }
+
+    listen_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        error = std::string ("socket failed: ") + strerror (errno);
+        return false;
+    }
+
+    unlink (socket_path.c_str());
+    if (bind (listen_fd, (const struct sockaddr *) &address, sizeof (address)) != 0)
+    {
+        error = "failed to bind " + socket_path + ": " + strerror (errno);
+        close (listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    path = socket_path;
+
+    if (::listen (listen_fd, 1) != 0)
+    {
+        error = "failed to listen on " + socket_path + ": " + strerror (errno);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Wait for the sender to connect
+ * @param[out] error When returning false, describes why no connection was accepted
+ * @return Returns true if a connection was accepted, after which stream() reads the trace sent
+ */
+bool unix_socket_trace_source::accept (std::string &error)
+{
+    do
+    {
+        connection_fd = ::accept (listen_fd, NULL, NULL);
+    } while ((connection_fd < 0) && (errno == EINTR));
+
+    if (connection_fd < 0)
+    {
+        error = std::string ("accept failed: ") + strerror (errno);
+        return false;
+    }
+    input_buffer.set_fd (connection_fd);
+    input.clear ();
+
+    return true;
+}
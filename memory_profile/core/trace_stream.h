@@ -0,0 +1,84 @@
+/*
+ * @file trace_stream.h
+ * @date 16 Oct 2026
+ * @details
+ *  Streams the memory profile trace live over a Unix-domain socket, so that the memory profile of a long running
+ *  program can be watched while it runs rather than after it exits. The memory_profile Pin tool connects to the socket
+ *  when the stream_socket option is set, and writes the same trace, in either the .csv or binary format, as it would
+ *  otherwise write to the trace file. The memory_profile_viewer program listens on the socket and displays the trace
+ *  as it arrives.
+ *
+ *  The viewer listens, and the Pin tool connects, so that the viewer is started first and the Pin tool fails at
+ *  startup rather than profiling the program with nowhere to send the trace. If the viewer disconnects the rest of the
+ *  trace is discarded, and the profiled program continues.
+ *
+ *  This is independent of Pin, so that the same code is used by the memory_profile Pin tool and by the
+ *  memory_profile_viewer program.
+ */
+
+#ifndef TRACE_STREAM_H_
+#define TRACE_STREAM_H_
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "trace_format.h"
+
+/** A trace_sink which sends the encoded trace to a connected Unix-domain socket */
+class unix_socket_trace_sink : public trace_sink
+{
+public:
+    unix_socket_trace_sink (void) : socket_fd (-1), disconnected (false) {}
+    virtual ~unix_socket_trace_sink (void);
+    bool connect (const std::string &socket_path, std::string &error);
+    void close (void);
+    virtual void write (const char *data, size_t length);
+
+    /** @return Returns true if the trace has been discarded since the socket was disconnected by the receiver */
+    bool was_disconnected (void) const { return disconnected; }
+private:
+    int socket_fd;
+
+    /** Set when a send fails, after which the trace is discarded */
+    bool disconnected;
+};
+
+/** A streambuf which reads from a file descriptor, blocking until more input arrives */
+class fd_streambuf : public std::streambuf
+{
+public:
+    fd_streambuf (void) : fd (-1), buffer (64 * 1024) {}
+    void set_fd (int new_fd) { fd = new_fd; setg (&buffer[0], &buffer[0], &buffer[0]); }
+    std::string peek (size_t length);
+protected:
+    virtual int_type underflow (void);
+private:
+    int fd;
+    std::vector<char> buffer;
+};
+
+/** Listens on a Unix-domain socket for the connection from the memory_profile Pin tool, and reads the trace sent */
+class unix_socket_trace_source
+{
+public:
+    unix_socket_trace_source (void) : listen_fd (-1), connection_fd (-1), input (&input_buffer) {}
+    ~unix_socket_trace_source (void);
+    bool listen (const std::string &socket_path, std::string &error);
+    bool accept (std::string &error);
+
+    /** @return The trace sent over the accepted connection, which reaches end-of-file when the sender disconnects */
+    std::istream &stream (void) { return input; }
+
+    /** @return Up to length bytes at the start of the trace, without removing them from the stream */
+    std::string peek (size_t length) { return input_buffer.peek (length); }
+private:
+    std::string path;
+    int listen_fd;
+    int connection_fd;
+    fd_streambuf input_buffer;
+    std::istream input;
+};
+
+#endif /* TRACE_STREAM_H_ */
@@ -4,9 +4,17 @@
  * @author Chester Gillon
  * @details
  *  A demonstration of a Pin tool which instruments a program to determine the memory profile usage
- *  of a fixed set of "top-level" functions in the FFTW_example program. The information obtained is:
- *  1) When memory allocations and frees occur. Currently, only malloc(), memalign() and free() are instrumented
- *     as they are the memory allocation functions used by the FFTW_example program.
+ *  of a set of "top-level" functions. By default the top-level functions are those of the FFTW_example program,
+ *  and may be selected by name patterns using command line options. The information obtained is:
+ *  1) When memory allocations and frees occur. The C library allocation functions, the C++ operator new and
+ *     operator delete variants and mmap()/munmap()/mremap() are instrumented from the allocator_functions[] table.
+ *     The caller of each allocator function is symbolised from a cache of the routines of each image, built at image
+ *     load. When the allocation_stacks option is set the call stack of each allocation is also captured, interned in
+ *     a trie so that each event only carries a stack ID, and the table of call stacks is output at exit.
+ *     The live heap, i.e. the bytes and blocks of the outstanding allocations, is maintained by the allocator hooks.
+ *     On exit from each top-level function the live heap at entry, its high-water mark and the live heap at exit are
+ *     output. When the heap_timeline_interval option is set a time series of the live heap is also output, sampled on
+ *     a clock of the instructions executed.
  *
  *  2) The unique regions of memory which are read/written by each top level function. For each region
  *     which is read or written the following is collected:
@@ -23,9 +31,90 @@
  *        - If both cache_line_increments and cache_line_decrements the region was accessed with non-uniform
  *          address sequence.
  *
- *  The FFTW_example is single threaded so the memory profile is maintained for the whole process.
- *  This program could be expanded with Pin thread-local-storage to maintain the memory profile for
- *  individual threads as required.
+ *  A memory operand which is both read and written, such as the destination of add [mem],reg, is instrumented with one
+ *  analysis call which records it once as a read-modify-write access. The read-modify-write accesses are merged into
+ *  the read and write memory profiles which are output, and are also output as a separate memory read-modify-write
+ *  memory profile which shows the regions where reads and writes overlap.
+ *
+ *  Top-level functions may be nested. A nested top-level function suspends recording of the memory profile of the
+ *  enclosing top-level function, whose exclusive memory profile then doesn't include the accesses of the nested function.
+ *  The inclusive memory profile, which does include the accesses of nested functions, is also output.
+ *
+ *  When the allocation_report option is set, each memory access is also attributed to the allocation which contains
+ *  it, using an index of the outstanding allocations. On exit from a top-level function the accesses made to each
+ *  allocation are output, ordered by the number of bytes accessed, to show which buffers dominate the bandwidth.
+ *
+ *  When the cache_simulation option is set, each memory access is also simulated in a configurable hierarchy of
+ *  L1D, L2 and LLC caches. The misses and writebacks of each level are output for each region, and totalled for
+ *  each top-level function.
+ *
+ *  When the reuse_distance option is set, the reuse distance of each cache line access is measured as the number of
+ *  distinct cache lines accessed since the previous access to the line. Log2 histograms of the reuse distances are
+ *  output for each region and top-level function, from which the hit rate of any size of cache can be predicted.
+ *
+ *  When the stride_analysis option is set, the stride between successive addresses accessed by each memory operand of
+ *  each static instruction is learnt, and the access pattern of the instruction classified as sequential, fixed stride,
+ *  power-of-two stride or random. The accesses to each region are counted by the access pattern of the accessing
+ *  instruction, and at exit the stride learnt for each instruction is output.
+ *
+ *  When the instruction_traffic option is set, the bytes read and written and the distinct cache lines touched are
+ *  counted for each memory operand of each static instruction. The counters are allocated when the instruction is
+ *  instrumented, and each thread counts in its own copy so the analysis doesn't lock. At exit the counters are rolled
+ *  up to the source line of each instruction and output in order of decreasing traffic, to find the code responsible
+ *  for the traffic to a region.
+ *
+ *  When the false_sharing option is set, each write is recorded in a shadow table of cache lines holding the last
+ *  thread to write each line and the bytes it wrote. A write to a line last written by another thread is counted as
+ *  false sharing when the bytes don't overlap, or true sharing when they do, against the top-level function,
+ *  instruction and allocation. Each table entry has its own spin lock, so threads only contend when writing lines in
+ *  the same entry. When the buffered option is also set the writes of each thread are recorded a buffer at a time,
+ *  which under-counts the sharing between threads which interleave finer than a buffer.
+ *
+ *  When the roofline option is set, the floating point add, subtract, multiply, divide and fused multiply-add
+ *  operations are counted by vector width. The operations of each basic block are counted when it is instrumented,
+ *  so the inlined analysis only adds the counts of the block to the thread. At exit from each invocation of a
+ *  top-level function the operations are output with the bytes read and written and the operational intensity, which
+ *  places the function on a roofline model.
+ *
+ *  When the segments option is set, each memory operand is classified when it is instrumented as a stack access, from
+ *  its use of the stack pointer, a global access, from instruction pointer relative or absolute addressing within an
+ *  image, or otherwise dynamic. Stack and global accesses are only counted by inlined analysis, and aren't recorded in
+ *  the memory profile or by the other analyses, which avoids the cost of analysing the frequent stack accesses. At exit
+ *  from each invocation of a top-level function the traffic of each class is output.
+ *
+ *  When the page_footprint option is set, the distinct 4K and 2M pages touched are counted for each top-level function,
+ *  along with how densely the pages are used, and the data TLB misses for each page size are estimated by simulating
+ *  a TLB for each thread. This shows if the memory would be suitable for backing by huge pages.
+ *
+ *  For long running programs the accesses may be sampled. The sample_every and sample_first options select which
+ *  invocations of each top-level function are profiled, and the sample_burst_instructions option only profiles
+ *  a burst of instructions at the start of each sample_burst_period instructions. While accesses aren't sampled, code
+ *  which hasn't been executed during a sample runs without instrumentation for memory accesses, and only the routines
+ *  containing that code are re-instrumented when a sample starts. At exit the number of invocations and instructions
+ *  which were sampled is output, to allow the totals to be estimated.
+ *
+ *  When the access_trace option is set, the memory accesses made while top-level functions are active are also written
+ *  to a raw access trace, along with the entries to and exits from the top-level functions. The memory_profile_replay
+ *  program replays the raw access trace through the same memory profile and analyses at native speed, so that the
+ *  analyses can be repeated with different parameters without re-running the program under Pin.
+ *
+ *  When the stream_socket option is set, the trace is streamed live over a Unix-domain socket instead of being written
+ *  to the trace file, and the memory_profile_viewer program displays the trace as it arrives. The output for each
+ *  top-level invocation is sent when the invocation completes, and the heap_timeline_interval option adds periodic
+ *  samples of the live heap, so the memory behaviour of a long running program can be watched as it evolves and the
+ *  program stopped early, without the trace being first written to a large file.
+ *
+ *  When the aggregate_invocations option is set, an invocation of a top-level function whose memory profile is the same
+ *  as that of the previous invocation output isn't output, and is instead counted in a record of the number of repeats
+ *  of the previous invocation. When most of the regions of a memory profile are the same as the last memory
+ *  profile output in full, only the changed regions are output. Memory profiles are compared by fingerprints of their
+ *  regions. This reduces the output for loops which call top-level functions many times, and makes changes in
+ *  behaviour between invocations stand out.
+ *
+ *  The memory profile is maintained for each thread in Pin thread-local-storage, so that threads record memory accesses
+ *  without locking. A top-level function is active for the whole process, so that accesses made by worker threads
+ *  on behalf of the top-level function are profiled. On exit from the top-level function the profiles of the threads
+ *  are combined, and optionally also output for each thread.
  */
 
 #include <unistd.h>
@@ -37,632 +126,4693 @@
 #include <string>
 #include <fstream>
 #include <map>
+#include <set>
+#include <sstream>
+#include <algorithm>
+
+#include "core/trace_format.h"
+#include "core/cache_simulator.h"
+#include "core/reuse_distance.h"
+#include "core/stride_detector.h"
+#include "core/page_footprint.h"
+#include "core/instruction_traffic.h"
+#include "core/cache_line_sharing.h"
+#include "core/fp_operations.h"
+#include "core/call_stacks.h"
+#include "core/memory_regions.h"
+#include "core/access_trace.h"
+#include "core/trace_stream.h"
 
 /** Command line options */
 KNOB<string> trace_filename(KNOB_MODE_WRITEONCE, "pintool",
     "o", "memory_profile.csv", "specify trace file name");
 
-/** Text .csv file the trace is written to */
+KNOB<BOOL> buffered_accesses(KNOB_MODE_WRITEONCE, "pintool",
+    "buffered", "0", "buffer memory accesses and record them in the memory profile in batches");
+
+KNOB<BOOL> instrument_only_top_level(KNOB_MODE_WRITEONCE, "pintool",
+    "instrument_only_top_level", "0",
+    "only instrument memory accesses while a top-level function is active, re-instrumenting on entry the routines run "
+    "outside of top-level functions. Only helps when top-level functions are called rarely");
+
+KNOB<BOOL> per_thread_profiles(KNOB_MODE_WRITEONCE, "pintool",
+    "per_thread", "0", "output the memory profile for each thread, in addition to the combined memory profile");
+
+KNOB<BOOL> aggregate_invocations(KNOB_MODE_WRITEONCE, "pintool",
+    "aggregate_invocations", "0",
+    "output a count of repeats for invocations of a top-level function with the same memory profile as the previous "
+    "invocation, and only the changed regions for memory profiles which are mostly the same as the last full profile");
+
+KNOB<string> top_level_function_patterns(KNOB_MODE_APPEND, "pintool",
+    "top_level_function", "",
+    "[image_pattern:]function_pattern of a top-level function to profile, where the patterns may contain the *, ? and [] "
+    "wildcards and image_pattern is matched against the image file name. May be repeated. "
+    "If neither this or -top_level_functions_file are specified, the functions in the FFTW_example program are profiled");
+
+KNOB<string> top_level_functions_filename(KNOB_MODE_WRITEONCE, "pintool",
+    "top_level_functions_file", "",
+    "file containing top-level function patterns, one per line in the same form as -top_level_function. "
+    "Blank lines and lines starting with # are ignored");
+
+KNOB<BOOL> binary_output(KNOB_MODE_WRITEONCE, "pintool",
+    "binary_output", "0",
+    "write the trace in a compact binary format, which memory_profile_convert converts to the .csv format");
+
+KNOB<string> stream_socket_path(KNOB_MODE_WRITEONCE, "pintool",
+    "stream_socket", "",
+    "stream the trace live to the memory_profile_viewer program listening on this Unix-domain socket, "
+    "instead of writing the trace file");
+
+KNOB<string> access_trace_filename(KNOB_MODE_WRITEONCE, "pintool",
+    "access_trace", "",
+    "record the memory accesses made while top-level functions are active to this raw access trace file, "
+    "which memory_profile_replay replays through the analyses with different parameters");
+
+KNOB<BOOL> allocation_report(KNOB_MODE_WRITEONCE, "pintool",
+    "allocation_report", "0",
+    "attribute memory accesses to the outstanding allocations, and output the accesses to each allocation "
+    "on exit from a top-level function");
+
+KNOB<BOOL> allocation_stacks(KNOB_MODE_WRITEONCE, "pintool",
+    "allocation_stacks", "0",
+    "capture the call stack of each allocator function call, and output the table of call stacks at exit");
+
+KNOB<UINT32> allocation_stack_depth(KNOB_MODE_WRITEONCE, "pintool",
+    "allocation_stack_depth", "32", "the maximum number of frames captured in the call stack of an allocation");
+
+KNOB<UINT64> heap_timeline_interval(KNOB_MODE_WRITEONCE, "pintool",
+    "heap_timeline_interval", "0",
+    "sample the live heap every N instructions executed by all threads, or zero to not output a time series");
+
+KNOB<BOOL> cache_simulation(KNOB_MODE_WRITEONCE, "pintool",
+    "cache_simulation", "0",
+    "simulate the memory accesses in a cache hierarchy of L1D, L2 and LLC, and output the misses and writebacks "
+    "of each level for each region and top-level function");
+
+KNOB<string> cache_l1d_config(KNOB_MODE_WRITEONCE, "pintool",
+    "cache_l1d", "32K:8", "size:ways of the simulated L1D cache, where the size may have a K, M or G suffix");
+
+KNOB<string> cache_l2_config(KNOB_MODE_WRITEONCE, "pintool",
+    "cache_l2", "256K:8", "size:ways of the simulated L2 cache, where the size may have a K, M or G suffix");
+
+KNOB<string> cache_llc_config(KNOB_MODE_WRITEONCE, "pintool",
+    "cache_llc", "8M:16", "size:ways of the simulated last level cache, where the size may have a K, M or G suffix");
+
+KNOB<UINT32> cache_line_size_config(KNOB_MODE_WRITEONCE, "pintool",
+    "cache_line_size", "64",
+    "cache line size in bytes of all levels of the simulated cache hierarchy, and for the reuse distances, "
+    "access patterns and page footprints");
+
+KNOB<string> cache_replacement(KNOB_MODE_WRITEONCE, "pintool",
+    "cache_replacement", "lru", "replacement policy of the simulated caches, either lru or plru for tree pseudo-LRU");
+
+KNOB<BOOL> cache_next_line_prefetch(KNOB_MODE_WRITEONCE, "pintool",
+    "cache_next_line_prefetch", "0", "simulate a next line prefetch on each L1D miss");
+
+KNOB<BOOL> reuse_distance(KNOB_MODE_WRITEONCE, "pintool",
+    "reuse_distance", "0",
+    "measure the reuse distance of each cache line access, and output log2 histograms of the reuse distances "
+    "for each region and top-level function");
+
+KNOB<BOOL> stride_analysis(KNOB_MODE_WRITEONCE, "pintool",
+    "stride_analysis", "0",
+    "learn the stride of the addresses accessed by each instruction, and classify the accesses to each region "
+    "by the access pattern of the accessing instruction");
+
+KNOB<BOOL> page_footprint_knob(KNOB_MODE_WRITEONCE, "pintool",
+    "page_footprint", "0",
+    "count the distinct 4K and 2M pages touched by each top-level function, and estimate the data TLB misses "
+    "for each page size");
+
+KNOB<BOOL> instruction_traffic_knob(KNOB_MODE_WRITEONCE, "pintool",
+    "instruction_traffic", "0",
+    "count the bytes accessed and distinct cache lines touched by each instruction, and output them at exit rolled up "
+    "to source lines in order of decreasing traffic");
+
+KNOB<BOOL> false_sharing_knob(KNOB_MODE_WRITEONCE, "pintool",
+    "false_sharing", "0",
+    "detect writes to cache lines last written by another thread, as false sharing when different bytes were written "
+    "or true sharing when the same bytes were written, attributed to top-level function, instruction and allocation");
+
+KNOB<BOOL> roofline_knob(KNOB_MODE_WRITEONCE, "pintool",
+    "roofline", "0",
+    "count the floating point operations of each top-level function by vector width, and output them at exit from "
+    "each invocation with the bytes read and written and the operational intensity");
+
+KNOB<BOOL> segments_knob(KNOB_MODE_WRITEONCE, "pintool",
+    "segments", "0",
+    "classify memory operands as stack, global or dynamic when instrumented, and only count the accesses to the stack "
+    "and globals rather than recording them in the memory profile. The traffic of each class is output at exit from "
+    "each invocation of a top-level function.");
+
+KNOB<BOOL> frame_pointer_knob(KNOB_MODE_WRITEONCE, "pintool",
+    "frame_pointer", "0",
+    "when the segments knob is set, also classify accesses addressed from the frame pointer register as stack "
+    "accesses, which is only valid for code compiled with frame pointers");
+
+KNOB<UINT64> false_sharing_table_lines(KNOB_MODE_WRITEONCE, "pintool",
+    "false_sharing_table", "1048576",
+    "entries in the shadow table of the cache lines written when the false_sharing knob is set, a power of two");
+
+KNOB<string> dtlb_4k_config(KNOB_MODE_WRITEONCE, "pintool",
+    "dtlb_4k", "64:4", "entries:ways of the simulated data TLB for 4K pages");
+
+KNOB<string> dtlb_2m_config(KNOB_MODE_WRITEONCE, "pintool",
+    "dtlb_2m", "32:4", "entries:ways of the simulated data TLB for 2M pages");
+
+KNOB<UINT32> sample_every(KNOB_MODE_WRITEONCE, "pintool",
+    "sample_every", "1", "only profile every Nth invocation of each top-level function");
+
+KNOB<UINT32> sample_first(KNOB_MODE_WRITEONCE, "pintool",
+    "sample_first", "0",
+    "only profile the first K sampled invocations of each top-level function, or zero to profile all sampled invocations");
+
+KNOB<UINT64> sample_burst_instructions(KNOB_MODE_WRITEONCE, "pintool",
+    "sample_burst_instructions", "0",
+    "only profile the accesses in a burst of this many instructions at the start of each sample_burst_period, "
+    "or zero to profile all instructions");
+
+KNOB<UINT64> sample_burst_period(KNOB_MODE_WRITEONCE, "pintool",
+    "sample_burst_period", "10000000", "the period in instructions executed by all threads of the sample bursts");
+
+/** The file the trace is written to, either .csv text or binary */
 std::ofstream trace_file;
 
-/** The top-level functions in the FFTW_example program which have memory profiles maintained */
+/** A pattern which selects top-level functions by name, optionally only in images with matching file names */
+struct top_level_function_pattern
+{
+    /** Pattern for the file name of the image, or empty to match all images */
+    std::string image_pattern;
+    /** Pattern for the function name */
+    std::string function_pattern;
+};
+
+/** The patterns for top-level functions which contain wildcards, which have to be tested against each routine */
+static std::vector<top_level_function_pattern> top_level_function_wildcard_patterns;
+
+/** The patterns for top-level functions which are plain function names, indexed by function name to avoid
+ *  testing every pattern against each routine. The data is the image patterns for the function name. */
+static std::multimap<std::string,std::string> top_level_function_names_index;
+
+/** The default top-level functions in the FFTW_example program, used when no patterns are specified */
+static const char *const default_top_level_functions[] =
+{
+    "fft_initialise",
+    "set_fft_data",
+    "copy_input_data",
+    "fft_execute",
+    "fft_free"
+};
+
+/** The top-level functions which have memory profiles maintained */
 static std::vector<std::string> top_level_func_names;
 
-/* The index into top_level_func_names[] for the top level function which is currently executing,
+/* The index into top_level_func_names[] for the innermost top level function which is currently executing,
  * or -1 if no top level function is currently executing.
  * Memory is only profiled when a top level function is executing
  */
 static INT32 active_top_level_func_index = -1;
 
-/** The allocation size requested at entry to malloc, to correlate with the allocated address at exit from malloc */
-static ADDRINT malloc_requested_size = 0;
+/** The index into top_level_func_names[] for the innermost top-level function while its accesses are sampled,
+ *  or -1 if no top-level function is executing or its accesses are not sampled.
+ *  Memory accesses are only recorded when this isn't -1. */
+static INT32 sampled_top_level_func_index = -1;
+
+/** The number of calls of each top-level function which started an activation, indexed as top_level_func_names[] */
+static std::vector<UINT64> top_level_func_invocations;
 
-/** Return Instruction Pointer at entry to malloc */
-static ADDRINT malloc_return_ip;
+/** The number of invocations of each top-level function which were sampled, indexed as top_level_func_names[] */
+static std::vector<UINT64> top_level_func_sampled_invocations;
 
-/** The alignment requested at entry to memalign, to correlate with the allocated address at exit from memalign */
-static ADDRINT memalign_boundary = 0;
+/** The memory profiles which have been output for a top-level function, used to aggregate invocations when the
+ *  aggregate_invocations knob is set */
+struct invocation_aggregate
+{
+    /** Set once a memory profile has been output for the top-level function */
+    bool profile_output;
+    /** The last invocation which a memory profile was output for, and the fingerprint of the whole memory profile */
+    UINT64 last_invocation;
+    uint64_t last_fingerprint;
+    /** The number of invocations since last_invocation with the same memory profile, which haven't been output */
+    UINT64 repeats;
+    /** The last invocation which a full memory profile was output for, and the sorted fingerprints of its regions
+     *  which the regions of later invocations are compared against */
+    UINT64 reference_invocation;
+    std::vector<uint64_t> reference_fingerprints;
+};
 
-/** The allocation size requested at entry to memalign, to correlate with the allocated address at exit from memalign */
-static ADDRINT memalign_requested_size = 0;
+/** Set from the aggregate_invocations knob */
+static bool aggregate_invocations_enabled = false;
 
-/** Return Instruction Pointer at entry to memalign */
-static ADDRINT memalign_return_ip;
+/** The invocations of each top-level function which have been aggregated, indexed as top_level_func_names[] */
+static std::vector<invocation_aggregate> top_level_func_aggregates;
 
-/** Records memory allocations, which are then removed when freed.
- *  Used to report memory which is allocated but not freed upon program completion.
- *  Key is address of allocation, data is size
- */
-static std::map<ADDRINT,ADDRINT> outstanding_allocations;
+/** Incremented on each entry to a top-level function, to give a unique number to each activation */
+static UINT32 top_level_invocation_count = 0;
 
-/** Used to record the memory profile for either read or writes */
-class memory_regions_usage
+/** The maximum depth of nested top-level functions which are profiled. Deeper top-level functions are treated as part
+ *  of the enclosing top-level function. */
+static const UINT32 max_activation_depth = 16;
+
+/** The start addresses of the top-level functions which have been instrumented.
+ *  When the instrument_only_top_level knob is set or sampling is enabled, memory accesses in the top-level functions
+ *  are always instrumented, since the trace at the entry to a top-level function is already executing when
+ *  re-instrumentation is requested. */
+static std::set<ADDRINT> top_level_func_addrs;
+
+/** Set when the sampling knobs select a subset of the invocations or instructions to profile */
+static bool sampling_enabled = false;
+
+/** Set when the sample_burst_instructions knob is non-zero */
+static bool burst_sampling_enabled = false;
+
+/** Set during the burst at the start of each sample_burst_period, when the accesses are sampled.
+ *  Always set when burst_sampling_enabled is clear. */
+static bool in_sample_burst = true;
+
+/** The number of instructions in the current burst or gap between bursts, and the number remaining.
+ *  Decremented by all threads without locking, so the length of a burst is approximate. */
+static INT64 burst_phase_instructions = 0;
+static INT64 burst_phase_remaining = 0;
+
+/** The number of instructions in completed bursts and gaps, and the number of those in bursts */
+static UINT64 burst_total_instructions = 0;
+static UINT64 burst_sampled_instructions = 0;
+
+/** Serialises changes to which accesses are sampled, between top-level function entry and exit and the end of
+ *  each burst */
+static PIN_LOCK sampling_lock;
+
+/** When the instrument_only_top_level knob is set or sampling is enabled, determines if instrumentation for memory
+ *  accesses is inserted.
+ *  Only changed when the sampled top-level function changes. When set, the code in uninstrumented_routines is
+ *  removed from the code cache so that it is re-instrumented as it is next executed. */
+static bool memory_accesses_instrumented = true;
+
+/** The address ranges of the routines, indexed by start address, containing code which was instrumented without its
+ *  memory accesses while memory_accesses_instrumented was clear. Only this code needs to be re-instrumented when
+ *  memory_accesses_instrumented is set, rather than the whole code cache. Code instrumented while
+ *  memory_accesses_instrumented is set is left in place when it is cleared, since the inlined analysis checks if the
+ *  accesses are sampled. */
+static std::map<ADDRINT,ADDRINT> uninstrumented_routines;
+
+/** Serialises additions to uninstrumented_routines by instrumentation with their removal when memory accesses are
+ *  sampled */
+static PIN_LOCK uninstrumented_routines_lock;
+
+/** One memory allocation made while a top-level function was active */
+struct allocation_info
+{
+    /** The address of the allocation */
+    ADDRINT data_ptr;
+    /** The size of the allocation */
+    ADDRINT size;
+    /** Unique number for the allocation, so that accesses can be attributed to an allocation after it has been freed */
+    UINT64 allocation_id;
+    /** Index into top_level_func_names[] for the top-level function which made the allocation */
+    UINT32 allocated_in_func_index;
+    /** Return Instruction Pointer of the call of the memory allocation function */
+    ADDRINT caller_ip;
+    /** The call stack of the allocation in allocation_call_stacks, or empty_call_stack_id if not captured */
+    UINT32 stack_id;
+};
+
+/**
+ * @brief Index of the outstanding memory allocations, which allows the allocation containing an address to be found
+ * @details The allocations don't overlap, so are held in an array sorted by address which is binary searched.
+ *          As with the memory regions an array is used rather than a tree, since lookups are much more frequent
+ *          than allocations.
+ */
+class allocation_index
 {
 public:
-    void clear (void);
-    void display (const std::string &prefix);
-    void record_access (ADDRINT memory_addr, UINT32 bytes_accessed);
+    allocation_index (void) : total_size (0) {}
+    void insert (const allocation_info &allocation);
+    bool erase (const ADDRINT data_ptr, ADDRINT &size);
+    bool erase_range (const ADDRINT start_addr, const ADDRINT length);
+    const allocation_info *find (const ADDRINT addr, ADDRINT &interval_start, ADDRINT &interval_end) const;
 
-    memory_regions_usage() {};
+    /** @return The outstanding allocations, sorted by address */
+    const std::vector<allocation_info> &allocations (void) const
+    {
+        return sorted_allocations;
+    }
+
+    /** @return The total size of the outstanding allocations */
+    UINT64 live_bytes (void) const
+    {
+        return total_size;
+    }
 private:
-    static const UINT32 max_mem_access_size = 64;
-
-    /** The information maintained for each non-consecutive memory region */
-    struct region_info
-    {
-        /** The end address of the region */
-        UINT64 region_end_addr;
-        /** The total number of bytes which have been accessed in the region */
-        UINT64 total_bytes;
-        /** Count of the number of times the region has been extended to cover a incrementing cache line */
-        UINT32 cache_line_increments;
-        /** Count of the number of times the region has been extended to cover a decrementing cache line */
-        UINT32 cache_line_decrements;
-        /** Count of total instruction memory accesses to the region, indexed by the number of bytes in each access.
-         *  Index zero is used for sizes outside of the expected range. */
-        UINT64 mem_access_size_counts[max_mem_access_size + 1];
-    };
+    std::vector<allocation_info> sorted_allocations;
 
-    /** Which memory regions have been accessed.
-     *  Key is the start address, data is the region information
+    /** The total size of sorted_allocations[] */
+    UINT64 total_size;
+
+    /**
+     * @brief Find the first allocation with an address greater than an address
+     * @param[in] addr The address to search for
+     * @return The index of the allocation, or sorted_allocations.size() if no allocation starts after addr
      */
-    std::map<ADDRINT,region_info> memory_regions;
-    typedef std::map<ADDRINT,region_info>::iterator region_iter;
+    inline UINT32 upper_bound_allocation_index (const ADDRINT addr) const
+    {
+        UINT32 low = 0;
+        UINT32 high = sorted_allocations.size();
+
+        while (low < high)
+        {
+            const UINT32 mid = low + ((high - low) / 2);
+
+            if (sorted_allocations[mid].data_ptr > addr)
+            {
+                high = mid;
+            }
+            else
+            {
+                low = mid + 1;
+            }
+        }
+
+        return low;
+    }
+};
+
+/** How an allocator function changes the outstanding allocations */
+enum allocator_action
+{
+    /** Returns a new allocation */
+    ALLOCATOR_ALLOCATE,
+    /** Returns a new allocation with a requested alignment */
+    ALLOCATOR_ALIGNED_ALLOCATE,
+    /** Stores a new allocation with a requested alignment through a pointer argument, and returns zero on success */
+    ALLOCATOR_POSIX_MEMALIGN,
+    /** Returns an allocation which replaces an existing allocation */
+    ALLOCATOR_REALLOCATE,
+    /** Frees an allocation */
+    ALLOCATOR_FREE,
+    /** Unmaps an address range, which may be part of an allocation */
+    ALLOCATOR_UNMAP
+};
+
+/** Describes the arguments and result of one allocator function which is instrumented */
+struct allocator_function
+{
+    /** The symbol name of the function */
+    const char *symbol_name;
+    /** The name of the function in the trace */
+    const char *trace_name;
+    /** How the function changes the outstanding allocations */
+    allocator_action action;
+    /** Index of the argument for the size in bytes, or of each element when count_arg is used. -1 if none. */
+    INT32 size_arg;
+    /** Index of the argument for the number of elements which the size is multiplied by, or -1 if none */
+    INT32 count_arg;
+    /** Index of the argument for the alignment, or -1 if none */
+    INT32 alignment_arg;
+    /** Index of the argument for the existing allocation, or for ALLOCATOR_POSIX_MEMALIGN where the new allocation
+     *  is stored. -1 if none. */
+    INT32 ptr_arg;
+    /** The return value when the function fails */
+    ADDRINT failure_value;
+};
+
+/** The maximum number of arguments of an allocator function which are used */
+static const UINT32 max_allocator_args = 3;
+
+/** The return value of mmap() and mremap() on failure */
+static const ADDRINT map_failed = ~(ADDRINT) 0;
+
+/** The allocator functions which are instrumented in each image, in the C library, the C++ library (using the Itanium
+ *  mangled names of the 64-bit operators) and any other image which defines them */
+static const allocator_function allocator_functions[] =
+{
+    /* symbol_name                    trace_name           action                     size count align ptr failure */
+    {"malloc",                        "malloc",            ALLOCATOR_ALLOCATE,          0,  -1,  -1,  -1, 0},
+    {"calloc",                        "calloc",            ALLOCATOR_ALLOCATE,          1,   0,  -1,  -1, 0},
+    {"valloc",                        "valloc",            ALLOCATOR_ALLOCATE,          0,  -1,  -1,  -1, 0},
+    {"pvalloc",                       "pvalloc",           ALLOCATOR_ALLOCATE,          0,  -1,  -1,  -1, 0},
+    {"memalign",                      "memalign",          ALLOCATOR_ALIGNED_ALLOCATE,  1,  -1,   0,  -1, 0},
+    {"aligned_alloc",                 "aligned_alloc",     ALLOCATOR_ALIGNED_ALLOCATE,  1,  -1,   0,  -1, 0},
+    {"posix_memalign",                "posix_memalign",    ALLOCATOR_POSIX_MEMALIGN,    2,  -1,   1,   0, 0},
+    {"realloc",                       "realloc",           ALLOCATOR_REALLOCATE,        1,  -1,  -1,   0, 0},
+    {"reallocarray",                  "reallocarray",      ALLOCATOR_REALLOCATE,        2,   1,  -1,   0, 0},
+    {"free",                          "free",              ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"cfree",                         "cfree",             ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_Znwm",                         "operator new",      ALLOCATOR_ALLOCATE,          0,  -1,  -1,  -1, 0},
+    {"_Znam",                         "operator new[]",    ALLOCATOR_ALLOCATE,          0,  -1,  -1,  -1, 0},
+    {"_ZnwmRKSt9nothrow_t",           "operator new",      ALLOCATOR_ALLOCATE,          0,  -1,  -1,  -1, 0},
+    {"_ZnamRKSt9nothrow_t",           "operator new[]",    ALLOCATOR_ALLOCATE,          0,  -1,  -1,  -1, 0},
+    {"_ZnwmSt11align_val_t",          "operator new",      ALLOCATOR_ALIGNED_ALLOCATE,  0,  -1,   1,  -1, 0},
+    {"_ZnamSt11align_val_t",          "operator new[]",    ALLOCATOR_ALIGNED_ALLOCATE,  0,  -1,   1,  -1, 0},
+    {"_ZnwmSt11align_val_tRKSt9nothrow_t", "operator new", ALLOCATOR_ALIGNED_ALLOCATE,  0,  -1,   1,  -1, 0},
+    {"_ZnamSt11align_val_tRKSt9nothrow_t", "operator new[]", ALLOCATOR_ALIGNED_ALLOCATE, 0, -1,   1,  -1, 0},
+    {"_ZdlPv",                        "operator delete",   ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdaPv",                        "operator delete[]", ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdlPvm",                       "operator delete",   ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdaPvm",                       "operator delete[]", ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdlPvRKSt9nothrow_t",          "operator delete",   ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdaPvRKSt9nothrow_t",          "operator delete[]", ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdlPvSt11align_val_t",         "operator delete",   ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdaPvSt11align_val_t",         "operator delete[]", ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdlPvmSt11align_val_t",        "operator delete",   ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"_ZdaPvmSt11align_val_t",        "operator delete[]", ALLOCATOR_FREE,             -1,  -1,  -1,   0, 0},
+    {"mmap",                          "mmap",              ALLOCATOR_ALLOCATE,          1,  -1,  -1,  -1, map_failed},
+    {"mmap64",                        "mmap",              ALLOCATOR_ALLOCATE,          1,  -1,  -1,  -1, map_failed},
+    {"mremap",                        "mremap",            ALLOCATOR_REALLOCATE,        2,  -1,  -1,   0, map_failed},
+    {"munmap",                        "munmap",            ALLOCATOR_UNMAP,             1,  -1,  -1,   0, 0}
+};
+
+static const UINT32 num_allocator_functions = sizeof (allocator_functions) / sizeof (allocator_functions[0]);
+
+/** Records memory allocations, which are then removed when freed.
+ *  Used to report memory which is allocated but not freed upon program completion, and to attribute memory accesses
+ *  to allocations. */
+static allocation_index outstanding_allocations;
+
+/** Serialises output to trace_output and updates of outstanding_allocations by different threads */
+static PIN_LOCK output_lock;
+
+/** Taken for writing when outstanding_allocations is modified, and for reading when memory access analysis searches
+ *  outstanding_allocations. Writers also hold output_lock. */
+static PIN_RWMUTEX outstanding_allocations_lock;
+
+/** Incremented each time outstanding_allocations is modified, to invalidate the allocations cached by each thread */
+static UINT32 outstanding_allocations_generation = 0;
+
+/*
+ * The values of the knobs which are tested by instrumentation and analysis routines. These are copied from the knobs
+ * at start-up, since reading the value of a knob is too slow for the analysis of each memory access.
+ */
+/** Set from the allocation_report knob */
+static bool allocation_report_enabled = false;
+
+/** Set from the allocation_stacks knob */
+static bool allocation_stacks_enabled = false;
+
+/** Set from the heap_timeline_interval knob */
+static bool heap_timeline_enabled = false;
+
+/** Set from the cache_simulation knob */
+static bool cache_simulation_enabled = false;
+
+/** Set from the reuse_distance knob */
+static bool reuse_distance_enabled = false;
+
+/** Set from the stride_analysis knob */
+static bool stride_analysis_enabled = false;
+
+/** Set from the page_footprint knob */
+static bool page_footprint_enabled = false;
+
+/** Set from the instruction_traffic knob */
+static bool instruction_traffic_enabled = false;
+
+/** Set from the false_sharing knob */
+static bool false_sharing_enabled = false;
+
+/** Set from the roofline knob */
+static bool roofline_enabled = false;
+
+/** Set from the segments knob */
+static bool segments_enabled = false;
+
+/** Set from the frame_pointer knob */
+static bool frame_pointer_stack = false;
+
+/** Set from the cache_line_size knob */
+static UINT32 cache_line_size = 0;
+
+/** Set from the access_trace knob */
+static bool access_trace_enabled = false;
+
+/** The maximum value of the allocation_stack_depth knob */
+static const UINT32 max_allocation_stack_depth = 256;
+
+/** The clock for the time series of the live heap, which counts the instructions executed by all threads when
+ *  heap_timeline_enabled is set. Updated without locking, so is approximate when threads run concurrently. */
+static UINT64 heap_timeline_instructions = 0;
+
+/** The value of heap_timeline_instructions at which the next sample of the live heap is due.
+ *  Protected by output_lock. */
+static UINT64 heap_timeline_next_sample = 0;
+
+/** The live heap at the previous change, and the high-water mark since the previous sample.
+ *  Protected by output_lock. */
+static trace_heap_sample heap_timeline_current;
+
+/** Set when the live heap has changed since the previous sample. Protected by output_lock. */
+static bool heap_timeline_changed = false;
+
+/** The name of the routine containing each address in the loaded images, used to symbolise the callers of allocator
+ *  functions without a slow symbol lookup for each event. Protected by output_lock. */
+static symbol_cache routine_symbols;
+
+/** The call stacks of allocations, when the allocation_stacks knob is set. Protected by output_lock. */
+static call_stack_trie allocation_call_stacks;
+
+/** The name of the routine of the innermost frame of each call stack in allocation_call_stacks, indexed by stack ID.
+ *  Symbolised when the call stack is interned, since the image may be unloaded before the call stacks are output. */
+static std::vector<std::string> allocation_call_stack_symbols;
+
+/** The configuration of the cache hierarchy simulated for each thread, from the cache knobs */
+static cache_config cache_simulation_config;
+
+/** Records the last thread to write each cache line, when the false_sharing knob is set. Shared by all threads. */
+static cache_line_sharing_detector shared_lines;
+
+/** The number of entries and associativity of the data TLB simulated for each page size, from the dtlb knobs */
+static UINT64 tlb_entries[trace_num_page_sizes];
+static UINT32 tlb_ways[trace_num_page_sizes];
+
+/** Used to allocate allocation_info.allocation_id */
+static UINT64 next_allocation_id = 0;
+
+/**
+ * @brief A trace_sink which passes the encoded trace through a ring buffer to a Pin internal thread which writes
+ *        the trace file or stream socket, so that application threads don't wait for file writes.
+ * @details There is a single producer, since the callers of write() hold output_lock, and the single consumer is the
+ *          writer thread. Once the writer thread has been stopped, or if it couldn't be started, the trace is written
+ *          directly to the output. The output is flushed whenever the ring buffer becomes empty, so that a stream
+ *          receives the trace of each top-level invocation soon after it completes.
+ */
+class trace_ring_sink : public trace_sink
+{
+public:
+    trace_ring_sink (trace_sink &output);
+    void start_writer_thread (void);
+    void stop_writer_thread (void);
+    virtual void write (const char *data, size_t length);
+private:
+    static void writer_thread (void *arg);
+
+    /** The size of the ring buffer in bytes, which is a power of two */
+    static const UINT64 ring_size = 4 * 1024 * 1024;
+
+    /** How long the writer thread waits when the ring buffer is empty */
+    static const UINT32 writer_poll_ms = 10;
+
+    trace_sink &output;
+    std::vector<char> ring;
+
+    /** The total number of bytes written to and read from the ring buffer. The write_index is only changed by
+     *  the producer and the read_index is only changed by the writer thread. */
+    UINT64 write_index;
+    UINT64 read_index;
+
+    /** Set to request the writer thread to exit, once the ring buffer is empty */
+    bool stop_requested;
+
+    /** Set while the writer thread is running */
+    bool writer_running;
+    PIN_THREAD_UID writer_thread_uid;
+};
+
+trace_ring_sink::trace_ring_sink (trace_sink &output)
+    : output (output), ring (ring_size), write_index (0), read_index (0), stop_requested (false), writer_running (false)
+{
+}
+
+/**
+ * @brief Start the writer thread. If the thread can't be started the trace is written directly to the output.
+ */
+void trace_ring_sink::start_writer_thread (void)
+{
+    writer_running = PIN_SpawnInternalThread (writer_thread, this, PIN_DEFAULT_THREAD_STACK_SIZE,
+                                              &writer_thread_uid) != INVALID_THREADID;
+}
+
+/**
+ * @brief Stop the writer thread, after it has written the contents of the ring buffer
+ * @details Called when the application is exiting. Any subsequent trace output is written directly to the output.
+ */
+void trace_ring_sink::stop_writer_thread (void)
+{
+    PIN_GetLock (&output_lock, PIN_ThreadId () + 1);
+    if (writer_running)
+    {
+        __atomic_store_n (&stop_requested, true, __ATOMIC_RELEASE);
+        PIN_WaitForThreadTermination (writer_thread_uid, PIN_INFINITE_TIMEOUT, NULL);
+        writer_running = false;
+    }
+    PIN_ReleaseLock (&output_lock);
+}
+
+/**
+ * @brief Copy encoded trace into the ring buffer, waiting for the writer thread when the ring buffer is full
+ * @param[in] data The encoded trace
+ * @param[in] length The number of bytes of encoded trace
+ */
+void trace_ring_sink::write (const char *data, size_t length)
+{
+    if (!writer_running)
+    {
+        output.write (data, length);
+        return;
+    }
+
+    while (length > 0)
+    {
+        const UINT64 free_bytes = ring_size - (write_index - __atomic_load_n (&read_index, __ATOMIC_ACQUIRE));
+
+        if (free_bytes == 0)
+        {
+            PIN_Yield ();
+            continue;
+        }
+
+        const UINT64 ring_offset = write_index & (ring_size - 1);
+        const UINT64 contiguous_bytes = ring_size - ring_offset;
+        UINT64 copy_bytes = (length < free_bytes) ? length : free_bytes;
+
+        if (copy_bytes > contiguous_bytes)
+        {
+            copy_bytes = contiguous_bytes;
+        }
+        memcpy (&ring[ring_offset], data, copy_bytes);
+        __atomic_store_n (&write_index, write_index + copy_bytes, __ATOMIC_RELEASE);
+        data += copy_bytes;
+        length -= copy_bytes;
+    }
+}
+
+/**
+ * @brief Pin internal thread which writes the contents of the ring buffer to the output
+ * @param[in] arg The trace_ring_sink
+ */
+void trace_ring_sink::writer_thread (void *arg)
+{
+    trace_ring_sink *const sink = static_cast<trace_ring_sink *> (arg);
+
+    for (;;)
+    {
+        const bool stopping = __atomic_load_n (&sink->stop_requested, __ATOMIC_ACQUIRE);
+        const UINT64 available_bytes = __atomic_load_n (&sink->write_index, __ATOMIC_ACQUIRE) - sink->read_index;
+
+        if (available_bytes > 0)
+        {
+            const UINT64 ring_offset = sink->read_index & (ring_size - 1);
+            const UINT64 contiguous_bytes = ring_size - ring_offset;
+            const UINT64 write_bytes = (available_bytes < contiguous_bytes) ? available_bytes : contiguous_bytes;
+
+            sink->output.write (&sink->ring[ring_offset], write_bytes);
+            __atomic_store_n (&sink->read_index, sink->read_index + write_bytes, __ATOMIC_RELEASE);
+        }
+        else if (stopping)
+        {
+            break;
+        }
+        else
+        {
+            sink->output.flush ();
+            PIN_Sleep (writer_poll_ms);
+        }
+    }
+
+    sink->output.flush ();
+    PIN_ExitThread (0);
+}
+
+/** The output the writer thread writes the trace to, which is either trace_file or the stream socket */
+static ostream_trace_sink *trace_file_sink;
+static unix_socket_trace_sink *trace_stream_sink;
+
+/** Passes the encoded trace to the writer thread */
+static trace_ring_sink *trace_output_sink;
+
+/** Encodes the trace in the format selected by the binary_output knob */
+static trace_encoder *trace_output;
+
+/** The file the raw access trace is written to, when the access_trace knob is set */
+static std::ofstream access_trace_file;
+
+/** Writes the records of the raw access trace to access_trace_file */
+static ostream_trace_sink *access_trace_sink;
+static access_trace_writer *access_trace_output;
+
+/** Serialises output to access_trace_output by different threads */
+static PIN_LOCK access_trace_lock;
+
+/** The number of accesses which each thread buffers before writing them to the raw access trace */
+static const UINT32 access_trace_buffer_size = 16384;
+
+/** The stride learnt for one memory operand of a static instruction, when the stride_analysis knob is set.
+ *  Also used to identify the memory operand in the raw access trace, when the access_trace knob is set, the
+ *  traffic counters of the memory operand, when the instruction_traffic knob is set, and the instruction which wrote
+ *  a shared cache line, when the false_sharing knob is set. */
+struct instruction_stride_entry
+{
+    /** The address of the instruction */
+    ADDRINT ip;
+    /** Learns the stride from the accesses by all threads */
+    stride_detector detector;
+    /** The name of the routine containing the instruction, found when the instruction is instrumented */
+    std::string routine;
+    /** The index of the memory operand in the raw access trace, when the access_trace knob is set */
+    UINT32 access_trace_index;
+    /** The index of the traffic counters of the memory operand in thread_profile.operand_traffic, and the source file
+     *  and line of the instruction found when the instruction is instrumented, when the instruction_traffic knob
+     *  is set */
+    UINT32 traffic_index;
+    std::string source_file;
+    UINT32 source_line;
+};
+
+/** The strides learnt for each static instruction, indexed by the instruction address and
+ *  (memory operand * NUM_MEMORY_OPERAND_KINDS) + memory_access_kind.
+ *  Entries are created at instrumentation time, which Pin serialises, and the analysis calls are passed a pointer to
+ *  the entry so the table isn't searched per access. Entries are retained when code is re-instrumented. */
+static std::map<std::pair<ADDRINT,UINT32>,instruction_stride_entry *> instruction_strides;
+
+/** The number of memory operands which have been allocated traffic counters, when the instruction_traffic knob
+ *  is set */
+static UINT32 num_operand_traffic = 0;
+
+/** One memory access saved in access_buffer[] when the buffered knob is set */
+struct buffered_access
+{
+    /** The memory address read or written */
+    ADDRINT memory_addr;
+    /** The number of bytes read or written by the instruction */
+    UINT32 bytes_accessed;
+    /** The memory_access_kind which selects the memory profile to update */
+    UINT32 access_kind;
+    /** The stride entry of the accessing instruction, or NULL when no per-instruction analysis is enabled */
+    instruction_stride_entry *stride;
+};
+
+/** The number of memory accesses which can be saved in access_buffer[] before they are recorded */
+static const UINT32 access_buffer_size = 65536;
+
+/** The accesses made by one thread to one allocation, when the allocation_report knob is set */
+struct allocation_accesses
+{
+    /** The allocation which was accessed */
+    allocation_info allocation;
+    /** The number of accesses, indexed by memory_access_kind */
+    UINT64 accesses[NUM_MEMORY_ACCESS_KINDS];
+    /** The total bytes accessed, indexed by memory_access_kind */
+    UINT64 bytes[NUM_MEMORY_ACCESS_KINDS];
+};
+
+/** The memory profile of one thread for one activation of a top-level function */
+struct thread_activation_profile
+{
+    /** The invocation_count of the activation when memory_regions[] were last cleared.
+     *  The memory profiles are cleared by the thread on its first access in each activation, so a thread
+     *  has made accesses in an activation when this equals the invocation_count of the activation. */
+    UINT32 invocation_count;
+
+    /** Used to record the memory regions read/written/prefetched by the thread, indexed by memory_access_kind.
+     *  The accesses of read-modify-write operands are only recorded in memory_regions[MEMORY_ACCESS_READ_WRITE]. */
+    memory_regions_usage memory_regions[NUM_MEMORY_OPERAND_KINDS];
+
+    /** The accesses made by the thread to each allocation, when the allocation_report knob is set */
+    std::vector<allocation_accesses> allocations;
+
+    /** Index into allocations[] for each allocation_info.allocation_id which has been accessed */
+    std::map<UINT64,UINT32> allocation_indices;
+};
+
+/** Identifies the writes to shared cache lines by one instruction to one allocation during the activations of a
+ *  top-level function, when the false_sharing knob is set */
+struct cache_line_sharing_key
+{
+    /** Index into top_level_func_names[] for the top-level function */
+    UINT32 func_index;
+    /** The address of the instruction which wrote the lines */
+    ADDRINT ip;
+    /** The allocation_info.allocation_id of the allocation containing the lines, or no_allocation_id when the lines
+     *  aren't in an allocation */
+    UINT64 allocation_id;
+
+    bool operator< (const cache_line_sharing_key &other) const
+    {
+        if (func_index != other.func_index)
+        {
+            return func_index < other.func_index;
+        }
+        if (ip != other.ip)
+        {
+            return ip < other.ip;
+        }
+
+        return allocation_id < other.allocation_id;
+    }
+};
+
+/** Used as the cache_line_sharing_key.allocation_id of lines which aren't in an allocation */
+static const UINT64 no_allocation_id = ~(UINT64) 0;
+
+/** The writes to shared cache lines identified by a cache_line_sharing_key */
+struct cache_line_sharing_counts
+{
+    /** The name of the routine containing the instruction */
+    std::string routine;
+    /** The allocation containing the lines, with a size of zero when the lines aren't in an allocation */
+    allocation_info allocation;
+    /** The number of writes classified as false sharing */
+    UINT64 false_sharing;
+    /** The number of writes classified as true sharing */
+    UINT64 true_sharing;
+    /** The addresses of the shared lines */
+    std::set<ADDRINT> lines;
+};
+
+/** The state saved at entry to an allocator function, to be used when the function returns */
+struct allocator_call
+{
+    /** Index into allocator_functions[] for the function */
+    UINT32 function_index;
+    /** The stack pointer at entry to the function, which is the same when the function returns */
+    ADDRINT stack_ptr;
+    /** The arguments of the function */
+    ADDRINT args[max_allocator_args];
+    /** Return Instruction Pointer of the function */
+    ADDRINT return_ip;
+    /** The call stack of the function call in allocation_call_stacks, or empty_call_stack_id if not captured */
+    UINT32 stack_id;
+};
+
+/** The maximum depth of allocator function calls tracked for each thread, e.g. operator new calling malloc */
+static const UINT32 max_allocator_calls = 8;
+
+/** The allocation, or the gap between allocations, which contains a recently accessed address */
+struct cached_allocation
+{
+    /** The first address of the allocation or gap */
+    ADDRINT start_addr;
+    /** The last address of the allocation or gap */
+    ADDRINT end_addr;
+    /** Index into thread_activation_profile.allocations[] for the allocation, or -1 for a gap between allocations */
+    INT32 allocations_index;
+};
+
+/** The maximum number of allocations cached by each thread. Enough for an algorithm which alternates between
+ *  input, output and coefficient buffers to find each buffer from the cache. */
+static const UINT32 max_cached_allocations = 4;
+
+/** The floating point operations counted by a thread, or during an activation of a top-level function, when the
+ *  roofline knob is set */
+struct fp_operation_counts
+{
+    /** The number of floating point arithmetic instructions executed */
+    UINT64 fp_instructions;
+    /** The number of floating point operations, indexed by fp_vector_width */
+    UINT64 flops[trace_num_vector_widths];
+};
+
+/** The class of memory accessed by a memory operand, found when the instruction is instrumented. The accesses to the
+ *  classes before NUM_STATIC_SEGMENTS are only counted, when the segments knob is set. */
+enum segment_class
+{
+    SEGMENT_STACK,
+    SEGMENT_GLOBAL,
+    NUM_STATIC_SEGMENTS,
+    /** Any other memory, such as the heap and memory mappings, which is recorded in the memory profile */
+    SEGMENT_DYNAMIC = NUM_STATIC_SEGMENTS
+};
+
+/** The accesses to the stack and globals counted by a thread, or during an activation of a top-level function,
+ *  when the segments knob is set */
+struct segment_access_counts
+{
+    /** The number of accesses, indexed by segment_class and memory_access_kind */
+    UINT64 accesses[NUM_STATIC_SEGMENTS][NUM_MEMORY_ACCESS_KINDS];
+    /** The total bytes accessed, indexed by segment_class and memory_access_kind */
+    UINT64 bytes[NUM_STATIC_SEGMENTS][NUM_MEMORY_ACCESS_KINDS];
+};
+
+/** The memory profile state maintained for each thread. Apart from the inlined counters and access_buffer[], the
+ *  state is only modified or read with the lock of the profile held, since the thread which calls or returns from a
+ *  top-level function records and outputs the profiles of all threads while they may still be running. */
+struct thread_profile
+{
+    /** The Pin ID of the thread */
+    THREADID thread_id;
+
+    /** Spin lock which serialises the recording of memory accesses by the thread with the recording of its buffered
+     *  accesses, and the output of its memory profile, by the thread which calls or returns from a top-level function.
+     *  Uncontended except at those points. */
+    volatile UINT32 lock;
+
+    /** The exclusive memory profiles of the thread for each depth of activation_stack[] */
+    thread_activation_profile activations[max_activation_depth];
+
+    /** When the buffered knob is set, memory accesses are saved by inlined analysis code and then recorded in the
+     *  memory profiles in batches by process_access_buffer(). This avoids a call of record_access() per memory access,
+     *  and allows runs of accesses to contiguous addresses to be recorded in one step.
+     *  Only allocated when the buffered knob is set. */
+    buffered_access *access_buffer;
+
+    /** The number of memory accesses saved in access_buffer[]. Only modified by the thread itself, and stored with
+     *  release semantics so that another thread which reads the count also sees the saved accesses. */
+    UINT32 access_buffer_count;
+
+    /** The number of accesses at the start of access_buffer[] which have already been recorded by another thread,
+     *  by process_other_access_buffer(). Reset to zero along with access_buffer_count. */
+    UINT32 access_buffer_start;
+
+    /** Used by record_buffered_accesses() to sort the saved memory accesses by memory_access_kind */
+    buffered_access *sorted_access_buffer;
+
+    /** The allocations containing recently accessed addresses, in most recently used order, which avoid searching
+     *  outstanding_allocations for each access. Only the first num_cached_allocations entries are valid. */
+    cached_allocation allocation_cache[max_cached_allocations];
+    UINT32 num_cached_allocations;
+
+    /** The outstanding_allocations_generation and activation invocation_count the allocation_cache[] is valid for */
+    UINT32 allocation_cache_generation;
+    UINT32 allocation_cache_invocation_count;
+
+    /** The allocator functions which the thread has entered and not yet returned from, innermost last.
+     *  Only the outermost call changes the outstanding allocations, so that an allocator function implemented by
+     *  calling another allocator function, such as operator new calling malloc, is traced once. */
+    allocator_call allocator_calls[max_allocator_calls];
+    UINT32 num_allocator_calls;
+
+    /** The cache hierarchy simulated for the thread's accesses, as if the thread has its own core.
+     *  Only allocated when the cache_simulation knob is set. */
+    cache_hierarchy *caches;
+
+    /** Measures the reuse distances of the thread's cache line accesses.
+     *  Only allocated when the reuse_distance knob is set. */
+    reuse_distance_analyser *reuse_distances;
+
+    /** The data TLBs simulated for the thread's accesses, as if the thread has its own core.
+     *  Only allocated when the page_footprint knob is set. */
+    tlb_simulator *tlbs;
+
+    /** The accesses made by the thread which have yet to be written to the raw access trace.
+     *  Only allocated when the access_trace knob is set. */
+    access_trace_access *access_trace_buffer;
+    UINT32 access_trace_count;
+
+    /** The traffic counted for the memory operands executed by the thread, indexed by the traffic_index of the
+     *  stride entry of the operand. Grown as operands are first executed by the thread, and only used when the
+     *  instruction_traffic knob is set. */
+    std::vector<instruction_traffic> operand_traffic;
+
+    /** The writes by the thread to cache lines last written by another thread, only used when the false_sharing knob
+     *  is set */
+    std::map<cache_line_sharing_key,cache_line_sharing_counts> cache_line_sharing;
+
+    /** The floating point operations executed by the thread while the accesses of a top-level function are sampled,
+     *  which is never reset. Only used when the roofline knob is set. */
+    fp_operation_counts fp_operations;
+
+    /** The accesses to the stack and globals made by the thread while the accesses of a top-level function are
+     *  sampled, which is never reset. Only used when the segments knob is set. */
+    segment_access_counts segment_accesses;
+};
+
+/**
+ * @brief Acquire the spin lock of the profile of a thread
+ * @param[in,out] profile The profile to lock
+ */
+static inline void lock_thread_profile (thread_profile *const profile)
+{
+    while (__sync_lock_test_and_set (&profile->lock, 1) != 0)
+    {
+        while (profile->lock != 0)
+        {
+        }
+    }
+}
+
+/**
+ * @brief Release the spin lock of the profile of a thread
+ * @param[in,out] profile The profile to unlock
+ */
+static inline void unlock_thread_profile (thread_profile *const profile)
+{
+    __sync_lock_release (&profile->lock);
+}
+
+/** The profiles of all threads which have been started, in order of thread start.
+ *  Profiles are retained after their thread exits, so that accesses by the thread are included in the memory profile
+ *  output on exit from the top-level function. */
+static std::vector<thread_profile *> thread_profiles;
+
+/** Serialises changes to thread_profiles by thread start with reads of thread_profiles at top-level function exit */
+static PIN_LOCK thread_profiles_lock;
+
+/** Pin thread-local-storage key for the thread_profile of each thread, used by the memory allocation hooks */
+static TLS_KEY thread_profile_key;
+
+/** Pin tool register which holds the thread_profile of each thread, used to pass the profile to the memory access
+ *  analysis functions without a call to PIN_GetThreadData() */
+static REG thread_profile_reg;
+
+/** One activation of a top-level function on activation_stack[] */
+struct top_level_activation
+{
+    /** Index into top_level_func_names[] for the top-level function */
+    UINT32 func_index;
+    /** The value of top_level_invocation_count at entry to the top-level function */
+    UINT32 invocation_count;
+    /** The invocation of the top-level function, counting from zero */
+    UINT64 invocation;
+    /** The number of outstanding calls of top-level functions which are treated as part of this activation,
+     *  either direct recursive calls or calls which would exceed max_activation_depth */
+    UINT32 ignored_calls;
+    /** The thread which called the top-level function */
+    THREADID thread_id;
+    /** Set when the invocation is sampled, otherwise the accesses of the activation aren't recorded */
+    bool sampled;
+    /** Set when a nested top-level function has been called from this activation */
+    bool nested;
+    /** Set when the entry to the top-level function has yet to be output, when the aggregate_invocations knob is set.
+     *  The entry is output once the memory profile of the activation, or of a nested top-level function, is output. */
+    bool enter_pending;
+    /** The live heap during the activation, where the high-water marks are updated by the allocator hooks */
+    trace_heap_statistics heap;
+    /** The inclusive memory profiles of the nested top-level functions, indexed by memory_access_kind */
+    memory_regions_usage nested_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+    /** When the roofline knob is set, the floating point operations of all threads at entry to the top-level function,
+     *  the inclusive floating point operations of the nested top-level functions, and the inclusive floating point
+     *  operations of the activation set at exit from the top-level function */
+    fp_operation_counts entry_fp_operations;
+    fp_operation_counts nested_fp_operations;
+    fp_operation_counts fp_operations;
+    /** When the segments knob is set, the accesses to the stack and globals of all threads at entry to the top-level
+     *  function, the inclusive accesses of the nested top-level functions, and the inclusive accesses of the activation
+     *  set at exit from the top-level function */
+    segment_access_counts entry_segment_accesses;
+    segment_access_counts nested_segment_accesses;
+    segment_access_counts segment_accesses;
+};
+
+/** The active top-level functions, with the innermost at activation_stack[num_activations - 1] */
+static top_level_activation activation_stack[max_activation_depth];
+
+/** The number of active top-level functions on activation_stack[] */
+static UINT32 num_activations = 0;
+
+/** Used to combine the memory profiles of multiple threads for output at top-level function exit */
+static memory_regions_usage combined_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+
+/** Used to combine the memory profiles of a top-level function and its nested top-level functions */
+static memory_regions_usage inclusive_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+
+/** Used to add the read-modify-write accesses of each thread to its read and write memory profiles, when the
+ *  per_thread knob is set. Indexed by (thread * NUM_MEMORY_ACCESS_KINDS) + memory_access_kind. */
+static std::vector<memory_regions_usage> thread_memory_regions;
+
+/**
+ * @brief Insert a new allocation into the index
+ * @details Any existing allocations which overlap the new allocation are removed, since they must have been freed
+ *          when no top-level function was active.
+ * @param[in] allocation The allocation to insert
+ */
+void allocation_index::insert (const allocation_info &allocation)
+{
+    const ADDRINT end_addr = allocation.data_ptr + ((allocation.size > 0) ? (allocation.size - 1) : 0);
+    UINT32 first_index = upper_bound_allocation_index (allocation.data_ptr);
+    UINT32 last_index;
+
+    if ((first_index > 0) &&
+        ((sorted_allocations[first_index - 1].data_ptr == allocation.data_ptr) ||
+         ((sorted_allocations[first_index - 1].data_ptr + sorted_allocations[first_index - 1].size) > allocation.data_ptr)))
+    {
+        first_index--;
+    }
+    last_index = first_index;
+    while ((last_index < sorted_allocations.size()) && (sorted_allocations[last_index].data_ptr <= end_addr))
+    {
+        last_index++;
+    }
+
+    for (UINT32 replaced_index = first_index; replaced_index < last_index; replaced_index++)
+    {
+        total_size -= sorted_allocations[replaced_index].size;
+    }
+    total_size += allocation.size;
+    if (last_index > first_index)
+    {
+        sorted_allocations[first_index] = allocation;
+        sorted_allocations.erase (sorted_allocations.begin() + first_index + 1, sorted_allocations.begin() + last_index);
+    }
+    else
+    {
+        sorted_allocations.insert (sorted_allocations.begin() + first_index, allocation);
+    }
+}
+
+/**
+ * @brief Remove an allocation from the index when it is freed
+ * @param[in] data_ptr The address of the allocation
+ * @param[out] size When returning true, the size of the allocation
+ * @return Returns true if data_ptr was an outstanding allocation
+ */
+bool allocation_index::erase (const ADDRINT data_ptr, ADDRINT &size)
+{
+    const UINT32 next_index = upper_bound_allocation_index (data_ptr);
+
+    if ((next_index > 0) && (sorted_allocations[next_index - 1].data_ptr == data_ptr))
+    {
+        size = sorted_allocations[next_index - 1].size;
+        total_size -= size;
+        sorted_allocations.erase (sorted_allocations.begin() + next_index - 1);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Remove an address range from the allocations, when the range is unmapped
+ * @details Allocations which are partly in the range are truncated, or split in two when the range is in the middle
+ *          of the allocation. Both parts of a split allocation keep the same allocation_id.
+ * @param[in] start_addr The first address of the range
+ * @param[in] length The number of bytes in the range
+ * @return Returns true if any allocation was in the range
+ */
+bool allocation_index::erase_range (const ADDRINT start_addr, const ADDRINT length)
+{
+    const ADDRINT end_addr = start_addr + length;
+    UINT32 allocation_index = upper_bound_allocation_index (start_addr);
+    bool erased = false;
+
+    if (length == 0)
+    {
+        return false;
+    }
+
+    if (allocation_index > 0)
+    {
+        allocation_index--;
+    }
+    while ((allocation_index < sorted_allocations.size()) && (sorted_allocations[allocation_index].data_ptr < end_addr))
+    {
+        allocation_info &allocation = sorted_allocations[allocation_index];
+        const ADDRINT allocation_end_addr = allocation.data_ptr + allocation.size;
+
+        if (allocation_end_addr <= start_addr)
+        {
+            allocation_index++;
+        }
+        else if ((allocation.data_ptr >= start_addr) && (allocation_end_addr <= end_addr))
+        {
+            total_size -= allocation.size;
+            sorted_allocations.erase (sorted_allocations.begin() + allocation_index);
+            erased = true;
+        }
+        else if (allocation.data_ptr >= start_addr)
+        {
+            /* Range covers the start of the allocation */
+            total_size -= end_addr - allocation.data_ptr;
+            allocation.size = allocation_end_addr - end_addr;
+            allocation.data_ptr = end_addr;
+            erased = true;
+            allocation_index++;
+        }
+        else
+        {
+            /* Range covers the end or the middle of the allocation */
+            total_size -= std::min (allocation_end_addr, end_addr) - start_addr;
+            allocation.size = start_addr - allocation.data_ptr;
+            if (allocation_end_addr > end_addr)
+            {
+                allocation_info upper_part = allocation;
+
+                upper_part.data_ptr = end_addr;
+                upper_part.size = allocation_end_addr - end_addr;
+                sorted_allocations.insert (sorted_allocations.begin() + allocation_index + 1, upper_part);
+            }
+            erased = true;
+            allocation_index++;
+        }
+    }
+
+    return erased;
+}
+
+/**
+ * @brief Find the allocation which contains an address
+ * @param[in] addr The address to search for
+ * @param[out] interval_start The first address of the allocation, or of the gap between allocations containing addr
+ * @param[out] interval_end The last address of the allocation, or of the gap between allocations containing addr
+ * @return The allocation which contains addr, or NULL if addr isn't in an allocation
+ */
+const allocation_info *allocation_index::find (const ADDRINT addr, ADDRINT &interval_start, ADDRINT &interval_end) const
+{
+    const UINT32 next_index = upper_bound_allocation_index (addr);
+
+    interval_start = 0;
+    if (next_index > 0)
+    {
+        const allocation_info &allocation = sorted_allocations[next_index - 1];
+
+        if ((addr - allocation.data_ptr) < allocation.size)
+        {
+            interval_start = allocation.data_ptr;
+            interval_end = allocation.data_ptr + allocation.size - 1;
+            return &allocation;
+        }
+        interval_start = allocation.data_ptr + allocation.size;
+    }
+    interval_end = (next_index < sorted_allocations.size()) ? (sorted_allocations[next_index].data_ptr - 1) : ~(ADDRINT) 0;
+
+    return NULL;
+}
+
+/**
+ * @brief Inlined analysis function which checks if a top-level function is active
+ * @details Used as the If part of the memory access instrumentation, so that the Then part which records the access
+ *          is only called when a top-level function is active.
+ * @return Non-zero if a top-level function is active
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL top_level_function_active (void)
+{
+    return sampled_top_level_func_index != -1;
+}
+
+/**
+ * @brief Get the memory profile of a thread to record accesses for the innermost active top-level function
+ * @details Clears the memory profile when the first access is made by the thread in the activation.
+ * @param[in,out] profile The profile of the thread making the access
+ * @return The memory profile of the thread for the innermost activation, or NULL if no top-level function is active
+ */
+static inline thread_activation_profile *start_thread_profile (thread_profile *const profile)
+{
+    const UINT32 depth = num_activations;
+
+    if (depth == 0)
+    {
+        return NULL;
+    }
+
+    thread_activation_profile &activation = profile->activations[depth - 1];
+    const UINT32 invocation_count = activation_stack[depth - 1].invocation_count;
+
+    if (activation.invocation_count != invocation_count)
+    {
+        for (UINT32 kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+        {
+            activation.memory_regions[kind].clear();
+        }
+        activation.allocations.clear();
+        activation.allocation_indices.clear();
+        activation.invocation_count = invocation_count;
+    }
+
+    return &activation;
+}
+
+/**
+ * @brief Find the allocation, or gap between allocations, which contains an address accessed by a thread
+ * @details Searches the allocations cached by the thread, and on a miss searches outstanding_allocations and adds the
+ *          result to the cache. The cache is invalidated when outstanding_allocations is modified, or the activation
+ *          changes.
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in,out] activation The memory profile of the thread for the innermost activation
+ * @param[in] addr The address accessed
+ * @return The cached allocation or gap which contains addr
+ */
+static const cached_allocation &find_cached_allocation (thread_profile *const profile,
+                                                        thread_activation_profile *const activation,
+                                                        const ADDRINT addr)
+{
+    const UINT32 generation = __atomic_load_n (&outstanding_allocations_generation, __ATOMIC_ACQUIRE);
+    UINT32 cache_index;
+
+    if ((profile->allocation_cache_generation != generation) ||
+        (profile->allocation_cache_invocation_count != activation->invocation_count))
+    {
+        profile->num_cached_allocations = 0;
+        profile->allocation_cache_generation = generation;
+        profile->allocation_cache_invocation_count = activation->invocation_count;
+    }
+
+    for (cache_index = 0; cache_index < profile->num_cached_allocations; cache_index++)
+    {
+        const cached_allocation &entry = profile->allocation_cache[cache_index];
+
+        if ((addr >= entry.start_addr) && (addr <= entry.end_addr))
+        {
+            if (cache_index > 0)
+            {
+                const cached_allocation hit = entry;
+
+                memmove (&profile->allocation_cache[1], &profile->allocation_cache[0],
+                         cache_index * sizeof (profile->allocation_cache[0]));
+                profile->allocation_cache[0] = hit;
+            }
+            return profile->allocation_cache[0];
+        }
+    }
+
+    /* Search outstanding_allocations, and make the result the most recently used entry */
+    cached_allocation new_entry;
+    allocation_info allocation;
+    const allocation_info *found;
+
+    PIN_RWMutexReadLock (&outstanding_allocations_lock);
+    found = outstanding_allocations.find (addr, new_entry.start_addr, new_entry.end_addr);
+    if (found != NULL)
+    {
+        allocation = *found;
+    }
+    PIN_RWMutexUnlock (&outstanding_allocations_lock);
+
+    new_entry.allocations_index = -1;
+    if (found != NULL)
+    {
+        std::map<UINT64,UINT32>::const_iterator it = activation->allocation_indices.find (allocation.allocation_id);
+
+        if (it != activation->allocation_indices.end())
+        {
+            new_entry.allocations_index = it->second;
+        }
+        else
+        {
+            allocation_accesses new_accesses;
+
+            new_accesses.allocation = allocation;
+            memset (new_accesses.accesses, 0, sizeof (new_accesses.accesses));
+            memset (new_accesses.bytes, 0, sizeof (new_accesses.bytes));
+            new_entry.allocations_index = activation->allocations.size();
+            activation->allocations.push_back (new_accesses);
+            activation->allocation_indices[allocation.allocation_id] = new_entry.allocations_index;
+        }
+    }
+
+    if (profile->num_cached_allocations < max_cached_allocations)
+    {
+        profile->num_cached_allocations++;
+    }
+    memmove (&profile->allocation_cache[1], &profile->allocation_cache[0],
+             (profile->num_cached_allocations - 1) * sizeof (profile->allocation_cache[0]));
+    profile->allocation_cache[0] = new_entry;
+
+    return profile->allocation_cache[0];
+}
+
+/**
+ * @brief Attribute a run of memory accesses to the allocation which contains them, when the allocation_report knob is set
+ * @details A run which isn't contained in one allocation or gap is attributed one access at a time.
+ *          An access which straddles the end of an allocation is attributed by its start address.
+ *          Read-modify-write accesses are counted as both reads and writes.
+ * @param[in,out] profile The profile of the thread making the accesses
+ * @param[in,out] activation The memory profile of the thread for the innermost activation
+ * @param[in] access_kind The memory_access_kind of the accesses
+ * @param[in] first_memory_addr The memory address of the first access
+ * @param[in] bytes_accessed The number of bytes in each access
+ * @param[in] num_accesses The number of accesses to contiguous addresses
+ * @param[in] ascending When num_accesses exceeds one, true if the accesses are to ascending addresses
+ */
+static void attribute_accesses (thread_profile *const profile, thread_activation_profile *const activation,
+                                const UINT32 access_kind, const ADDRINT first_memory_addr, const UINT32 bytes_accessed,
+                                const UINT32 num_accesses, const bool ascending)
+{
+    const ADDRINT run_length = (ADDRINT) bytes_accessed * (num_accesses - 1);
+    const ADDRINT run_start_addr = ascending ? first_memory_addr : (first_memory_addr - run_length);
+    const ADDRINT last_access_addr = run_start_addr + run_length;
+    const cached_allocation &entry = find_cached_allocation (profile, activation, run_start_addr);
+
+    if (last_access_addr <= entry.end_addr)
+    {
+        if (entry.allocations_index >= 0)
+        {
+            allocation_accesses &accesses = activation->allocations[entry.allocations_index];
+
+            if (access_kind == MEMORY_ACCESS_READ_WRITE)
+            {
+                accesses.accesses[MEMORY_ACCESS_READ] += num_accesses;
+                accesses.bytes[MEMORY_ACCESS_READ] += (UINT64) bytes_accessed * num_accesses;
+                accesses.accesses[MEMORY_ACCESS_WRITE] += num_accesses;
+                accesses.bytes[MEMORY_ACCESS_WRITE] += (UINT64) bytes_accessed * num_accesses;
+            }
+            else
+            {
+                accesses.accesses[access_kind] += num_accesses;
+                accesses.bytes[access_kind] += (UINT64) bytes_accessed * num_accesses;
+            }
+        }
+    }
+    else
+    {
+        for (UINT32 access_index = 0; access_index < num_accesses; access_index++)
+        {
+            attribute_accesses (profile, activation, access_kind,
+                                run_start_addr + ((ADDRINT) bytes_accessed * access_index), bytes_accessed, 1, true);
+        }
+    }
+}
+
+/**
+ * @brief Simulate a memory access in the cache hierarchy of a thread, when the cache_simulation knob is set
+ * @details The outcome is added to the region containing the access, which must have already been recorded.
+ *          A read-modify-write access is simulated once as a write, which leaves the caches in the same state as the
+ *          read followed by the write, since the write always hits.
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in,out] activation The memory profile of the thread for the innermost activation
+ * @param[in] access_kind The memory_access_kind of the access
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ */
+static inline void simulate_cache_access (thread_profile *const profile, thread_activation_profile *const activation,
+                                          const UINT32 access_kind, const ADDRINT memory_addr,
+                                          const UINT32 bytes_accessed)
+{
+    const bool is_write = (access_kind == MEMORY_ACCESS_WRITE) || (access_kind == MEMORY_ACCESS_READ_WRITE);
+    cache_access_outcome outcome;
+
+    profile->caches->access (memory_addr, bytes_accessed, is_write, outcome);
+    activation->memory_regions[access_kind].record_cache_outcome (memory_addr, outcome);
+}
+
+/**
+ * @brief Measure the reuse distances of a memory access by a thread, when the reuse_distance knob is set
+ * @details The reuse distances are added to the region containing the access, which must have already been recorded.
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in,out] activation The memory profile of the thread for the innermost activation
+ * @param[in] access_kind The memory_access_kind of the access
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ */
+static inline void measure_reuse_distances (thread_profile *const profile, thread_activation_profile *const activation,
+                                            const UINT32 access_kind, const ADDRINT memory_addr,
+                                            const UINT32 bytes_accessed)
+{
+    activation->memory_regions[access_kind].record_reuse_distances (memory_addr, bytes_accessed,
+                                                                    *profile->reuse_distances);
+}
+
+/**
+ * @brief Learn the stride of an instruction from a memory access by a thread, when the stride_analysis knob is set
+ * @details Once the access pattern of the instruction has been classified, the access is counted by access pattern in
+ *          the region containing the access, which must have already been recorded.
+ * @param[in] profile The profile of the thread making the access
+ * @param[in,out] activation The memory profile of the thread for the innermost activation
+ * @param[in] access_kind The memory_access_kind of the access
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in,out] stride The stride entry of the accessing instruction
+ */
+static inline void learn_access_stride (const thread_profile *const profile, thread_activation_profile *const activation,
+                                        const UINT32 access_kind, const ADDRINT memory_addr,
+                                        instruction_stride_entry *const stride)
+{
+    trace_access_pattern access_pattern;
+
+    if (stride->detector.access (profile->thread_id, memory_addr, cache_line_size, access_pattern))
+    {
+        activation->memory_regions[access_kind].record_access_pattern (memory_addr, access_pattern);
+    }
+}
+
+/**
+ * @brief Simulate a memory access in the data TLBs of a thread, when the page_footprint knob is set
+ * @details The TLB misses are added to the region containing the access, which must have already been recorded.
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in,out] activation The memory profile of the thread for the innermost activation
+ * @param[in] access_kind The memory_access_kind of the access
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ */
+static inline void simulate_tlb_access (thread_profile *const profile, thread_activation_profile *const activation,
+                                        const UINT32 access_kind, const ADDRINT memory_addr,
+                                        const UINT32 bytes_accessed)
+{
+    UINT64 misses[trace_num_page_sizes];
+
+    profile->tlbs->access (memory_addr, bytes_accessed, misses);
+    activation->memory_regions[access_kind].record_tlb_misses (memory_addr, misses);
+}
+
+/**
+ * @brief Count the traffic of a memory access by a thread in the counters of the accessing memory operand, when the
+ *        instruction_traffic knob is set
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in] access_kind The memory_access_kind of the access
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ * @param[in] stride The stride entry of the accessing instruction, which selects the traffic counters
+ */
+static inline void count_operand_traffic (thread_profile *const profile, const UINT32 access_kind,
+                                          const ADDRINT memory_addr, const UINT32 bytes_accessed,
+                                          const instruction_stride_entry *const stride)
+{
+    if (stride->traffic_index >= profile->operand_traffic.size())
+    {
+        profile->operand_traffic.resize (stride->traffic_index + 1, instruction_traffic (cache_line_size));
+    }
+    profile->operand_traffic[stride->traffic_index].record_access (access_kind, memory_addr, bytes_accessed);
+}
+
+/**
+ * @brief Record a write by a thread in the shadow table of cache lines, and count the write when it is to a line last
+ *        written by another thread, when the false_sharing knob is set
+ * @details The allocation containing the line is only searched for when the write is shared, which is expected to be
+ *          rare compared to all writes.
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in] activation The memory profile of the thread for the innermost activation, which selects the top-level
+ *                       function the write is attributed to
+ * @param[in] access_kind The memory_access_kind of the access, where only writes and read-modify-writes are recorded
+ * @param[in] memory_addr The memory address being written
+ * @param[in] bytes_accessed The number of bytes written by the instruction
+ * @param[in] stride The stride entry of the writing instruction
+ */
+static inline void detect_cache_line_sharing (thread_profile *const profile,
+                                              const thread_activation_profile *const activation,
+                                              const UINT32 access_kind, const ADDRINT memory_addr,
+                                              const UINT32 bytes_accessed, const instruction_stride_entry *const stride)
+{
+    if ((access_kind != MEMORY_ACCESS_WRITE) && (access_kind != MEMORY_ACCESS_READ_WRITE))
+    {
+        return;
+    }
+
+    UINT64 line_addr = 0;
+    const cache_line_sharing_kind kind =
+            shared_lines.record_write (profile->thread_id, memory_addr, bytes_accessed, line_addr);
+    if (kind == CACHE_LINE_NOT_SHARED)
+    {
+        return;
+    }
+
+    cache_line_sharing_key key;
+    allocation_info allocation;
+    const allocation_info *found;
+    ADDRINT interval_start;
+    ADDRINT interval_end;
+
+    PIN_RWMutexReadLock (&outstanding_allocations_lock);
+    found = outstanding_allocations.find (memory_addr, interval_start, interval_end);
+    if (found != NULL)
+    {
+        allocation = *found;
+    }
+    PIN_RWMutexUnlock (&outstanding_allocations_lock);
+
+    if (found == NULL)
+    {
+        allocation.data_ptr = 0;
+        allocation.size = 0;
+        allocation.allocation_id = no_allocation_id;
+        allocation.allocated_in_func_index = 0;
+        allocation.caller_ip = 0;
+        allocation.stack_id = empty_call_stack_id;
+    }
+    key.func_index = activation_stack[activation - profile->activations].func_index;
+    key.ip = stride->ip;
+    key.allocation_id = allocation.allocation_id;
+
+    std::map<cache_line_sharing_key,cache_line_sharing_counts>::iterator it = profile->cache_line_sharing.find (key);
+    if (it == profile->cache_line_sharing.end())
+    {
+        cache_line_sharing_counts new_counts;
+
+        new_counts.routine = stride->routine;
+        new_counts.allocation = allocation;
+        new_counts.false_sharing = 0;
+        new_counts.true_sharing = 0;
+        it = profile->cache_line_sharing.insert
+                (std::pair<cache_line_sharing_key,cache_line_sharing_counts> (key, new_counts)).first;
+    }
+    if (kind == CACHE_LINE_TRUE_SHARING)
+    {
+        it->second.true_sharing++;
+    }
+    else
+    {
+        it->second.false_sharing++;
+    }
+    it->second.lines.insert (line_addr);
+}
+
+/**
+ * @brief Write the accesses buffered by a thread to the raw access trace, when the access_trace knob is set
+ * @param[in,out] profile The profile of the thread which made the accesses
+ */
+static void write_access_trace (thread_profile *const profile)
+{
+    if (profile->access_trace_count > 0)
+    {
+        PIN_GetLock (&access_trace_lock, profile->thread_id + 1);
+        access_trace_output->accesses (profile->thread_id, profile->access_trace_buffer, profile->access_trace_count);
+        PIN_ReleaseLock (&access_trace_lock);
+        profile->access_trace_count = 0;
+    }
+}
+
+/**
+ * @brief Save a memory access by a thread for the raw access trace, when the access_trace knob is set
+ * @details The accesses are written when the buffer of the thread is full, or the innermost activation changes.
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ * @param[in] stride The stride entry of the accessing instruction, which identifies it in the raw access trace
+ */
+static inline void trace_access (thread_profile *const profile, const ADDRINT memory_addr, const UINT32 bytes_accessed,
+                                 const instruction_stride_entry *const stride)
+{
+    access_trace_access &access = profile->access_trace_buffer[profile->access_trace_count];
+
+    access.addr = memory_addr;
+    access.instruction_index = stride->access_trace_index;
+    access.bytes_accessed = bytes_accessed;
+    profile->access_trace_count++;
+    if (profile->access_trace_count == access_trace_buffer_size)
+    {
+        write_access_trace (profile);
+    }
+}
+
+/**
+ * @brief Analysis function called when an instruction reads or writes memory while a top-level function is active
+ * @details Updates the memory profile of the thread
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in] access_kind The memory_access_kind which selects the memory profile to update
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ * @param[in,out] stride The stride entry of the instruction, or NULL when no per-instruction analysis is enabled
+ */
+static void memory_access_analysis (thread_profile *const profile, UINT32 access_kind, ADDRINT memory_addr,
+                                    UINT32 bytes_accessed, instruction_stride_entry *stride)
+{
+    lock_thread_profile (profile);
+
+    thread_activation_profile *const activation = start_thread_profile (profile);
+
+    if (activation != NULL)
+    {
+        activation->memory_regions[access_kind].record_access (memory_addr, bytes_accessed);
+        if (allocation_report_enabled)
+        {
+            attribute_accesses (profile, activation, access_kind, memory_addr, bytes_accessed, 1, true);
+        }
+        if (cache_simulation_enabled)
+        {
+            simulate_cache_access (profile, activation, access_kind, memory_addr, bytes_accessed);
+        }
+        if (reuse_distance_enabled)
+        {
+            measure_reuse_distances (profile, activation, access_kind, memory_addr, bytes_accessed);
+        }
+        if (stride_analysis_enabled)
+        {
+            learn_access_stride (profile, activation, access_kind, memory_addr, stride);
+        }
+        if (page_footprint_enabled)
+        {
+            simulate_tlb_access (profile, activation, access_kind, memory_addr, bytes_accessed);
+        }
+        if (instruction_traffic_enabled)
+        {
+            count_operand_traffic (profile, access_kind, memory_addr, bytes_accessed, stride);
+        }
+        if (false_sharing_enabled)
+        {
+            detect_cache_line_sharing (profile, activation, access_kind, memory_addr, bytes_accessed, stride);
+        }
+        if (access_trace_enabled)
+        {
+            trace_access (profile, memory_addr, bytes_accessed, stride);
+        }
+    }
+
+    unlock_thread_profile (profile);
+}
+
+/**
+ * @brief Record a range of the memory accesses saved in the access_buffer[] of a thread in the memory profiles of the
+ *        thread for the innermost active top-level function
+ * @details
+ *  Must be called with the lock of the profile held.
+ *  The accesses are first sorted by memory_access_kind, maintaining the order of accesses of each kind.
+ *  As each kind of access updates a different memory profile this gives the same memory profile as recording the
+ *  accesses in the order they were made. Runs of consecutive accesses of the same size to contiguous addresses are then
+ *  recorded in one step by record_access_run().
+ *  The saved memory accesses are discarded if no top-level function is active.
+ * @param[in,out] profile The profile of the thread which saved the memory accesses
+ * @param[in] start The index in access_buffer[] of the first access to record
+ * @param[in] end The index in access_buffer[] after the last access to record
+ */
+static void record_buffered_accesses (thread_profile *const profile, const UINT32 start, const UINT32 end)
+{
+    const buffered_access *const access_buffer = profile->access_buffer;
+    buffered_access *const sorted_access_buffer = profile->sorted_access_buffer;
+    UINT32 kind_start_indices[NUM_MEMORY_OPERAND_KINDS + 1];
+    UINT32 kind_fill_indices[NUM_MEMORY_OPERAND_KINDS];
+    UINT32 access_index;
+    UINT32 kind;
+
+    thread_activation_profile *const activation = (end > start) ? start_thread_profile (profile) : NULL;
+
+    if (activation != NULL)
+    {
+        /* Counting sort of the accesses by kind */
+        memset (kind_start_indices, 0, sizeof (kind_start_indices));
+        for (access_index = start; access_index < end; access_index++)
+        {
+            kind_start_indices[access_buffer[access_index].access_kind + 1]++;
+        }
+        for (kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+        {
+            kind_start_indices[kind + 1] += kind_start_indices[kind];
+            kind_fill_indices[kind] = kind_start_indices[kind];
+        }
+        for (access_index = start; access_index < end; access_index++)
+        {
+            sorted_access_buffer[kind_fill_indices[access_buffer[access_index].access_kind]++] = access_buffer[access_index];
+        }
+
+        /* Find runs of accesses to contiguous addresses for each kind */
+        for (kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+        {
+            memory_regions_usage *const memory_regions = &activation->memory_regions[kind];
+
+            access_index = kind_start_indices[kind];
+            while (access_index < kind_start_indices[kind + 1])
+            {
+                const buffered_access &first_access = sorted_access_buffer[access_index];
+                const ADDRINT bytes_accessed = first_access.bytes_accessed;
+                UINT32 num_accesses = 1;
+                bool ascending = true;
+
+                if ((access_index + 1) < kind_start_indices[kind + 1])
+                {
+                    const buffered_access &second_access = sorted_access_buffer[access_index + 1];
+
+                    if (second_access.bytes_accessed == bytes_accessed)
+                    {
+                        if (second_access.memory_addr == (first_access.memory_addr + bytes_accessed))
+                        {
+                            num_accesses = 2;
+                        }
+                        else if (second_access.memory_addr == (first_access.memory_addr - bytes_accessed))
+                        {
+                            num_accesses = 2;
+                            ascending = false;
+                        }
+                    }
+                }
+
+                if (num_accesses > 1)
+                {
+                    ADDRINT next_addr = ascending ? (first_access.memory_addr + (2 * bytes_accessed)) :
+                                                    (first_access.memory_addr - (2 * bytes_accessed));
+
+                    while (((access_index + num_accesses) < kind_start_indices[kind + 1]) &&
+                           (sorted_access_buffer[access_index + num_accesses].bytes_accessed == bytes_accessed) &&
+                           (sorted_access_buffer[access_index + num_accesses].memory_addr == next_addr))
+                    {
+                        num_accesses++;
+                        next_addr = ascending ? (next_addr + bytes_accessed) : (next_addr - bytes_accessed);
+                    }
+                }
+
+                memory_regions->record_access_run (first_access.memory_addr, first_access.bytes_accessed,
+                                                   num_accesses, ascending);
+                if (allocation_report_enabled)
+                {
+                    attribute_accesses (profile, activation, kind, first_access.memory_addr,
+                                        first_access.bytes_accessed, num_accesses, ascending);
+                }
+                access_index += num_accesses;
+            }
+        }
+
+        /* The caches and TLBs are simulated, reuse distances measured, strides learnt, instruction traffic counted,
+         * shared cache lines detected and the raw access trace written, in the order the accesses were made since the
+         * kinds of access interact and the strides of an instruction depend upon the order */
+        if (cache_simulation_enabled || reuse_distance_enabled || stride_analysis_enabled || page_footprint_enabled ||
+            instruction_traffic_enabled || false_sharing_enabled || access_trace_enabled)
+        {
+            for (access_index = start; access_index < end; access_index++)
+            {
+                const buffered_access &access = access_buffer[access_index];
+
+                if (cache_simulation_enabled)
+                {
+                    simulate_cache_access (profile, activation, access.access_kind, access.memory_addr,
+                                           access.bytes_accessed);
+                }
+                if (reuse_distance_enabled)
+                {
+                    measure_reuse_distances (profile, activation, access.access_kind, access.memory_addr,
+                                             access.bytes_accessed);
+                }
+                if (stride_analysis_enabled)
+                {
+                    learn_access_stride (profile, activation, access.access_kind, access.memory_addr, access.stride);
+                }
+                if (page_footprint_enabled)
+                {
+                    simulate_tlb_access (profile, activation, access.access_kind, access.memory_addr,
+                                         access.bytes_accessed);
+                }
+                if (instruction_traffic_enabled)
+                {
+                    count_operand_traffic (profile, access.access_kind, access.memory_addr, access.bytes_accessed,
+                                           access.stride);
+                }
+                if (false_sharing_enabled)
+                {
+                    detect_cache_line_sharing (profile, activation, access.access_kind, access.memory_addr,
+                                               access.bytes_accessed, access.stride);
+                }
+                if (access_trace_enabled)
+                {
+                    trace_access (profile, access.memory_addr, access.bytes_accessed, access.stride);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Record the memory accesses saved in the access_buffer[] of the calling thread, and empty the buffer
+ * @details Called by the thread itself when access_buffer[] is full, and when the thread exits.
+ * @param[in,out] profile The profile of the calling thread
+ */
+static void process_access_buffer (thread_profile *const profile)
+{
+    lock_thread_profile (profile);
+    record_buffered_accesses (profile, profile->access_buffer_start, profile->access_buffer_count);
+    profile->access_buffer_start = 0;
+    profile->access_buffer_count = 0;
+    unlock_thread_profile (profile);
+}
+
+/**
+ * @brief Record the memory accesses saved so far in the access_buffer[] of a thread which may still be running
+ * @details The buffer can't be emptied, since the thread may be saving another access with inlined analysis code.
+ *          Instead the accesses are marked as recorded, and the buffer is emptied when the thread next calls
+ *          process_access_buffer().
+ * @param[in,out] profile The profile of the thread which saved the memory accesses
+ */
+static void process_other_access_buffer (thread_profile *const profile)
+{
+    lock_thread_profile (profile);
+
+    const UINT32 access_buffer_count = __atomic_load_n (&profile->access_buffer_count, __ATOMIC_ACQUIRE);
+
+    record_buffered_accesses (profile, profile->access_buffer_start, access_buffer_count);
+    profile->access_buffer_start = access_buffer_count;
+    unlock_thread_profile (profile);
+}
+
+/**
+ * @brief Inlined analysis function to check if access_buffer[] has insufficient space for the accesses of an instruction
+ * @param[in] profile The profile of the thread executing the instruction
+ * @param[in] num_accesses The number of accesses which the instruction will save in the buffer
+ * @return Non-zero if process_access_buffer() needs to be called to empty the buffer.
+ *         Always zero when no top-level function is active, as then no accesses are saved.
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL access_buffer_full (const thread_profile *const profile, UINT32 num_accesses)
+{
+    return (sampled_top_level_func_index != -1) & (profile->access_buffer_count > (access_buffer_size - num_accesses));
+}
+
+/**
+ * @brief Inlined analysis function which saves one memory access in access_buffer[]
+ * @param[in,out] profile The profile of the thread executing the instruction
+ * @param[in] memory_addr The memory address being read or written
+ * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ * @param[in] access_kind The memory_access_kind of the access
+ * @param[in] stride The stride entry of the instruction, or NULL when no per-instruction analysis is enabled
+ */
+static void PIN_FAST_ANALYSIS_CALL buffer_memory_access (thread_profile *const profile, ADDRINT memory_addr,
+                                                         UINT32 bytes_accessed, UINT32 access_kind,
+                                                         instruction_stride_entry *stride)
+{
+    buffered_access &access = profile->access_buffer[profile->access_buffer_count];
+
+    access.memory_addr = memory_addr;
+    access.bytes_accessed = bytes_accessed;
+    access.access_kind = access_kind;
+    access.stride = stride;
+    __atomic_store_n (&profile->access_buffer_count, profile->access_buffer_count + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Get the stride entry for one memory operand of an instruction, creating it if the instruction hasn't been
+ *        instrumented before
+ * @param[in] ins The instruction being instrumented
+ * @param[in] mem_op The memory operand of the instruction
+ * @param[in] access_kind The memory_access_kind of the access by the operand
+ * @details When the access_trace knob is set, a new entry is also defined in the raw access trace.
+ * @return The stride entry, or NULL when none of the stride_analysis, access_trace, instruction_traffic or
+ *         false_sharing knobs are set
+ */
+static instruction_stride_entry *get_instruction_stride (INS ins, const UINT32 mem_op, const UINT32 access_kind)
+{
+    if (!stride_analysis_enabled && !access_trace_enabled && !instruction_traffic_enabled && !false_sharing_enabled)
+    {
+        return NULL;
+    }
+
+    const std::pair<ADDRINT,UINT32> key (INS_Address (ins), (mem_op * NUM_MEMORY_OPERAND_KINDS) + access_kind);
+    instruction_stride_entry *&stride = instruction_strides[key];
+    if (stride == NULL)
+    {
+        RTN routine = INS_Rtn (ins);
+
+        stride = new instruction_stride_entry;
+        stride->ip = INS_Address (ins);
+        stride->routine = RTN_Valid (routine) ? RTN_Name (routine) : "???";
+        stride->access_trace_index = 0;
+        stride->source_line = 0;
+        if (instruction_traffic_enabled)
+        {
+            INT32 column = 0;
+            INT32 line = 0;
+
+            stride->traffic_index = num_operand_traffic++;
+            PIN_GetSourceLocation (INS_Address (ins), &column, &line, &stride->source_file);
+            if (stride->source_file.empty() || (line <= 0))
+            {
+                stride->source_file = "???";
+                line = 0;
+            }
+            stride->source_line = line;
+        }
+        if (access_trace_enabled)
+        {
+            access_trace_instruction instruction;
+
+            instruction.ip = INS_Address (ins);
+            instruction.mem_op = mem_op;
+            instruction.access_kind = access_kind;
+            instruction.routine = stride->routine;
+            PIN_GetLock (&access_trace_lock, PIN_ThreadId () + 1);
+            stride->access_trace_index = access_trace_output->instruction (instruction);
+            PIN_ReleaseLock (&access_trace_lock);
+        }
+    }
+
+    return stride;
+}
+
+/**
+ * @brief Get the kind of access made by a memory operand of an instruction
+ * @details An operand which is both read and written, such as the destination of add [mem],reg, is one
+ *          MEMORY_ACCESS_READ_WRITE access, so that it is instrumented with a single analysis call.
+ * @param[in] ins The instruction being instrumented
+ * @param[in] mem_op The memory operand of the instruction
+ * @param[out] access_kind When returning true, the memory_access_kind of the operand
+ * @return Returns true if the operand accesses memory
+ */
+static bool get_operand_access_kind (INS ins, const UINT32 mem_op, UINT32 &access_kind)
+{
+    const bool read = INS_MemoryOperandIsRead (ins, mem_op);
+    const bool written = INS_MemoryOperandIsWritten (ins, mem_op);
+
+    if (INS_IsPrefetch (ins))
+    {
+        access_kind = MEMORY_ACCESS_PREFETCH;
+    }
+    else if (read && written)
+    {
+        access_kind = MEMORY_ACCESS_READ_WRITE;
+    }
+    else if (read)
+    {
+        access_kind = MEMORY_ACCESS_READ;
+    }
+    else if (written)
+    {
+        access_kind = MEMORY_ACCESS_WRITE;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Inlined analysis function which counts an access to the stack or a global, when the segments knob is set
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in] segment The segment_class of the memory accessed
+ * @param[in] access_kind The memory_access_kind of the access, which isn't MEMORY_ACCESS_READ_WRITE
+ * @param[in] bytes_accessed The number of bytes read or written by the operand
+ */
+static void PIN_FAST_ANALYSIS_CALL count_segment_access (thread_profile *const profile, UINT32 segment,
+                                                         UINT32 access_kind, UINT32 bytes_accessed)
+{
+    profile->segment_accesses.accesses[segment][access_kind]++;
+    profile->segment_accesses.bytes[segment][access_kind] += bytes_accessed;
+}
+
+/**
+ * @brief Inlined analysis function which counts a read-modify-write access to the stack or a global as both a read
+ *        and a write, when the segments knob is set
+ * @param[in,out] profile The profile of the thread making the access
+ * @param[in] segment The segment_class of the memory accessed
+ * @param[in] bytes_accessed The number of bytes read and written by the operand
+ */
+static void PIN_FAST_ANALYSIS_CALL count_segment_read_write (thread_profile *const profile, UINT32 segment,
+                                                             UINT32 bytes_accessed)
+{
+    profile->segment_accesses.accesses[segment][MEMORY_ACCESS_READ]++;
+    profile->segment_accesses.bytes[segment][MEMORY_ACCESS_READ] += bytes_accessed;
+    profile->segment_accesses.accesses[segment][MEMORY_ACCESS_WRITE]++;
+    profile->segment_accesses.bytes[segment][MEMORY_ACCESS_WRITE] += bytes_accessed;
+}
+
+/**
+ * @brief Classify the memory accessed by a memory operand of an instruction, when the segments knob is set
+ * @details The classification uses the addressing of the operand itself, so each operand of an instruction with
+ *          several memory operands, such as push [mem], movs or a gather, is classified separately:
+ *          - Stack accesses are those which use the stack pointer as the base register, which includes the implicit
+ *            stack operand of push, pop, call and ret. With the frame_pointer knob accesses using the frame pointer as
+ *            the base register are also stack accesses.
+ *          - Global accesses are those which are instruction pointer relative, or use an absolute address within a
+ *            loaded image.
+ *          Other accesses are dynamic, including accesses to the stack or globals through a pointer.
+ * @param[in] ins The instruction being instrumented
+ * @param[in] mem_op The memory operand of the instruction
+ * @return The segment_class of the operand, which is always SEGMENT_DYNAMIC when the segments knob isn't set
+ */
+static UINT32 get_operand_segment (INS ins, const UINT32 mem_op)
+{
+    if (!segments_enabled)
+    {
+        return SEGMENT_DYNAMIC;
+    }
+
+    const UINT32 operand = INS_MemoryOperandIndexToOperandIndex (ins, mem_op);
+    const REG base_reg = INS_OperandMemoryBaseReg (ins, operand);
+
+    if (base_reg == REG_INST_PTR)
+    {
+        return SEGMENT_GLOBAL;
+    }
+    if ((base_reg == REG_STACK_PTR) || (frame_pointer_stack && (base_reg == REG_GBP)))
+    {
+        return SEGMENT_STACK;
+    }
+    if ((base_reg == REG_INVALID()) && (INS_OperandMemoryIndexReg (ins, operand) == REG_INVALID()) &&
+        IMG_Valid (IMG_FindByAddress ((ADDRINT) INS_OperandMemoryDisplacement (ins, operand))))
+    {
+        return SEGMENT_GLOBAL;
+    }
+
+    return SEGMENT_DYNAMIC;
+}
+
+/**
+ * @brief Instrument a memory operand which accesses the stack or a global to count the access, when the segments knob
+ *        is set
+ * @details The access isn't recorded in the memory profile, which avoids the cost of the analysis for the frequent
+ *          accesses to the stack. The size of the operand is known at instrumentation time, so is passed as a constant.
+ * @param[in] ins The instruction being instrumented
+ * @param[in] mem_op The memory operand of the instruction
+ * @param[in] access_kind The memory_access_kind of the access by the operand
+ * @param[in] segment The segment_class of the operand
+ */
+static void instrument_segment_access (INS ins, const UINT32 mem_op, const UINT32 access_kind, const UINT32 segment)
+{
+    INS_InsertIfPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) top_level_function_active,
+                                IARG_FAST_ANALYSIS_CALL,
+                                IARG_END);
+    if (access_kind == MEMORY_ACCESS_READ_WRITE)
+    {
+        INS_InsertThenPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) count_segment_read_write,
+                                      IARG_FAST_ANALYSIS_CALL,
+                                      IARG_REG_VALUE, thread_profile_reg,
+                                      IARG_UINT32, segment,
+                                      IARG_UINT32, INS_MemoryOperandSize (ins, mem_op),
+                                      IARG_END);
+    }
+    else
+    {
+        INS_InsertThenPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) count_segment_access,
+                                      IARG_FAST_ANALYSIS_CALL,
+                                      IARG_REG_VALUE, thread_profile_reg,
+                                      IARG_UINT32, segment,
+                                      IARG_UINT32, access_kind,
+                                      IARG_UINT32, INS_MemoryOperandSize (ins, mem_op),
+                                      IARG_END);
+    }
+}
+
+/**
+ * @brief Instrument an instruction to save its memory accesses in access_buffer[], when the buffered knob is set
+ * @details Accesses to the stack and globals are counted rather than saved, when the segments knob is set.
+ * @param[in] ins The instruction to instrument
+ * @param[in] mem_operands The number of memory operands of the instruction
+ */
+static void instrument_buffered_memory_access (INS ins, const UINT32 mem_operands)
+{
+    UINT32 num_accesses = 0;
+    UINT32 access_kind;
+
+    for (UINT32 mem_op = 0; mem_op < mem_operands; mem_op++)
+    {
+        if (get_operand_access_kind (ins, mem_op, access_kind) &&
+            (get_operand_segment (ins, mem_op) == SEGMENT_DYNAMIC))
+        {
+            num_accesses++;
+        }
+    }
+
+    if (num_accesses > 0)
+    {
+        INS_InsertIfCall (ins, IPOINT_BEFORE, (AFUNPTR) access_buffer_full,
+                          IARG_FAST_ANALYSIS_CALL,
+                          IARG_REG_VALUE, thread_profile_reg,
+                          IARG_UINT32, num_accesses,
+                          IARG_END);
+        INS_InsertThenCall (ins, IPOINT_BEFORE, (AFUNPTR) process_access_buffer,
+                            IARG_REG_VALUE, thread_profile_reg,
+                            IARG_END);
+    }
+
+    for (UINT32 mem_op = 0; mem_op < mem_operands; mem_op++)
+    {
+        if (!get_operand_access_kind (ins, mem_op, access_kind))
+        {
+            continue;
+        }
+
+        const UINT32 segment = get_operand_segment (ins, mem_op);
+        if (segment != SEGMENT_DYNAMIC)
+        {
+            instrument_segment_access (ins, mem_op, access_kind, segment);
+        }
+        else
+        {
+            INS_InsertIfPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) top_level_function_active,
+                                        IARG_FAST_ANALYSIS_CALL,
+                                        IARG_END);
+            INS_InsertThenPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) buffer_memory_access,
+                                          IARG_FAST_ANALYSIS_CALL,
+                                          IARG_REG_VALUE, thread_profile_reg,
+                                          IARG_MEMORYOP_EA, mem_op,
+                                          (access_kind == MEMORY_ACCESS_WRITE) ?
+                                                  IARG_MEMORYWRITE_SIZE : IARG_MEMORYREAD_SIZE,
+                                          IARG_UINT32, access_kind,
+                                          IARG_PTR, get_instruction_stride (ins, mem_op, access_kind),
+                                          IARG_END);
+        }
+    }
+}
+
+/**
+ * @brief Note code which is instrumented without its memory accesses or floating point operations, while
+ *        memory_accesses_instrumented is clear
+ * @details The whole routine containing the code is noted, so that few ranges need to be removed from the code cache.
+ * @param[in] routine The routine containing the code, which may not be valid
+ * @param[in] addr The address of the code
+ * @param[in] size The size of the code in bytes
+ */
+static void add_uninstrumented_code (RTN routine, const ADDRINT addr, const USIZE size)
+{
+    const ADDRINT start = RTN_Valid (routine) ? RTN_Address (routine) : addr;
+    const ADDRINT end = RTN_Valid (routine) ? (RTN_Address (routine) + RTN_Size (routine)) : (addr + size);
+
+    PIN_GetLock (&uninstrumented_routines_lock, PIN_ThreadId () + 1);
+    ADDRINT &routine_end = uninstrumented_routines[start];
+    routine_end = std::max (routine_end, end);
+    PIN_ReleaseLock (&uninstrumented_routines_lock);
+}
+
+/**
+ * @brief Is called for every instruction and instruments memory reads and writes
+ * @details When a top-level function is active updates the memory read / write profiles for the top-level function.
+ * @details When the instrument_only_top_level knob is set or sampling is enabled, while no accesses are sampled only
+ *          the instructions in the top-level functions are instrumented.
+ * @param[in] arg Instrumentation context - not used
+ */
+static void instrument_memory_access (INS ins, void *arg)
+{
+    /* Instruments memory accesses using a predicated call, i.e.
+       the instrumentation is called if the instruction will actually be executed.
+
+       On the IA-32 and Intel(R) 64 architectures conditional moves and REP
+       prefixed instructions appear as predicated instructions in Pin.
+
+       The analysis function which records the access is the Then part of an If/Then call, where the inlined If part
+       checks if the accesses of a top-level function are sampled. This avoids the cost of a call for accesses outside
+       of the top-level functions. */
+    UINT32 mem_operands = INS_MemoryOperandCount(ins);
+    UINT32 access_kind;
+
+    if (!memory_accesses_instrumented)
+    {
+        RTN routine = INS_Rtn (ins);
+
+        if (!RTN_Valid (routine) || (top_level_func_addrs.find (RTN_Address (routine)) == top_level_func_addrs.end()))
+        {
+            if (mem_operands > 0)
+            {
+                add_uninstrumented_code (routine, INS_Address (ins), INS_Size (ins));
+            }
+            return;
+        }
+    }
+
+    if (buffered_accesses)
+    {
+        instrument_buffered_memory_access (ins, mem_operands);
+        return;
+    }
+
+    /* Iterate over each memory operand of the instruction.
+       Note that in some architectures a single memory operand can be
+       both read and written (for instance incl (%eax) on IA-32)
+       In that case it is instrumented once as a read-modify-write.
+       When the segments knob is set, accesses to the stack and globals are only counted. */
+    for (UINT32 mem_op = 0; mem_op < mem_operands; mem_op++)
+    {
+        if (!get_operand_access_kind (ins, mem_op, access_kind))
+        {
+            continue;
+        }
+
+        const UINT32 segment = get_operand_segment (ins, mem_op);
+        if (segment != SEGMENT_DYNAMIC)
+        {
+            instrument_segment_access (ins, mem_op, access_kind, segment);
+        }
+        else
+        {
+            INS_InsertIfPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) top_level_function_active,
+                                        IARG_FAST_ANALYSIS_CALL,
+                                        IARG_END);
+            INS_InsertThenPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) memory_access_analysis,
+                                          IARG_REG_VALUE, thread_profile_reg,
+                                          IARG_UINT32, access_kind,
+                                          IARG_MEMORYOP_EA, mem_op,
+                                          (access_kind == MEMORY_ACCESS_WRITE) ?
+                                                  IARG_MEMORYWRITE_SIZE : IARG_MEMORYREAD_SIZE,
+                                          IARG_PTR, get_instruction_stride (ins, mem_op, access_kind),
+                                          IARG_END);
+        }
+    }
+}
+
+/**
+ * @brief Change if memory accesses are instrumented, when the instrument_only_top_level knob is set or sampling
+ *        is enabled
+ * @details When memory accesses become instrumented, the routines in uninstrumented_routines are removed from the code
+ *          cache so that they are re-instrumented as they are next executed. Adjacent routines are removed as one
+ *          range. The change takes effect for the current trace when it exits.
+ *          When memory accesses are no longer instrumented the existing instrumentation is left in place, so code
+ *          executed both while the accesses are sampled and while they are not is only re-instrumented once.
+ * @param[in] thread_id The Pin ID of the calling thread
+ * @param[in] instrumented If memory accesses are to be instrumented
+ */
+static void set_memory_accesses_instrumented (THREADID thread_id, const bool instrumented)
+{
+    if ((instrument_only_top_level || sampling_enabled) && (instrumented != memory_accesses_instrumented))
+    {
+        memory_accesses_instrumented = instrumented;
+        if (instrumented)
+        {
+            std::map<ADDRINT,ADDRINT> routines;
+            std::map<ADDRINT,ADDRINT>::const_iterator it;
+
+            /* The code cache is not modified with the lock held, as Pin holds its own lock while instrumenting */
+            PIN_GetLock (&uninstrumented_routines_lock, thread_id + 1);
+            routines.swap (uninstrumented_routines);
+            PIN_ReleaseLock (&uninstrumented_routines_lock);
+
+            it = routines.begin();
+            while (it != routines.end())
+            {
+                const ADDRINT start = it->first;
+                ADDRINT end = it->second;
+
+                for (++it; (it != routines.end()) && (it->first <= end); ++it)
+                {
+                    end = std::max (end, it->second);
+                }
+                PIN_RemoveInstrumentationInRange (start, end - 1);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Update if memory accesses are sampled, following a change to the innermost activation or the sample burst
+ * @details Accesses are sampled while the innermost activation is a sampled invocation, during a sample burst.
+ * @param[in] thread_id The Pin ID of the calling thread
+ */
+static void update_access_sampling (THREADID thread_id)
+{
+    PIN_GetLock (&sampling_lock, thread_id + 1);
+    if ((num_activations > 0) && activation_stack[num_activations - 1].sampled && in_sample_burst)
+    {
+        sampled_top_level_func_index = active_top_level_func_index;
+    }
+    else
+    {
+        sampled_top_level_func_index = -1;
+    }
+    set_memory_accesses_instrumented (thread_id, sampled_top_level_func_index != -1);
+    PIN_ReleaseLock (&sampling_lock);
+}
+
+/**
+ * @brief Inlined analysis function which counts the instructions in a basic block towards the end of the current
+ *        burst or gap between bursts, when the sample_burst_instructions knob is non-zero
+ * @param[in] num_instructions The number of instructions in the basic block
+ * @return Non-zero if end_sample_burst_phase() needs to be called
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL count_burst_instructions (UINT32 num_instructions)
+{
+    burst_phase_remaining -= num_instructions;
+    return burst_phase_remaining <= 0;
+}
+
+/**
+ * @brief Analysis function called at the end of a burst or gap between bursts, to start the next
+ * @details Starting a burst re-instruments the routines executed without instrumentation for memory accesses during
+ *          the gap, which after the first bursts are only the routines first executed in the gap.
+ * @param[in] thread_id The Pin ID of the thread which ended the burst or gap
+ */
+static void end_sample_burst_phase (THREADID thread_id)
+{
+    PIN_GetLock (&sampling_lock, thread_id + 1);
+    if (burst_phase_remaining > 0)
+    {
+        /* Another thread has already started the next phase */
+        PIN_ReleaseLock (&sampling_lock);
+        return;
+    }
+
+    const UINT64 phase_instructions = burst_phase_instructions - burst_phase_remaining;
+
+    burst_total_instructions += phase_instructions;
+    if (in_sample_burst)
+    {
+        burst_sampled_instructions += phase_instructions;
+    }
+    in_sample_burst = !in_sample_burst;
+    burst_phase_instructions = in_sample_burst ? sample_burst_instructions.Value() :
+            (sample_burst_period.Value() - sample_burst_instructions.Value());
+    burst_phase_remaining = burst_phase_instructions;
+    PIN_ReleaseLock (&sampling_lock);
+
+    update_access_sampling (thread_id);
+}
+
+/**
+ * @brief Instrument each basic block of a trace to count the instructions executed, when the
+ *        sample_burst_instructions knob is non-zero
+ * @param[in] trace The trace to instrument
+ * @param[in] arg Instrumentation context - not used
+ */
+static void instrument_sample_bursts (TRACE trace, void *arg)
+{
+    for (BBL bbl = TRACE_BblHead (trace); BBL_Valid (bbl); bbl = BBL_Next (bbl))
+    {
+        BBL_InsertIfCall (bbl, IPOINT_BEFORE, (AFUNPTR) count_burst_instructions,
+                          IARG_FAST_ANALYSIS_CALL,
+                          IARG_UINT32, BBL_NumIns (bbl),
+                          IARG_END);
+        BBL_InsertThenCall (bbl, IPOINT_BEFORE, (AFUNPTR) end_sample_burst_phase,
+                            IARG_THREAD_ID,
+                            IARG_END);
+    }
+}
+
+/**
+ * @brief Inlined analysis function which advances the clock of the heap timeline by the instructions in a basic block
+ * @param[in] num_instructions The number of instructions in the basic block
+ */
+static void PIN_FAST_ANALYSIS_CALL count_heap_timeline_instructions (UINT32 num_instructions)
+{
+    heap_timeline_instructions += num_instructions;
+}
+
+/**
+ * @brief Instrument each basic block of a trace to count the instructions executed, when the heap_timeline_interval
+ *        knob is non-zero
+ * @param[in] trace The trace to instrument
+ * @param[in] arg Instrumentation context - not used
+ */
+static void instrument_heap_timeline (TRACE trace, void *arg)
+{
+    for (BBL bbl = TRACE_BblHead (trace); BBL_Valid (bbl); bbl = BBL_Next (bbl))
+    {
+        BBL_InsertCall (bbl, IPOINT_BEFORE, (AFUNPTR) count_heap_timeline_instructions,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_UINT32, BBL_NumIns (bbl),
+                        IARG_END);
+    }
+}
+
+/**
+ * @brief Inlined analysis function which counts the floating point operations of a basic block, when the roofline knob
+ *        is set
+ * @param[in,out] profile The profile of the thread executing the basic block
+ * @param[in] fp_instructions The number of floating point arithmetic instructions in the basic block
+ * @param[in] scalar_flops The number of scalar floating point operations in the basic block
+ * @param[in] vector128_flops The number of floating point operations by 128-bit vector instructions
+ * @param[in] vector256_flops The number of floating point operations by 256-bit vector instructions
+ * @param[in] vector512_flops The number of floating point operations by 512-bit vector instructions
+ */
+static void PIN_FAST_ANALYSIS_CALL count_fp_operations (thread_profile *const profile, UINT32 fp_instructions,
+                                                        UINT32 scalar_flops, UINT32 vector128_flops,
+                                                        UINT32 vector256_flops, UINT32 vector512_flops)
+{
+    profile->fp_operations.fp_instructions += fp_instructions;
+    profile->fp_operations.flops[FP_VECTOR_SCALAR] += scalar_flops;
+    profile->fp_operations.flops[FP_VECTOR_128] += vector128_flops;
+    profile->fp_operations.flops[FP_VECTOR_256] += vector256_flops;
+    profile->fp_operations.flops[FP_VECTOR_512] += vector512_flops;
+}
+
+/**
+ * @brief Determine if an instruction may perform floating point arithmetic, from its XED category
+ * @details Used to avoid getting the mnemonic of the majority of instructions which can't perform floating point
+ *          arithmetic.
+ * @param[in] ins The instruction to check
+ * @return Returns true if the category of the instruction includes floating point arithmetic instructions
+ */
+static bool is_fp_arithmetic_category (INS ins)
+{
+    switch (INS_Category (ins))
+    {
+    case XED_CATEGORY_SSE:
+    case XED_CATEGORY_AVX:
+    case XED_CATEGORY_AVX512:
+    case XED_CATEGORY_VFMA:
+    case XED_CATEGORY_FMA4:
+    case XED_CATEGORY_X87_ALU:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Instrument each basic block of a trace which contains floating point arithmetic instructions to count the
+ *        floating point operations, when the roofline knob is set
+ * @details The operations of the basic block are counted when it is instrumented, so the inlined analysis only adds
+ *          the counts of the basic block. As with memory accesses the operations are only counted while the accesses
+ *          of a top-level function are sampled.
+ * @param[in] trace The trace to instrument
+ * @param[in] arg Instrumentation context - not used
+ */
+static void instrument_fp_operations (TRACE trace, void *arg)
+{
+    if (!memory_accesses_instrumented)
+    {
+        RTN routine = TRACE_Rtn (trace);
+
+        if (!RTN_Valid (routine) || (top_level_func_addrs.find (RTN_Address (routine)) == top_level_func_addrs.end()))
+        {
+            add_uninstrumented_code (routine, TRACE_Address (trace), TRACE_Size (trace));
+            return;
+        }
+    }
+
+    for (BBL bbl = TRACE_BblHead (trace); BBL_Valid (bbl); bbl = BBL_Next (bbl))
+    {
+        UINT32 fp_instructions = 0;
+        UINT32 flops[trace_num_vector_widths] = {0};
+
+        for (INS ins = BBL_InsHead (bbl); INS_Valid (ins); ins = INS_Next (ins))
+        {
+            fp_vector_width vector_width;
+            UINT32 ins_flops;
+
+            if (is_fp_arithmetic_category (ins) &&
+                classify_fp_operation (INS_Mnemonic (ins), xed_decoded_inst_vector_length_bits (INS_XedDec (ins)),
+                                       vector_width, ins_flops))
+            {
+                fp_instructions++;
+                flops[vector_width] += ins_flops;
+            }
+        }
+
+        if (fp_instructions > 0)
+        {
+            BBL_InsertIfCall (bbl, IPOINT_BEFORE, (AFUNPTR) top_level_function_active,
+                              IARG_FAST_ANALYSIS_CALL,
+                              IARG_END);
+            BBL_InsertThenCall (bbl, IPOINT_BEFORE, (AFUNPTR) count_fp_operations,
+                                IARG_FAST_ANALYSIS_CALL,
+                                IARG_REG_VALUE, thread_profile_reg,
+                                IARG_UINT32, fp_instructions,
+                                IARG_UINT32, flops[FP_VECTOR_SCALAR],
+                                IARG_UINT32, flops[FP_VECTOR_128],
+                                IARG_UINT32, flops[FP_VECTOR_256],
+                                IARG_UINT32, flops[FP_VECTOR_512],
+                                IARG_END);
+        }
+    }
+}
+
+/**
+ * @brief Get the floating point operations executed by all threads, when the roofline knob is set
+ * @details The counters are only incremented by their own thread, so are read atomically without locking the profiles.
+ * @param[in] thread_id The Pin ID of the calling thread
+ * @param[out] total The sum of the floating point operations of all threads
+ */
+static void sum_thread_fp_operations (THREADID thread_id, fp_operation_counts &total)
+{
+    std::vector<thread_profile *>::const_iterator it;
+
+    memset (&total, 0, sizeof (total));
+    PIN_GetLock (&thread_profiles_lock, thread_id + 1);
+    for (it = thread_profiles.begin(); it != thread_profiles.end(); ++it)
+    {
+        total.fp_instructions += __atomic_load_n (&(*it)->fp_operations.fp_instructions, __ATOMIC_RELAXED);
+        for (UINT32 width = 0; width < trace_num_vector_widths; width++)
+        {
+            total.flops[width] += __atomic_load_n (&(*it)->fp_operations.flops[width], __ATOMIC_RELAXED);
+        }
+    }
+    PIN_ReleaseLock (&thread_profiles_lock);
+}
+
+/**
+ * @brief Get the accesses to the stack and globals made by all threads, when the segments knob is set
+ * @details As for sum_thread_fp_operations(), the counters are read atomically without locking the profiles.
+ * @param[in] thread_id The Pin ID of the calling thread
+ * @param[out] total The sum of the accesses of all threads
+ */
+static void sum_thread_segment_accesses (THREADID thread_id, segment_access_counts &total)
+{
+    std::vector<thread_profile *>::const_iterator it;
+
+    memset (&total, 0, sizeof (total));
+    PIN_GetLock (&thread_profiles_lock, thread_id + 1);
+    for (it = thread_profiles.begin(); it != thread_profiles.end(); ++it)
+    {
+        for (UINT32 segment = 0; segment < NUM_STATIC_SEGMENTS; segment++)
+        {
+            for (UINT32 kind = 0; kind < NUM_MEMORY_ACCESS_KINDS; kind++)
+            {
+                total.accesses[segment][kind] +=
+                    __atomic_load_n (&(*it)->segment_accesses.accesses[segment][kind], __ATOMIC_RELAXED);
+                total.bytes[segment][kind] +=
+                    __atomic_load_n (&(*it)->segment_accesses.bytes[segment][kind], __ATOMIC_RELAXED);
+            }
+        }
+    }
+    PIN_ReleaseLock (&thread_profiles_lock);
+}
+
+/**
+ * @brief Get the profile of a thread from thread-local-storage
+ * @param[in] thread_id The Pin ID of the thread
+ * @return The profile of the thread
+ */
+static thread_profile *get_thread_profile (THREADID thread_id)
+{
+    return static_cast<thread_profile *> (PIN_GetThreadData (thread_profile_key, thread_id));
+}
+
+/**
+ * @brief Record the memory accesses buffered by all threads, for the innermost active top-level function
+ * @details Called by the thread which calls or returns from a top-level function, before the innermost active top-level
+ *          function changes. Other threads may still be running, so only the accesses they have saved so far are
+ *          recorded, and the rest are recorded when the threads next empty their buffers.
+ * @param[in] thread_id The Pin ID of the calling thread
+ */
+static void process_all_access_buffers (THREADID thread_id)
+{
+    if (buffered_accesses)
+    {
+        std::vector<thread_profile *>::const_iterator it;
+
+        PIN_GetLock (&thread_profiles_lock, thread_id + 1);
+        for (it = thread_profiles.begin(); it != thread_profiles.end(); ++it)
+        {
+            process_other_access_buffer (*it);
+        }
+        PIN_ReleaseLock (&thread_profiles_lock);
+    }
+}
+
+/**
+ * @brief Write the accesses buffered by all threads to the raw access trace, followed by a marker for the entry to or
+ *        exit from a top-level function, when the access_trace knob is set
+ * @details Called by the thread which calls or returns from a sampled top-level function, after the buffered memory
+ *          accesses have been recorded. The lock of each profile is held while its accesses are written, since the
+ *          thread may still be running.
+ * @param[in] thread_id The Pin ID of the calling thread
+ * @param[in] func_name The name of the top-level function
+ * @param[in] entry Set for entry to the top-level function, otherwise exit
+ */
+static void write_access_trace_marker (THREADID thread_id, const std::string &func_name, const bool entry)
+{
+    if (access_trace_enabled)
+    {
+        std::vector<thread_profile *>::const_iterator it;
+
+        PIN_GetLock (&thread_profiles_lock, thread_id + 1);
+        for (it = thread_profiles.begin(); it != thread_profiles.end(); ++it)
+        {
+            lock_thread_profile (*it);
+            write_access_trace (*it);
+            unlock_thread_profile (*it);
+        }
+        PIN_ReleaseLock (&thread_profiles_lock);
+
+        PIN_GetLock (&access_trace_lock, thread_id + 1);
+        if (entry)
+        {
+            access_trace_output->function_enter (func_name);
+        }
+        else
+        {
+            access_trace_output->function_exit (func_name);
+        }
+        PIN_ReleaseLock (&access_trace_lock);
+    }
+}
+
+/**
+ * @brief Instrumentation function called before entry to a top-level function.
+ * @details Traces entry to the top-level function, and pushes a new activation so that the memory profile of each
+ *          thread for the activation is initialised to empty on the first access by the thread.
+ *          A direct recursive call of the innermost top-level function, or a call which would exceed
+ *          max_activation_depth, is part of the existing activation.
+ *          While a top-level function is active, calls of top-level functions by other threads are ignored.
+ *          An invocation which isn't sampled still pushes an activation, so that accesses are not attributed to the
+ *          enclosing top-level function, but isn't traced.
+ * @param[in] func_index Index into top_level_func_names[] for the top-level function
+ * @param[in] thread_id The Pin ID of the thread calling the top-level function
+ */
+static void before_top_level_function (ADDRINT func_index, THREADID thread_id)
+{
+    if (num_activations > 0)
+    {
+        top_level_activation &innermost = activation_stack[num_activations - 1];
+
+        if (innermost.thread_id != thread_id)
+        {
+            return;
+        }
+        if ((innermost.func_index == func_index) || (num_activations == max_activation_depth))
+        {
+            innermost.ignored_calls++;
+            return;
+        }
+
+        /* Record the accesses buffered for the enclosing top-level function before it is suspended */
+        process_all_access_buffers (thread_id);
+        innermost.nested = true;
+    }
+
+    const UINT64 invocation = top_level_func_invocations[func_index]++;
+    const bool sampled = ((invocation % sample_every) == 0) &&
+            ((sample_first == 0) || (top_level_func_sampled_invocations[func_index] < sample_first));
+
+    if (sampled)
+    {
+        top_level_func_sampled_invocations[func_index]++;
+        if (!aggregate_invocations_enabled)
+        {
+            PIN_GetLock (&output_lock, thread_id + 1);
+            trace_output->function_enter (top_level_func_names[func_index]);
+            PIN_ReleaseLock (&output_lock);
+        }
+        write_access_trace_marker (thread_id, top_level_func_names[func_index], true);
+    }
+
+    top_level_activation &activation = activation_stack[num_activations];
+    activation.func_index = func_index;
+    activation.invocation_count = ++top_level_invocation_count;
+    activation.invocation = invocation;
+    activation.ignored_calls = 0;
+    activation.thread_id = thread_id;
+    activation.sampled = sampled;
+    activation.nested = false;
+    activation.enter_pending = sampled && aggregate_invocations_enabled;
+    for (UINT32 kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+    {
+        activation.nested_memory_regions[kind].clear();
+    }
+    if (roofline_enabled)
+    {
+        sum_thread_fp_operations (thread_id, activation.entry_fp_operations);
+        memset (&activation.nested_fp_operations, 0, sizeof (activation.nested_fp_operations));
+    }
+    if (segments_enabled)
+    {
+        sum_thread_segment_accesses (thread_id, activation.entry_segment_accesses);
+        memset (&activation.nested_segment_accesses, 0, sizeof (activation.nested_segment_accesses));
+    }
+
+    /* The allocator hooks of other threads modify outstanding_allocations and update the high-water marks of the
+     * active top-level functions with output_lock held, so the live heap at entry is read under output_lock and the
+     * activation made active before it is released. Other threads must see the new activation before it is active. */
+    PIN_GetLock (&output_lock, thread_id + 1);
+    activation.heap.entry_live_bytes = outstanding_allocations.live_bytes();
+    activation.heap.entry_live_blocks = outstanding_allocations.allocations().size();
+    activation.heap.peak_live_bytes = activation.heap.entry_live_bytes;
+    activation.heap.peak_live_blocks = activation.heap.entry_live_blocks;
+    __sync_synchronize ();
+    num_activations++;
+    PIN_ReleaseLock (&output_lock);
+    active_top_level_func_index = func_index;
+    update_access_sampling (thread_id);
+}
+
+/**
+ * @brief Add the memory profile of one kind of a thread to a combined memory profile
+ * @details The read-modify-write accesses of the thread are added to the read and write memory profiles.
+ * @param[in,out] combined The combined memory profile
+ * @param[in] activation The memory profile of the thread for the activation
+ * @param[in] kind The memory_access_kind of the memory profile
+ */
+static void merge_thread_profile (memory_regions_usage &combined, const thread_activation_profile &activation,
+                                  const UINT32 kind)
+{
+    combined.merge_from (activation.memory_regions[kind]);
+    if ((kind == MEMORY_ACCESS_READ) || (kind == MEMORY_ACCESS_WRITE))
+    {
+        combined.merge_read_modify_write_from (activation.memory_regions[MEMORY_ACCESS_READ_WRITE],
+                                               (memory_access_kind) kind);
+    }
+}
+
+/**
+ * @brief Combine the memory profiles of the threads which made accesses in an activation of a top-level function
+ * @param[in] depth The depth of the activation in activation_stack[]
+ * @param[in] kind The memory_access_kind of the memory profile
+ * @param[in] profiles The profiles of the threads which made accesses in the activation
+ * @return The combined memory profile, which is the memory profile of the thread when only one thread made accesses
+ *         and there are no read-modify-write accesses to add to a read or write memory profile
+ */
+static const memory_regions_usage &combine_thread_profiles (const UINT32 depth, const UINT32 kind,
+                                                            const std::vector<thread_profile *> &profiles)
+{
+    if ((profiles.size() == 1) &&
+        (((kind != MEMORY_ACCESS_READ) && (kind != MEMORY_ACCESS_WRITE)) ||
+         (profiles[0]->activations[depth].memory_regions[MEMORY_ACCESS_READ_WRITE].num_regions() == 0)))
+    {
+        return profiles[0]->activations[depth].memory_regions[kind];
+    }
+
+    combined_memory_regions[kind].clear();
+    for (UINT32 profile_index = 0; profile_index < profiles.size(); profile_index++)
+    {
+        merge_thread_profile (combined_memory_regions[kind], profiles[profile_index]->activations[depth], kind);
+    }
+    return combined_memory_regions[kind];
+}
+
+/**
+ * @brief Used to sort the allocations accessed in an activation by decreasing total bytes accessed
+ */
+static bool more_bytes_accessed (const trace_allocation_accesses &left, const trace_allocation_accesses &right)
+{
+    UINT64 left_bytes = 0;
+    UINT64 right_bytes = 0;
+
+    for (UINT32 kind = 0; kind < NUM_MEMORY_ACCESS_KINDS; kind++)
+    {
+        left_bytes += left.bytes[kind];
+        right_bytes += right.bytes[kind];
+    }
+
+    return (left_bytes != right_bytes) ? (left_bytes > right_bytes) : (left.data_ptr < right.data_ptr);
+}
+
+/**
+ * @brief Get the accesses made to each allocation in an activation of a top-level function
+ * @details The accesses of the threads are combined. The footprint of each allocation is the number of bytes of the
+ *          allocation which are in the accessed memory regions.
+ *          Must be called with output_lock held.
+ * @param[in] depth The depth of the activation in activation_stack[]
+ * @param[in] profiles The profiles of the threads which made accesses in the activation
+ * @param[in] exclusive_memory_regions The combined exclusive memory profile of the activation,
+ *                                     indexed by memory_access_kind
+ * @param[out] sorted_allocations The accesses to each allocation, sorted by decreasing bytes accessed
+ */
+static void get_allocation_accesses (const UINT32 depth, const std::vector<thread_profile *> &profiles,
+                                     const memory_regions_usage *const exclusive_memory_regions[],
+                                     std::vector<trace_allocation_accesses> &sorted_allocations)
+{
+    std::map<UINT64,trace_allocation_accesses> combined_allocations;
+    std::map<UINT64,trace_allocation_accesses>::iterator combined_it;
+
+    for (UINT32 profile_index = 0; profile_index < profiles.size(); profile_index++)
+    {
+        const std::vector<allocation_accesses> &allocations = profiles[profile_index]->activations[depth].allocations;
+        std::vector<allocation_accesses>::const_iterator it;
+
+        for (it = allocations.begin(); it != allocations.end(); ++it)
+        {
+            combined_it = combined_allocations.find (it->allocation.allocation_id);
+            if (combined_it == combined_allocations.end())
+            {
+                trace_allocation_accesses new_allocation;
+                const ADDRINT end_addr = it->allocation.data_ptr + it->allocation.size - 1;
+
+                new_allocation.data_ptr = it->allocation.data_ptr;
+                new_allocation.size = it->allocation.size;
+                new_allocation.allocated_in = top_level_func_names[it->allocation.allocated_in_func_index];
+                new_allocation.caller = routine_symbols.find (it->allocation.caller_ip);
+                new_allocation.stack_id = it->allocation.stack_id;
+                for (UINT32 kind = 0; kind < NUM_MEMORY_ACCESS_KINDS; kind++)
+                {
+                    new_allocation.accesses[kind] = 0;
+                    new_allocation.bytes[kind] = 0;
+                    new_allocation.footprint[kind] =
+                            exclusive_memory_regions[kind]->bytes_within (it->allocation.data_ptr, end_addr);
+                }
+                combined_it = combined_allocations.insert
+                        (std::pair<UINT64,trace_allocation_accesses> (it->allocation.allocation_id, new_allocation)).first;
+            }
+            for (UINT32 kind = 0; kind < NUM_MEMORY_ACCESS_KINDS; kind++)
+            {
+                combined_it->second.accesses[kind] += it->accesses[kind];
+                combined_it->second.bytes[kind] += it->bytes[kind];
+            }
+        }
+    }
+
+    for (combined_it = combined_allocations.begin(); combined_it != combined_allocations.end(); ++combined_it)
+    {
+        sorted_allocations.push_back (combined_it->second);
+    }
+    std::stable_sort (sorted_allocations.begin(), sorted_allocations.end(), more_bytes_accessed);
+}
+
+/** A memory profile which is output for an activation of a top-level function */
+struct activation_memory_profile
+{
+    /** Output at the start of each line of the memory profile */
+    std::string prefix;
+    const memory_regions_usage *memory_regions;
+};
+
+/**
+ * @brief Output the entries to the active top-level functions which have yet to be output, outermost first
+ * @details Must be called with output_lock held.
+ */
+static void write_pending_function_enters (void)
+{
+    for (UINT32 depth = 0; depth < num_activations; depth++)
+    {
+        top_level_activation &activation = activation_stack[depth];
+
+        if (activation.enter_pending)
+        {
+            trace_output->function_enter (top_level_func_names[activation.func_index]);
+            activation.enter_pending = false;
+        }
+    }
+}
+
+/**
+ * @brief Output the number of invocations of a top-level function which repeated the last memory profile output,
+ *        if any haven't been output
+ * @param[in] func_index Index into top_level_func_names[] for the top-level function
+ */
+static void write_invocation_repeats (const UINT32 func_index)
+{
+    invocation_aggregate &aggregate = top_level_func_aggregates[func_index];
+
+    if (aggregate.repeats > 0)
+    {
+        trace_output->invocation_repeats (top_level_func_names[func_index], aggregate.last_invocation,
+                                          aggregate.repeats);
+        aggregate.repeats = 0;
+    }
+}
+
+/**
+ * @brief Add the accesses to an allocation to the fingerprint of a memory profile
+ * @param[in] allocation The accesses to the allocation
+ * @param[in] fingerprint The fingerprint of the preceding parts of the memory profile
+ * @return The fingerprint including the allocation
+ */
+static uint64_t fingerprint_allocation_accesses (const trace_allocation_accesses &allocation, uint64_t fingerprint)
+{
+    fingerprint = trace_fingerprint (&allocation.data_ptr, sizeof (allocation.data_ptr), fingerprint);
+    fingerprint = trace_fingerprint (&allocation.size, sizeof (allocation.size), fingerprint);
+    fingerprint = trace_fingerprint (allocation.allocated_in.data(), allocation.allocated_in.size(), fingerprint);
+    fingerprint = trace_fingerprint (allocation.caller.data(), allocation.caller.size(), fingerprint);
+    fingerprint = trace_fingerprint (&allocation.stack_id, sizeof (allocation.stack_id), fingerprint);
+    fingerprint = trace_fingerprint (allocation.accesses, sizeof (allocation.accesses), fingerprint);
+    fingerprint = trace_fingerprint (allocation.bytes, sizeof (allocation.bytes), fingerprint);
+    fingerprint = trace_fingerprint (allocation.footprint, sizeof (allocation.footprint), fingerprint);
+
+    return fingerprint;
+}
+
+/**
+ * @brief Compare the memory profile of an activation against the previous invocations of the top-level function,
+ *        when the aggregate_invocations knob is set
+ * @details If the memory profile is the same as that of the last invocation output, the invocation is counted as a
+ *          repeat and isn't output. Otherwise the entry and exit are output, followed by a record of whether the
+ *          regions are output in full or only those which changed since the last full memory profile.
+ *          Must be called with output_lock held.
+ * @param[in] depth The depth of the activation in activation_stack[]
+ * @param[in] memory_profiles The memory profiles of the activation, in the order they are output
+ * @param[in] allocations The accesses to each allocation made by the activation
+ * @param[out] unchanged_fingerprints When returning true, the fingerprints of the regions which aren't output,
+ *                                    or NULL when all regions are output
+ * @return Returns true if the memory profile is to be output, or false if it repeats the last memory profile output
+ */
+static bool aggregate_activation_profile (const UINT32 depth,
+                                          const std::vector<activation_memory_profile> &memory_profiles,
+                                          const std::vector<trace_allocation_accesses> &allocations,
+                                          const std::vector<uint64_t> *&unchanged_fingerprints)
+{
+    top_level_activation &activation = activation_stack[depth];
+    const std::string &func_name = top_level_func_names[activation.func_index];
+    invocation_aggregate &aggregate = top_level_func_aggregates[activation.func_index];
+    std::vector<uint64_t> fingerprints;
+    uint64_t fingerprint = trace_fingerprint_seed;
+    trace_invocation_profile profile;
+
+    for (UINT32 profile_index = 0; profile_index < memory_profiles.size(); profile_index++)
+    {
+        memory_profiles[profile_index].memory_regions->get_region_fingerprints (memory_profiles[profile_index].prefix,
+                                                                                fingerprints);
+    }
+    if (!fingerprints.empty())
+    {
+        fingerprint = trace_fingerprint (&fingerprints[0], fingerprints.size() * sizeof (fingerprints[0]), fingerprint);
+    }
+    for (UINT32 allocation_index = 0; allocation_index < allocations.size(); allocation_index++)
+    {
+        fingerprint = fingerprint_allocation_accesses (allocations[allocation_index], fingerprint);
+    }
+    fingerprint = trace_fingerprint (&activation.heap, sizeof (activation.heap), fingerprint);
+    if (roofline_enabled)
+    {
+        fingerprint = trace_fingerprint (&activation.fp_operations, sizeof (activation.fp_operations), fingerprint);
+    }
+    if (segments_enabled)
+    {
+        fingerprint = trace_fingerprint (&activation.segment_accesses, sizeof (activation.segment_accesses),
+                                         fingerprint);
+    }
+
+    if (aggregate.profile_output && (fingerprint == aggregate.last_fingerprint))
+    {
+        aggregate.repeats++;
+        if (!activation.enter_pending)
+        {
+            /* The entry was output before the memory profile of a nested top-level function */
+            trace_output->function_exit (func_name);
+        }
+        activation.enter_pending = false;
+        return false;
+    }
+
+    write_invocation_repeats (activation.func_index);
+    write_pending_function_enters ();
+    trace_output->function_exit (func_name);
+
+    /* Count the regions which are the same as in the reference invocation */
+    std::sort (fingerprints.begin(), fingerprints.end());
+    profile.invocation = activation.invocation;
+    profile.unchanged_regions = 0;
+    if (aggregate.profile_output)
+    {
+        std::vector<uint64_t>::const_iterator it = fingerprints.begin();
+        std::vector<uint64_t>::const_iterator reference_it = aggregate.reference_fingerprints.begin();
+
+        while ((it != fingerprints.end()) && (reference_it != aggregate.reference_fingerprints.end()))
+        {
+            if (*it < *reference_it)
+            {
+                ++it;
+            }
+            else if (*reference_it < *it)
+            {
+                ++reference_it;
+            }
+            else
+            {
+                profile.unchanged_regions++;
+                ++it;
+                ++reference_it;
+            }
+        }
+    }
+
+    if ((profile.unchanged_regions > 0) && ((profile.unchanged_regions * 2) >= fingerprints.size()))
+    {
+        /* Mostly the same as the reference invocation, so only output the changed regions */
+        profile.reference_invocation = aggregate.reference_invocation;
+        profile.changed_regions = fingerprints.size() - profile.unchanged_regions;
+        profile.removed_regions = aggregate.reference_fingerprints.size() - profile.unchanged_regions;
+        unchanged_fingerprints = &aggregate.reference_fingerprints;
+    }
+    else
+    {
+        /* Output all regions, and make this the reference invocation */
+        profile.reference_invocation = profile.invocation;
+        profile.changed_regions = fingerprints.size();
+        profile.unchanged_regions = 0;
+        profile.removed_regions = 0;
+        aggregate.reference_invocation = profile.invocation;
+        aggregate.reference_fingerprints.swap (fingerprints);
+        unchanged_fingerprints = NULL;
+    }
+    trace_output->invocation_profile (func_name, profile);
+
+    aggregate.profile_output = true;
+    aggregate.last_invocation = activation.invocation;
+    aggregate.last_fingerprint = fingerprint;
+
+    return true;
+}
+
+/**
+ * @brief Output the floating point operations and memory traffic of an activation, when the roofline knob is set
+ * @details If nested top-level functions were called, the inclusive counts are output followed by the exclusive
+ *          counts, as for the memory profiles.
+ * @param[in] depth The depth of the activation in activation_stack[]
+ * @param[in] exclusive_memory_regions The combined exclusive memory profiles of the activation, indexed by
+ *                                     memory_access_kind, where the read and write profiles include the
+ *                                     read-modify-write accesses. When nested top-level functions were called,
+ *                                     inclusive_memory_regions[] holds the inclusive memory profiles.
+ */
+static void display_activation_roofline (const UINT32 depth,
+                                         const memory_regions_usage *const exclusive_memory_regions[])
+{
+    const top_level_activation &activation = activation_stack[depth];
+    const std::string prefix = top_level_func_names[activation.func_index] + ",roofline";
+    trace_roofline roofline;
+
+    if (activation.nested)
+    {
+        roofline.fp_instructions = activation.fp_operations.fp_instructions;
+        for (UINT32 width = 0; width < trace_num_vector_widths; width++)
+        {
+            roofline.flops[width] = activation.fp_operations.flops[width];
+        }
+        roofline.bytes_read = inclusive_memory_regions[MEMORY_ACCESS_READ].total_bytes_accessed();
+        roofline.bytes_written = inclusive_memory_regions[MEMORY_ACCESS_WRITE].total_bytes_accessed();
+        trace_output->roofline (prefix, roofline);
+    }
+
+    roofline.fp_instructions =
+            activation.fp_operations.fp_instructions - activation.nested_fp_operations.fp_instructions;
+    for (UINT32 width = 0; width < trace_num_vector_widths; width++)
+    {
+        roofline.flops[width] = activation.fp_operations.flops[width] - activation.nested_fp_operations.flops[width];
+    }
+    roofline.bytes_read = exclusive_memory_regions[MEMORY_ACCESS_READ]->total_bytes_accessed();
+    roofline.bytes_written = exclusive_memory_regions[MEMORY_ACCESS_WRITE]->total_bytes_accessed();
+    trace_output->roofline (activation.nested ? (prefix + " exclusive") : prefix, roofline);
+}
+
+/**
+ * @brief Output the memory traffic of an activation broken down by class of memory, when the segments knob is set
+ * @details The traffic of the dynamic class is the bytes recorded in the memory profiles. If nested top-level functions
+ *          were called, the inclusive traffic is output followed by the exclusive traffic, as for the memory profiles.
+ * @param[in] depth The depth of the activation in activation_stack[]
+ * @param[in] exclusive_memory_regions The combined exclusive memory profiles of the activation, indexed by
+ *                                     memory_access_kind, where the read and write profiles include the
+ *                                     read-modify-write accesses. When nested top-level functions were called,
+ *                                     inclusive_memory_regions[] holds the inclusive memory profiles.
+ */
+static void display_activation_segments (const UINT32 depth,
+                                         const memory_regions_usage *const exclusive_memory_regions[])
+{
+    const top_level_activation &activation = activation_stack[depth];
+    const std::string prefix = top_level_func_names[activation.func_index] + ",segments";
+    trace_segment_traffic traffic;
+
+    if (activation.nested)
+    {
+        for (UINT32 kind = 0; kind < NUM_MEMORY_ACCESS_KINDS; kind++)
+        {
+            for (UINT32 segment = 0; segment < NUM_STATIC_SEGMENTS; segment++)
+            {
+                traffic.accesses[segment][kind] = activation.segment_accesses.accesses[segment][kind];
+                traffic.bytes[segment][kind] = activation.segment_accesses.bytes[segment][kind];
+            }
+            traffic.dynamic_bytes[kind] = inclusive_memory_regions[kind].total_bytes_accessed();
+        }
+        trace_output->segment_traffic (prefix, traffic);
+    }
+
+    for (UINT32 kind = 0; kind < NUM_MEMORY_ACCESS_KINDS; kind++)
+    {
+        for (UINT32 segment = 0; segment < NUM_STATIC_SEGMENTS; segment++)
+        {
+            traffic.accesses[segment][kind] = activation.segment_accesses.accesses[segment][kind] -
+                    activation.nested_segment_accesses.accesses[segment][kind];
+            traffic.bytes[segment][kind] = activation.segment_accesses.bytes[segment][kind] -
+                    activation.nested_segment_accesses.bytes[segment][kind];
+        }
+        traffic.dynamic_bytes[kind] = exclusive_memory_regions[kind]->total_bytes_accessed();
+    }
+    trace_output->segment_traffic (activation.nested ? (prefix + " exclusive") : prefix, traffic);
+}
+
+/**
+ * @brief Output the exit from a top-level function and the memory profiles of the activation
+ * @details When more than one thread made accesses, the memory profiles of the threads are combined.
+ *          If nested top-level functions were called, the inclusive memory profile is output followed by the exclusive
+ *          memory profile. The inclusive memory profile is then added to that of the enclosing top-level function.
+ *          When the per_thread knob is set, the exclusive memory profile of each thread is also output.
+ *          When the allocation_report knob is set, the exclusive accesses to each allocation are also output.
+ *          When the aggregate_invocations knob is set, nothing is output if the memory profile repeats that of the
+ *          previous invocation, and only the changed regions may be output.
+ *          Must be called with output_lock held.
+ * @param[in] depth The depth of the activation in activation_stack[]
+ * @param[in] profiles The profiles of the threads which made accesses in the activation
+ */
+static void display_activation_profiles (const UINT32 depth, const std::vector<thread_profile *> &profiles)
+{
+    top_level_activation &activation = activation_stack[depth];
+    const std::string &func_name = top_level_func_names[activation.func_index];
+    const char *const exclusive_suffix = activation.nested ? " exclusive" : "";
+    const memory_regions_usage *combined_exclusive_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+    std::vector<activation_memory_profile> memory_profiles;
+    std::vector<trace_allocation_accesses> allocations;
+    const std::vector<uint64_t> *unchanged_fingerprints = NULL;
+    activation_memory_profile memory_profile;
+
+    for (UINT32 kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+    {
+        const std::string prefix = func_name + "," + memory_access_kind_names[kind];
+        const memory_regions_usage &exclusive_memory_regions = combine_thread_profiles (depth, kind, profiles);
+        const memory_regions_usage *outer_memory_regions = &exclusive_memory_regions;
+
+        combined_exclusive_memory_regions[kind] = &exclusive_memory_regions;
+        if (activation.nested)
+        {
+            inclusive_memory_regions[kind].clear();
+            inclusive_memory_regions[kind].merge_from (exclusive_memory_regions);
+            inclusive_memory_regions[kind].merge_from (activation.nested_memory_regions[kind]);
+            memory_profile.prefix = prefix;
+            memory_profile.memory_regions = &inclusive_memory_regions[kind];
+            memory_profiles.push_back (memory_profile);
+            outer_memory_regions = &inclusive_memory_regions[kind];
+        }
+        memory_profile.prefix = prefix + exclusive_suffix;
+        memory_profile.memory_regions = &exclusive_memory_regions;
+        memory_profiles.push_back (memory_profile);
+
+        if (depth > 0)
+        {
+            activation_stack[depth - 1].nested_memory_regions[kind].merge_from (*outer_memory_regions);
+        }
+    }
+    const UINT32 num_combined_profiles = memory_profiles.size();
+
+    if (allocation_report_enabled)
+    {
+        get_allocation_accesses (depth, profiles, combined_exclusive_memory_regions, allocations);
+    }
+
+    if (per_thread_profiles)
+    {
+        if (thread_memory_regions.size() < (profiles.size() * NUM_MEMORY_ACCESS_KINDS))
+        {
+            thread_memory_regions.resize (profiles.size() * NUM_MEMORY_ACCESS_KINDS);
+        }
+        for (UINT32 profile_index = 0; profile_index < profiles.size(); profile_index++)
+        {
+            const thread_activation_profile &thread_activation = profiles[profile_index]->activations[depth];
+
+            for (UINT32 kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+            {
+                std::ostringstream prefix;
+
+                prefix << func_name << "," << memory_access_kind_names[kind] << exclusive_suffix
+                       << ",thread=" << profiles[profile_index]->thread_id;
+                memory_profile.prefix = prefix.str();
+                memory_profile.memory_regions = &thread_activation.memory_regions[kind];
+                if (((kind == MEMORY_ACCESS_READ) || (kind == MEMORY_ACCESS_WRITE)) &&
+                    (thread_activation.memory_regions[MEMORY_ACCESS_READ_WRITE].num_regions() > 0))
+                {
+                    memory_regions_usage &thread_regions =
+                            thread_memory_regions[(profile_index * NUM_MEMORY_ACCESS_KINDS) + kind];
+
+                    thread_regions.clear();
+                    merge_thread_profile (thread_regions, thread_activation, kind);
+                    memory_profile.memory_regions = &thread_regions;
+                }
+                memory_profiles.push_back (memory_profile);
+            }
+        }
+    }
+
+    if (aggregate_invocations_enabled)
+    {
+        if (!aggregate_activation_profile (depth, memory_profiles, allocations, unchanged_fingerprints))
+        {
+            return;
+        }
+    }
+    else
+    {
+        trace_output->function_exit (func_name);
+    }
+
+    for (UINT32 profile_index = 0; profile_index < num_combined_profiles; profile_index++)
+    {
+        memory_profiles[profile_index].memory_regions->display (*trace_output, memory_profiles[profile_index].prefix,
+                                                                unchanged_fingerprints);
+    }
+    for (UINT32 allocation_index = 0; allocation_index < allocations.size(); allocation_index++)
+    {
+        trace_output->allocation_accesses (func_name, allocations[allocation_index]);
+    }
+    for (UINT32 profile_index = num_combined_profiles; profile_index < memory_profiles.size(); profile_index++)
+    {
+        memory_profiles[profile_index].memory_regions->display (*trace_output, memory_profiles[profile_index].prefix,
+                                                                unchanged_fingerprints);
+    }
+    if (roofline_enabled)
+    {
+        display_activation_roofline (depth, combined_exclusive_memory_regions);
+    }
+    if (segments_enabled)
+    {
+        display_activation_segments (depth, combined_exclusive_memory_regions);
+    }
+    trace_output->heap_statistics (func_name, activation.heap);
+}
+
+/**
+ * @brief Instrumentation function called after exit from a top-level function.
+ * @details Outputs the memory profile for the innermost activation to the trace file, and pops the activation.
+ *          Any accesses buffered by other threads are recorded by this thread. Since worker threads started by the
+ *          top-level function may still be running, the profiles of the threads are locked while they are output.
+ * @param[in] func_index Index into top_level_func_names[] for the top-level function
+ * @param[in] thread_id The Pin ID of the thread returning from the top-level function
+ */
+static void after_top_level_function (ADDRINT func_index, THREADID thread_id)
+{
+    if (num_activations == 0)
+    {
+        return;
+    }
+
+    const UINT32 depth = num_activations - 1;
+    top_level_activation &activation = activation_stack[depth];
+
+    if (activation.thread_id != thread_id)
+    {
+        return;
+    }
+    if (activation.ignored_calls > 0)
+    {
+        activation.ignored_calls--;
+        return;
+    }
+    if (activation.func_index != func_index)
+    {
+        return;
+    }
+
+    if (roofline_enabled)
+    {
+        /* The inclusive operations of the activation are passed to the enclosing top-level function, whether or not
+         * the activation is sampled, since a sampled nested activation may have counted operations */
+        fp_operation_counts &operations = activation.fp_operations;
+
+        sum_thread_fp_operations (thread_id, operations);
+        operations.fp_instructions -= activation.entry_fp_operations.fp_instructions;
+        for (UINT32 width = 0; width < trace_num_vector_widths; width++)
+        {
+            operations.flops[width] -= activation.entry_fp_operations.flops[width];
+        }
+        if (depth > 0)
+        {
+            fp_operation_counts &nested_operations = activation_stack[depth - 1].nested_fp_operations;
+
+            nested_operations.fp_instructions += operations.fp_instructions;
+            for (UINT32 width = 0; width < trace_num_vector_widths; width++)
+            {
+                nested_operations.flops[width] += operations.flops[width];
+            }
+        }
+    }
+    if (segments_enabled)
+    {
+        /* As for the floating point operations, the inclusive accesses are added to the enclosing activation */
+        segment_access_counts &accesses = activation.segment_accesses;
+
+        sum_thread_segment_accesses (thread_id, accesses);
+        for (UINT32 segment = 0; segment < NUM_STATIC_SEGMENTS; segment++)
+        {
+            for (UINT32 kind = 0; kind < NUM_MEMORY_ACCESS_KINDS; kind++)
+            {
+                accesses.accesses[segment][kind] -= activation.entry_segment_accesses.accesses[segment][kind];
+                accesses.bytes[segment][kind] -= activation.entry_segment_accesses.bytes[segment][kind];
+                if (depth > 0)
+                {
+                    segment_access_counts &nested_accesses = activation_stack[depth - 1].nested_segment_accesses;
+
+                    nested_accesses.accesses[segment][kind] += accesses.accesses[segment][kind];
+                    nested_accesses.bytes[segment][kind] += accesses.bytes[segment][kind];
+                }
+            }
+        }
+    }
+
+    if (activation.sampled)
+    {
+        std::vector<thread_profile *> active_profiles;
+        std::vector<thread_profile *>::const_iterator it;
+
+        process_all_access_buffers (thread_id);
+        write_access_trace_marker (thread_id, top_level_func_names[func_index], false);
+        PIN_GetLock (&thread_profiles_lock, thread_id + 1);
+        for (it = thread_profiles.begin(); it != thread_profiles.end(); ++it)
+        {
+            lock_thread_profile (*it);
+            if ((*it)->activations[depth].invocation_count == activation.invocation_count)
+            {
+                active_profiles.push_back (*it);
+            }
+            else
+            {
+                unlock_thread_profile (*it);
+            }
+        }
+        PIN_ReleaseLock (&thread_profiles_lock);
+
+        PIN_GetLock (&output_lock, thread_id + 1);
+        activation.heap.exit_live_bytes = outstanding_allocations.live_bytes();
+        activation.heap.exit_live_blocks = outstanding_allocations.allocations().size();
+        display_activation_profiles (depth, active_profiles);
+        PIN_ReleaseLock (&output_lock);
+        for (it = active_profiles.begin(); it != active_profiles.end(); ++it)
+        {
+            unlock_thread_profile (*it);
+        }
+    }
+    else if ((depth > 0) && activation.nested)
+    {
+        /* Pass the inclusive profiles of sampled nested top-level functions to the enclosing top-level function */
+        for (UINT32 kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+        {
+            activation_stack[depth - 1].nested_memory_regions[kind].merge_from (activation.nested_memory_regions[kind]);
+        }
+    }
+
+    num_activations--;
+    if (num_activations > 0)
+    {
+        active_top_level_func_index = activation_stack[num_activations - 1].func_index;
+    }
+    else
+    {
+        active_top_level_func_index = -1;
+    }
+    update_access_sampling (thread_id);
+}
+
+/**
+ * @brief Output a sample of the live heap, for the heap timeline
+ * @details Must be called with output_lock held.
+ */
+static void output_heap_sample (void)
+{
+    heap_timeline_current.instructions = heap_timeline_instructions;
+    trace_output->heap_sample (heap_timeline_current);
+    heap_timeline_current.peak_live_bytes = heap_timeline_current.live_bytes;
+    heap_timeline_changed = false;
+    heap_timeline_next_sample = heap_timeline_current.instructions + heap_timeline_interval;
+}
+
+/**
+ * @brief Update the high-water marks of the live heap of the active top-level functions, and the heap timeline,
+ *        following a possible change to the outstanding allocations
+ * @details The high-water marks of all active top-level functions are updated, so that the high-water mark of an
+ *          enclosing top-level function includes those of nested top-level functions.
+ *          When the heap timeline is enabled and a sample is due, the sample is output with the live heap before the
+ *          change, so that the sample covers the changes up to the end of its interval.
+ *          Must be called with output_lock held.
+ */
+static void update_live_heap (void)
+{
+    const UINT64 live_bytes = outstanding_allocations.live_bytes();
+    const UINT64 live_blocks = outstanding_allocations.allocations().size();
+
+    for (UINT32 depth = 0; depth < num_activations; depth++)
+    {
+        trace_heap_statistics &heap = activation_stack[depth].heap;
+
+        heap.peak_live_bytes = std::max (heap.peak_live_bytes, live_bytes);
+        heap.peak_live_blocks = std::max (heap.peak_live_blocks, live_blocks);
+    }
+
+    if (heap_timeline_enabled &&
+        ((live_bytes != heap_timeline_current.live_bytes) || (live_blocks != heap_timeline_current.live_blocks)))
+    {
+        if (heap_timeline_changed && (heap_timeline_instructions >= heap_timeline_next_sample))
+        {
+            output_heap_sample ();
+        }
+        heap_timeline_current.live_bytes = live_bytes;
+        heap_timeline_current.live_blocks = live_blocks;
+        heap_timeline_current.peak_live_bytes = std::max (heap_timeline_current.peak_live_bytes, live_bytes);
+        heap_timeline_changed = true;
+    }
+}
+
+/**
+ * @brief Record a memory allocation as outstanding
+ * @details Must be called with output_lock held, while a top-level function is active.
+ * @param[in] data_ptr The allocated memory pointer
+ * @param[in] size The size of the allocation
+ * @param[in] caller_ip Return IP for the memory allocation function call
+ * @param[in] stack_id The call stack of the memory allocation function call
+ */
+static void insert_outstanding_allocation (const ADDRINT data_ptr, const ADDRINT size, const ADDRINT caller_ip,
+                                           const UINT32 stack_id)
+{
+    allocation_info allocation;
+
+    allocation.data_ptr = data_ptr;
+    allocation.size = size;
+    allocation.allocation_id = next_allocation_id++;
+    allocation.allocated_in_func_index = active_top_level_func_index;
+    allocation.caller_ip = caller_ip;
+    allocation.stack_id = stack_id;
+
+    PIN_RWMutexWriteLock (&outstanding_allocations_lock);
+    outstanding_allocations.insert (allocation);
+    __atomic_add_fetch (&outstanding_allocations_generation, 1, __ATOMIC_RELEASE);
+    PIN_RWMutexUnlock (&outstanding_allocations_lock);
+}
+
+/**
+ * @brief Remove an allocation from the outstanding allocations and trace that it has been freed
+ * @details Must be called with output_lock held, while a top-level function is active.
+ * @param[in] function The allocator function which freed the allocation
+ * @param[in] data_ptr The allocation being freed
+ * @param[in] caller_ip Return IP for the allocator function call
+ * @param[in] stack_id The call stack of the allocator function call
+ */
+static void free_outstanding_allocation (const allocator_function &function, const ADDRINT data_ptr,
+                                         const ADDRINT caller_ip, const UINT32 stack_id)
+{
+    bool size_known;
+    ADDRINT size = 0;
+
+    PIN_RWMutexWriteLock (&outstanding_allocations_lock);
+    size_known = outstanding_allocations.erase (data_ptr, size);
+    if (size_known)
+    {
+        __atomic_add_fetch (&outstanding_allocations_generation, 1, __ATOMIC_RELEASE);
+    }
+    PIN_RWMutexUnlock (&outstanding_allocations_lock);
+    update_live_heap ();
+
+    trace_output->free_event (top_level_func_names[active_top_level_func_index], function.trace_name, data_ptr,
+                              size_known, size, routine_symbols.find (caller_ip), stack_id);
+}
+
+/**
+ * @brief Remove an unmapped address range from the outstanding allocations and trace the unmapping
+ * @details Must be called with output_lock held, while a top-level function is active.
+ * @param[in] function The allocator function which unmapped the range
+ * @param[in] start_addr The start of the address range
+ * @param[in] length The length of the address range
+ * @param[in] caller_ip Return IP for the allocator function call
+ * @param[in] stack_id The call stack of the allocator function call
+ */
+static void unmap_outstanding_allocations (const allocator_function &function, const ADDRINT start_addr,
+                                           const ADDRINT length, const ADDRINT caller_ip, const UINT32 stack_id)
+{
+    PIN_RWMutexWriteLock (&outstanding_allocations_lock);
+    if (outstanding_allocations.erase_range (start_addr, length))
+    {
+        __atomic_add_fetch (&outstanding_allocations_generation, 1, __ATOMIC_RELEASE);
+    }
+    PIN_RWMutexUnlock (&outstanding_allocations_lock);
+    update_live_heap ();
+
+    trace_output->free_event (top_level_func_names[active_top_level_func_index], function.trace_name, start_addr,
+                              true, length, routine_symbols.find (caller_ip), stack_id);
+}
+
+/**
+ * @brief Update the outstanding allocations for the result of an allocator function, and trace the allocation
+ * @details Must be called with output_lock held, while a top-level function is active.
+ * @param[in] call The state saved at entry to the function
+ * @param[in] return_value The return value of the function
+ */
+static void complete_allocator_call (const allocator_call &call, const ADDRINT return_value)
+{
+    const allocator_function &function = allocator_functions[call.function_index];
+    const std::string &func_name = top_level_func_names[active_top_level_func_index];
+    ADDRINT size = (function.size_arg >= 0) ? call.args[function.size_arg] : 0;
+    ADDRINT data_ptr = return_value;
+
+    if (function.count_arg >= 0)
+    {
+        size *= call.args[function.count_arg];
+    }
+
+    switch (function.action)
+    {
+    case ALLOCATOR_ALLOCATE:
+        if ((data_ptr != function.failure_value) && (data_ptr != 0))
+        {
+            insert_outstanding_allocation (data_ptr, size, call.return_ip, call.stack_id);
+            trace_output->allocation_event (func_name, function.trace_name, size, data_ptr,
+                                            routine_symbols.find (call.return_ip), call.stack_id);
+        }
+        break;
+
+    case ALLOCATOR_ALIGNED_ALLOCATE:
+    case ALLOCATOR_POSIX_MEMALIGN:
+        if (function.action == ALLOCATOR_POSIX_MEMALIGN)
+        {
+            /* The allocation is stored through the first argument when the function returns zero */
+            if ((return_value != 0) ||
+                (PIN_SafeCopy (&data_ptr, (const VOID *) call.args[function.ptr_arg], sizeof (data_ptr)) !=
+                 sizeof (data_ptr)))
+            {
+                data_ptr = 0;
+            }
+        }
+        if ((data_ptr != function.failure_value) && (data_ptr != 0))
+        {
+            insert_outstanding_allocation (data_ptr, size, call.return_ip, call.stack_id);
+            trace_output->aligned_allocation_event (func_name, function.trace_name, call.args[function.alignment_arg],
+                                                    size, data_ptr, routine_symbols.find (call.return_ip),
+                                                    call.stack_id);
+        }
+        break;
+
+    case ALLOCATOR_REALLOCATE:
+        /* On failure the existing allocation is unchanged, except that realloc() with a zero size frees it */
+        if (((data_ptr != function.failure_value) && (data_ptr != 0)) || ((size == 0) && (function.failure_value == 0)))
+        {
+            const ADDRINT old_data_ptr = call.args[function.ptr_arg];
+            bool old_size_known = false;
+            ADDRINT old_size = 0;
+
+            if (data_ptr == function.failure_value)
+            {
+                data_ptr = 0;
+            }
+            PIN_RWMutexWriteLock (&outstanding_allocations_lock);
+            if ((old_data_ptr != 0) && outstanding_allocations.erase (old_data_ptr, old_size))
+            {
+                old_size_known = true;
+                __atomic_add_fetch (&outstanding_allocations_generation, 1, __ATOMIC_RELEASE);
+            }
+            PIN_RWMutexUnlock (&outstanding_allocations_lock);
+            if (data_ptr != 0)
+            {
+                insert_outstanding_allocation (data_ptr, size, call.return_ip, call.stack_id);
+            }
+            trace_output->reallocation_event (func_name, function.trace_name, old_data_ptr, old_size_known, old_size,
+                                              size, data_ptr, routine_symbols.find (call.return_ip), call.stack_id);
+        }
+        break;
+
+    case ALLOCATOR_FREE:
+    case ALLOCATOR_UNMAP:
+        /* Handled at entry to the function, before the memory can be re-allocated by another thread */
+        break;
+    }
+
+    update_live_heap ();
+}
+
+/**
+ * @brief Capture the call stack of an allocator function call
+ * @details The backtrace from the context at entry to the allocator function may start with the entry point of the
+ *          function, so the frames before the return IP are skipped. If the return IP isn't found in the backtrace,
+ *          such as when the caller has no frame information, the call stack is just the return IP.
+ * @param[in] ctxt The register state at entry to the allocator function
+ * @param[in] return_ip Return IP for the allocator function call
+ * @param[out] stack_frames The instruction addresses of the frames of the call stack, innermost first
+ * @return The number of frames in the call stack
+ */
+static UINT32 capture_call_stack (const CONTEXT *const ctxt, const ADDRINT return_ip, UINT64 stack_frames[])
+{
+    void *backtrace_frames[max_allocation_stack_depth + 1];
+    const INT32 num_backtrace_frames = PIN_Backtrace (ctxt, backtrace_frames, allocation_stack_depth + 1);
+    INT32 first_frame = 0;
+    UINT32 num_stack_frames = 0;
+
+    while ((first_frame < num_backtrace_frames) && ((ADDRINT) backtrace_frames[first_frame] != return_ip))
+    {
+        first_frame++;
+    }
+    if (first_frame == num_backtrace_frames)
+    {
+        stack_frames[num_stack_frames++] = return_ip;
+    }
+    for (INT32 frame = first_frame; (frame < num_backtrace_frames) && (num_stack_frames < allocation_stack_depth);
+         frame++)
+    {
+        stack_frames[num_stack_frames++] = (ADDRINT) backtrace_frames[frame];
+    }
+
+    return num_stack_frames;
+}
+
+/**
+ * @brief Intern the call stack of an allocator function call, symbolising the frames which are new
+ * @details Must be called with output_lock held.
+ * @param[in] stack_frames The instruction addresses of the frames of the call stack, innermost first
+ * @param[in] num_stack_frames The number of frames in the call stack
+ * @return The stack ID of the call stack in allocation_call_stacks
+ */
+static UINT32 intern_call_stack (const UINT64 stack_frames[], const UINT32 num_stack_frames)
+{
+    const UINT32 stack_id = allocation_call_stacks.intern (stack_frames, num_stack_frames);
+
+    while (allocation_call_stack_symbols.size() < allocation_call_stacks.num_stacks())
+    {
+        const UINT32 new_stack_id = allocation_call_stack_symbols.size();
+
+        allocation_call_stack_symbols.push_back (routine_symbols.find (allocation_call_stacks.ip (new_stack_id)));
+    }
+
+    return stack_id;
+}
+
+/**
+ * @brief Instrumentation function called at entry to an allocator function, to save the arguments used when the
+ *        function returns
+ * @details The call is pushed on the allocator_calls[] of the thread. When this is the outermost allocator function
+ *          call, a free or unmap is traced at entry and the call stack is captured when the allocation_stacks knob
+ *          is set.
+ * @param[in] thread_id The Pin ID of the thread calling the function
+ * @param[in] function_index Index into allocator_functions[] for the function
+ * @param[in] stack_ptr The stack pointer at entry to the function
+ * @param[in] arg0 The first argument of the function
+ * @param[in] arg1 The second argument of the function
+ * @param[in] arg2 The third argument of the function
+ * @param[in] return_ip Return IP for the function call, which is traced
+ * @param[in] ctxt The register state at entry to the function, or NULL when call stacks aren't captured
+ */
+static void before_allocator_function (THREADID thread_id, UINT32 function_index, ADDRINT stack_ptr,
+                                       ADDRINT arg0, ADDRINT arg1, ADDRINT arg2, ADDRINT return_ip,
+                                       const CONTEXT *ctxt)
+{
+    thread_profile *const profile = get_thread_profile (thread_id);
+    const allocator_function &function = allocator_functions[function_index];
+    UINT32 stack_id = empty_call_stack_id;
+
+    /* Discard any calls which were abandoned without returning, e.g. by longjmp(). A call with the same stack pointer
+     * is a tail call from the previous function, so isn't discarded. */
+    while ((profile->num_allocator_calls > 0) &&
+           (profile->allocator_calls[profile->num_allocator_calls - 1].stack_ptr < stack_ptr))
+    {
+        profile->num_allocator_calls--;
+    }
+
+    if ((profile->num_allocator_calls == 0) && (active_top_level_func_index != -1))
+    {
+        UINT64 stack_frames[max_allocation_stack_depth];
+        const UINT32 num_stack_frames = (ctxt != NULL) ? capture_call_stack (ctxt, return_ip, stack_frames) : 0;
+
+        if ((num_stack_frames > 0) || (function.action == ALLOCATOR_FREE) || (function.action == ALLOCATOR_UNMAP))
+        {
+            PIN_GetLock (&output_lock, thread_id + 1);
+            stack_id = intern_call_stack (stack_frames, num_stack_frames);
+            if (function.action == ALLOCATOR_FREE)
+            {
+                free_outstanding_allocation (function, arg0, return_ip, stack_id);
+            }
+            else if (function.action == ALLOCATOR_UNMAP)
+            {
+                unmap_outstanding_allocations (function, arg0, arg1, return_ip, stack_id);
+            }
+            PIN_ReleaseLock (&output_lock);
+        }
+    }
+
+    if (profile->num_allocator_calls < max_allocator_calls)
+    {
+        allocator_call &call = profile->allocator_calls[profile->num_allocator_calls];
+
+        call.function_index = function_index;
+        call.stack_ptr = stack_ptr;
+        call.args[0] = arg0;
+        call.args[1] = arg1;
+        call.args[2] = arg2;
+        call.return_ip = return_ip;
+        call.stack_id = stack_id;
+        profile->num_allocator_calls++;
+    }
+}
+
+/**
+ * @brief Instrumentation function called on return from an allocator function
+ * @details Pops the call from the allocator_calls[] of the thread. When the function was tail called from other
+ *          allocator functions, which then don't return themselves, those calls are also popped. When the outermost
+ *          allocator function call returns the outstanding allocations are updated.
+ * @param[in] thread_id The Pin ID of the thread returning from the function
+ * @param[in] function_index Index into allocator_functions[] for the function
+ * @param[in] stack_ptr The stack pointer at the return, which is the same as at entry to the function
+ * @param[in] return_value The return value from the function
+ */
+static void after_allocator_function (THREADID thread_id, UINT32 function_index, ADDRINT stack_ptr,
+                                      ADDRINT return_value)
+{
+    thread_profile *const profile = get_thread_profile (thread_id);
+
+    /* Discard any calls which were abandoned without returning */
+    while ((profile->num_allocator_calls > 0) &&
+           (profile->allocator_calls[profile->num_allocator_calls - 1].stack_ptr < stack_ptr))
+    {
+        profile->num_allocator_calls--;
+    }
+
+    if ((profile->num_allocator_calls == 0) ||
+        (profile->allocator_calls[profile->num_allocator_calls - 1].stack_ptr != stack_ptr) ||
+        (profile->allocator_calls[profile->num_allocator_calls - 1].function_index != function_index))
+    {
+        /* Not a call which was pushed, such as when max_allocator_calls was exceeded */
+        return;
+    }
+
+    /* Pop the call, and any calls which tail called it from the same stack frame */
+    do
+    {
+        profile->num_allocator_calls--;
+    } while ((profile->num_allocator_calls > 0) &&
+             (profile->allocator_calls[profile->num_allocator_calls - 1].stack_ptr == stack_ptr));
+
+    if ((profile->num_allocator_calls == 0) && (active_top_level_func_index != -1))
+    {
+        PIN_GetLock (&output_lock, thread_id + 1);
+        complete_allocator_call (profile->allocator_calls[0], return_value);
+        PIN_ReleaseLock (&output_lock);
+    }
+}
+
+/**
+ * @brief Match a string against a pattern containing wildcards
+ * @details The wildcards are * for any sequence of characters, ? for any single character and [] for a set of
+ *          characters, where the set may contain ranges and is negated by a leading !.
+ * @param[in] pattern The pattern to match
+ * @param[in] text The string to match against the pattern
+ * @return Returns true if the whole of text matches pattern
+ */
+static bool wildcard_match (const char *pattern, const char *text)
+{
+    const char *star_pattern = NULL;
+    const char *star_text = NULL;
+
+    while (*text != '\0')
+    {
+        bool matched = false;
+        const char *next_pattern = pattern + 1;
+
+        if (*pattern == '*')
+        {
+            /* Initially match an empty sequence, and backtrack to here to match longer sequences */
+            star_pattern = pattern++;
+            star_text = text;
+            continue;
+        }
+        else if (*pattern == '?')
+        {
+            matched = true;
+        }
+        else if (*pattern == '[')
+        {
+            const bool negated = next_pattern[0] == '!';
+            const char *set = negated ? (next_pattern + 1) : next_pattern;
+            bool in_set = false;
+
+            /* A ] as the first character of the set is a member of the set */
+            while (*set != '\0')
+            {
+                if ((set[1] == '-') && (set[2] != ']') && (set[2] != '\0'))
+                {
+                    in_set = in_set || ((*text >= set[0]) && (*text <= set[2]));
+                    set += 3;
+                }
+                else
+                {
+                    in_set = in_set || (*text == set[0]);
+                    set++;
+                }
+                if (*set == ']')
+                {
+                    break;
+                }
+            }
+
+            if (*set == ']')
+            {
+                matched = in_set != negated;
+                next_pattern = set + 1;
+            }
+            else
+            {
+                /* An unterminated set is treated as a literal [ */
+                matched = *text == '[';
+            }
+        }
+        else
+        {
+            matched = *pattern == *text;
+        }
+
+        if (matched && (*pattern != '\0'))
+        {
+            pattern = next_pattern;
+            text++;
+        }
+        else if (star_pattern != NULL)
+        {
+            pattern = star_pattern + 1;
+            text = ++star_text;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (*pattern == '*')
+    {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+/**
+ * @brief Add a top-level function pattern
+ * @param[in] pattern The pattern in the form [image_pattern:]function_pattern, where a :: in function_pattern
+ *                    isn't treated as the image separator
+ */
+static void add_top_level_function_pattern (const std::string &pattern)
+{
+    top_level_function_pattern new_pattern;
+    size_t separator = pattern.find (':');
+
+    while ((separator != std::string::npos) && ((separator + 1) < pattern.size()) && (pattern[separator + 1] == ':'))
+    {
+        separator = pattern.find (':', separator + 2);
+    }
+    if (separator != std::string::npos)
+    {
+        new_pattern.image_pattern = pattern.substr (0, separator);
+        new_pattern.function_pattern = pattern.substr (separator + 1);
+    }
+    else
+    {
+        new_pattern.function_pattern = pattern;
+    }
+
+    if (new_pattern.function_pattern.find_first_of ("*?[") == std::string::npos)
+    {
+        top_level_function_names_index.insert (std::make_pair (new_pattern.function_pattern, new_pattern.image_pattern));
+    }
+    else
+    {
+        top_level_function_wildcard_patterns.push_back (new_pattern);
+    }
+}
+
+/**
+ * @brief Read the top-level function patterns from the command line options and the optional file
+ * @details If no patterns are specified, the top-level functions of the FFTW_example program are used.
+ * @return Returns true if the patterns were read, or false if the file couldn't be read
+ */
+static bool read_top_level_function_patterns (void)
+{
+    for (UINT32 pattern_index = 0; pattern_index < top_level_function_patterns.NumberOfValues(); pattern_index++)
+    {
+        const std::string pattern = top_level_function_patterns.Value (pattern_index);
+
+        if (!pattern.empty())
+        {
+            add_top_level_function_pattern (pattern);
+        }
+    }
+
+    if (!top_level_functions_filename.Value().empty())
+    {
+        std::ifstream patterns_file (top_level_functions_filename.Value().c_str());
+        std::string line;
+
+        if (!patterns_file.is_open())
+        {
+            cerr << "Unable to open " << top_level_functions_filename.Value() << endl;
+            return false;
+        }
+        while (std::getline (patterns_file, line))
+        {
+            const size_t first = line.find_first_not_of (" \t\r");
+            const size_t last = line.find_last_not_of (" \t\r");
+
+            if ((first != std::string::npos) && (line[first] != '#'))
+            {
+                add_top_level_function_pattern (line.substr (first, last - first + 1));
+            }
+        }
+    }
+
+    if (top_level_function_names_index.empty() && top_level_function_wildcard_patterns.empty())
+    {
+        for (UINT32 func_index = 0;
+             func_index < (sizeof (default_top_level_functions) / sizeof (default_top_level_functions[0])); func_index++)
+        {
+            add_top_level_function_pattern (default_top_level_functions[func_index]);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Determine if a routine is selected as a top-level function by the patterns
+ * @param[in] image_file_name The file name of the image containing the routine, without any directory
+ * @param[in] func_name The name of the routine
+ * @return Returns true if the routine is a top-level function
+ */
+static bool is_top_level_function (const std::string &image_file_name, const std::string &func_name)
+{
+    typedef std::multimap<std::string,std::string>::const_iterator names_index_iterator;
+    const std::pair<names_index_iterator,names_index_iterator> names = top_level_function_names_index.equal_range (func_name);
+    names_index_iterator name_it;
+    std::vector<top_level_function_pattern>::const_iterator pattern_it;
+
+    for (name_it = names.first; name_it != names.second; ++name_it)
+    {
+        if (name_it->second.empty() || wildcard_match (name_it->second.c_str(), image_file_name.c_str()))
+        {
+            return true;
+        }
+    }
+
+    for (pattern_it = top_level_function_wildcard_patterns.begin();
+         pattern_it != top_level_function_wildcard_patterns.end(); ++pattern_it)
+    {
+        if ((pattern_it->image_pattern.empty() || wildcard_match (pattern_it->image_pattern.c_str(), image_file_name.c_str())) &&
+            wildcard_match (pattern_it->function_pattern.c_str(), func_name.c_str()))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Called at image load to insert instrumentation for a "top level" function in the program under test
+ * @details The memory profile is gathered for each "top level" function, where top level functions may be nested.
+ * @param[in] routine The routine for the top-level function
+ */
+static void hook_top_level_function (RTN routine)
+{
+    const size_t func_index = top_level_func_names.size();
+
+    if (top_level_func_addrs.find (RTN_Address (routine)) != top_level_func_addrs.end())
+    {
+        /* Already hooked, from an alias of the same routine */
+        return;
+    }
+
+    top_level_func_names.push_back (RTN_Name (routine));
+    top_level_func_invocations.push_back (0);
+    top_level_func_sampled_invocations.push_back (0);
+    top_level_func_aggregates.push_back (invocation_aggregate ());
+    top_level_func_aggregates.back().profile_output = false;
+    top_level_func_aggregates.back().repeats = 0;
+    top_level_func_addrs.insert (RTN_Address (routine));
+
+    RTN_Open (routine);
+    RTN_InsertCall (routine, IPOINT_BEFORE, (AFUNPTR) before_top_level_function,
+                    IARG_ADDRINT, func_index,
+                    IARG_THREAD_ID,
+                    IARG_END);
+    RTN_InsertCall (routine, IPOINT_AFTER, (AFUNPTR) after_top_level_function,
+                    IARG_ADDRINT, func_index,
+                    IARG_THREAD_ID,
+                    IARG_END);
+    RTN_Close (routine);
+}
+
+/**
+ * @brief Called at image load to insert instrumentation for all routines in the image selected as top-level functions
+ * @param[in] image The image being loaded
+ */
+static void hook_top_level_functions (IMG image)
+{
+    const std::string &image_name = IMG_Name (image);
+    const size_t directory_end = image_name.rfind ('/');
+    const std::string image_file_name =
+            (directory_end != std::string::npos) ? image_name.substr (directory_end + 1) : image_name;
+
+    for (SEC section = IMG_SecHead (image); SEC_Valid (section); section = SEC_Next (section))
+    {
+        for (RTN routine = SEC_RtnHead (section); RTN_Valid (routine); routine = RTN_Next (routine))
+        {
+            if (is_top_level_function (image_file_name, RTN_Name (routine)))
+            {
+                hook_top_level_function (routine);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Called at image load to insert instrumentation for the allocator functions defined in the image
+ * @details Functions which are aliases for an already instrumented function, such as mmap64() for mmap(),
+ *          are skipped so the function isn't instrumented twice.
+ */
+static void hook_memory_allocation (IMG image)
+{
+    std::set<ADDRINT> hooked_addrs;
+
+    for (UINT32 function_index = 0; function_index < num_allocator_functions; function_index++)
+    {
+        RTN allocator_rtn = RTN_FindByName (image, allocator_functions[function_index].symbol_name);
+
+        if (RTN_Valid (allocator_rtn) && hooked_addrs.insert (RTN_Address (allocator_rtn)).second)
+        {
+            RTN_Open (allocator_rtn);
+            if (allocation_stacks_enabled)
+            {
+                RTN_InsertCall (allocator_rtn, IPOINT_BEFORE, (AFUNPTR) before_allocator_function,
+                                IARG_THREAD_ID,
+                                IARG_UINT32, function_index,
+                                IARG_REG_VALUE, REG_STACK_PTR,
+                                IARG_FUNCARG_ENTRYPOINT_VALUE, 0,
+                                IARG_FUNCARG_ENTRYPOINT_VALUE, 1,
+                                IARG_FUNCARG_ENTRYPOINT_VALUE, 2,
+                                IARG_RETURN_IP,
+                                IARG_CONST_CONTEXT,
+                                IARG_END);
+            }
+            else
+            {
+                /* The context is only passed when needed, since it adds to the cost of each call */
+                RTN_InsertCall (allocator_rtn, IPOINT_BEFORE, (AFUNPTR) before_allocator_function,
+                                IARG_THREAD_ID,
+                                IARG_UINT32, function_index,
+                                IARG_REG_VALUE, REG_STACK_PTR,
+                                IARG_FUNCARG_ENTRYPOINT_VALUE, 0,
+                                IARG_FUNCARG_ENTRYPOINT_VALUE, 1,
+                                IARG_FUNCARG_ENTRYPOINT_VALUE, 2,
+                                IARG_RETURN_IP,
+                                IARG_PTR, NULL,
+                                IARG_END);
+            }
+            RTN_InsertCall (allocator_rtn, IPOINT_AFTER, (AFUNPTR) after_allocator_function,
+                            IARG_THREAD_ID,
+                            IARG_UINT32, function_index,
+                            IARG_REG_VALUE, REG_STACK_PTR,
+                            IARG_FUNCRET_EXITPOINT_VALUE,
+                            IARG_END);
+            RTN_Close (allocator_rtn);
+        }
+    }
+}
+
+/**
+ * @brief Called at image load to add the routines in the image to routine_symbols
+ * @param[in] image The image being loaded
+ */
+static void cache_routine_symbols (IMG image)
+{
+    PIN_GetLock (&output_lock, PIN_ThreadId () + 1);
+    for (SEC section = IMG_SecHead (image); SEC_Valid (section); section = SEC_Next (section))
+    {
+        for (RTN routine = SEC_RtnHead (section); RTN_Valid (routine); routine = RTN_Next (routine))
+        {
+            routine_symbols.add_symbol (RTN_Address (routine), RTN_Size (routine), RTN_Name (routine));
+        }
+    }
+    PIN_ReleaseLock (&output_lock);
+}
+
+/**
+ * @brief Called on a image load to instrument the top-level and memory allocation functions
+ * @param[in] image The image being loaded
+ * @param[in] arg Instrumentation context - not used
+ */
+static void image_insert_calls (IMG image, void *arg)
+{
+    cache_routine_symbols (image);
+    hook_top_level_functions (image);
+    hook_memory_allocation (image);
+}
+
+/**
+ * @brief Called on an image unload to remove the routines in the image from routine_symbols
+ * @param[in] image The image being unloaded
+ * @param[in] arg Instrumentation context - not used
+ */
+static void image_unload (IMG image, void *arg)
+{
+    PIN_GetLock (&output_lock, PIN_ThreadId () + 1);
+    routine_symbols.remove_symbols (IMG_LowAddress (image), IMG_HighAddress (image));
+    PIN_ReleaseLock (&output_lock);
+}
 
-    /* @todo Hard coded as sysconf (_SC_LEVEL1_DCACHE_LINESIZE) is not supported by the PinCRT */
-    static const ADDRINT cache_line_size = 64;
+/**
+ * @brief Called when a thread starts to create the memory profile for the thread
+ * @param[in] thread_id The Pin ID of the thread
+ * @param[in,out] ctxt The initial register state of the thread, used to set the tool register for the profile
+ * @param[in] flags OS specific thread flags - not used
+ * @param[in] arg Instrumentation context - not used
+ */
+static void thread_start (THREADID thread_id, CONTEXT *ctxt, INT32 flags, void *arg)
+{
+    thread_profile *const profile = new thread_profile;
 
-    /**
-     * @details
-     *  Called when an instruction memory access extends the upper address of an existing region,
-     *  to check when the region extends to a new cache line at a higher address.
-     * @param[in,out] it Iterator referencing the region being extended
-     * @param[in] access_end_addr The end address of the memory access
-     */
-    inline void update_addr_inc_cache_line_counts (region_iter &it, const ADDRINT access_end_addr)
+    profile->thread_id = thread_id;
+    profile->lock = 0;
+    for (UINT32 depth = 0; depth < max_activation_depth; depth++)
     {
-        const ADDRINT previous_end_cache_line = it->second.region_end_addr / cache_line_size;
-        const ADDRINT access_end_cache_line = access_end_addr / cache_line_size;
-
-        if (access_end_cache_line > previous_end_cache_line)
-        {
-            it->second.cache_line_increments++;
-        }
+        profile->activations[depth].invocation_count = 0;
+    }
+    profile->access_buffer_count = 0;
+    profile->access_buffer_start = 0;
+    profile->num_cached_allocations = 0;
+    profile->allocation_cache_generation = 0;
+    profile->allocation_cache_invocation_count = 0;
+    if (buffered_accesses)
+    {
+        profile->access_buffer = new buffered_access[access_buffer_size];
+        profile->sorted_access_buffer = new buffered_access[access_buffer_size];
+    }
+    else
+    {
+        profile->access_buffer = NULL;
+        profile->sorted_access_buffer = NULL;
     }
+    profile->num_allocator_calls = 0;
+    if (cache_simulation_enabled)
+    {
+        std::string error;
 
-    /**
-     * @details
-     *  Called when an instruction memory access extends the lower address of an existing region,
-     *  to check when the region extends to a new cache line at a lower address.
-     * @param[in,out] it Iterator referencing the region being extended
-     * @param[in] access_start_addr The start address of the memory access
-     */
-    inline void update_addr_dec_cache_line_counts (region_iter &it, const ADDRINT access_start_addr)
+        profile->caches = new cache_hierarchy;
+        profile->caches->configure (cache_simulation_config, error);
+    }
+    else
+    {
+        profile->caches = NULL;
+    }
+    profile->reuse_distances = reuse_distance_enabled ? new reuse_distance_analyser (cache_line_size_config) : NULL;
+    if (page_footprint_enabled)
     {
-        const ADDRINT previous_start_cache_line = it->first / cache_line_size;
-        const ADDRINT access_start_cache_line = access_start_addr / cache_line_size;
+        std::string error;
 
-        if (access_start_cache_line < previous_start_cache_line)
-        {
-            it->second.cache_line_decrements++;
-        }
+        profile->tlbs = new tlb_simulator;
+        profile->tlbs->configure (tlb_entries, tlb_ways, error);
+    }
+    else
+    {
+        profile->tlbs = NULL;
     }
+    profile->access_trace_buffer = access_trace_enabled ? new access_trace_access[access_trace_buffer_size] : NULL;
+    profile->access_trace_count = 0;
+    memset (&profile->fp_operations, 0, sizeof (profile->fp_operations));
+    memset (&profile->segment_accesses, 0, sizeof (profile->segment_accesses));
 
-    /**
-     * @brief Called after each instruction memory access to update the count of memory accesses
-     * @param[in,out] region The region to update the counter for
-     * @param[in] bytes_accessed How many bytes were accessed by the instruction
-     */
-    inline void update_access_counts (region_info &region, const UINT32 bytes_accessed)
+    PIN_SetThreadData (thread_profile_key, profile, thread_id);
+    PIN_SetContextReg (ctxt, thread_profile_reg, (ADDRINT) profile);
+
+    PIN_GetLock (&thread_profiles_lock, thread_id + 1);
+    thread_profiles.push_back (profile);
+    PIN_ReleaseLock (&thread_profiles_lock);
+}
+
+/**
+ * @brief Called when a thread exits, to record any memory accesses buffered by the thread
+ * @details The profile is retained, so the accesses are included in the output on exit from the top-level function.
+ *          When the access_trace knob is set, the accesses saved for the raw access trace are also written.
+ * @param[in] thread_id The Pin ID of the thread
+ * @param[in] ctxt The final register state of the thread - not used
+ * @param[in] code The exit code of the thread - not used
+ * @param[in] arg Instrumentation context - not used
+ */
+static void thread_fini (THREADID thread_id, const CONTEXT *ctxt, INT32 code, void *arg)
+{
+    if (buffered_accesses || access_trace_enabled)
     {
-        region.total_bytes += bytes_accessed;
-        if (bytes_accessed <= max_mem_access_size)
+        PIN_GetLock (&thread_profiles_lock, thread_id + 1);
+        if (buffered_accesses)
         {
-            region.mem_access_size_counts[bytes_accessed]++;
+            process_access_buffer (get_thread_profile (thread_id));
         }
-        else
+        if (access_trace_enabled)
         {
-            region.mem_access_size_counts[0]++;
+            thread_profile *const profile = get_thread_profile (thread_id);
+
+            lock_thread_profile (profile);
+            write_access_trace (profile);
+            unlock_thread_profile (profile);
         }
+        PIN_ReleaseLock (&thread_profiles_lock);
     }
-};
-
-/** Used to record the memory regions read/written by the current active top level function */
-static memory_regions_usage read_memory_regions;
-static memory_regions_usage write_memory_regions;
-
-/** Used to record the memory regions prefetched using cache-hint instructions by the current active top level function */
-static memory_regions_usage prefetch_memory_regions;
+}
 
 /**
- * @brief Clear the memory profile
+ * @brief Called at program exit to display memory allocations which have not been explicitly freed.
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
  */
-void memory_regions_usage::clear(void)
+static void display_outstanding_allocations (INT32 code, void *arg)
 {
-    memory_regions.clear();
+    std::vector<allocation_info>::const_iterator it;
+    std::vector<trace_outstanding_allocation> allocations;
+
+    for (it = outstanding_allocations.allocations().begin(); it != outstanding_allocations.allocations().end(); ++it)
+    {
+        allocations.push_back (trace_outstanding_allocation (it->data_ptr, it->size));
+    }
+    trace_output->outstanding_allocations (allocations);
 }
 
 /**
- * @brief Called when an instruction reads or write memory to update the memory profile
- * @param[in] access_start_address Start address read or written
- * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ * @brief Called at program exit to display how effective the cached regions were at avoiding searches of the regions
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
  */
-void memory_regions_usage::record_access (const ADDRINT access_start_addr, const UINT32 bytes_accessed)
+static void display_region_cache_statistics (INT32 code, void *arg)
 {
-    const ADDRINT access_end_addr = access_start_addr + bytes_accessed - 1;
-    region_info new_region;
-    region_iter begin_it, end_it, current_it, next_it;
-    bool region_processed = false;
-    bool region_addrs_changed = false;
-    bool region_merge_complete;
-    ADDRINT modified_start_addr = access_start_addr;
-    ADDRINT modified_end_addr = access_end_addr;
-    UINT32 mem_access_size;
+    memory_regions_usage total_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+    std::vector<thread_profile *>::const_iterator it;
 
-    if (!memory_regions.empty())
+    for (it = thread_profiles.begin(); it != thread_profiles.end(); ++it)
     {
-        /* Determine if the memory access overlaps any existing region */
-        begin_it = memory_regions.lower_bound (access_start_addr);
-        if (begin_it != memory_regions.begin())
-        {
-            --begin_it;
-        }
-        end_it = memory_regions.upper_bound(access_end_addr + 1);
-        for (current_it = begin_it; !region_processed && (current_it != end_it); ++current_it)
+        for (UINT32 depth = 0; depth < max_activation_depth; depth++)
         {
-            if ((access_start_addr < current_it->first) && (access_end_addr >= current_it->first))
-            {
-                /* The memory access overlaps the beginning of an existing region */
-                update_addr_dec_cache_line_counts (current_it, access_start_addr);
-                new_region = current_it->second;
-                update_access_counts (new_region, bytes_accessed);
-                if (access_end_addr > new_region.region_end_addr)
-                {
-                    new_region.region_end_addr = access_end_addr;
-                }
-                memory_regions.erase (current_it);
-                memory_regions[access_start_addr] = new_region;
-                end_it = memory_regions.upper_bound(access_end_addr + 1);
-                region_processed = true;
-                region_addrs_changed = true;
-                modified_end_addr = new_region.region_end_addr;
-            }
-            else if ((access_start_addr >= current_it->first) && (access_end_addr <= current_it->second.region_end_addr))
-            {
-                /* The memory access is entirely within an existing region */
-                update_access_counts (current_it->second, bytes_accessed);
-                region_processed = true;
-            }
-            else if ((access_start_addr <= current_it->second.region_end_addr) &&
-                     (access_end_addr > current_it->second.region_end_addr))
-            {
-                /* The memory access overlaps the end of an existing region */
-                update_addr_inc_cache_line_counts (current_it, access_end_addr);
-                current_it->second.region_end_addr = access_end_addr;
-                update_access_counts (current_it->second, bytes_accessed);
-                region_processed = true;
-                region_addrs_changed = true;
-                modified_start_addr = current_it->first;
-            }
-            else
+            for (UINT32 kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
             {
-                /* Update cache line counts for a memory access which will be combined with an adjacent region */
-                if (access_start_addr == (current_it->second.region_end_addr + 1))
-                {
-                    update_addr_inc_cache_line_counts (current_it, access_end_addr);
-                }
-                if ((access_end_addr + 1) == current_it->first)
-                {
-                    update_addr_dec_cache_line_counts (current_it, access_start_addr);
-                }
+                total_memory_regions[kind].add_region_cache_statistics ((*it)->activations[depth].memory_regions[kind]);
             }
         }
     }
-
-    if (!region_processed)
+    for (UINT32 kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
     {
-        /* Insert as a new region */
-        new_region.region_end_addr = access_end_addr;
-        new_region.total_bytes = 0;
-        new_region.cache_line_increments = 0;
-        new_region.cache_line_decrements = 0;
-        memset (&new_region.mem_access_size_counts, 0, sizeof (new_region.mem_access_size_counts));
-        update_access_counts (new_region, bytes_accessed);
-        memory_regions[access_start_addr] = new_region;
-        region_addrs_changed = true;
+        total_memory_regions[kind].display_region_cache_statistics
+                (*trace_output, std::string ("N/A,") + memory_access_kind_names[kind]);
     }
+}
 
-    if (region_addrs_changed)
-    {
-        /* Combine adjacent regions */
-        begin_it = memory_regions.lower_bound (modified_start_addr);
-        if (begin_it != memory_regions.begin())
-        {
-            --begin_it;
-        }
+/**
+ * @brief Called at program exit to display the stride learnt for each memory operand of each instruction which made
+ *        accesses while a top-level function was active, in order of instruction address
+ * @details The stride of a read-modify-write operand is output for both the read and the write.
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
+ */
+static void display_instruction_strides (INT32 code, void *arg)
+{
+    std::map<std::pair<ADDRINT,UINT32>,instruction_stride_entry *>::const_iterator it;
+    trace_instruction_stride stride;
 
-        current_it = begin_it;
-        next_it = current_it;
-        if (next_it != memory_regions.end())
-        {
-            ++next_it;
-        }
-        region_merge_complete = false;
-        while ((next_it != memory_regions.end()) && !region_merge_complete)
+    for (it = instruction_strides.begin(); it != instruction_strides.end(); ++it)
+    {
+        it->second->detector.get_statistics (cache_line_size, stride);
+        if (stride.samples > 0)
         {
-            while ((next_it != memory_regions.end()) && ((current_it->second.region_end_addr + 1) >= next_it->first))
-            {
-                /* Regions are adjacent - so combine */
-                current_it->second.region_end_addr = next_it->second.region_end_addr;
-                current_it->second.total_bytes += next_it->second.total_bytes;
-                current_it->second.cache_line_increments += next_it->second.cache_line_increments;
-                current_it->second.cache_line_decrements += next_it->second.cache_line_decrements;
-                for (mem_access_size = 0; mem_access_size <= max_mem_access_size; mem_access_size++)
-                {
-                    current_it->second.mem_access_size_counts[mem_access_size] +=
-                            next_it->second.mem_access_size_counts[mem_access_size];
-                }
-                memory_regions.erase (next_it);
-                next_it = current_it;
-                ++next_it;
-            }
-
-            ++current_it;
-            next_it = current_it;
-            ++next_it;
-            if (current_it != memory_regions.end())
+            stride.ip = it->first.first;
+            stride.routine = it->second->routine;
+            stride.access_kind = it->first.second % NUM_MEMORY_OPERAND_KINDS;
+            if (stride.access_kind == MEMORY_ACCESS_READ_WRITE)
             {
-                region_merge_complete = current_it->first > modified_end_addr;
+                stride.access_kind = MEMORY_ACCESS_READ;
+                trace_output->instruction_stride ("N/A", stride);
+                stride.access_kind = MEMORY_ACCESS_WRITE;
             }
+            trace_output->instruction_stride ("N/A", stride);
         }
     }
 }
 
 /**
- * @brief Output the the trace file the read or write memory profile
- * @param[in] prefix Output at the start of each line of trace output to identify the top-level function and if read or write
+ * @brief Called at program exit to display the memory traffic of the instructions which made accesses while a top-level
+ *        function was active, when the instruction_traffic knob is set
+ * @details The traffic counted by each thread for each memory operand is rolled up to the source line of the
+ *          instruction, and the source lines output in order of decreasing bytes accessed.
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
  */
-void memory_regions_usage::display (const std::string &prefix)
+static void display_instruction_traffic (INT32 code, void *arg)
 {
-    std::map<ADDRINT,region_info>::const_iterator it;
-    ADDRINT previous_end_addr = 0;
-    bool first_region = true;
-    UINT32 mem_access_size;
+    if (!instruction_traffic_enabled)
+    {
+        return;
+    }
+
+    source_line_traffic source_lines (cache_line_size);
+    std::map<std::pair<ADDRINT,UINT32>,instruction_stride_entry *>::const_iterator it;
+    std::vector<thread_profile *>::const_iterator thread_it;
+    instruction_source_location location;
 
-    for (it = memory_regions.begin(); it != memory_regions.end(); ++it)
+    for (it = instruction_strides.begin(); it != instruction_strides.end(); ++it)
     {
-        trace_file << prefix << ",start_addr=" << it->first << ",end_addr=" << it->second.region_end_addr
-                << ",size=" << (it->second.region_end_addr - it->first + 1)
-                << ",total_bytes_accessed=" << it->second.total_bytes;
-        if (it->second.cache_line_increments > 0)
-        {
-            trace_file << ",cache_line_increments=" << it->second.cache_line_increments;
-        }
-        if (it->second.cache_line_decrements > 0)
-        {
-            trace_file << ",cache_line_decrements=" << it->second.cache_line_decrements;
-        }
-        if (it->second.mem_access_size_counts[0] > 0)
-        {
-            trace_file << ",unknown size accesses=" << it->second.mem_access_size_counts[0];
-        }
-        for (mem_access_size = 1; mem_access_size <= max_mem_access_size; mem_access_size++)
-        {
-            if (it->second.mem_access_size_counts[mem_access_size] > 0)
-            {
-                trace_file << "," << dec << mem_access_size << hex << " byte accesses="
-                        << it->second.mem_access_size_counts[mem_access_size];
-            }
-        }
-        trace_file << endl;
-        if (first_region)
-        {
-            first_region = false;
-        }
-        else
+        const UINT32 traffic_index = it->second->traffic_index;
+
+        location.routine = it->second->routine;
+        location.file = it->second->source_file;
+        location.line = it->second->source_line;
+        for (thread_it = thread_profiles.begin(); thread_it != thread_profiles.end(); ++thread_it)
         {
-            if ((previous_end_addr + 1) == it->first)
+            if (traffic_index < (*thread_it)->operand_traffic.size())
             {
-                trace_file << prefix << ",**ERROR** merge of adjacent regions failed" << endl;
+                source_lines.add_operand (it->first.first, location, (*thread_it)->operand_traffic[traffic_index]);
             }
         }
-        previous_end_addr = it->second.region_end_addr;
     }
+    source_lines.display (*trace_output, "N/A");
 }
 
 /**
- * @brief Analysis function called when an instruction reads or writes memory
- * @details When a top-level function is active updates the memory profile
- * @param[in,out] memory_regions The read or write memory regions to update
- * @param[in] memory_addr The memory address being read or written
- * @param[in] bytes_accessed The number of bytes read or written by the instruction
+ * @brief Used to sort the writes to shared cache lines by top-level function index, and then by decreasing number of
+ *        shared writes
  */
-static void memory_access_analysis (memory_regions_usage *const memory_regions, ADDRINT memory_addr, UINT32 bytes_accessed)
+static bool more_cache_line_sharing (const std::pair<UINT32,trace_cache_line_sharing> &left,
+                                     const std::pair<UINT32,trace_cache_line_sharing> &right)
 {
-    if (active_top_level_func_index != -1)
+    const UINT64 left_writes = left.second.false_sharing + left.second.true_sharing;
+    const UINT64 right_writes = right.second.false_sharing + right.second.true_sharing;
+
+    if (left.first != right.first)
+    {
+        return left.first < right.first;
+    }
+    if (left_writes != right_writes)
     {
-        memory_regions->record_access (memory_addr, bytes_accessed);
+        return left_writes > right_writes;
     }
+
+    return (left.second.ip != right.second.ip) ? (left.second.ip < right.second.ip) :
+                                                 (left.second.data_ptr < right.second.data_ptr);
 }
 
 /**
- * @brief Is called for every instruction and instruments memory reads and writes
- * @details When a top-level function is active updates the memory read / write profiles for the top-level function.
+ * @brief Called at program exit to display the writes to cache lines last written by another thread, when the
+ *        false_sharing knob is set
+ * @details The writes detected by each thread are combined, and output for each top-level function, instruction and
+ *          allocation in order of decreasing number of shared writes.
+ * @param[in] code Exit status from program - not used
  * @param[in] arg Instrumentation context - not used
  */
-static void instrument_memory_access (INS ins, void *arg)
+static void display_cache_line_sharing (INT32 code, void *arg)
 {
-    /* Instruments memory accesses using a predicated call, i.e.
-       the instrumentation is called if the instruction will actually be executed.
+    if (!false_sharing_enabled)
+    {
+        return;
+    }
 
-       On the IA-32 and Intel(R) 64 architectures conditional moves and REP
-       prefixed instructions appear as predicated instructions in Pin. */
-    UINT32 mem_operands = INS_MemoryOperandCount(ins);
+    std::map<cache_line_sharing_key,cache_line_sharing_counts> combined;
+    std::map<cache_line_sharing_key,cache_line_sharing_counts>::const_iterator it;
+    std::map<cache_line_sharing_key,cache_line_sharing_counts>::iterator combined_it;
+    std::vector<thread_profile *>::const_iterator thread_it;
+    std::vector<std::pair<UINT32,trace_cache_line_sharing> > sorted;
 
-    /* Iterate over each memory operand of the instruction. */
-    for (UINT32 mem_op = 0; mem_op < mem_operands; mem_op++)
+    for (thread_it = thread_profiles.begin(); thread_it != thread_profiles.end(); ++thread_it)
     {
-        if (INS_IsPrefetch (ins))
-        {
-            INS_InsertPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) memory_access_analysis,
-                                      IARG_PTR, &prefetch_memory_regions,
-                                      IARG_MEMORYOP_EA, mem_op,
-                                      IARG_MEMORYREAD_SIZE,
-                                      IARG_END);
-        }
-        else
+        for (it = (*thread_it)->cache_line_sharing.begin(); it != (*thread_it)->cache_line_sharing.end(); ++it)
         {
-            if (INS_MemoryOperandIsRead (ins, mem_op))
+            combined_it = combined.find (it->first);
+            if (combined_it == combined.end())
             {
-                INS_InsertPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) memory_access_analysis,
-                                          IARG_PTR, &read_memory_regions,
-                                          IARG_MEMORYOP_EA, mem_op,
-                                          IARG_MEMORYREAD_SIZE,
-                                          IARG_END);
+                combined.insert (*it);
             }
-
-            /* Note that in some architectures a single memory operand can be
-               both read and written (for instance incl (%eax) on IA-32)
-               In that case we instrument it once for read and once for write. */
-            if (INS_MemoryOperandIsWritten (ins, mem_op))
+            else
             {
-                INS_InsertPredicatedCall (ins, IPOINT_BEFORE, (AFUNPTR) memory_access_analysis,
-                                          IARG_PTR, &write_memory_regions,
-                                          IARG_MEMORYOP_EA, mem_op,
-                                          IARG_MEMORYWRITE_SIZE,
-                                          IARG_END);
+                combined_it->second.false_sharing += it->second.false_sharing;
+                combined_it->second.true_sharing += it->second.true_sharing;
+                combined_it->second.lines.insert (it->second.lines.begin(), it->second.lines.end());
             }
         }
     }
+
+    for (it = combined.begin(); it != combined.end(); ++it)
+    {
+        trace_cache_line_sharing sharing;
+
+        sharing.ip = it->first.ip;
+        sharing.routine = it->second.routine;
+        sharing.data_ptr = it->second.allocation.data_ptr;
+        sharing.size = it->second.allocation.size;
+        sharing.caller = (sharing.size > 0) ? routine_symbols.find (it->second.allocation.caller_ip) : "";
+        sharing.stack_id = it->second.allocation.stack_id;
+        sharing.false_sharing = it->second.false_sharing;
+        sharing.true_sharing = it->second.true_sharing;
+        sharing.lines = it->second.lines.size();
+        sorted.push_back (std::pair<UINT32,trace_cache_line_sharing> (it->first.func_index, sharing));
+    }
+
+    std::sort (sorted.begin(), sorted.end(), more_cache_line_sharing);
+    for (UINT32 index = 0; index < sorted.size(); index++)
+    {
+        trace_output->cache_line_sharing (top_level_func_names[sorted[index].first], sorted[index].second);
+    }
 }
 
 /**
- * @brief Instrumentation function called before entry to a top-level function.
- * @details Traces entry to the top-level function and re-initialises the memory profile to empty.
- * @param[in] func_index Index into top_level_func_names[] for the top-level function
+ * @brief Called at program exit to output the invocations of each top-level function which repeated the last memory
+ *        profile output and haven't been output, when the aggregate_invocations knob is set
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
  */
-static void before_top_level_function (ADDRINT func_index)
+static void display_invocation_repeats (INT32 code, void *arg)
 {
-   if (active_top_level_func_index == -1)
-   {
-       trace_file << top_level_func_names[func_index] << ",enter" << endl;
-       read_memory_regions.clear();
-       write_memory_regions.clear();
-       prefetch_memory_regions.clear();
-       active_top_level_func_index = func_index;
-   }
+    if (!aggregate_invocations_enabled)
+    {
+        return;
+    }
+
+    for (UINT32 func_index = 0; func_index < top_level_func_names.size(); func_index++)
+    {
+        write_invocation_repeats (func_index);
+    }
 }
 
 /**
- * @brief Instrumentation function called after exit from a top-level function.
- * @details Outputs the memory profile for the top-level function to the trace file.
- * @param[in] func_index Index into top_level_func_names[] for the top-level function
+ * @brief Called at program exit to display how many invocations of each top-level function, and how many
+ *        instructions, were sampled, when sampling is enabled
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
  */
-static void after_top_level_function (ADDRINT func_index)
+static void display_sampling_statistics (INT32 code, void *arg)
 {
-    if (active_top_level_func_index == (INT32) func_index)
+    if (!sampling_enabled)
     {
-        trace_file << top_level_func_names[func_index] << ",exit" << endl;
-        read_memory_regions.display(top_level_func_names[func_index] + ",memory read");
-        write_memory_regions.display(top_level_func_names[func_index] + ",memory write");
-        prefetch_memory_regions.display(top_level_func_names[func_index] + ",memory prefetch");
-        active_top_level_func_index = -1;
+        return;
+    }
+
+    for (UINT32 func_index = 0; func_index < top_level_func_names.size(); func_index++)
+    {
+        trace_output->sampling_statistics (top_level_func_names[func_index], top_level_func_invocations[func_index],
+                                           top_level_func_sampled_invocations[func_index]);
+    }
+    if (burst_sampling_enabled)
+    {
+        /* Include the partial phase at exit */
+        const UINT64 phase_instructions = burst_phase_instructions - burst_phase_remaining;
+
+        trace_output->burst_sampling_statistics (burst_total_instructions + phase_instructions,
+                                                 burst_sampled_instructions + (in_sample_burst ? phase_instructions : 0));
     }
 }
 
 /**
- * @brief Instrumentation function called before malloc() to save parameters used in after_malloc()
- * @param[in] size malloc() parameter for the requested size to be allocated
- * @param[in] return_ip Return IP for malloc() call, which is traced
+ * @brief Called at program exit to display the call stacks of the allocations, when the allocation_stacks knob is set
+ * @details Each call stack is output after the call stack of its callers, so can be built in one pass.
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
  */
-static void before_malloc (ADDRINT size, ADDRINT return_ip)
+static void display_allocation_call_stacks (INT32 code, void *arg)
 {
-    malloc_requested_size = size;
-    malloc_return_ip = return_ip;
+    for (UINT32 stack_id = empty_call_stack_id + 1; stack_id < allocation_call_stacks.num_stacks(); stack_id++)
+    {
+        trace_output->call_stack_frame (stack_id, allocation_call_stacks.parent (stack_id),
+                                        allocation_call_stacks.ip (stack_id), allocation_call_stack_symbols[stack_id]);
+    }
 }
 
 /**
- * @brief Instrumentation function called after malloc()
- * @details Traces the memory allocation, and records the allocation as outstanding.
- *          Only takes action when a top-level function is active.
- * @param[in] data_ptr Return value from malloc(), i.e. if non-zero the allocated memory pointer
+ * @brief Called at program exit to output the final sample of the live heap, when the heap_timeline_interval knob is
+ *        non-zero and the live heap has changed since the previous sample
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
  */
-static void after_malloc (ADDRINT data_ptr)
+static void display_heap_timeline (INT32 code, void *arg)
 {
-    if ((active_top_level_func_index != -1) && (data_ptr != 0))
+    if (heap_timeline_changed)
     {
-        outstanding_allocations[data_ptr] = malloc_requested_size;
-        trace_file << top_level_func_names[active_top_level_func_index] << ",malloc,size=" << malloc_requested_size
-                << ",data_ptr=" << data_ptr << ",caller=" << RTN_FindNameByAddress (malloc_return_ip) << endl;
+        output_heap_sample ();
     }
-    malloc_requested_size = 0;
-    malloc_return_ip = 0;
 }
 
 /**
- * @brief Instrumention function called before memalign() to save parameters used in after_malloc()
- * @param[in] boundary memalign() parameter for the alignment
- * @param[in] size memalign() parameter for the allocation size
- * @param[in] return_ip Return IP for memalign() call, which is traced
+ * @brief Called when the application is about to exit, to stop the writer thread for the trace
+ * @details Pin internal threads must exit before the Fini functions are called. Any trace output from the Fini
+ *          functions is written directly to the trace file.
+ * @param[in] arg Instrumentation context - not used
  */
-static void before_memalign (ADDRINT boundary, ADDRINT size, ADDRINT return_ip)
+static void stop_trace_output (void *arg)
 {
-    memalign_boundary = boundary;
-    memalign_requested_size = size;
-    memalign_return_ip = return_ip;
+    trace_output_sink->stop_writer_thread ();
 }
 
 /**
- * @brief Instrumentation function called after memalign()
- * @details Traces the memory allocation, and records the allocation as outstanding.
- *          Only takes action when a top-level function is active.
- * @param[in] data_ptr Return value from memalign(), i.e. if non-zero the allocated memory pointer
+ * @brief Called at program exit, after the other Fini functions, to complete the trace file and the raw access trace
+ * @param[in] code Exit status from program - not used
+ * @param[in] arg Instrumentation context - not used
  */
-static void after_memalign (ADDRINT data_ptr)
+static void close_trace_file (INT32 code, void *arg)
 {
-    if ((active_top_level_func_index != -1) && (data_ptr != 0))
+    if (trace_stream_sink != NULL)
     {
-        outstanding_allocations[data_ptr] = memalign_requested_size;
-        trace_file << top_level_func_names[active_top_level_func_index] << ",memalign,boundary=" << memalign_boundary
-                << ",size=" << memalign_requested_size
-                << ",data_ptr=" << data_ptr << ",caller=" << RTN_FindNameByAddress (memalign_return_ip) << endl;
+        trace_stream_sink->close ();
+    }
+    else
+    {
+        trace_file.close ();
+    }
+    if (access_trace_enabled)
+    {
+        access_trace_file.close ();
     }
-
-    memalign_boundary = 0;
-    memalign_requested_size = 0;
-    memalign_return_ip = 0;
 }
 
 /**
- * @brief Instrumentation function called before free()
- * @details Traces the buffer which is being freed, and removes the buffer from the outstanding allocations.
- *          if the buffer is on the list of outstanding allocations, also traces the size of the allocation being freed.
- *          Only takes action when a top-level function is active.
- * @param[in] data_ptr Data buffer being freed
- * @param[in] return_ip Return IP for free() call, which is traced
+ * @brief Set the configuration of the simulated cache hierarchy, reuse distance measurement, stride analysis and
+ *        page footprint from the knobs
+ * @details The configuration is checked once, so that the hierarchy and TLBs of each thread can be configured without
+ *          error.
+ * @return Returns true if the configuration is valid for the enabled analyses
  */
-static void before_free (ADDRINT data_ptr, ADDRINT return_ip)
+static bool configure_cache_analysis (void)
 {
-    if (active_top_level_func_index != -1)
+    const std::string level_configs[cache_num_levels] =
+    {
+        cache_l1d_config.Value(), cache_l2_config.Value(), cache_llc_config.Value()
+    };
+    const std::string tlb_configs[trace_num_page_sizes] =
     {
-        std::map<ADDRINT,ADDRINT>::iterator it;
-        trace_file << top_level_func_names[active_top_level_func_index] << ",free,data_ptr=" << data_ptr << ",size=";
-        it = outstanding_allocations.find (data_ptr);
-        if (it != outstanding_allocations.end())
+        dtlb_4k_config.Value(), dtlb_2m_config.Value()
+    };
+    memory_regions_config regions_config;
+    cache_hierarchy caches;
+    tlb_simulator tlbs;
+    std::string error;
+
+    cache_simulation_enabled = cache_simulation;
+    reuse_distance_enabled = reuse_distance;
+    stride_analysis_enabled = stride_analysis;
+    page_footprint_enabled = page_footprint_knob;
+    instruction_traffic_enabled = instruction_traffic_knob;
+    false_sharing_enabled = false_sharing_knob;
+    cache_line_size = cache_line_size_config;
+    if ((reuse_distance_enabled || stride_analysis_enabled || page_footprint_enabled || instruction_traffic_enabled) &&
+        ((cache_line_size_config == 0) || ((cache_line_size_config & (cache_line_size_config - 1)) != 0) ||
+         (cache_line_size_config > (1U << trace_page_shifts[0]))))
+    {
+        cerr << "Invalid cache line size " << cache_line_size_config << endl;
+        return false;
+    }
+    regions_config.cache_simulation = cache_simulation_enabled;
+    regions_config.reuse_distance = reuse_distance_enabled;
+    regions_config.page_footprint = page_footprint_enabled;
+    regions_config.line_size = cache_line_size;
+    memory_regions_usage::configure (regions_config);
+    if (false_sharing_enabled && !shared_lines.configure (cache_line_size_config, false_sharing_table_lines, error))
+    {
+        cerr << "Invalid false sharing configuration: " << error << endl;
+        return false;
+    }
+    if (page_footprint_enabled)
+    {
+        for (UINT32 page_size = 0; page_size < trace_num_page_sizes; page_size++)
         {
-            trace_file << it->second;
-            outstanding_allocations.erase (it);
+            if (!parse_cache_level_config (tlb_configs[page_size], tlb_entries[page_size], tlb_ways[page_size]))
+            {
+                cerr << "Invalid TLB configuration " << tlb_configs[page_size] << endl;
+                return false;
+            }
         }
-        else
+        if (!tlbs.configure (tlb_entries, tlb_ways, error))
         {
-            trace_file << "???";
+            cerr << "Invalid TLB configuration: " << error << endl;
+            return false;
         }
-        trace_file << ",caller=" << RTN_FindNameByAddress (return_ip) << endl;
     }
-}
-
-/**
- * @brief Called at image load to insert instrumentation for a "top level" function in the program under test
- * @details The memory profile is gather for each "top level" function, where the top level functions are assumed
- *          to be called in series, i.e. not nested.
- * @param[in] image The image being loaded
- */
-static void hook_top_level_function (IMG image, const char *func_name)
-{
-    const size_t func_index = top_level_func_names.size();
-    RTN routine = RTN_FindByName (image, func_name);
-
-    if (RTN_Valid (routine))
+    if (!cache_simulation_enabled)
     {
-        RTN_Open (routine);
-        RTN_InsertCall (routine, IPOINT_BEFORE, (AFUNPTR) before_top_level_function,
-                        IARG_ADDRINT, func_index,
-                        IARG_END);
-        RTN_InsertCall (routine, IPOINT_AFTER, (AFUNPTR) after_top_level_function,
-                        IARG_ADDRINT, func_index,
-                        IARG_END);
-        RTN_Close (routine);
-
-        top_level_func_names.push_back (func_name);
+        return true;
     }
-}
 
-/**
- * @brief Called at image load to insert instrumentation for the malloc() and free() memory allocation functions
- */
-static void hook_memory_allocation (IMG image)
-{
-    RTN malloc_rtn = RTN_FindByName (image, "malloc");
-    if (RTN_Valid (malloc_rtn))
+    for (UINT32 level = 0; level < cache_num_levels; level++)
     {
-        RTN_Open (malloc_rtn);
-        RTN_InsertCall (malloc_rtn, IPOINT_BEFORE, (AFUNPTR) before_malloc,
-                        IARG_FUNCARG_ENTRYPOINT_VALUE, 0,
-                        IARG_RETURN_IP,
-                        IARG_END);
-        RTN_InsertCall (malloc_rtn, IPOINT_AFTER, (AFUNPTR) after_malloc,
-                        IARG_FUNCRET_EXITPOINT_VALUE,
-                        IARG_END);
-        RTN_Close (malloc_rtn);
+        if (!parse_cache_level_config (level_configs[level], cache_simulation_config.level_sizes[level],
+                                       cache_simulation_config.level_ways[level]))
+        {
+            cerr << "Invalid cache configuration " << level_configs[level] << endl;
+            return false;
+        }
     }
-
-    RTN memalign_rtn = RTN_FindByName (image, "memalign");
-    if (RTN_Valid (memalign_rtn))
+    cache_simulation_config.line_size = cache_line_size_config;
+    if (cache_replacement.Value() == "lru")
     {
-        RTN_Open (memalign_rtn);
-        RTN_InsertCall (memalign_rtn, IPOINT_BEFORE, (AFUNPTR) before_memalign,
-                        IARG_FUNCARG_ENTRYPOINT_VALUE, 0,
-                        IARG_FUNCARG_ENTRYPOINT_VALUE, 1,
-                        IARG_RETURN_IP,
-                        IARG_END);
-        RTN_InsertCall (memalign_rtn, IPOINT_AFTER, (AFUNPTR) after_memalign,
-                        IARG_FUNCRET_EXITPOINT_VALUE,
-                        IARG_END);
-        RTN_Close (memalign_rtn);
+        cache_simulation_config.replacement_policy = CACHE_REPLACEMENT_LRU;
+    }
+    else if (cache_replacement.Value() == "plru")
+    {
+        cache_simulation_config.replacement_policy = CACHE_REPLACEMENT_PLRU;
     }
+    else
+    {
+        cerr << "Invalid cache replacement policy " << cache_replacement.Value() << endl;
+        return false;
+    }
+    cache_simulation_config.next_line_prefetch = cache_next_line_prefetch;
 
-    RTN free_rtn = RTN_FindByName (image, "free");
-    if (RTN_Valid (free_rtn))
+    if (!caches.configure (cache_simulation_config, error))
     {
-        RTN_Open (free_rtn);
-        RTN_InsertCall (free_rtn, IPOINT_BEFORE, (AFUNPTR) before_free,
-                        IARG_FUNCARG_ENTRYPOINT_VALUE, 0,
-                        IARG_RETURN_IP,
-                        IARG_END);
-        RTN_Close (free_rtn);
+        cerr << "Invalid cache configuration: " << error << endl;
+        return false;
     }
+
+    return true;
 }
 
 /**
- * @brief Called on a image load to instrument fixed functions
- * @param[in] image The image being loaded
- * @param[in] arg Instrumentation context - not used
+ * @brief Set the sampling of invocations and instructions from the knobs
+ * @return Returns true if the sampling configuration is valid
  */
-static void image_insert_calls (IMG image, void *arg)
+static bool configure_sampling (void)
 {
-    hook_top_level_function (image, "fft_initialise");
-    hook_top_level_function (image, "set_fft_data");
-    hook_top_level_function (image, "copy_input_data");
-    hook_top_level_function (image, "fft_execute");
-    hook_top_level_function (image, "fft_free");
-    hook_memory_allocation (image);
+    if (sample_every == 0)
+    {
+        cerr << "Invalid sample_every of zero" << endl;
+        return false;
+    }
+    burst_sampling_enabled = sample_burst_instructions > 0;
+    if (burst_sampling_enabled && (sample_burst_instructions >= sample_burst_period))
+    {
+        cerr << "sample_burst_instructions must be less than sample_burst_period" << endl;
+        return false;
+    }
+    sampling_enabled = (sample_every > 1) || (sample_first > 0) || burst_sampling_enabled;
+    in_sample_burst = true;
+    burst_phase_instructions = sample_burst_instructions;
+    burst_phase_remaining = burst_phase_instructions;
+
+    return true;
 }
 
 /**
- * @brief Called at program exit to display memory allocations which have not been explicitly freed.
- * @param[in] code Exit status from program - not used
- * @param[in] arg Instrumentation context - not used
+ * @brief Set the capture of allocation call stacks from the knobs
+ * @return Returns true if the configuration is valid
  */
-static void display_outstanding_allocations (INT32 code, void *arg)
+static bool configure_allocation_stacks (void)
 {
-    std::map<ADDRINT,ADDRINT>::const_iterator it;
-
-    trace_file << "N/A,outstanding_allocations";
-    for (it = outstanding_allocations.begin(); it != outstanding_allocations.end(); ++it)
+    allocation_stacks_enabled = allocation_stacks;
+    if (allocation_stacks_enabled &&
+        ((allocation_stack_depth == 0) || (allocation_stack_depth > max_allocation_stack_depth)))
     {
-        trace_file << "," << it->first << "(" << it->second << ")";
+        cerr << "allocation_stack_depth must be between 1 and " << max_allocation_stack_depth << endl;
+        return false;
     }
-    trace_file << endl;
+
+    return true;
 }
 
 /**
@@ -670,7 +4820,7 @@ static void display_outstanding_allocations (INT32 code, void *arg)
  */
 static INT32 Usage()
 {
-    cerr << "This tool produces profiles the memory usage of the FFTW_example program." << endl;
+    cerr << "This tool produces profiles the memory usage of top-level functions, by default in the FFTW_example program." << endl;
     cerr << endl << KNOB_BASE::StringKnobSummary() << endl;
     return -1;
 }
@@ -687,15 +4837,113 @@ int main(int argc, char *argv[])
         return Usage();
     }
 
-    /* Create trace file */
-    trace_file.open(trace_filename.Value().c_str());
-    trace_file << hex;
-    trace_file.setf(ios::showbase);
+    if (!read_top_level_function_patterns ())
+    {
+        return Usage();
+    }
+
+    /* Allocate the thread-local-storage for the per-thread memory profiles */
+    PIN_InitLock (&output_lock);
+    PIN_InitLock (&thread_profiles_lock);
+    PIN_InitLock (&sampling_lock);
+    PIN_InitLock (&access_trace_lock);
+    PIN_InitLock (&uninstrumented_routines_lock);
+    PIN_RWMutexInit (&outstanding_allocations_lock);
+    allocation_report_enabled = allocation_report;
+    aggregate_invocations_enabled = aggregate_invocations;
+    heap_timeline_enabled = heap_timeline_interval > 0;
+    heap_timeline_next_sample = heap_timeline_interval;
+    roofline_enabled = roofline_knob;
+    segments_enabled = segments_knob;
+    frame_pointer_stack = frame_pointer_knob;
+    if (!configure_cache_analysis () || !configure_sampling () || !configure_allocation_stacks ())
+    {
+        return Usage();
+    }
+    thread_profile_key = PIN_CreateThreadDataKey (NULL);
+    thread_profile_reg = PIN_ClaimToolRegister ();
+    if ((thread_profile_key == INVALID_TLS_KEY) || !REG_valid (thread_profile_reg))
+    {
+        cerr << "Unable to allocate the thread-local-storage for the memory profiles" << endl;
+        return 1;
+    }
+
+    /* Create trace file or connect to the stream socket, which is written by an internal thread */
+    if (!stream_socket_path.Value().empty())
+    {
+        std::string error;
+
+        trace_stream_sink = new unix_socket_trace_sink;
+        if (!trace_stream_sink->connect (stream_socket_path.Value(), error))
+        {
+            cerr << "Unable to stream the trace: " << error << endl;
+            return 1;
+        }
+        trace_output_sink = new trace_ring_sink (*trace_stream_sink);
+    }
+    else
+    {
+        trace_file.open (trace_filename.Value().c_str(), binary_output ? (ios::out | ios::binary) : ios::out);
+        trace_file_sink = new ostream_trace_sink (trace_file);
+        trace_output_sink = new trace_ring_sink (*trace_file_sink);
+    }
+    if (binary_output)
+    {
+        trace_output = new binary_trace_encoder (*trace_output_sink);
+    }
+    else
+    {
+        trace_output = new csv_trace_encoder (*trace_output_sink);
+    }
+    trace_output_sink->start_writer_thread ();
+
+    /* Create the raw access trace, which is written directly by the threads which make the accesses */
+    access_trace_enabled = !access_trace_filename.Value().empty();
+    if (access_trace_enabled)
+    {
+        access_trace_file.open (access_trace_filename.Value().c_str(), ios::out | ios::binary);
+        if (!access_trace_file)
+        {
+            cerr << "Failed to create access trace " << access_trace_filename.Value() << endl;
+            return 1;
+        }
+        access_trace_sink = new ostream_trace_sink (access_trace_file);
+        access_trace_output = new access_trace_writer (*access_trace_sink);
+    }
+
+    /* When only instrumenting top-level functions or sampling, code executed before the first sampled top-level function
+     * isn't instrumented */
+    memory_accesses_instrumented = !instrument_only_top_level && !sampling_enabled;
 
     /* Set functions to install instrumentation */
     IMG_AddInstrumentFunction (image_insert_calls, NULL);
+    IMG_AddUnloadFunction (image_unload, NULL);
     INS_AddInstrumentFunction (instrument_memory_access, NULL);
+    if (burst_sampling_enabled)
+    {
+        TRACE_AddInstrumentFunction (instrument_sample_bursts, NULL);
+    }
+    if (heap_timeline_enabled)
+    {
+        TRACE_AddInstrumentFunction (instrument_heap_timeline, NULL);
+    }
+    if (roofline_enabled)
+    {
+        TRACE_AddInstrumentFunction (instrument_fp_operations, NULL);
+    }
+    PIN_AddThreadStartFunction (thread_start, NULL);
+    PIN_AddThreadFiniFunction (thread_fini, NULL);
+    PIN_AddFiniFunction (display_invocation_repeats, 0);
     PIN_AddFiniFunction (display_outstanding_allocations, 0);
+    PIN_AddFiniFunction (display_region_cache_statistics, 0);
+    PIN_AddFiniFunction (display_instruction_strides, 0);
+    PIN_AddFiniFunction (display_instruction_traffic, 0);
+    PIN_AddFiniFunction (display_cache_line_sharing, 0);
+    PIN_AddFiniFunction (display_sampling_statistics, 0);
+    PIN_AddFiniFunction (display_allocation_call_stacks, 0);
+    PIN_AddFiniFunction (display_heap_timeline, 0);
+    PIN_AddFiniFunction (close_trace_file, 0);
+    PIN_AddPrepareForFiniFunction (stop_trace_output, 0);
 
     /* Never returns */
     PIN_StartProgram();
@@ -0,0 +1,604 @@
+/*
+ * @file memory_profile_benchmark.cpp
+ * @date 16 Oct 2026
+ * @details
+ *   Microbenchmark of memory_regions_usage::record_access, which the memory_profile Pin tool calls for every memory
+ *   access made while a top-level function is active. The memory profile is driven at native speed with generated
+ *   streams of accesses which model the patterns seen in the profiled programs:
+ *   - sequential : Incrementing addresses, such as the in[index] fill in set_fft_data of FFTW_example.
+ *   - reverse    : Decrementing addresses, such as the out[N - index - 1] fill in set_fft_data of FFTW_example.
+ *   - strided    : Incrementing addresses with a gap between accesses, which leaves one region per access.
+ *   - butterfly  : The pairs of complex elements accessed by the stages of a radix-2 FFT.
+ *   - random     : Random addresses, which fragment the regions until the buffer is covered.
+ *   - interleaved: Incrementing addresses in several buffers, accessed in turn.
+ *
+ *   Each stream is generated before the timed loop, and for each pattern the output is:
+ *   - The time per access of the fastest of the repeated runs.
+ *   - The peak heap memory allocated while recording the stream, read from the malloc statistics. The heap is
+ *     sampled after each access which changes the storage of the memory profile, so the peak doesn't include the
+ *     transient allocation of both the old and new storage while a container of the memory profile grows.
+ *   - The peak number of regions, and the peak heap memory per peak region.
+ *   - The final number of regions.
+ *   The peak memory and regions are measured in a separate run from the timed runs, so sampling the number of
+ *   regions after each access doesn't add to the time.
+ *
+ *   The output is CSV. When the -baseline option gives the output of a previous run with the same options, each
+ *   pattern is checked against the baseline and the exit status is failure if the time per access or heap memory per
+ *   region exceeds the baseline by more than the -tolerance percentage. This allows a baseline to be saved before a
+ *   change to the memory profile, and the change checked for regressions on the same machine. The heap memory is
+ *   deterministic for given options, whereas the time varies between runs, so the default tolerance of 50% is
+ *   intended to only catch large slowdowns unless the machine is quiet enough for a tighter -tolerance.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <malloc.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "memory_regions.h"
+
+/** The parameters of the generated access streams, set by the command line options */
+struct benchmark_options
+{
+    /** The number of accesses in each stream */
+    uint64_t num_accesses;
+    /** The size in bytes of the buffer accessed by each stream, where addresses wrap around within the buffer */
+    uint64_t buffer_size;
+    /** The size in bytes of each access, other than the butterfly pattern which accesses complex doubles */
+    uint32_t access_size;
+    /** The increment in bytes between accesses for the strided pattern */
+    uint64_t stride;
+    /** The number of buffers accessed in turn by the interleaved pattern */
+    uint32_t num_buffers;
+    /** The number of times each stream is recorded, with the fastest run reported */
+    uint32_t num_repeats;
+    /** The seed for the random pattern */
+    uint64_t seed;
+    /** When not empty, the CSV output of a previous run to check the results against */
+    std::string baseline_filename;
+    /** The percentage by which a result may exceed the baseline before being reported as a regression */
+    uint32_t tolerance_percent;
+};
+
+/** The result of benchmarking one access pattern, as output in the CSV */
+struct benchmark_result
+{
+    /** The number of accesses in the stream */
+    uint64_t num_accesses;
+    /** The time per access of the fastest run */
+    double ns_per_access;
+    /** The peak heap memory allocated while recording the stream */
+    uint64_t peak_bytes;
+    /** The peak number of regions while recording the stream */
+    uint32_t peak_regions;
+    /** The number of regions after recording the stream */
+    uint32_t num_regions;
+};
+
+/** The results of a previous run, indexed by the name of the access pattern */
+typedef std::map<std::string, benchmark_result> benchmark_baseline;
+
+/** One access in a generated stream */
+struct benchmark_access
+{
+    uint64_t addr;
+    uint32_t bytes_accessed;
+};
+
+/** The start address of the buffers, which is page aligned like a large allocation */
+static const uint64_t buffer_base_addr = 0x7f0000000000ULL;
+
+/** The size in bytes of the complex double elements accessed by the butterfly pattern */
+static const uint32_t complex_double_size = 16;
+
+typedef void (*stream_generator) (const benchmark_options &options, std::vector<benchmark_access> &stream);
+
+/**
+ * @return The bytes of heap memory currently allocated, including the large allocations which malloc maps separately
+ */
+static uint64_t heap_bytes_in_use (void)
+{
+#if __GLIBC_PREREQ (2, 33)
+    const struct mallinfo2 info = mallinfo2 ();
+#else
+    const struct mallinfo info = mallinfo ();
+#endif
+
+    return (uint64_t) info.uordblks + (uint64_t) info.hblkhd;
+}
+
+/**
+ * @brief Append one access to a generated stream
+ * @param[in,out] stream The stream to append to
+ * @param[in] addr The address accessed
+ * @param[in] bytes_accessed The size of the access
+ */
+static void append_access (std::vector<benchmark_access> &stream, const uint64_t addr, const uint32_t bytes_accessed)
+{
+    benchmark_access access;
+
+    access.addr = addr;
+    access.bytes_accessed = bytes_accessed;
+    stream.push_back (access);
+}
+
+/**
+ * @brief Generate incrementing accesses of access_size over the buffer, repeated from the start of the buffer
+ */
+static void generate_sequential (const benchmark_options &options, std::vector<benchmark_access> &stream)
+{
+    const uint64_t num_elements = options.buffer_size / options.access_size;
+
+    for (uint64_t access_index = 0; access_index < options.num_accesses; access_index++)
+    {
+        append_access (stream, buffer_base_addr + ((access_index % num_elements) * options.access_size),
+                       options.access_size);
+    }
+}
+
+/**
+ * @brief Generate decrementing accesses of access_size over the buffer, repeated from the end of the buffer
+ */
+static void generate_reverse (const benchmark_options &options, std::vector<benchmark_access> &stream)
+{
+    const uint64_t num_elements = options.buffer_size / options.access_size;
+
+    for (uint64_t access_index = 0; access_index < options.num_accesses; access_index++)
+    {
+        const uint64_t element_index = num_elements - (access_index % num_elements) - 1;
+
+        append_access (stream, buffer_base_addr + (element_index * options.access_size), options.access_size);
+    }
+}
+
+/**
+ * @brief Generate incrementing accesses of access_size which are stride bytes apart, repeated over the buffer
+ */
+static void generate_strided (const benchmark_options &options, std::vector<benchmark_access> &stream)
+{
+    const uint64_t num_elements = options.buffer_size / options.stride;
+
+    for (uint64_t access_index = 0; access_index < options.num_accesses; access_index++)
+    {
+        append_access (stream, buffer_base_addr + ((access_index % num_elements) * options.stride),
+                       options.access_size);
+    }
+}
+
+/**
+ * @brief Generate the accesses of repeated in-place radix-2 FFTs over the buffer
+ * @details Each butterfly accesses the pair of complex elements which are half the span of the stage apart, so the
+ *          early stages access pairs of adjacent elements and the later stages pairs in separate halves of the buffer.
+ */
+static void generate_butterfly (const benchmark_options &options, std::vector<benchmark_access> &stream)
+{
+    const uint64_t num_elements = options.buffer_size / complex_double_size;
+
+    while (stream.size() < options.num_accesses)
+    {
+        for (uint64_t span = 2; (span <= num_elements) && (stream.size() < options.num_accesses); span *= 2)
+        {
+            const uint64_t half_span = span / 2;
+
+            for (uint64_t group = 0; (group < num_elements) && (stream.size() < options.num_accesses); group += span)
+            {
+                for (uint64_t element = group; (element < (group + half_span)) &&
+                     (stream.size() < options.num_accesses); element++)
+                {
+                    append_access (stream, buffer_base_addr + (element * complex_double_size),
+                                   complex_double_size);
+                    append_access (stream, buffer_base_addr + ((element + half_span) * complex_double_size),
+                                   complex_double_size);
+                }
+            }
+        }
+    }
+    stream.resize (options.num_accesses);
+}
+
+/**
+ * @brief Generate accesses of access_size to elements of the buffer chosen by a pseudo-random sequence from the seed
+ */
+static void generate_random (const benchmark_options &options, std::vector<benchmark_access> &stream)
+{
+    const uint64_t num_elements = options.buffer_size / options.access_size;
+    uint64_t state = options.seed;
+
+    for (uint64_t access_index = 0; access_index < options.num_accesses; access_index++)
+    {
+        /* xorshift64, so the stream is the same on all platforms for a given seed */
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        append_access (stream, buffer_base_addr + ((state % num_elements) * options.access_size), options.access_size);
+    }
+}
+
+/**
+ * @brief Generate incrementing accesses to several buffers in turn
+ * @details The buffers are spaced a page beyond their size apart, so each buffer is a separate region.
+ */
+static void generate_interleaved (const benchmark_options &options, std::vector<benchmark_access> &stream)
+{
+    const uint64_t num_elements = options.buffer_size / options.access_size;
+    const uint64_t buffer_spacing = (options.buffer_size + 0x1fff) & ~0xfffULL;
+
+    for (uint64_t access_index = 0; access_index < options.num_accesses; access_index++)
+    {
+        const uint64_t buffer_index = access_index % options.num_buffers;
+        const uint64_t element_index = (access_index / options.num_buffers) % num_elements;
+
+        const uint64_t buffer_addr = buffer_base_addr + (buffer_index * buffer_spacing);
+
+        append_access (stream, buffer_addr + (element_index * options.access_size), options.access_size);
+    }
+}
+
+/** The access patterns which are benchmarked, in the order they are run */
+static const struct
+{
+    const char *name;
+    stream_generator generate;
+} benchmark_patterns[] =
+{
+    {"sequential", generate_sequential},
+    {"reverse", generate_reverse},
+    {"strided", generate_strided},
+    {"butterfly", generate_butterfly},
+    {"random", generate_random},
+    {"interleaved", generate_interleaved}
+};
+static const uint32_t num_benchmark_patterns = sizeof (benchmark_patterns) / sizeof (benchmark_patterns[0]);
+
+/**
+ * @return The current time of a monotonic clock in nanoseconds
+ */
+static uint64_t monotonic_time_ns (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000ULL) + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * @return The peak heap memory per peak region of a result
+ */
+static double bytes_per_region (const benchmark_result &result)
+{
+    return (double) result.peak_bytes / (double) ((result.peak_regions > 0) ? result.peak_regions : 1);
+}
+
+/**
+ * @brief Record a generated stream in a new memory profile, repeated to report the fastest run
+ * @param[in] options The number of repeats
+ * @param[in] stream The accesses to record
+ * @param[out] result The time and memory used to record the stream
+ */
+static void run_benchmark (const benchmark_options &options, const std::vector<benchmark_access> &stream,
+                           benchmark_result &result)
+{
+    uint64_t best_elapsed_ns = 0;
+
+    for (uint32_t repeat = 0; repeat < options.num_repeats; repeat++)
+    {
+        memory_regions_usage memory_regions;
+        const uint64_t start_ns = monotonic_time_ns ();
+
+        for (std::vector<benchmark_access>::const_iterator it = stream.begin(); it != stream.end(); ++it)
+        {
+            memory_regions.record_access (it->addr, it->bytes_accessed);
+        }
+
+        const uint64_t elapsed_ns = monotonic_time_ns () - start_ns;
+
+        if ((repeat == 0) || (elapsed_ns < best_elapsed_ns))
+        {
+            best_elapsed_ns = elapsed_ns;
+        }
+    }
+
+    /* Reading the heap statistics is slow, so the heap is only sampled when the storage of the memory profile changes,
+     * which is the only time the memory profile changes its heap allocations */
+    const uint64_t start_heap_bytes = heap_bytes_in_use ();
+    uint64_t peak_heap_bytes = start_heap_bytes;
+
+    result.peak_regions = 0;
+    {
+        memory_regions_usage memory_regions;
+        uint64_t allocated_bytes = memory_regions.allocated_bytes ();
+
+        peak_heap_bytes = std::max (peak_heap_bytes, heap_bytes_in_use ());
+        for (std::vector<benchmark_access>::const_iterator it = stream.begin(); it != stream.end(); ++it)
+        {
+            memory_regions.record_access (it->addr, it->bytes_accessed);
+            if (memory_regions.num_regions () > result.peak_regions)
+            {
+                result.peak_regions = memory_regions.num_regions ();
+            }
+            if (memory_regions.allocated_bytes () != allocated_bytes)
+            {
+                allocated_bytes = memory_regions.allocated_bytes ();
+                peak_heap_bytes = std::max (peak_heap_bytes, heap_bytes_in_use ());
+            }
+        }
+        result.num_regions = memory_regions.num_regions ();
+    }
+
+    result.num_accesses = stream.size();
+    result.ns_per_access = stream.empty() ? 0.0 : ((double) best_elapsed_ns / (double) stream.size());
+    result.peak_bytes = peak_heap_bytes - start_heap_bytes;
+}
+
+/**
+ * @brief Read the results of a previous run, to check for regressions
+ * @param[in] filename The CSV output of the previous run
+ * @param[out] baseline The results read, indexed by the name of the access pattern
+ * @return Returns true if the file was read
+ */
+static bool read_baseline (const std::string &filename, benchmark_baseline &baseline)
+{
+    std::ifstream baseline_file (filename.c_str());
+    std::string line;
+
+    if (!baseline_file.is_open())
+    {
+        std::cerr << "Unable to open baseline " << filename << std::endl;
+        return false;
+    }
+
+    while (std::getline (baseline_file, line))
+    {
+        std::istringstream fields (line);
+        std::string name;
+        benchmark_result result;
+        double baseline_bytes_per_region;
+        char separator;
+
+        if (std::getline (fields, name, ',') && (name != "pattern") &&
+            (fields >> result.num_accesses >> separator >> result.ns_per_access >> separator >> result.peak_bytes >>
+             separator >> result.peak_regions >> separator >> baseline_bytes_per_region >> separator >>
+             result.num_regions))
+        {
+            baseline[name] = result;
+        }
+    }
+
+    if (baseline.empty())
+    {
+        std::cerr << "No results in baseline " << filename << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Check the result for an access pattern against the baseline
+ * @param[in] options The tolerance for the check
+ * @param[in] name The name of the access pattern
+ * @param[in] result The result to check
+ * @param[in] baseline The results of the previous run
+ * @return Returns true if the result is within the tolerance of the baseline, otherwise reports the regression
+ */
+static bool check_result (const benchmark_options &options, const std::string &name, const benchmark_result &result,
+                          const benchmark_baseline &baseline)
+{
+    const benchmark_baseline::const_iterator it = baseline.find (name);
+    const double limit_scale = (100.0 + options.tolerance_percent) / 100.0;
+    bool within_tolerance = true;
+
+    if (it == baseline.end())
+    {
+        std::cerr << name << ": not in the baseline" << std::endl;
+        return false;
+    }
+
+    const benchmark_result &reference = it->second;
+
+    if (result.num_accesses != reference.num_accesses)
+    {
+        std::cerr << name << ": baseline has " << reference.num_accesses << " accesses rather than "
+                << result.num_accesses << std::endl;
+        return false;
+    }
+    if (result.ns_per_access > (reference.ns_per_access * limit_scale))
+    {
+        std::cerr << name << ": ns_per_access " << result.ns_per_access << " exceeds baseline "
+                << reference.ns_per_access << std::endl;
+        within_tolerance = false;
+    }
+    if (bytes_per_region (result) > (bytes_per_region (reference) * limit_scale))
+    {
+        std::cerr << name << ": bytes_per_region " << bytes_per_region (result) << " exceeds baseline "
+                << bytes_per_region (reference) << std::endl;
+        within_tolerance = false;
+    }
+
+    return within_tolerance;
+}
+
+/**
+ * @brief Parse the command line options
+ * @param[in] argc, argv The command line
+ * @param[out] options The parameters of the access streams
+ * @param[out] first_pattern_arg The index in argv[] of the first pattern name after the options
+ * @return Returns true if the options are valid
+ */
+static bool parse_options (const int argc, char *argv[], benchmark_options &options, int &first_pattern_arg)
+{
+    int arg_index;
+
+    options.num_accesses = 1024 * 1024;
+    options.buffer_size = 1024 * 1024;
+    options.access_size = 8;
+    options.stride = 64;
+    options.num_buffers = 8;
+    options.num_repeats = 3;
+    options.seed = 1;
+    options.tolerance_percent = 50;
+    for (arg_index = 1; (arg_index < argc) && (argv[arg_index][0] == '-'); arg_index++)
+    {
+        const std::string option = argv[arg_index];
+
+        if ((arg_index + 1) >= argc)
+        {
+            std::cerr << "Missing value for option " << option << std::endl;
+            return false;
+        }
+        else if (option == "-accesses")
+        {
+            options.num_accesses = strtoull (argv[++arg_index], NULL, 0);
+        }
+        else if (option == "-buffer_size")
+        {
+            options.buffer_size = strtoull (argv[++arg_index], NULL, 0);
+        }
+        else if (option == "-access_size")
+        {
+            options.access_size = strtoul (argv[++arg_index], NULL, 0);
+        }
+        else if (option == "-stride")
+        {
+            options.stride = strtoull (argv[++arg_index], NULL, 0);
+        }
+        else if (option == "-buffers")
+        {
+            options.num_buffers = strtoul (argv[++arg_index], NULL, 0);
+        }
+        else if (option == "-repeat")
+        {
+            options.num_repeats = strtoul (argv[++arg_index], NULL, 0);
+        }
+        else if (option == "-seed")
+        {
+            options.seed = strtoull (argv[++arg_index], NULL, 0);
+        }
+        else if (option == "-baseline")
+        {
+            options.baseline_filename = argv[++arg_index];
+        }
+        else if (option == "-tolerance")
+        {
+            options.tolerance_percent = strtoul (argv[++arg_index], NULL, 0);
+        }
+        else
+        {
+            std::cerr << "Invalid option " << option << std::endl;
+            return false;
+        }
+    }
+    first_pattern_arg = arg_index;
+
+    if ((options.access_size == 0) || (options.access_size > trace_max_mem_access_size))
+    {
+        std::cerr << "Invalid access size " << options.access_size << std::endl;
+        return false;
+    }
+    if ((options.stride == 0) || (options.num_buffers == 0) || (options.num_repeats == 0) || (options.seed == 0))
+    {
+        std::cerr << "The stride, buffers, repeat and seed options must be non-zero" << std::endl;
+        return false;
+    }
+    if ((options.buffer_size < options.access_size) || (options.buffer_size < options.stride) ||
+        (options.buffer_size < (2 * complex_double_size)))
+    {
+        std::cerr << "Buffer size " << options.buffer_size << " too small for the access size or stride" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main (int argc, char *argv[])
+{
+    benchmark_options options;
+    std::vector<bool> selected_patterns (num_benchmark_patterns, true);
+    int first_pattern_arg = 0;
+    benchmark_baseline baseline;
+    bool within_tolerance = true;
+
+    if (!parse_options (argc, argv, options, first_pattern_arg))
+    {
+        std::cerr << "Usage: " << argv[0] << " [options] [pattern ...]" << std::endl;
+        std::cerr << "Options:" << std::endl;
+        std::cerr << "  -accesses <count> -buffer_size <bytes> -access_size <bytes> -stride <bytes>" << std::endl;
+        std::cerr << "  -buffers <count> -repeat <count> -seed <value>" << std::endl;
+        std::cerr << "  -baseline <previous output .csv> -tolerance <percent>" << std::endl;
+        std::cerr << "Patterns, which default to all:" << std::endl;
+        for (uint32_t pattern_index = 0; pattern_index < num_benchmark_patterns; pattern_index++)
+        {
+            std::cerr << "  " << benchmark_patterns[pattern_index].name << std::endl;
+        }
+        return EXIT_FAILURE;
+    }
+
+    if (first_pattern_arg < argc)
+    {
+        selected_patterns.assign (num_benchmark_patterns, false);
+        for (int arg_index = first_pattern_arg; arg_index < argc; arg_index++)
+        {
+            const std::string pattern_name = argv[arg_index];
+            bool found = false;
+
+            for (uint32_t pattern_index = 0; pattern_index < num_benchmark_patterns; pattern_index++)
+            {
+                if (pattern_name == benchmark_patterns[pattern_index].name)
+                {
+                    selected_patterns[pattern_index] = true;
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                std::cerr << "Unknown pattern " << pattern_name << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (!options.baseline_filename.empty() && !read_baseline (options.baseline_filename, baseline))
+    {
+        return EXIT_FAILURE;
+    }
+
+    printf ("pattern,accesses,ns_per_access,peak_bytes,peak_regions,bytes_per_region,regions\n");
+    for (uint32_t pattern_index = 0; pattern_index < num_benchmark_patterns; pattern_index++)
+    {
+        if (selected_patterns[pattern_index])
+        {
+            const char *const name = benchmark_patterns[pattern_index].name;
+            std::vector<benchmark_access> stream;
+            benchmark_result result;
+
+            stream.reserve (options.num_accesses);
+            benchmark_patterns[pattern_index].generate (options, stream);
+            run_benchmark (options, stream, result);
+            printf ("%s,%lu,%.2f,%lu,%u,%.2f,%u\n", name, (unsigned long) result.num_accesses, result.ns_per_access,
+                    (unsigned long) result.peak_bytes, result.peak_regions, bytes_per_region (result),
+                    result.num_regions);
+            fflush (stdout);
+            if (!baseline.empty() && !check_result (options, name, result, baseline))
+            {
+                within_tolerance = false;
+            }
+        }
+    }
+
+    if (!within_tolerance)
+    {
+        std::cerr << "Regression against baseline " << options.baseline_filename << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
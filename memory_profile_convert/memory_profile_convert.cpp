@@ -0,0 +1,57 @@
+/*
+ * @file memory_profile_convert.cpp
+ * @date 16 Oct 2026
+ * @details
+ *   Converts a trace written by the memory_profile Pin tool with the -binary_output option to the .csv format
+ *   which the Pin tool writes by default.
+ */
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "trace_format.h"
+
+int main (int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <binary_trace> <csv_output>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream binary_trace (argv[1], std::ios::in | std::ios::binary);
+    if (!binary_trace)
+    {
+        std::cerr << "Failed to open " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream csv_output (argv[2]);
+    if (!csv_output)
+    {
+        std::cerr << "Failed to create " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    ostream_trace_sink sink (csv_output);
+    csv_trace_encoder encoder (sink);
+    std::string error;
+
+    if (!decode_binary_trace (binary_trace, encoder, error))
+    {
+        std::cerr << argv[1] << ": " << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    csv_output.close ();
+    if (!csv_output)
+    {
+        std::cerr << "Failed to write " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,737 @@
+/*
+ * @file memory_profile_replay.cpp
+ * @date 16 Oct 2026
+ * @details
+ *   Replays a raw access trace written by the memory_profile Pin tool with the -access_trace option through the memory
+ *   profile and analyses, at native speed. The trace written has the same records as the trace of the Pin tool, and the
+ *   analyses are selected by options with the same names as the Pin tool options. This allows the analyses of one run
+ *   of the instrumented program to be repeated with different parameters, such as the cache line size or the cache
+ *   configuration, without re-running the program under Pin.
+ *
+ *   The accesses of each thread are recorded in the memory profile of the thread, and on exit from a top-level function
+ *   the memory profiles of the threads are combined in the same way as the Pin tool. The raw access trace doesn't
+ *   contain allocation events, so the allocation report and heap statistics aren't available.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "trace_format.h"
+#include "access_trace.h"
+#include "memory_regions.h"
+#include "cache_simulator.h"
+#include "reuse_distance.h"
+#include "stride_detector.h"
+#include "page_footprint.h"
+
+/** The analyses selected by the command line options */
+struct replay_options
+{
+    /** Write the trace in the binary format */
+    bool binary_output;
+    /** Output the memory profile of each thread, in addition to the combined memory profile */
+    bool per_thread;
+    /** Simulate the accesses in the cache hierarchy of cache_simulation_config */
+    bool cache_simulation;
+    cache_config cache_simulation_config;
+    /** Measure the reuse distances of the cache line accesses */
+    bool reuse_distance;
+    /** Learn the stride of the accesses by each instruction */
+    bool stride_analysis;
+    /** Count the pages touched, and estimate the TLB misses with TLBs of tlb_entries and tlb_ways */
+    bool page_footprint;
+    uint64_t tlb_entries[trace_num_page_sizes];
+    uint32_t tlb_ways[trace_num_page_sizes];
+    /** The cache line size for the cache simulation, reuse distances, access patterns and page footprints */
+    uint32_t line_size;
+};
+
+/** The memory profile of one thread for one depth of the activation stack */
+struct replay_thread_activation
+{
+    /** The invocation_count of the activation when memory_regions[] were last cleared */
+    uint32_t invocation_count;
+    /** The memory regions accessed by the thread, indexed by memory_access_kind */
+    memory_regions_usage memory_regions[NUM_MEMORY_OPERAND_KINDS];
+};
+
+/** The state of one thread in the access trace */
+struct replay_thread
+{
+    /** The thread ID from the access trace */
+    uint32_t thread_id;
+    /** The exclusive memory profiles of the thread for each depth of the activation stack */
+    std::vector<replay_thread_activation> activations;
+    /** The cache hierarchy simulated for the thread, when cache simulation is selected */
+    cache_hierarchy *caches;
+    /** Measures the reuse distances of the thread, when reuse distances are selected */
+    reuse_distance_analyser *reuse_distances;
+    /** The data TLBs simulated for the thread, when the page footprint is selected */
+    tlb_simulator *tlbs;
+};
+
+/** One activation of a top-level function in the access trace */
+struct replay_activation
+{
+    /** The name of the top-level function */
+    std::string func_name;
+    /** Identifies the activation, to detect when the memory profiles of a thread are from a previous activation */
+    uint32_t invocation_count;
+    /** Set when a nested top-level function has been called from this activation */
+    bool nested;
+    /** The inclusive memory profiles of the nested top-level functions, indexed by memory_access_kind */
+    memory_regions_usage nested_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+};
+
+/** One memory operand of a static instruction in the access trace */
+struct replay_instruction
+{
+    /** The definition from the access trace */
+    access_trace_instruction instruction;
+    /** Learns the stride of the accesses by the operand, when stride analysis is selected */
+    stride_detector detector;
+};
+
+/** Replays the records of an access trace through the memory profile and analyses */
+class access_trace_replay : public access_trace_handler
+{
+public:
+    access_trace_replay (const replay_options &options, trace_encoder &output);
+    virtual ~access_trace_replay (void);
+    virtual void instruction (uint32_t instruction_index, const access_trace_instruction &instruction);
+    virtual void function_enter (const std::string &func_name);
+    virtual void function_exit (const std::string &func_name);
+    virtual void accesses (uint32_t thread_id, const access_trace_access accesses[], uint32_t num_accesses);
+    void finish (void);
+    bool valid (std::string &error) const;
+private:
+    replay_thread *get_thread (uint32_t thread_id);
+    void record_access (replay_thread &thread, replay_thread_activation &activation, const access_trace_access &access);
+    const memory_regions_usage &combine_thread_profiles (uint32_t depth, uint32_t kind,
+                                                         const std::vector<replay_thread *> &active_threads);
+    void display_activation_profiles (uint32_t depth);
+
+    const replay_options &options;
+    trace_encoder &output;
+
+    /** The threads which have made accesses, in order of their first access */
+    std::vector<replay_thread *> threads;
+    std::map<uint32_t,replay_thread *> thread_indices;
+
+    /** The active top-level functions, with the innermost last */
+    std::vector<replay_activation> activation_stack;
+
+    /** Used to allocate replay_activation.invocation_count */
+    uint32_t invocation_count;
+
+    /** The memory operands defined in the access trace, indexed by instruction index */
+    std::vector<replay_instruction> instructions;
+
+    /** Set when an instruction has an invalid access kind */
+    bool invalid_access_kind;
+
+    /** Used to combine the memory profiles of multiple threads, and of nested top-level functions */
+    memory_regions_usage combined_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+    memory_regions_usage inclusive_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+};
+
+access_trace_replay::access_trace_replay (const replay_options &options, trace_encoder &output)
+    : options (options), output (output), invocation_count (0), invalid_access_kind (false)
+{
+}
+
+access_trace_replay::~access_trace_replay (void)
+{
+    std::vector<replay_thread *>::iterator it;
+
+    for (it = threads.begin(); it != threads.end(); ++it)
+    {
+        delete (*it)->caches;
+        delete (*it)->reuse_distances;
+        delete (*it)->tlbs;
+        delete *it;
+    }
+}
+
+/**
+ * @brief Check if the records replayed so far were valid
+ * @param[out] error When returning false, describes why the records are invalid
+ * @return Returns true if the records are valid
+ */
+bool access_trace_replay::valid (std::string &error) const
+{
+    if (invalid_access_kind)
+    {
+        error = "instruction with an invalid access kind";
+        return false;
+    }
+
+    return true;
+}
+
+void access_trace_replay::instruction (const uint32_t instruction_index, const access_trace_instruction &instruction)
+{
+    if (instructions.size() <= instruction_index)
+    {
+        instructions.resize (instruction_index + 1);
+    }
+    instructions[instruction_index].instruction = instruction;
+    if (instruction.access_kind >= NUM_MEMORY_OPERAND_KINDS)
+    {
+        invalid_access_kind = true;
+        instructions[instruction_index].instruction.access_kind = MEMORY_ACCESS_READ;
+    }
+}
+
+/**
+ * @brief Get the state of a thread, creating it on the first access by the thread
+ * @param[in] thread_id The thread ID from the access trace
+ * @return The state of the thread
+ */
+replay_thread *access_trace_replay::get_thread (const uint32_t thread_id)
+{
+    const std::map<uint32_t,replay_thread *>::const_iterator it = thread_indices.find (thread_id);
+
+    if (it != thread_indices.end())
+    {
+        return it->second;
+    }
+
+    replay_thread *const thread = new replay_thread;
+    std::string error;
+
+    thread->thread_id = thread_id;
+    thread->caches = NULL;
+    thread->reuse_distances = NULL;
+    thread->tlbs = NULL;
+    if (options.cache_simulation)
+    {
+        thread->caches = new cache_hierarchy;
+        thread->caches->configure (options.cache_simulation_config, error);
+    }
+    if (options.reuse_distance)
+    {
+        thread->reuse_distances = new reuse_distance_analyser (options.line_size);
+    }
+    if (options.page_footprint)
+    {
+        thread->tlbs = new tlb_simulator;
+        thread->tlbs->configure (options.tlb_entries, options.tlb_ways, error);
+    }
+    threads.push_back (thread);
+    thread_indices[thread_id] = thread;
+
+    return thread;
+}
+
+void access_trace_replay::function_enter (const std::string &func_name)
+{
+    replay_activation activation;
+
+    if (!activation_stack.empty())
+    {
+        activation_stack.back().nested = true;
+    }
+    activation.func_name = func_name;
+    activation.invocation_count = ++invocation_count;
+    activation.nested = false;
+    activation_stack.push_back (activation);
+    output.function_enter (func_name);
+}
+
+/**
+ * @brief Record one access in the memory profile of a thread, and in the selected analyses
+ * @details The same as the memory_access_analysis() of the Pin tool
+ * @param[in,out] thread The thread which made the access
+ * @param[in,out] activation The memory profile of the thread for the innermost activation
+ * @param[in] access The access to record
+ */
+void access_trace_replay::record_access (replay_thread &thread, replay_thread_activation &activation,
+                                         const access_trace_access &access)
+{
+    replay_instruction &instruction = instructions[access.instruction_index];
+    const uint32_t access_kind = instruction.instruction.access_kind;
+    memory_regions_usage &memory_regions = activation.memory_regions[access_kind];
+
+    memory_regions.record_access (access.addr, access.bytes_accessed);
+    if (options.cache_simulation)
+    {
+        cache_access_outcome outcome;
+
+        const bool is_write = (access_kind == MEMORY_ACCESS_WRITE) || (access_kind == MEMORY_ACCESS_READ_WRITE);
+
+        thread.caches->access (access.addr, access.bytes_accessed, is_write, outcome);
+        memory_regions.record_cache_outcome (access.addr, outcome);
+    }
+    if (options.reuse_distance)
+    {
+        memory_regions.record_reuse_distances (access.addr, access.bytes_accessed, *thread.reuse_distances);
+    }
+    if (options.stride_analysis)
+    {
+        trace_access_pattern access_pattern;
+
+        if (instruction.detector.access (thread.thread_id, access.addr, options.line_size, access_pattern))
+        {
+            memory_regions.record_access_pattern (access.addr, access_pattern);
+        }
+    }
+    if (options.page_footprint)
+    {
+        uint64_t misses[trace_num_page_sizes];
+
+        thread.tlbs->access (access.addr, access.bytes_accessed, misses);
+        memory_regions.record_tlb_misses (access.addr, misses);
+    }
+}
+
+/**
+ * @brief Record a block of accesses made by one thread in the memory profile of the thread for the innermost activation
+ * @details Accesses made while no top-level function is active are ignored.
+ */
+void access_trace_replay::accesses (const uint32_t thread_id, const access_trace_access accesses[],
+                                    const uint32_t num_accesses)
+{
+    if (activation_stack.empty())
+    {
+        return;
+    }
+
+    const uint32_t depth = activation_stack.size() - 1;
+    replay_thread *const thread = get_thread (thread_id);
+
+    if (thread->activations.size() <= depth)
+    {
+        replay_thread_activation new_activation;
+
+        new_activation.invocation_count = 0;
+        thread->activations.resize (depth + 1, new_activation);
+    }
+
+    replay_thread_activation &activation = thread->activations[depth];
+    if (activation.invocation_count != activation_stack[depth].invocation_count)
+    {
+        for (uint32_t kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+        {
+            activation.memory_regions[kind].clear();
+        }
+        activation.invocation_count = activation_stack[depth].invocation_count;
+    }
+
+    for (uint32_t access_index = 0; access_index < num_accesses; access_index++)
+    {
+        record_access (*thread, activation, accesses[access_index]);
+    }
+}
+
+/**
+ * @brief Add the memory profile of one kind of a thread to a combined memory profile
+ * @details The same as the merge_thread_profile() of the Pin tool
+ */
+static void merge_thread_profile (memory_regions_usage &combined, const replay_thread_activation &activation,
+                                  const uint32_t kind)
+{
+    combined.merge_from (activation.memory_regions[kind]);
+    if ((kind == MEMORY_ACCESS_READ) || (kind == MEMORY_ACCESS_WRITE))
+    {
+        combined.merge_read_modify_write_from (activation.memory_regions[MEMORY_ACCESS_READ_WRITE],
+                                               (memory_access_kind) kind);
+    }
+}
+
+/**
+ * @brief Combine the memory profiles of the threads which made accesses in an activation of a top-level function
+ * @return The combined memory profile, which is the memory profile of the thread when only one thread made accesses
+ *         and there are no read-modify-write accesses to add to a read or write memory profile
+ */
+const memory_regions_usage &access_trace_replay::combine_thread_profiles (const uint32_t depth, const uint32_t kind,
+        const std::vector<replay_thread *> &active_threads)
+{
+    if ((active_threads.size() == 1) &&
+        (((kind != MEMORY_ACCESS_READ) && (kind != MEMORY_ACCESS_WRITE)) ||
+         (active_threads[0]->activations[depth].memory_regions[MEMORY_ACCESS_READ_WRITE].num_regions() == 0)))
+    {
+        return active_threads[0]->activations[depth].memory_regions[kind];
+    }
+
+    combined_memory_regions[kind].clear();
+    for (uint32_t thread_index = 0; thread_index < active_threads.size(); thread_index++)
+    {
+        merge_thread_profile (combined_memory_regions[kind], active_threads[thread_index]->activations[depth], kind);
+    }
+    return combined_memory_regions[kind];
+}
+
+/**
+ * @brief Output the memory profiles of an activation of a top-level function
+ * @details The same as the display_activation_profiles() of the Pin tool, without the allocation report.
+ * @param[in] depth The depth of the activation in activation_stack[]
+ */
+void access_trace_replay::display_activation_profiles (const uint32_t depth)
+{
+    replay_activation &activation = activation_stack[depth];
+    const char *const exclusive_suffix = activation.nested ? " exclusive" : "";
+    std::vector<replay_thread *> active_threads;
+    std::vector<replay_thread *>::const_iterator it;
+
+    for (it = threads.begin(); it != threads.end(); ++it)
+    {
+        if (((*it)->activations.size() > depth) &&
+            ((*it)->activations[depth].invocation_count == activation.invocation_count))
+        {
+            active_threads.push_back (*it);
+        }
+    }
+
+    for (uint32_t kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+    {
+        const std::string prefix = activation.func_name + "," + memory_access_kind_names[kind];
+        memory_regions_usage empty_memory_regions;
+        const memory_regions_usage &exclusive_memory_regions = active_threads.empty() ? empty_memory_regions :
+                combine_thread_profiles (depth, kind, active_threads);
+        const memory_regions_usage *outer_memory_regions = &exclusive_memory_regions;
+
+        if (activation.nested)
+        {
+            inclusive_memory_regions[kind].clear();
+            inclusive_memory_regions[kind].merge_from (exclusive_memory_regions);
+            inclusive_memory_regions[kind].merge_from (activation.nested_memory_regions[kind]);
+            inclusive_memory_regions[kind].display (output, prefix);
+            outer_memory_regions = &inclusive_memory_regions[kind];
+        }
+        exclusive_memory_regions.display (output, prefix + exclusive_suffix);
+
+        if (depth > 0)
+        {
+            activation_stack[depth - 1].nested_memory_regions[kind].merge_from (*outer_memory_regions);
+        }
+    }
+
+    if (options.per_thread)
+    {
+        for (uint32_t thread_index = 0; thread_index < active_threads.size(); thread_index++)
+        {
+            const replay_thread_activation &thread_activation = active_threads[thread_index]->activations[depth];
+
+            for (uint32_t kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+            {
+                std::ostringstream prefix;
+
+                prefix << activation.func_name << "," << memory_access_kind_names[kind] << exclusive_suffix
+                       << ",thread=" << active_threads[thread_index]->thread_id;
+                if (((kind == MEMORY_ACCESS_READ) || (kind == MEMORY_ACCESS_WRITE)) &&
+                    (thread_activation.memory_regions[MEMORY_ACCESS_READ_WRITE].num_regions() > 0))
+                {
+                    combined_memory_regions[kind].clear();
+                    merge_thread_profile (combined_memory_regions[kind], thread_activation, kind);
+                    combined_memory_regions[kind].display (output, prefix.str());
+                }
+                else
+                {
+                    thread_activation.memory_regions[kind].display (output, prefix.str());
+                }
+            }
+        }
+    }
+}
+
+void access_trace_replay::function_exit (const std::string &func_name)
+{
+    if (activation_stack.empty())
+    {
+        return;
+    }
+
+    output.function_exit (func_name);
+    display_activation_profiles (activation_stack.size() - 1);
+    activation_stack.pop_back ();
+}
+
+/**
+ * @brief Output the statistics which the Pin tool outputs at program exit, once the access trace has been replayed
+ */
+void access_trace_replay::finish (void)
+{
+    memory_regions_usage total_memory_regions[NUM_MEMORY_OPERAND_KINDS];
+    std::vector<replay_thread *>::const_iterator it;
+
+    for (it = threads.begin(); it != threads.end(); ++it)
+    {
+        for (uint32_t depth = 0; depth < (*it)->activations.size(); depth++)
+        {
+            for (uint32_t kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+            {
+                total_memory_regions[kind].add_region_cache_statistics ((*it)->activations[depth].memory_regions[kind]);
+            }
+        }
+    }
+    for (uint32_t kind = 0; kind < NUM_MEMORY_OPERAND_KINDS; kind++)
+    {
+        total_memory_regions[kind].display_region_cache_statistics
+                (output, std::string ("N/A,") + memory_access_kind_names[kind]);
+    }
+
+    if (options.stride_analysis)
+    {
+        /* Output in order of instruction address and operand, the same as the Pin tool */
+        std::map<std::pair<uint64_t,uint32_t>,uint32_t> sorted_instructions;
+        std::map<std::pair<uint64_t,uint32_t>,uint32_t>::const_iterator sorted_it;
+        trace_instruction_stride stride;
+
+        for (uint32_t instruction_index = 0; instruction_index < instructions.size(); instruction_index++)
+        {
+            const access_trace_instruction &instruction = instructions[instruction_index].instruction;
+
+            sorted_instructions[std::pair<uint64_t,uint32_t>
+                    (instruction.ip, (instruction.mem_op * NUM_MEMORY_OPERAND_KINDS) + instruction.access_kind)] =
+                            instruction_index;
+        }
+        for (sorted_it = sorted_instructions.begin(); sorted_it != sorted_instructions.end(); ++sorted_it)
+        {
+            const replay_instruction &instruction = instructions[sorted_it->second];
+
+            instruction.detector.get_statistics (options.line_size, stride);
+            if (stride.samples > 0)
+            {
+                stride.ip = instruction.instruction.ip;
+                stride.routine = instruction.instruction.routine;
+                stride.access_kind = instruction.instruction.access_kind;
+                if (stride.access_kind == MEMORY_ACCESS_READ_WRITE)
+                {
+                    stride.access_kind = MEMORY_ACCESS_READ;
+                    output.instruction_stride ("N/A", stride);
+                    stride.access_kind = MEMORY_ACCESS_WRITE;
+                }
+                output.instruction_stride ("N/A", stride);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Select the analyses from the command line options, which have the same names as the Pin tool options
+ * @param[in] argc The number of command line arguments
+ * @param[in] argv The command line arguments
+ * @param[out] options The selected analyses
+ * @param[out] first_file_arg The index in argv[] of the first argument which isn't an option
+ * @return Returns true if the options are valid
+ */
+static bool parse_options (const int argc, char *argv[], replay_options &options, int &first_file_arg)
+{
+    std::string level_configs[cache_num_levels] = {"32K:8", "256K:8", "8M:16"};
+    std::string tlb_configs[trace_num_page_sizes] = {"64:4", "32:4"};
+    std::string replacement = "lru";
+    cache_hierarchy caches;
+    tlb_simulator tlbs;
+    std::string error;
+    int arg_index;
+
+    memset (&options, 0, sizeof (options));
+    options.line_size = 64;
+    for (arg_index = 1; (arg_index < argc) && (argv[arg_index][0] == '-'); arg_index++)
+    {
+        const std::string option = argv[arg_index];
+        const bool has_value = (arg_index + 1) < argc;
+
+        if (option == "-binary_output")
+        {
+            options.binary_output = true;
+        }
+        else if (option == "-per_thread")
+        {
+            options.per_thread = true;
+        }
+        else if (option == "-cache_simulation")
+        {
+            options.cache_simulation = true;
+        }
+        else if (option == "-cache_next_line_prefetch")
+        {
+            options.cache_simulation_config.next_line_prefetch = true;
+        }
+        else if (option == "-reuse_distance")
+        {
+            options.reuse_distance = true;
+        }
+        else if (option == "-stride_analysis")
+        {
+            options.stride_analysis = true;
+        }
+        else if (option == "-page_footprint")
+        {
+            options.page_footprint = true;
+        }
+        else if (has_value && (option == "-cache_l1d"))
+        {
+            level_configs[0] = argv[++arg_index];
+        }
+        else if (has_value && (option == "-cache_l2"))
+        {
+            level_configs[1] = argv[++arg_index];
+        }
+        else if (has_value && (option == "-cache_llc"))
+        {
+            level_configs[2] = argv[++arg_index];
+        }
+        else if (has_value && (option == "-cache_line_size"))
+        {
+            options.line_size = strtoul (argv[++arg_index], NULL, 0);
+        }
+        else if (has_value && (option == "-cache_replacement"))
+        {
+            replacement = argv[++arg_index];
+        }
+        else if (has_value && (option == "-dtlb_4k"))
+        {
+            tlb_configs[0] = argv[++arg_index];
+        }
+        else if (has_value && (option == "-dtlb_2m"))
+        {
+            tlb_configs[1] = argv[++arg_index];
+        }
+        else
+        {
+            std::cerr << "Invalid option " << option << std::endl;
+            return false;
+        }
+    }
+    first_file_arg = arg_index;
+
+    if ((options.line_size == 0) || ((options.line_size & (options.line_size - 1)) != 0) ||
+        (options.line_size > (1U << trace_page_shifts[0])))
+    {
+        std::cerr << "Invalid cache line size " << options.line_size << std::endl;
+        return false;
+    }
+    if (options.page_footprint)
+    {
+        for (uint32_t page_size = 0; page_size < trace_num_page_sizes; page_size++)
+        {
+            if (!parse_cache_level_config (tlb_configs[page_size], options.tlb_entries[page_size],
+                                           options.tlb_ways[page_size]))
+            {
+                std::cerr << "Invalid TLB configuration " << tlb_configs[page_size] << std::endl;
+                return false;
+            }
+        }
+        if (!tlbs.configure (options.tlb_entries, options.tlb_ways, error))
+        {
+            std::cerr << "Invalid TLB configuration: " << error << std::endl;
+            return false;
+        }
+    }
+    if (options.cache_simulation)
+    {
+        for (uint32_t level = 0; level < cache_num_levels; level++)
+        {
+            if (!parse_cache_level_config (level_configs[level], options.cache_simulation_config.level_sizes[level],
+                                           options.cache_simulation_config.level_ways[level]))
+            {
+                std::cerr << "Invalid cache configuration " << level_configs[level] << std::endl;
+                return false;
+            }
+        }
+        options.cache_simulation_config.line_size = options.line_size;
+        if (replacement == "lru")
+        {
+            options.cache_simulation_config.replacement_policy = CACHE_REPLACEMENT_LRU;
+        }
+        else if (replacement == "plru")
+        {
+            options.cache_simulation_config.replacement_policy = CACHE_REPLACEMENT_PLRU;
+        }
+        else
+        {
+            std::cerr << "Invalid cache replacement policy " << replacement << std::endl;
+            return false;
+        }
+        if (!caches.configure (options.cache_simulation_config, error))
+        {
+            std::cerr << "Invalid cache configuration: " << error << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main (int argc, char *argv[])
+{
+    replay_options options;
+    memory_regions_config regions_config;
+    int first_file_arg = 0;
+
+    if (!parse_options (argc, argv, options, first_file_arg) || ((argc - first_file_arg) != 2))
+    {
+        std::cerr << "Usage: " << argv[0] << " [options] <access_trace> <output>" << std::endl;
+        std::cerr << "Options, which have the same meaning as the memory_profile Pin tool options:" << std::endl;
+        std::cerr << "  -binary_output -per_thread" << std::endl;
+        std::cerr << "  -cache_simulation -cache_l1d <size:ways> -cache_l2 <size:ways> -cache_llc <size:ways>"
+                  << std::endl;
+        std::cerr << "  -cache_line_size <bytes> -cache_replacement <lru|plru> -cache_next_line_prefetch" << std::endl;
+        std::cerr << "  -reuse_distance -stride_analysis" << std::endl;
+        std::cerr << "  -page_footprint -dtlb_4k <entries:ways> -dtlb_2m <entries:ways>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const char *const access_trace_name = argv[first_file_arg];
+    const char *const output_name = argv[first_file_arg + 1];
+
+    std::ifstream access_trace (access_trace_name, std::ios::in | std::ios::binary);
+    if (!access_trace)
+    {
+        std::cerr << "Failed to open " << access_trace_name << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream trace_file (output_name, options.binary_output ? (std::ios::out | std::ios::binary) : std::ios::out);
+    if (!trace_file)
+    {
+        std::cerr << "Failed to create " << output_name << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    regions_config.cache_simulation = options.cache_simulation;
+    regions_config.reuse_distance = options.reuse_distance;
+    regions_config.page_footprint = options.page_footprint;
+    regions_config.line_size = options.line_size;
+    memory_regions_usage::configure (regions_config);
+
+    ostream_trace_sink sink (trace_file);
+    trace_encoder *output;
+
+    if (options.binary_output)
+    {
+        output = new binary_trace_encoder (sink);
+    }
+    else
+    {
+        output = new csv_trace_encoder (sink);
+    }
+    access_trace_replay replay (options, *output);
+    std::string error;
+
+    if (!decode_access_trace (access_trace, replay, error) || !replay.valid (error))
+    {
+        std::cerr << access_trace_name << ": " << error << std::endl;
+        delete output;
+        return EXIT_FAILURE;
+    }
+    replay.finish ();
+    delete output;
+
+    trace_file.close ();
+    if (!trace_file)
+    {
+        std::cerr << "Failed to write " << output_name << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
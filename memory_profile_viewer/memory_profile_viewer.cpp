@@ -0,0 +1,172 @@
+/*
+ * @file memory_profile_viewer.cpp
+ * @date 16 Oct 2026
+ * @details
+ *  Displays the trace streamed live by the memory_profile Pin tool with the stream_socket option, as the profiled
+ *  program runs. The viewer is started first, listening on the socket, and then the Pin tool connects to it.
+ *  The trace is displayed in the .csv format, with a binary trace converted as it arrives, and the viewer exits
+ *  when the Pin tool disconnects.
+ *
+ *  Usage: memory_profile_viewer [options] <socket_path>
+ *
+ *  Options:
+ *    -function <name>  Only display the lines of this top-level function, and the N/A lines for the whole process.
+ *                      May be repeated.
+ *    -summary          Don't display the lines for individual regions and allocations, leaving the enters, exits,
+ *                      totals and heap statistics of each top-level invocation and the samples of the live heap.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <string>
+#include <set>
+
+#include "trace_format.h"
+#include "trace_stream.h"
+
+/** A trace_sink which displays the lines of a .csv trace selected by the options */
+class viewer_sink : public trace_sink
+{
+public:
+    viewer_sink (void) : summary (false) {}
+    virtual void write (const char *data, size_t length);
+    void display_line (const std::string &line);
+
+    /** The top-level functions to display, or empty to display all */
+    std::set<std::string> functions;
+
+    /** Set to only display the summary lines of each invocation */
+    bool summary;
+private:
+    /** The line being received, which doesn't yet have its newline */
+    std::string partial_line;
+};
+
+/**
+ * @brief Display the complete lines of encoded trace, retaining any partial line until the rest is received
+ * @param[in] data The encoded trace
+ * @param[in] length The number of bytes of encoded trace
+ */
+void viewer_sink::write (const char *data, size_t length)
+{
+    const char *const end = data + length;
+
+    while (data < end)
+    {
+        const char *const newline = static_cast<const char *> (memchr (data, '\n', end - data));
+
+        if (newline == NULL)
+        {
+            partial_line.append (data, end);
+            break;
+        }
+        partial_line.append (data, newline);
+        display_line (partial_line);
+        partial_line.clear ();
+        data = newline + 1;
+    }
+}
+
+/**
+ * @brief Display one line of the trace if selected by the options, flushing so that it is seen immediately
+ * @param[in] line The line, without its newline
+ */
+void viewer_sink::display_line (const std::string &line)
+{
+    const std::string::size_type first_comma = line.find (',');
+    const std::string::size_type second_comma =
+            (first_comma != std::string::npos) ? line.find (',', first_comma + 1) : std::string::npos;
+    const std::string func_name = line.substr (0, first_comma);
+
+    if (!functions.empty() && (func_name != "N/A") && (functions.find (func_name) == functions.end()))
+    {
+        return;
+    }
+
+    if (summary && (second_comma != std::string::npos))
+    {
+        const std::string kind = line.substr (first_comma + 1, second_comma - first_comma - 1);
+
+        if ((kind == "allocation") || (line.compare (second_comma + 1, strlen ("start_addr="), "start_addr=") == 0))
+        {
+            return;
+        }
+    }
+
+    std::cout << line << std::endl;
+}
+
+int main (int argc, char *argv[])
+{
+    viewer_sink sink;
+    std::string socket_path;
+    int arg_index;
+
+    for (arg_index = 1; arg_index < argc; arg_index++)
+    {
+        const std::string arg (argv[arg_index]);
+
+        if ((arg == "-function") && ((arg_index + 1) < argc))
+        {
+            arg_index++;
+            sink.functions.insert (argv[arg_index]);
+        }
+        else if (arg == "-summary")
+        {
+            sink.summary = true;
+        }
+        else if (socket_path.empty() && (arg[0] != '-'))
+        {
+            socket_path = arg;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if ((arg_index < argc) || socket_path.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " [-function <name>]... [-summary] <socket_path>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    unix_socket_trace_source source;
+    std::string error;
+
+    if (!source.listen (socket_path, error))
+    {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cerr << "Waiting for memory_profile to connect to " << socket_path << std::endl;
+    if (!source.accept (error))
+    {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (source.peek (binary_trace_magic_length) == binary_trace_magic)
+    {
+        csv_trace_encoder encoder (sink);
+
+        if (!decode_binary_trace (source.stream(), encoder, error))
+        {
+            std::cerr << socket_path << ": " << error << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        std::string line;
+
+        while (std::getline (source.stream(), line))
+        {
+            sink.display_line (line);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}